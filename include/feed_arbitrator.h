@@ -0,0 +1,358 @@
+#pragma once
+#include "soup_bin_connection.h"
+#include "mold_udp64_receiver.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+/***
+ * Arbitrates between redundant A and B lines of the same sequenced feed. Each sequence number
+ * is passed to on_message exactly once, from whichever line delivered it first, and in sequence
+ * order.
+ *
+ * Everything happens in a ring of windowSize slots, one per sequence number, with no locks. A
+ * copy claims its slot with a compare and swap, so a copy the other line already delivered is
+ * dropped without the lines blocking each other. The winner copies its payload into the slot's
+ * buffer (preallocated, maxLength bytes) and marks it ready. Whichever thread gets the drain flag
+ * then sends the ready run from nextDeliver on, so on_message is never called on both lines'
+ * threads at once, and a single threaded consumer can be fed directly.
+ *
+ * Each line is expected in order. A hole is given up as lost once both lines have moved past it,
+ * or once a copy a window ahead of it needs its slot (i.e. the other line is down). A copy that
+ * shows up after that is dropped (counted as late).
+ */
+class FeedArbitrator
+{
+    public:
+    enum class Line : uint8_t
+    {
+        A = 0,
+        B = 1
+    };
+    struct LineStats
+    {
+        uint64_t received = 0;
+        uint64_t wins = 0; // copies that were first
+        uint64_t duplicates = 0; // copies that the other line already delivered
+        uint64_t late = 0; // copies that came after their hole was given up
+        uint64_t gaps = 0; // number of times this line skipped ahead
+        uint64_t missing = 0; // messages this line skipped
+        double win_rate() const { return received == 0 ? 0.0 : (double)wins / received; }
+    };
+    struct Stats
+    {
+        LineStats lines[2];
+        uint64_t emitted = 0;
+        uint64_t lost = 0; // messages neither line delivered, given up to let the ones after them go
+        uint64_t held = 0; // wins waiting for the messages before them
+    };
+
+    /***
+     * @param windowSize how far apart (in messages) the lines can drift. Must be a power of 2.
+     * @param maxLength the longest message, each slot keeps a buffer this big
+     */
+    FeedArbitrator(size_t windowSize = 65536, size_t maxLength = 64) : windowSize(windowSize),
+            mask(windowSize - 1), maxLength(maxLength), slots(new Slot[windowSize]),
+            buffers(new uint8_t[windowSize * maxLength])
+    {
+        if (windowSize == 0 || (windowSize & mask) != 0)
+            throw std::invalid_argument("Window size must be a power of 2");
+        for(size_t i = 0; i < windowSize; ++i)
+        {
+            slots[i].claimed.store(0, std::memory_order_relaxed);
+            slots[i].state.store(0, std::memory_order_relaxed);
+        }
+    }
+    virtual ~FeedArbitrator() {}
+
+    /****
+     * @brief hand in a message from one of the lines
+     * @param line the line it came from
+     * @param seqNo the sequence number (starting at 1)
+     * @param data the message
+     * @param length the length of the message, no more than maxLength
+     * @return true if this copy won and was passed on (now or later)
+     */
+    bool on_line_message(Line line, uint64_t seqNo, const uint8_t* data, size_t length)
+    {
+        if (length > maxLength)
+            throw std::invalid_argument("Message is longer than the arbitrator's slots");
+        LineCounters& counters = lines[(uint8_t)line];
+        counters.received.fetch_add(1, std::memory_order_relaxed);
+        uint64_t expected = counters.expected.load(std::memory_order_relaxed);
+        if (seqNo > expected)
+        {
+            if (expected != 0)
+            {
+                counters.gaps.fetch_add(1, std::memory_order_relaxed);
+                counters.missing.fetch_add(seqNo - expected, std::memory_order_relaxed);
+            }
+            counters.expected.store(seqNo + 1, std::memory_order_relaxed);
+        }
+        else if (seqNo == expected)
+        {
+            counters.expected.store(seqNo + 1, std::memory_order_relaxed);
+        }
+        // this line is done with everything before seqNo, so holes there can be given up
+        advance(counters, seqNo);
+        // the first message from either line is where the feed starts for us
+        uint64_t start = 0;
+        nextDeliver.compare_exchange_strong(start, seqNo, std::memory_order_seq_cst);
+        bool won = claim(counters, seqNo) && pass_on(counters, seqNo, data, length);
+        advance(counters, seqNo + 1);
+        // this copy, or this line moving past a hole, may let the next ones go
+        drain();
+        return won;
+    }
+
+    Stats get_stats() const
+    {
+        Stats stats;
+        for(int i = 0; i < 2; ++i)
+        {
+            stats.lines[i].received = lines[i].received.load(std::memory_order_relaxed);
+            stats.lines[i].wins = lines[i].wins.load(std::memory_order_relaxed);
+            stats.lines[i].duplicates = lines[i].duplicates.load(std::memory_order_relaxed);
+            stats.lines[i].late = lines[i].late.load(std::memory_order_relaxed);
+            stats.lines[i].gaps = lines[i].gaps.load(std::memory_order_relaxed);
+            stats.lines[i].missing = lines[i].missing.load(std::memory_order_relaxed);
+        }
+        stats.emitted = emitted.load(std::memory_order_relaxed);
+        stats.lost = lost.load(std::memory_order_relaxed);
+        stats.held = held.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    protected:
+    /***
+     * Called once per sequence number, in order, one call at a time
+     */
+    virtual void on_message(uint64_t seqNo, const uint8_t* data, size_t length) {}
+
+    private:
+    // each line gets its own cache line so they do not fight over the counters
+    struct alignas(64) LineCounters
+    {
+        std::atomic<uint64_t> expected = 0;
+        std::atomic<uint64_t> passed = 0; // everything before this has been claimed, held or dropped
+        std::atomic<uint64_t> received = 0;
+        std::atomic<uint64_t> wins = 0;
+        std::atomic<uint64_t> duplicates = 0;
+        std::atomic<uint64_t> late = 0;
+        std::atomic<uint64_t> gaps = 0;
+        std::atomic<uint64_t> missing = 0;
+    };
+    /***
+     * state is the sequence number whose payload is in the buffer, with WRITING while the winner
+     * copies it in, or GIVEN_UP once the drain has skipped it
+     */
+    struct Slot
+    {
+        std::atomic<uint64_t> claimed; // the last sequence number a line claimed
+        std::atomic<uint64_t> state;
+        size_t length = 0;
+    };
+    static constexpr uint64_t WRITING = 1ULL << 63;
+    static constexpr uint64_t GIVEN_UP = 1ULL << 62;
+    static constexpr uint64_t SEQUENCE = GIVEN_UP - 1;
+
+    /***
+     * The line's thread only writes its own passed. The publishing and draining are seq_cst, so a
+     * drain that gives up after a copy was marked ready sees it, and a line that publishes after
+     * the drain flag was let go finds the work and drains it.
+     */
+    void advance(LineCounters& counters, uint64_t seqNo)
+    {
+        if (seqNo > counters.passed.load(std::memory_order_relaxed))
+            counters.passed.store(seqNo, std::memory_order_seq_cst);
+    }
+    /***
+     * @returns true if no copy of seqNo has been claimed before
+     */
+    bool claim(LineCounters& counters, uint64_t seqNo)
+    {
+        std::atomic<uint64_t>& slot = slots[seqNo & mask].claimed;
+        uint64_t previous = slot.load(std::memory_order_acquire);
+        do
+        {
+            if (previous >= seqNo)
+            {
+                if (previous == seqNo)
+                    counters.duplicates.fetch_add(1, std::memory_order_relaxed);
+                else
+                    counters.late.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while(!slot.compare_exchange_weak(previous, seqNo, std::memory_order_acq_rel, std::memory_order_acquire));
+        return true;
+    }
+    /***
+     * A claimed copy goes into its slot, to be sent by the drain
+     * @returns false if its hole was given up already
+     */
+    bool pass_on(LineCounters& counters, uint64_t seqNo, const uint8_t* data, size_t length)
+    {
+        // the slot still has the message a window back, so give up the holes until it has gone
+        uint64_t next = nextDeliver.load(std::memory_order_seq_cst);
+        while(seqNo >= next + windowSize)
+        {
+            raise(giveUpTo, seqNo - windowSize + 1);
+            if (!drain())
+                std::this_thread::yield();
+            next = nextDeliver.load(std::memory_order_seq_cst);
+        }
+        Slot& slot = slots[seqNo & mask];
+        uint64_t state = slot.state.load(std::memory_order_seq_cst);
+        if (seqNo < next || (state & SEQUENCE) >= seqNo
+                || !slot.state.compare_exchange_strong(state, seqNo | WRITING, std::memory_order_seq_cst))
+        {
+            counters.late.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // the slot is ours until it is marked ready
+        counters.wins.fetch_add(1, std::memory_order_relaxed);
+        memcpy(buffer(seqNo), data, length);
+        slot.length = length;
+        held.fetch_add(1, std::memory_order_relaxed);
+        slot.state.store(seqNo, std::memory_order_seq_cst);
+        return true;
+    }
+    /***
+     * Sends the ready run that is next, giving up the holes in front of it that will not be
+     * filled. Only the thread that gets the flag does it, the others carry on.
+     * @returns true if anything was sent or given up
+     */
+    bool drain()
+    {
+        bool progress = false;
+        // having let the flag go, look again, in case a copy was marked ready just before
+        while(pending() && !draining.exchange(true, std::memory_order_seq_cst))
+        {
+            uint64_t next = nextDeliver.load(std::memory_order_seq_cst);
+            while(true)
+            {
+                Slot& slot = slots[next & mask];
+                uint64_t state = slot.state.load(std::memory_order_seq_cst);
+                if (state == next)
+                {
+                    deliver(next, buffer(next), slot.length);
+                    held.fetch_sub(1, std::memory_order_relaxed);
+                }
+                else if (state == (next | WRITING) || !can_give_up(next))
+                    break;
+                else if (slot.state.compare_exchange_strong(state, next | GIVEN_UP, std::memory_order_seq_cst))
+                    lost.fetch_add(1, std::memory_order_relaxed);
+                else
+                    continue; // claimed just now
+                nextDeliver.store(++next, std::memory_order_seq_cst);
+                progress = true;
+            }
+            draining.store(false, std::memory_order_seq_cst);
+        }
+        return progress;
+    }
+    /***
+     * @returns true if the next one to go out is ready, or can be given up
+     */
+    bool pending() const
+    {
+        uint64_t next = nextDeliver.load(std::memory_order_seq_cst);
+        if (next == 0)
+            return false;
+        uint64_t state = slots[next & mask].state.load(std::memory_order_seq_cst);
+        return state == next || (state != (next | WRITING) && can_give_up(next));
+    }
+    /***
+     * @returns true if both lines have moved past seqNo, or a copy a window ahead needs its slot
+     */
+    bool can_give_up(uint64_t seqNo) const
+    {
+        return seqNo < std::min(lines[0].passed.load(std::memory_order_seq_cst),
+                lines[1].passed.load(std::memory_order_seq_cst))
+                || seqNo < giveUpTo.load(std::memory_order_seq_cst);
+    }
+    static void raise(std::atomic<uint64_t>& value, uint64_t to)
+    {
+        uint64_t curr = value.load(std::memory_order_seq_cst);
+        while(curr < to && !value.compare_exchange_weak(curr, to, std::memory_order_seq_cst))
+            ;
+    }
+    uint8_t* buffer(uint64_t seqNo) const { return buffers.get() + (seqNo & mask) * maxLength; }
+    void deliver(uint64_t seqNo, const uint8_t* data, size_t length)
+    {
+        emitted.fetch_add(1, std::memory_order_relaxed);
+        on_message(seqNo, data, length);
+    }
+
+    const size_t windowSize;
+    const size_t mask;
+    const size_t maxLength;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<uint8_t[]> buffers; // maxLength bytes per slot
+    LineCounters lines[2];
+    alignas(64) std::atomic<uint64_t> emitted = 0;
+    std::atomic<uint64_t> lost = 0;
+    std::atomic<uint64_t> held = 0; // marked ready and not sent yet
+    // delivery, by whichever thread has the flag
+    alignas(64) std::atomic<bool> draining = false;
+    std::atomic<uint64_t> nextDeliver = 0; // starts at the first sequence number seen
+    std::atomic<uint64_t> giveUpTo = 0; // holes before this are given up, to free their slots
+};
+
+/***
+ * A MoldUDP64 group feeding one line of an arbitrator
+ */
+class ArbitratedMoldUDP64Receiver : public MoldUDP64Receiver
+{
+    public:
+    ArbitratedMoldUDP64Receiver(FeedArbitrator& arbitrator, FeedArbitrator::Line line, const std::string& group,
+            uint16_t port, const std::string& interfaceAddress = "0.0.0.0", const std::string& rewindServer = "")
+            : MoldUDP64Receiver(group, port, interfaceAddress, rewindServer), arbitrator(arbitrator), line(line) {}
+
+    protected:
+    virtual void on_message(uint64_t seqNo, const uint8_t* data, uint16_t length) override
+    {
+        arbitrator.on_line_message(line, seqNo, data, length);
+    }
+
+    private:
+    FeedArbitrator& arbitrator;
+    const FeedArbitrator::Line line;
+};
+
+/***
+ * A SoupBinTCP session feeding one line of an arbitrator
+ */
+class ArbitratedSoupBinConnection : public SoupBinConnection
+{
+    public:
+    ArbitratedSoupBinConnection(FeedArbitrator& arbitrator, FeedArbitrator::Line line, const std::string& url,
+            const std::string& username, const std::string& password, const std::string& sessionId = "",
+            uint64_t nextSequenceNo = 0)
+            : SoupBinConnection(url, username, password, sessionId, nextSequenceNo), arbitrator(arbitrator),
+            line(line)
+    {
+        connect();
+    }
+
+    protected:
+    virtual void on_login_accepted(const soupbintcp::login_accepted& in) override
+    {
+        status = Status::CONNECTED;
+        nextSeq = in.get_int(soupbintcp::login_accepted::SEQUENCE_NUMBER);
+        sessionId = in.get_string(soupbintcp::login_accepted::SESSION);
+    }
+    virtual void on_sequenced_data(const soupbintcp::sequenced_data& in) override
+    {
+        arbitrator.on_line_message(line, get_next_seq(), in.get_record() + soupbintcp::SEQUENCED_DATA_LEN,
+                in.get_int(soupbintcp::sequenced_data::PACKET_LENGTH) - 1);
+    }
+    virtual void on_sequenced_data_filtered() override { get_next_seq(); }
+
+    private:
+    FeedArbitrator& arbitrator;
+    const FeedArbitrator::Line line;
+};
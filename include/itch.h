@@ -4,6 +4,7 @@
 #include <climits>
 #include <string>
 #include <memory>
+#include "itch_price.h"
 
 namespace itch
 {
@@ -62,6 +63,11 @@ struct message {
             case 4:
                 retVal = (int64_t)swap_endian_bytes<uint32_t>(*(uint32_t*)&record[mr.offset]);
                 break;
+            case 6:
+                // TIMESTAMP (nanoseconds since midnight)
+                for(uint8_t i = 0; i < 6; ++i)
+                    retVal = (retVal << 8) | record[mr.offset + i];
+                break;
             case 8:
                 retVal = (int64_t)swap_endian_bytes<uint64_t>(*(uint64_t*)&record[mr.offset]);
                 break;
@@ -83,6 +89,13 @@ struct message {
             case 4:
                 tmp = swap_endian_bytes<uint32_t>(in);
                 break;
+            case 6:
+                for(int i = 5; i >= 0; --i)
+                {
+                    record[mr.offset + i] = (uint8_t)tmp;
+                    tmp = (uint64_t)tmp >> 8;
+                }
+                return;
             case 8:
                 tmp = swap_endian_bytes<uint64_t>(in);
                 break;
@@ -91,23 +104,99 @@ struct message {
         }
         memcpy(&record[mr.offset], &tmp, mr.length);
     }
+    /***
+     * PRICE4 fields
+     */
+    price4 get_price4(const message_record& mr) const { return price4(get_int(mr)); }
+    /***
+     * PRICE8 fields
+     */
+    price8 get_price8(const message_record& mr) const { return price8(get_int(mr)); }
+    template<int DECIMALS>
+    void set_price(const message_record& mr, fixed_price<DECIMALS> in) { set_int(mr, in.raw()); }
     void set_string(const message_record& mr, const std::string& in)
     {
         strncpy((char*)&record[mr.offset], in.c_str(), mr.length);
     }
+    /***
+     * Single character ALPHA fields
+     */
+    void set_char(const message_record& mr, char in) { record[mr.offset] = (uint8_t)in; }
     const std::string get_string(const message_record& mr) const
     {
-        // get the section of the record we want
-        char buf[mr.length+1];
-        memset(buf, 0, mr.length+1);
-        strncpy(buf, (char*)&record[mr.offset], mr.length);
-        return buf;
+        // up to the first NUL, like strncpy, without the copy through a VLA
+        const char* start = (const char*)&record[mr.offset];
+        return std::string(start, strnlen(start, mr.length));
     }
     const uint8_t* get_record() const { return record; }
     protected:
     uint8_t record[SIZE];
 };
 
+/****
+ * @brief read an integer field straight out of a raw record, without building a message
+ * @param record the record (starting with the message type)
+ * @param mr the field
+ * @return the value
+ */
+inline uint64_t get_int(const uint8_t* record, const message_record& mr)
+{
+    uint64_t retVal = 0;
+    for(uint8_t i = 0; i < mr.length; ++i)
+        retVal = (retVal << 8) | record[mr.offset + i];
+    return retVal;
+}
+
+inline price4 get_price4(const uint8_t* record, const message_record& mr)
+{
+    return price4(get_int(record, mr));
+}
+
+inline price8 get_price8(const uint8_t* record, const message_record& mr)
+{
+    return price8(get_int(record, mr));
+}
+
+/***
+ * @returns the STOCK_LOCATE of a raw record (every message has it in the same place)
+ */
+inline uint16_t get_stock_locate(const uint8_t* record)
+{
+    return ((uint16_t)record[1] << 8) | record[2];
+}
+
+/***
+ * Symbols are 8 characters, padded on the right with spaces. Packed into an integer they
+ * compare in one instruction.
+ */
+inline uint64_t pack_symbol(const uint8_t* symbol)
+{
+    uint8_t buf[8];
+    for(int i = 0; i < 8; ++i)
+        buf[i] = symbol[i] == 0 ? ' ' : symbol[i];
+    uint64_t retVal;
+    memcpy(&retVal, buf, 8);
+    return retVal;
+}
+
+inline uint64_t pack_symbol(const std::string& symbol)
+{
+    uint8_t buf[8];
+    memset(buf, ' ', 8);
+    memcpy(buf, symbol.c_str(), symbol.size() < 8 ? symbol.size() : 8);
+    return pack_symbol(buf);
+}
+
+inline std::string unpack_symbol(uint64_t symbol)
+{
+    char buf[8];
+    memcpy(buf, &symbol, 8);
+    size_t len = 8;
+    while(len > 0 && buf[len - 1] == ' ')
+        len--;
+    return std::string(buf, len);
+}
+
 const static int8_t SYSTEM_EVENT_LEN = 12;
 struct system_event : public message<SYSTEM_EVENT_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA};
@@ -133,7 +222,7 @@ struct system_event : public message<SYSTEM_EVENT_LEN> {
         set_int(STOCK_LOCATE, stock_locate);
         set_int(TRACKING_NUMBER, tracking_number);
         set_int(TIMESTAMP, timestamp);
-        set_string(EVENT_CODE, std::to_string(event_code));
+        set_char(EVENT_CODE, event_code);
     }
 };
 
@@ -223,19 +312,19 @@ struct stock_directory : public message<STOCK_DIRECTORY_LEN> {
         set_int(TRACKING_NUMBER, tracking_number);
         set_int(TIMESTAMP, timestamp);
         set_string(STOCK, stock);
-        set_string(MARKET_CATEGORY, std::to_string(market_category)); // important
-        set_string(FINANCIAL_STATUS_INDICATOR, std::to_string(financial_status_indicator)); // important
+        set_char(MARKET_CATEGORY, market_category); // important
+        set_char(FINANCIAL_STATUS_INDICATOR, financial_status_indicator); // important
         set_int(ROUND_LOT_SIZE, round_lot_size);
-        set_string(ROUND_LOTS_ONLY, std::to_string(round_lots_only));
-        set_string(ISSUE_CLASSIFICATION, std::to_string(issue_classification));
+        set_char(ROUND_LOTS_ONLY, round_lots_only);
+        set_char(ISSUE_CLASSIFICATION, issue_classification);
         set_string(ISSUE_SUB_TYPE, issue_sub_type);
-        set_string(AUTHENTICITY, std::to_string(authenticity));
-        set_string(SHORT_SALE_THRESHOLD_INDICATOR, std::to_string(short_sale_threshold_indicator));
-        set_string(IPO_FLAG, std::to_string(ipo_flag));
-        set_string(LULDREFERENCE_PRICE_TIER, std::to_string(luldreference_price_tier));
-        set_string(ETP_FLAG, std::to_string(etp_flag));
+        set_char(AUTHENTICITY, authenticity);
+        set_char(SHORT_SALE_THRESHOLD_INDICATOR, short_sale_threshold_indicator);
+        set_char(IPO_FLAG, ipo_flag);
+        set_char(LULDREFERENCE_PRICE_TIER, luldreference_price_tier);
+        set_char(ETP_FLAG, etp_flag);
         set_int(ETP_LEVERAGE_FACTOR, etp_leverage_factor);
-        set_string(INVERSE_INDICATOR, std::to_string(inverse_indicator));
+        set_char(INVERSE_INDICATOR, inverse_indicator);
     }
 };
 
@@ -265,8 +354,8 @@ struct stock_trading_action : public message<STOCK_TRADING_ACTION_LEN> {
         set_int(TRACKING_NUMBER, tracking_number);
         set_int(TIMESTAMP, timestamp);
         set_string(STOCK, stock);
-        set_string(TRADING_STATE, std::to_string(trading_state));
-        set_string(RESERVED, std::to_string(reserved));
+        set_char(TRADING_STATE, trading_state);
+        set_char(RESERVED, reserved);
         set_string(REASON, reason);
     }
 };
@@ -320,7 +409,7 @@ struct market_participant_position : public message<MARKET_PARTICIPANT_POSITION_
 const static int8_t MWCP_DECLINE_LEVEL_LEN = 35;
 struct mwcp_decline_level : public message<MWCP_DECLINE_LEVEL_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record LEVEL_1{11, 8, message_record::field_type::PRICE8};
@@ -334,7 +423,7 @@ struct mwcp_decline_level : public message<MWCP_DECLINE_LEVEL_LEN> {
 const static int8_t MWCP_STATUS_LEN = 12;
 struct mwcp_status : public message<MWCP_STATUS_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record BREACHED_LEVEL{11, 1, message_record::field_type::ALPHA};
@@ -346,7 +435,7 @@ struct mwcp_status : public message<MWCP_STATUS_LEN> {
 const static int8_t IPO_QUOTING_PERIOD_UPDATE_LEN = 28;
 struct ipo_quoting_period_update : public message<IPO_QUOTING_PERIOD_UPDATE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{11, 8, message_record::field_type::ALPHA};
@@ -361,7 +450,7 @@ struct ipo_quoting_period_update : public message<IPO_QUOTING_PERIOD_UPDATE_LEN>
 const static int8_t LULD_AUCTION_COLLAR_LEN = 35;
 struct luld_auction_collar : public message<LULD_AUCTION_COLLAR_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{11, 8, message_record::field_type::ALPHA};
@@ -377,7 +466,7 @@ struct luld_auction_collar : public message<LULD_AUCTION_COLLAR_LEN> {
 const static int8_t OPERATIONAL_HALT_LEN = 21;
 struct operational_halt : public message<OPERATIONAL_HALT_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{11, 8, message_record::field_type::ALPHA};
@@ -391,7 +480,7 @@ struct operational_halt : public message<OPERATIONAL_HALT_LEN> {
 const static int8_t ADD_ORDER_LEN = 36;
 struct add_order : public message<ADD_ORDER_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -410,7 +499,7 @@ struct add_order : public message<ADD_ORDER_LEN> {
 const static int8_t ADD_ORDER_WITH_MPID_LEN = 40;
 struct add_order_with_mpid : public message<ADD_ORDER_WITH_MPID_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     /***
@@ -435,7 +524,7 @@ struct add_order_with_mpid : public message<ADD_ORDER_WITH_MPID_LEN> {
 const static int8_t ORDER_EXECUTED_LEN = 31;
 struct order_executed : public message<ORDER_EXECUTED_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -449,7 +538,7 @@ struct order_executed : public message<ORDER_EXECUTED_LEN> {
 const static int8_t ORDER_EXECUTED_WITH_PRICE_LEN = 36;
 struct order_executed_with_price : public message<ORDER_EXECUTED_WITH_PRICE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -465,7 +554,7 @@ struct order_executed_with_price : public message<ORDER_EXECUTED_WITH_PRICE_LEN>
 const static int8_t ORDER_CANCEL_LEN = 23;
 struct order_cancel : public message<ORDER_CANCEL_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -478,7 +567,7 @@ struct order_cancel : public message<ORDER_CANCEL_LEN> {
 const static int8_t ORDER_DELETE_LEN = 19;
 struct order_delete : public message<ORDER_DELETE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -490,7 +579,7 @@ struct order_delete : public message<ORDER_DELETE_LEN> {
 const static int8_t ORDER_REPLACE_LEN = 35;
 struct order_replace : public message<ORDER_REPLACE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORIGINAL_ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -505,7 +594,7 @@ struct order_replace : public message<ORDER_REPLACE_LEN> {
 const static int8_t TRADE_LEN = 44;
 struct trade : public message<TRADE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record ORDER_REFERENCE_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -522,10 +611,10 @@ struct trade : public message<TRADE_LEN> {
 const static int8_t CROSS_TRADE_LEN = 40;
 struct cross_trade : public message<CROSS_TRADE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
-    static constexpr message_record SHARES{11, 4, message_record::field_type::INTEGER};
+    static constexpr message_record SHARES{11, 8, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{19, 8, message_record::field_type::ALPHA};
     static constexpr message_record CROSS_PRICE{27, 4, message_record::field_type::PRICE4};
     static constexpr message_record MATCH_NUMBER{31, 8, message_record::field_type::INTEGER};
@@ -538,7 +627,7 @@ struct cross_trade : public message<CROSS_TRADE_LEN> {
 const static int8_t BROKEN_TRADE_LEN = 19;
 struct broken_trade : public message<BROKEN_TRADE_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record MATCH_NUMBER{11, 8, message_record::field_type::INTEGER};
@@ -550,7 +639,7 @@ struct broken_trade : public message<BROKEN_TRADE_LEN> {
 const static int8_t NOII_LEN = 50;
 struct noii : public message<NOII_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record PAIRED_SHARES{11, 8, message_record::field_type::INTEGER};
@@ -570,7 +659,7 @@ struct noii : public message<NOII_LEN> {
 const static int8_t RPII_LEN = 20;
 struct rpii : public message<RPII_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{11, 8, message_record::field_type::ALPHA};
@@ -584,7 +673,7 @@ const static int8_t DIRECT_LISTING_WITH_CAPITAL_RAISE_PRICE_DISCOVERY_LEN = 48;
 struct direct_listing_with_capital_raise_price_discovery : 
         public message<DIRECT_LISTING_WITH_CAPITAL_RAISE_PRICE_DISCOVERY_LEN> {
     static constexpr message_record MESSAGE_TYPE{0, 1, message_record::field_type::ALPHA}; 
-    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::ALPHA}; 
+    static constexpr message_record STOCK_LOCATE{1, 2, message_record::field_type::INTEGER}; 
     static constexpr message_record TRACKING_NUMBER{3, 2, message_record::field_type::INTEGER};
     static constexpr message_record TIMESTAMP{5, 6, message_record::field_type::INTEGER};
     static constexpr message_record STOCK{11, 8, message_record::field_type::ALPHA};
@@ -600,4 +689,39 @@ struct direct_listing_with_capital_raise_price_discovery :
     direct_listing_with_capital_raise_price_discovery(const uint8_t* in) : message(in) {}
 };
 
+/***
+ * @returns the length of a record of the given message type, or 0 if the type is unknown
+ */
+inline uint8_t get_record_length(uint8_t messageType)
+{
+    switch(messageType)
+    {
+        case('S'): return SYSTEM_EVENT_LEN;
+        case('R'): return STOCK_DIRECTORY_LEN;
+        case('H'): return STOCK_TRADING_ACTION_LEN;
+        case('Y'): return REG_SHO_RESTRICTION_LEN;
+        case('L'): return MARKET_PARTICIPANT_POSITION_LEN;
+        case('V'): return MWCP_DECLINE_LEVEL_LEN;
+        case('W'): return MWCP_STATUS_LEN;
+        case('K'): return IPO_QUOTING_PERIOD_UPDATE_LEN;
+        case('J'): return LULD_AUCTION_COLLAR_LEN;
+        case('h'): return OPERATIONAL_HALT_LEN;
+        case('A'): return ADD_ORDER_LEN;
+        case('F'): return ADD_ORDER_WITH_MPID_LEN;
+        case('E'): return ORDER_EXECUTED_LEN;
+        case('C'): return ORDER_EXECUTED_WITH_PRICE_LEN;
+        case('X'): return ORDER_CANCEL_LEN;
+        case('D'): return ORDER_DELETE_LEN;
+        case('U'): return ORDER_REPLACE_LEN;
+        case('P'): return TRADE_LEN;
+        case('Q'): return CROSS_TRADE_LEN;
+        case('B'): return BROKEN_TRADE_LEN;
+        case('I'): return NOII_LEN;
+        case('N'): return RPII_LEN;
+        case('O'): return DIRECT_LISTING_WITH_CAPITAL_RAISE_PRICE_DISCOVERY_LEN;
+        default: break;
+    }
+    return 0;
+}
+
 } // end namespace itch
@@ -0,0 +1,326 @@
+#pragma once
+#include "itch.h"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+
+namespace itch
+{
+
+/***
+ * One print on the trade tape
+ */
+struct print {
+    uint64_t timestamp = 0; // nanoseconds since midnight
+    uint64_t match_number = 0;
+    uint64_t shares = 0;
+    uint32_t price = 0; // 4 decimal places
+    uint16_t locate = 0;
+    char message_type = ' '; // P, Q or C
+    bool broken = false;
+    uint32_t bar = 0; // the bar the print went into
+    uint32_t next = 0; // the next print in the same bar
+};
+
+/***
+ * A bar, copied out of the columns
+ */
+struct bar {
+    uint16_t locate = 0;
+    uint64_t start = 0; // nanoseconds since midnight
+    uint32_t open = 0;
+    uint32_t high = 0;
+    uint32_t low = 0;
+    uint32_t close = 0;
+    uint64_t volume = 0;
+    uint64_t notional = 0; // sum of price * shares
+    uint32_t trades = 0;
+    double vwap() const { return volume == 0 ? 0.0 : (double)notional / volume / 10000.0; }
+    price4 vwap_price() const { return volume == 0 ? price4() : price4((int64_t)notional) / (int64_t)volume; }
+};
+
+/***
+ * Builds OHLCV bars and a trade tape from the executions in the feed.
+ *
+ * trade (P), cross_trade (Q) and printable order_executed_with_price (C) messages are counted.
+ * order_executed (E) does not carry a price, so it needs an order book and is not counted here.
+ *
+ * Bars are kept as columns (one vector per field) and indexed by the order they were opened in.
+ * Each STOCK_LOCATE has at most one open bar. Bars are aligned to multiples of the interval and
+ * are closed when the TIMESTAMP of any message passes the end of the interval, so a quiet
+ * instrument does not hold its bar open. Intervals without trades get no bar.
+ *
+ * A broken_trade takes the print off the tape and rebuilds the bar it went into, even if that
+ * bar has already closed.
+ */
+class bar_aggregator
+{
+    public:
+    static const size_t MAX_LOCATES = 65536;
+    static constexpr uint32_t NO_BAR = UINT32_MAX;
+    static constexpr uint32_t NO_PRINT = UINT32_MAX;
+
+    struct bar_columns {
+        std::vector<uint16_t> locate;
+        std::vector<uint64_t> start;
+        std::vector<uint32_t> open;
+        std::vector<uint32_t> high;
+        std::vector<uint32_t> low;
+        std::vector<uint32_t> close;
+        std::vector<uint64_t> volume;
+        std::vector<uint64_t> notional;
+        std::vector<uint32_t> trades;
+    };
+
+    /***
+     * @param intervalNs the length of a bar in nanoseconds
+     */
+    bar_aggregator(uint64_t intervalNs) : interval(intervalNs), currentBar(MAX_LOCATES, NO_BAR),
+            dayVolume(MAX_LOCATES), dayNotional(MAX_LOCATES), dayTrades(MAX_LOCATES)
+    {
+        if (interval == 0)
+            throw std::invalid_argument("Bar interval must be greater than 0");
+    }
+    virtual ~bar_aggregator() {}
+
+    /****
+     * @brief update the bars from a raw ITCH record
+     * @param record the record, starting with the message type
+     * @return true if the record changed the tape
+     */
+    bool apply(const uint8_t* record)
+    {
+        uint64_t timestamp = get_int(record, trade::TIMESTAMP);
+        if (timestamp >= intervalEnd)
+            roll(timestamp);
+        switch(record[0])
+        {
+            case('P'):
+                add_print(record, timestamp, get_int(record, trade::PRICE), get_int(record, trade::SHARES),
+                        get_int(record, trade::MATCH_NUMBER));
+                return true;
+            case('Q'):
+            {
+                uint64_t shares = get_int(record, cross_trade::SHARES);
+                if (shares == 0)
+                    return false;
+                add_print(record, timestamp, get_int(record, cross_trade::CROSS_PRICE), shares,
+                        get_int(record, cross_trade::MATCH_NUMBER));
+                return true;
+            }
+            case('C'):
+                if (record[order_executed_with_price::PRINTABLE.offset] != 'Y')
+                    return false;
+                add_print(record, timestamp, get_int(record, order_executed_with_price::EXECUTION_PRICE),
+                        get_int(record, order_executed_with_price::EXECUTED_SHARES),
+                        get_int(record, order_executed_with_price::MATCH_NUMBER));
+                return true;
+            case('B'):
+                return break_print(get_int(record, broken_trade::MATCH_NUMBER));
+            default:
+                break;
+        }
+        return false;
+    }
+    template<unsigned int SIZE>
+    bool apply(const message<SIZE>& msg) { return apply(msg.get_record()); }
+
+    /***
+     * Close every open bar (i.e. at the end of the day)
+     */
+    void flush()
+    {
+        for(uint16_t locate : openLocates)
+        {
+            uint32_t idx = currentBar[locate];
+            currentBar[locate] = NO_BAR;
+            on_bar(idx);
+        }
+        openLocates.clear();
+    }
+
+    /***
+     * Forget everything (i.e. at the start of a new day)
+     */
+    void clear()
+    {
+        columns = bar_columns();
+        firstPrint.clear();
+        lastPrint.clear();
+        tape.clear();
+        matches.clear();
+        openLocates.clear();
+        std::fill(currentBar.begin(), currentBar.end(), NO_BAR);
+        std::fill(dayVolume.begin(), dayVolume.end(), 0);
+        std::fill(dayNotional.begin(), dayNotional.end(), 0);
+        std::fill(dayTrades.begin(), dayTrades.end(), 0);
+        intervalEnd = 0;
+    }
+
+    size_t size() const { return columns.start.size(); }
+    const bar_columns& get_columns() const { return columns; }
+    bar get_bar(size_t idx) const
+    {
+        bar retVal;
+        retVal.locate = columns.locate[idx];
+        retVal.start = columns.start[idx];
+        retVal.open = columns.open[idx];
+        retVal.high = columns.high[idx];
+        retVal.low = columns.low[idx];
+        retVal.close = columns.close[idx];
+        retVal.volume = columns.volume[idx];
+        retVal.notional = columns.notional[idx];
+        retVal.trades = columns.trades[idx];
+        return retVal;
+    }
+    /***
+     * @returns the index of the open bar for the locate, or NO_BAR
+     */
+    uint32_t get_current_bar(uint16_t locate) const { return currentBar[locate]; }
+    const std::vector<print>& get_tape() const { return tape; }
+
+    // running totals for the day, less broken trades
+    uint64_t get_volume(uint16_t locate) const { return dayVolume[locate]; }
+    uint32_t get_trade_count(uint16_t locate) const { return dayTrades[locate]; }
+    double get_vwap(uint16_t locate) const
+    {
+        return dayVolume[locate] == 0 ? 0.0 : (double)dayNotional[locate] / dayVolume[locate] / 10000.0;
+    }
+    price4 get_vwap_price(uint16_t locate) const
+    {
+        return dayVolume[locate] == 0 ? price4() : price4((int64_t)dayNotional[locate]) / (int64_t)dayVolume[locate];
+    }
+
+    protected:
+    /***
+     * Called when a bar closes
+     */
+    virtual void on_bar(uint32_t idx) {}
+    /***
+     * Called when a broken trade changes a bar (open or closed)
+     */
+    virtual void on_bar_corrected(uint32_t idx) {}
+
+    void roll(uint64_t timestamp)
+    {
+        flush();
+        intervalEnd = timestamp - timestamp % interval + interval;
+    }
+
+    void add_print(const uint8_t* record, uint64_t timestamp, uint32_t price, uint64_t shares, uint64_t matchNumber)
+    {
+        uint16_t locate = get_stock_locate(record);
+        uint32_t idx = currentBar[locate];
+        uint32_t printIdx = tape.size();
+        if (idx == NO_BAR)
+        {
+            idx = open_bar(locate, timestamp - timestamp % interval);
+            firstPrint[idx] = printIdx;
+        }
+        else
+        {
+            tape[lastPrint[idx]].next = printIdx;
+        }
+        lastPrint[idx] = printIdx;
+        print curr;
+        curr.timestamp = timestamp;
+        curr.match_number = matchNumber;
+        curr.shares = shares;
+        curr.price = price;
+        curr.locate = locate;
+        curr.message_type = record[0];
+        curr.bar = idx;
+        curr.next = NO_PRINT;
+        tape.push_back(curr);
+        matches[matchNumber] = printIdx;
+        add_to_bar(idx, price, shares);
+        dayVolume[locate] += shares;
+        dayNotional[locate] += (uint64_t)price * shares;
+        dayTrades[locate]++;
+    }
+
+    uint32_t open_bar(uint16_t locate, uint64_t start)
+    {
+        uint32_t idx = columns.start.size();
+        columns.locate.push_back(locate);
+        columns.start.push_back(start);
+        columns.open.push_back(0);
+        columns.high.push_back(0);
+        columns.low.push_back(0);
+        columns.close.push_back(0);
+        columns.volume.push_back(0);
+        columns.notional.push_back(0);
+        columns.trades.push_back(0);
+        firstPrint.push_back(NO_PRINT);
+        lastPrint.push_back(NO_PRINT);
+        currentBar[locate] = idx;
+        openLocates.push_back(locate);
+        return idx;
+    }
+
+    void add_to_bar(uint32_t idx, uint32_t price, uint64_t shares)
+    {
+        if (columns.trades[idx] == 0)
+        {
+            columns.open[idx] = price;
+            columns.high[idx] = price;
+            columns.low[idx] = price;
+        }
+        else
+        {
+            if (price > columns.high[idx])
+                columns.high[idx] = price;
+            if (price < columns.low[idx])
+                columns.low[idx] = price;
+        }
+        columns.close[idx] = price;
+        columns.volume[idx] += shares;
+        columns.notional[idx] += (uint64_t)price * shares;
+        columns.trades[idx]++;
+    }
+
+    bool break_print(uint64_t matchNumber)
+    {
+        auto itr = matches.find(matchNumber);
+        if (itr == matches.end())
+            return false;
+        print& curr = tape[itr->second];
+        matches.erase(itr);
+        curr.broken = true;
+        dayVolume[curr.locate] -= curr.shares;
+        dayNotional[curr.locate] -= (uint64_t)curr.price * curr.shares;
+        dayTrades[curr.locate]--;
+        // open, high, low and close can not be backed out, so rebuild the bar from its prints
+        uint32_t idx = curr.bar;
+        columns.open[idx] = 0;
+        columns.high[idx] = 0;
+        columns.low[idx] = 0;
+        columns.close[idx] = 0;
+        columns.volume[idx] = 0;
+        columns.notional[idx] = 0;
+        columns.trades[idx] = 0;
+        for(uint32_t printIdx = firstPrint[idx]; printIdx != NO_PRINT; printIdx = tape[printIdx].next)
+            if (!tape[printIdx].broken)
+                add_to_bar(idx, tape[printIdx].price, tape[printIdx].shares);
+        on_bar_corrected(idx);
+        return true;
+    }
+
+    protected:
+    const uint64_t interval;
+    uint64_t intervalEnd = 0;
+    bar_columns columns;
+    std::vector<uint32_t> firstPrint; // per bar
+    std::vector<uint32_t> lastPrint; // per bar
+    std::vector<print> tape;
+    std::unordered_map<uint64_t, uint32_t> matches; // match number to tape index
+    // per locate
+    std::vector<uint32_t> currentBar;
+    std::vector<uint64_t> dayVolume;
+    std::vector<uint64_t> dayNotional;
+    std::vector<uint32_t> dayTrades;
+    std::vector<uint16_t> openLocates;
+};
+
+} // end namespace itch
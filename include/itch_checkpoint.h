@@ -0,0 +1,380 @@
+#pragma once
+#include "itch_order_book.h"
+#include "itch_instrument_table.h"
+#include "itch_file.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace itch
+{
+
+/***
+ * The start of a checkpoint file. It is followed by the orders, the price levels and the
+ * instrument table, each as an array of plain structs.
+ *
+ * The file is a straight dump of memory, so it is only meant to be read back by the same build
+ * on the same architecture.
+ */
+struct checkpoint_header {
+    char magic[8] = {'I', 'T', 'C', 'H', 'C', 'K', 'P', 'T'};
+    uint32_t version = 0;
+    uint32_t header_length = 0;
+    uint64_t itch_offset = 0; // where to pick up in the ITCH file
+    uint64_t sequence_number = 0; // the next SoupBinTCP sequence number wanted
+    char session[10] = {0};
+    uint64_t order_count = 0;
+    uint64_t level_count = 0;
+    uint64_t instrument_count = 0;
+    uint64_t next_priority = 0;
+    std::string get_session() const { return std::string(session, strnlen(session, 10)); }
+};
+
+struct checkpoint_level {
+    uint16_t locate = 0;
+    char side = ' ';
+    uint32_t price = 0;
+    uint32_t orders = 0;
+    uint64_t shares = 0;
+};
+
+/***
+ * Saves and restores the state of an order_book and instrument_table
+ */
+class checkpoint
+{
+    public:
+    static const uint32_t VERSION = 1;
+
+    /****
+     * @brief copy the state into a buffer
+     * @param book the orders
+     * @param table the instruments
+     * @param itchOffset where in the ITCH file (or stream) the state is as of
+     * @param sequenceNumber the next SoupBinTCP sequence number, to log back in with
+     * @param session the SoupBinTCP session
+     * @param out where to put it
+     */
+    static void serialize(const order_book& book, const instrument_table& table, uint64_t itchOffset,
+            uint64_t sequenceNumber, const std::string& session, std::vector<uint8_t>& out)
+    {
+        uint64_t levelCount = 0;
+        for(const auto& side : book.levels)
+            levelCount += side.size();
+        out.resize(sizeof(checkpoint_header) + book.size() * sizeof(order)
+                + levelCount * sizeof(checkpoint_level) + table.instruments.size() * sizeof(instrument));
+        // out may be reused, so clear it and write field by field to leave nothing in the padding
+        std::fill(out.begin(), out.end(), 0);
+        uint8_t* pos = out.data();
+        put(pos, offsetof(checkpoint_header, magic), checkpoint_header().magic);
+        put(pos, offsetof(checkpoint_header, version), (uint32_t)VERSION);
+        put(pos, offsetof(checkpoint_header, header_length), (uint32_t)sizeof(checkpoint_header));
+        put(pos, offsetof(checkpoint_header, itch_offset), itchOffset);
+        put(pos, offsetof(checkpoint_header, sequence_number), sequenceNumber);
+        memcpy(pos + offsetof(checkpoint_header, session), session.c_str(), session.size() < 10 ? session.size() : 10);
+        put(pos, offsetof(checkpoint_header, order_count), (uint64_t)book.size());
+        put(pos, offsetof(checkpoint_header, level_count), levelCount);
+        put(pos, offsetof(checkpoint_header, instrument_count), (uint64_t)table.instruments.size());
+        put(pos, offsetof(checkpoint_header, next_priority), book.nextPriority);
+        pos += sizeof(checkpoint_header);
+        book.for_each_order([&pos](const order& curr) {
+            put(pos, offsetof(order, reference), curr.reference);
+            put(pos, offsetof(order, priority), curr.priority);
+            put(pos, offsetof(order, price), curr.price);
+            put(pos, offsetof(order, shares), curr.shares);
+            put(pos, offsetof(order, locate), curr.locate);
+            put(pos, offsetof(order, side), curr.side);
+            pos += sizeof(order);
+        });
+        for(size_t i = 0; i < book.levels.size(); ++i)
+        {
+            for(const price_level& lvl : book.levels[i])
+            {
+                put(pos, offsetof(checkpoint_level, locate), (uint16_t)(i >> 1));
+                put(pos, offsetof(checkpoint_level, side), (i & 1) ? 'S' : 'B');
+                put(pos, offsetof(checkpoint_level, price), lvl.price);
+                put(pos, offsetof(checkpoint_level, orders), lvl.orders);
+                put(pos, offsetof(checkpoint_level, shares), lvl.shares);
+                pos += sizeof(checkpoint_level);
+            }
+        }
+        for(const instrument& curr : table.instruments)
+        {
+            put_instrument(pos, curr);
+            pos += sizeof(instrument);
+        }
+    }
+
+    /****
+     * @brief replace the state of the book and table with a checkpoint
+     * @param data the checkpoint
+     * @param length the size of the checkpoint
+     * @param book the book to fill
+     * @param table the table to fill
+     * @return the header
+     */
+    static checkpoint_header restore(const uint8_t* data, size_t length, order_book& book, instrument_table& table)
+    {
+        checkpoint_header header;
+        if (length < sizeof(checkpoint_header))
+            throw std::invalid_argument("Checkpoint is too short");
+        memcpy(&header, data, sizeof(checkpoint_header));
+        if (memcmp(header.magic, checkpoint_header().magic, 8) != 0)
+            throw std::invalid_argument("Not a checkpoint");
+        if (header.version != VERSION || header.header_length != sizeof(checkpoint_header))
+            throw std::invalid_argument("Unsupported checkpoint version");
+        // counts are checked against what is left before multiplying, so a bad one cannot wrap
+        size_t remaining = length - sizeof(checkpoint_header);
+        if (header.order_count > remaining / sizeof(order))
+            throw std::invalid_argument("Checkpoint is the wrong size");
+        remaining -= header.order_count * sizeof(order);
+        if (header.level_count > remaining / sizeof(checkpoint_level))
+            throw std::invalid_argument("Checkpoint is the wrong size");
+        remaining -= header.level_count * sizeof(checkpoint_level);
+        if (header.instrument_count != table.instruments.size()
+                || remaining != header.instrument_count * sizeof(instrument))
+            throw std::invalid_argument("Checkpoint is the wrong size");
+        // every record is checked before the book is touched, so a bad checkpoint leaves it as it was
+        const uint8_t* pos = data + sizeof(checkpoint_header);
+        for(uint64_t i = 0; i < header.order_count; ++i, pos += sizeof(order))
+            if (pos[offsetof(order, side)] != 'B' && pos[offsetof(order, side)] != 'S')
+                throw std::invalid_argument("Checkpoint has an order with a bad side");
+        for(uint64_t i = 0; i < header.level_count; ++i, pos += sizeof(checkpoint_level))
+            if (pos[offsetof(checkpoint_level, side)] != 'B' && pos[offsetof(checkpoint_level, side)] != 'S')
+                throw std::invalid_argument("Checkpoint has a price level with a bad side");
+        pos = data + sizeof(checkpoint_header);
+        // orders, into a table big enough that it will not need to grow
+        size_t capacity = 16;
+        while(capacity < header.order_count * 2 + 2)
+            capacity <<= 1;
+        if (capacity < book.slots.size())
+            capacity = book.slots.size();
+        book.slots.assign(capacity, order());
+        book.mask = capacity - 1;
+        book.count = 0;
+        for(uint64_t i = 0; i < header.order_count; ++i)
+        {
+            order curr;
+            memcpy(&curr, pos, sizeof(order));
+            pos += sizeof(order);
+            book.insert(curr);
+        }
+        book.nextPriority = header.next_priority;
+        // levels, already in order
+        for(auto& side : book.levels)
+            side.clear();
+        for(uint64_t i = 0; i < header.level_count; ++i)
+        {
+            checkpoint_level curr;
+            memcpy(&curr, pos, sizeof(checkpoint_level));
+            pos += sizeof(checkpoint_level);
+            price_level lvl;
+            lvl.price = curr.price;
+            lvl.orders = curr.orders;
+            lvl.shares = curr.shares;
+            book.levels[order_book::level_index(curr.locate, curr.side)].push_back(lvl);
+        }
+        // instruments, and their symbol index
+        memcpy(table.instruments.data(), pos, header.instrument_count * sizeof(instrument));
+        std::fill(table.symbols.begin(), table.symbols.end(), instrument_table::symbol_slot());
+        for(size_t locate = 0; locate < table.instruments.size(); ++locate)
+            if (table.instruments[locate].known())
+                table.index_symbol(table.instruments[locate].symbol, locate);
+        return header;
+    }
+
+    /***
+     * Write the buffer to a file. A temporary file is renamed over the old one, so a crash
+     * part way through leaves the last checkpoint intact.
+     * @returns true on success
+     */
+    static bool write(const std::string& fileName, const std::vector<uint8_t>& data)
+    {
+        std::string tmpName = fileName + ".tmp";
+        int fd = ::open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        size_t written = 0;
+        while(written < data.size())
+        {
+            ssize_t curr = ::write(fd, data.data() + written, data.size() - written);
+            if (curr <= 0)
+            {
+                ::close(fd);
+                ::unlink(tmpName.c_str());
+                return false;
+            }
+            written += curr;
+        }
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok && ::rename(tmpName.c_str(), fileName.c_str()) == 0;
+    }
+
+    /***
+     * Map a checkpoint file and restore from it
+     */
+    static checkpoint_header read(const std::string& fileName, order_book& book, instrument_table& table)
+    {
+        mapped_file file(fileName);
+        return restore(file.data(), file.size(), book, table);
+    }
+
+    private:
+    template<typename T>
+    static void put(uint8_t* record, size_t offset, const T& value)
+    {
+        memcpy(record + offset, &value, sizeof(T));
+    }
+    static void put_instrument(uint8_t* pos, const instrument& curr)
+    {
+        put(pos, offsetof(instrument, symbol), curr.symbol);
+        put(pos, offsetof(instrument, round_lot_size), curr.round_lot_size);
+        put(pos, offsetof(instrument, market_category), curr.market_category);
+        put(pos, offsetof(instrument, financial_status_indicator), curr.financial_status_indicator);
+        put(pos, offsetof(instrument, round_lots_only), curr.round_lots_only);
+        put(pos, offsetof(instrument, issue_classification), curr.issue_classification);
+        put(pos, offsetof(instrument, issue_sub_type), curr.issue_sub_type);
+        put(pos, offsetof(instrument, authenticity), curr.authenticity);
+        put(pos, offsetof(instrument, short_sale_threshold_indicator), curr.short_sale_threshold_indicator);
+        put(pos, offsetof(instrument, ipo_flag), curr.ipo_flag);
+        put(pos, offsetof(instrument, luld_reference_price_tier), curr.luld_reference_price_tier);
+        put(pos, offsetof(instrument, etp_flag), curr.etp_flag);
+        put(pos, offsetof(instrument, inverse_indicator), curr.inverse_indicator);
+        put(pos, offsetof(instrument, etp_leverage_factor), curr.etp_leverage_factor);
+        put(pos, offsetof(instrument, trading_state), curr.trading_state);
+        put(pos, offsetof(instrument, trading_reason), curr.trading_reason);
+        put(pos, offsetof(instrument, reg_sho_action), curr.reg_sho_action);
+        put(pos, offsetof(instrument, operational_halt_market), curr.operational_halt_market);
+        put(pos, offsetof(instrument, operational_halt_action), curr.operational_halt_action);
+        put(pos, offsetof(instrument, ipo_quotation_release_qualifier), curr.ipo_quotation_release_qualifier);
+        put(pos, offsetof(instrument, ipo_quotation_release_time), curr.ipo_quotation_release_time);
+        put(pos, offsetof(instrument, ipo_price), curr.ipo_price);
+        put(pos, offsetof(instrument, auction_collar_reference_price), curr.auction_collar_reference_price);
+        put(pos, offsetof(instrument, upper_auction_collar_price), curr.upper_auction_collar_price);
+        put(pos, offsetof(instrument, lower_auction_collar_price), curr.lower_auction_collar_price);
+        put(pos, offsetof(instrument, auction_collar_extension), curr.auction_collar_extension);
+    }
+};
+
+/***
+ * Writes checkpoints on a background thread.
+ *
+ * The state is copied into a buffer on the calling thread (the book is not locked, so that
+ * must be the thread that updates it), and the slow part, writing it out, is done in the
+ * background. A checkpoint is skipped if the previous one is still being written.
+ */
+class checkpoint_writer
+{
+    public:
+    /***
+     * @param fileName where to write
+     * @param intervalMs how often maybe_write actually writes
+     */
+    checkpoint_writer(const std::string& fileName, uint64_t intervalMs = 60000)
+            : fileName(fileName), interval(intervalMs)
+    {
+        writerThread = std::thread([this]() { run(); });
+    }
+    ~checkpoint_writer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            shuttingDown = true;
+        }
+        cv.notify_all();
+        writerThread.join();
+    }
+
+    /****
+     * @brief write a checkpoint if the interval has passed and the writer is free
+     * @return true if a checkpoint was started
+     */
+    bool maybe_write(const order_book& book, const instrument_table& table, uint64_t itchOffset,
+            uint64_t sequenceNumber, const std::string& session = "")
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastWrite < interval || busy.load(std::memory_order_acquire))
+            return false;
+        lastWrite = now;
+        start(book, table, itchOffset, sequenceNumber, session);
+        return true;
+    }
+    /***
+     * Write a checkpoint now, waiting for the previous one if need be
+     */
+    void write(const order_book& book, const instrument_table& table, uint64_t itchOffset,
+            uint64_t sequenceNumber, const std::string& session = "")
+    {
+        wait();
+        lastWrite = std::chrono::steady_clock::now();
+        start(book, table, itchOffset, sequenceNumber, session);
+    }
+    /***
+     * Wait for the checkpoint being written (if any) to finish
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return !busy.load(std::memory_order_acquire); });
+    }
+
+    uint64_t get_written() const { return written; }
+    uint64_t get_failures() const { return failures; }
+
+    private:
+    void start(const order_book& book, const instrument_table& table, uint64_t itchOffset,
+            uint64_t sequenceNumber, const std::string& session)
+    {
+        // the writer is idle, so the buffer is ours
+        checkpoint::serialize(book, table, itchOffset, sequenceNumber, session, buffer);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy.store(true, std::memory_order_release);
+        }
+        cv.notify_all();
+    }
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            cv.wait(lock, [this]() { return shuttingDown || busy.load(std::memory_order_acquire); });
+            if (!busy.load(std::memory_order_acquire) && shuttingDown)
+                return;
+            lock.unlock();
+            if (checkpoint::write(fileName, buffer))
+                written++;
+            else
+                failures++;
+            lock.lock();
+            busy.store(false, std::memory_order_release);
+            cv.notify_all();
+        }
+    }
+
+    private:
+    const std::string fileName;
+    const std::chrono::milliseconds interval;
+    std::chrono::steady_clock::time_point lastWrite;
+    std::vector<uint8_t> buffer;
+    std::thread writerThread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<bool> busy = false;
+    bool shuttingDown = false;
+    std::atomic<uint64_t> written = 0;
+    std::atomic<uint64_t> failures = 0;
+};
+
+} // end namespace itch
@@ -0,0 +1,145 @@
+#pragma once
+#include "itch_file.h"
+#include "message_filter.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+
+namespace itch
+{
+
+/***
+ * Reads a compressed ITCH file as a stream.
+ *
+ * A background thread decompresses into a ring of chunks (two by default) while the calling
+ * thread frames and handles the records in the chunk before it, so decompression and parsing
+ * overlap. Records that straddle two chunks are stitched together.
+ *
+ * gzip is always available. zstd and lz4 are available if the library was found at build
+ * time (NASDAQ_ITCH_HAVE_ZSTD, NASDAQ_ITCH_HAVE_LZ4). Uncompressed files can be read as well.
+ */
+class compressed_file
+{
+    public:
+    enum class format
+    {
+        AUTO = 0, // from the magic number at the start of the file
+        NONE = 1,
+        GZIP = 2,
+        ZSTD = 3,
+        LZ4 = 4
+    };
+
+    /***
+     * @param fileName the file
+     * @param fmt the compression, AUTO to detect it
+     * @param chunkSize the size of each decompressed chunk
+     * @param chunkCount how many chunks can be in flight
+     */
+    compressed_file(const std::string& fileName, format fmt = format::AUTO, size_t chunkSize = 4 * 1024 * 1024,
+            size_t chunkCount = 2);
+    ~compressed_file();
+    compressed_file(const compressed_file&) = delete;
+    compressed_file& operator=(const compressed_file&) = delete;
+
+    format get_format() const { return fileFormat; }
+    /***
+     * @returns the number of decompressed bytes produced so far
+     */
+    uint64_t get_decompressed_size() const { return decompressed; }
+
+    /***
+     * Calls func(record, record_length) for each record in the file. The file can only be read once.
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func)
+    {
+        start();
+        reader_guard guard(*this);
+        size_t consumed = 0;
+        record_stitcher stitcher;
+        for(const chunk* curr = next(); curr != nullptr; curr = next())
+        {
+            consumed += stitcher.feed(curr->data.data(), curr->length, func);
+            release();
+        }
+        guard.finished();
+        return consumed;
+    }
+    /***
+     * Calls func(record, record_length) for each record the filter accepts
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func, MessageFilter& filter)
+    {
+        return for_each([&func, &filter](const uint8_t* record, uint16_t recordLength) {
+            if (filter.accept(record, recordLength))
+                func(record, recordLength);
+        });
+    }
+
+    /***
+     * @returns the format, judging by the first bytes of the file
+     */
+    static format detect(const uint8_t* data, size_t length);
+
+    protected:
+    struct chunk {
+        std::vector<uint8_t> data;
+        size_t length = 0;
+        bool full = false;
+    };
+    /***
+     * Stops the decompression thread if the reader leaves early (i.e. func threw)
+     */
+    struct reader_guard {
+        reader_guard(compressed_file& file) : file(file) {}
+        ~reader_guard() { file.stop(); }
+        /***
+         * rethrow anything the decompression thread ran into
+         */
+        void finished() { file.stop(); file.rethrow(); }
+        compressed_file& file;
+    };
+
+    void start();
+    void stop();
+    void rethrow();
+    /***
+     * @returns the next full chunk, or nullptr at the end of the file
+     */
+    const chunk* next();
+    void release();
+    // the decompression thread
+    void run();
+    chunk* next_empty();
+    void publish(chunk* curr);
+    void decompress_none();
+    void decompress_gzip();
+    void decompress_zstd();
+    void decompress_lz4();
+    size_t read_input(uint8_t* buffer, size_t length);
+
+    protected:
+    int fd = -1;
+    format fileFormat = format::NONE;
+    std::vector<chunk> chunks;
+    size_t readIdx = 0; // the chunk being parsed
+    size_t writeIdx = 0; // the chunk being filled
+    bool started = false;
+    bool done = false; // no more chunks are coming
+    bool stopping = false;
+    std::exception_ptr error;
+    std::atomic<uint64_t> decompressed = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread decompressThread;
+};
+
+} // end namespace itch
@@ -0,0 +1,206 @@
+#pragma once
+#include "itch_order_book.h"
+#include <vector>
+
+namespace itch
+{
+
+/***
+ * The top of the book for one instrument, best price first
+ */
+struct depth_snapshot {
+    uint16_t locate = 0;
+    uint64_t timestamp = 0; // of the last message that changed the book, ns since midnight
+    std::vector<price_level> bids;
+    std::vector<price_level> asks;
+};
+
+/***
+ * Market by price depth for consumers that do not need every message.
+ *
+ * Each message that changes the book marks its instrument dirty. publish() sends one snapshot
+ * of the top levels for each dirty instrument and clears the marks, so however many messages
+ * came in between, a consumer gets at most one update per instrument. Call it when the consumer
+ * is ready for more, or let poll() call it on an interval.
+ *
+ * Snapshots can be encoded for a SoupBinServer with publish_to(). The layout is
+ * 'd', STOCK_LOCATE (2), TIMESTAMP (6), bid levels (1), ask levels (1), then for each level
+ * price (4), shares (8) and orders (4), bids first. Integers are big endian.
+ */
+class depth_conflator
+{
+    public:
+    static constexpr char MESSAGE_TYPE = 'd';
+    static constexpr size_t HEADER_LEN = 11;
+    static constexpr size_t LEVEL_LEN = 16;
+
+    /***
+     * @param book the book to publish from
+     * @param depth how many levels on each side
+     * @param intervalNs how often poll() publishes
+     */
+    depth_conflator(order_book& book, size_t depth = 5, uint64_t intervalNs = 100000000)
+            : book(book), depth(depth < 255 ? depth : 255), interval(intervalNs), dirtyBits(order_book::MAX_LOCATES / 64),
+            timestamps(order_book::MAX_LOCATES)
+    {
+    }
+
+    /***
+     * Update the book, and mark the instrument if it changed
+     * @returns true if the book changed
+     */
+    bool apply(const uint8_t* record)
+    {
+        if (!book.apply(record))
+            return false;
+        uint16_t locate = get_stock_locate(record);
+        timestamps[locate] = get_int(record, system_event::TIMESTAMP);
+        mark(locate);
+        return true;
+    }
+    template<unsigned int SIZE>
+    bool apply(const message<SIZE>& msg) { return apply(msg.get_record()); }
+    /***
+     * Mark an instrument, i.e. when the book is updated somewhere else
+     * @param timestamp of the message that changed it, 0 to keep the one from the last apply()
+     */
+    void mark(uint16_t locate, uint64_t timestamp = 0)
+    {
+        if (timestamp != 0)
+            timestamps[locate] = timestamp;
+        uint64_t bit = 1ull << (locate & 63);
+        uint64_t& word = dirtyBits[locate >> 6];
+        if ((word & bit) == 0)
+        {
+            word |= bit;
+            dirty.push_back(locate);
+        }
+    }
+    bool is_dirty(uint16_t locate) const { return (dirtyBits[locate >> 6] >> (locate & 63)) & 1; }
+    size_t get_dirty_count() const { return dirty.size(); }
+
+    /***
+     * Calls func(const depth_snapshot&) for each dirty instrument, in the order they were marked,
+     * and clears them. The snapshot is reused, so copy it to keep it.
+     * @returns the number of snapshots
+     */
+    template<typename F>
+    size_t publish(F&& func)
+    {
+        size_t count = dirty.size();
+        for(uint16_t locate : dirty)
+        {
+            dirtyBits[locate >> 6] &= ~(1ull << (locate & 63));
+            snapshot.locate = locate;
+            snapshot.timestamp = timestamps[locate];
+            copy_levels(book.get_levels(locate, 'B'), snapshot.bids);
+            copy_levels(book.get_levels(locate, 'S'), snapshot.asks);
+            func(snapshot);
+        }
+        dirty.clear();
+        return count;
+    }
+    /***
+     * publish() if the interval has passed since the last time it did
+     * @param now the time, in ns, on any clock as long as it is always the same one
+     */
+    template<typename F>
+    size_t poll(uint64_t now, F&& func)
+    {
+        if (now - lastPublish < interval)
+            return 0;
+        lastPublish = now;
+        return publish(func);
+    }
+    /***
+     * Publish encoded snapshots as sequenced data, i.e. through a SoupBinServer
+     */
+    template<typename SERVER>
+    size_t publish_to(SERVER& server)
+    {
+        return publish([this, &server](const depth_snapshot& in) {
+            encode(in, encoded);
+            server.send_sequenced(encoded);
+        });
+    }
+
+    static void encode(const depth_snapshot& in, std::vector<unsigned char>& out)
+    {
+        out.resize(HEADER_LEN + (in.bids.size() + in.asks.size()) * LEVEL_LEN);
+        unsigned char* pos = out.data();
+        *pos++ = MESSAGE_TYPE;
+        pos = put(pos, in.locate, 2);
+        pos = put(pos, in.timestamp, 6);
+        *pos++ = (unsigned char)in.bids.size();
+        *pos++ = (unsigned char)in.asks.size();
+        for(const std::vector<price_level>* side : { &in.bids, &in.asks })
+            for(const price_level& lvl : *side)
+            {
+                pos = put(pos, lvl.price, 4);
+                pos = put(pos, lvl.shares, 8);
+                pos = put(pos, lvl.orders, 4);
+            }
+    }
+    /***
+     * @returns false if the bytes are not an encoded snapshot
+     */
+    static bool decode(const unsigned char* in, size_t length, depth_snapshot& out)
+    {
+        if (length < HEADER_LEN || in[0] != MESSAGE_TYPE
+                || length != HEADER_LEN + ((size_t)in[9] + in[10]) * LEVEL_LEN)
+            return false;
+        out.locate = get(in + 1, 2);
+        out.timestamp = get(in + 3, 6);
+        out.bids.resize(in[9]);
+        out.asks.resize(in[10]);
+        const unsigned char* pos = in + HEADER_LEN;
+        for(std::vector<price_level>* side : { &out.bids, &out.asks })
+            for(price_level& lvl : *side)
+            {
+                lvl.price = get(pos, 4);
+                lvl.shares = get(pos + 4, 8);
+                lvl.orders = get(pos + 12, 4);
+                pos += LEVEL_LEN;
+            }
+        return true;
+    }
+
+    protected:
+    /***
+     * The book keeps the best price at the back
+     */
+    void copy_levels(const std::vector<price_level>& levels, std::vector<price_level>& out) const
+    {
+        size_t count = levels.size() < depth ? levels.size() : depth;
+        out.assign(levels.rbegin(), levels.rbegin() + count);
+    }
+    static unsigned char* put(unsigned char* out, uint64_t val, int length)
+    {
+        for(int i = length - 1; i >= 0; --i)
+        {
+            out[i] = val & 0xff;
+            val >>= 8;
+        }
+        return out + length;
+    }
+    static uint64_t get(const unsigned char* in, int length)
+    {
+        uint64_t retVal = 0;
+        for(int i = 0; i < length; ++i)
+            retVal = (retVal << 8) | in[i];
+        return retVal;
+    }
+
+    protected:
+    order_book& book;
+    size_t depth;
+    uint64_t interval;
+    uint64_t lastPublish = 0;
+    std::vector<uint64_t> dirtyBits; // a bit for each locate
+    std::vector<uint64_t> timestamps; // of the last change, by locate
+    std::vector<uint16_t> dirty; // the marked locates, in the order they were marked
+    depth_snapshot snapshot;
+    std::vector<unsigned char> encoded;
+};
+
+} // end namespace itch
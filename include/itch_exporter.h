@@ -0,0 +1,104 @@
+#pragma once
+#include "itch_file.h"
+#include <string>
+#include <vector>
+
+namespace itch
+{
+
+/***
+ * Turns ITCH records into CSV or JSON lines.
+ *
+ * Each message type has its own column layout: every field of the message in the order
+ * of the specification, led by the message type. Fields are written straight into the output
+ * buffer (integers and prices with to_chars, text copied and trimmed of its padding), so
+ * nothing goes through a std::string or a double.
+ *
+ * A file is converted in chunks on several threads. Each chunk is formatted into its own
+ * buffer and the buffers are written out in file order.
+ */
+class exporter
+{
+    public:
+    enum class format
+    {
+        CSV = 0,
+        JSON = 1 // one object per line
+    };
+    /***
+     * No line is longer than this
+     */
+    static constexpr size_t MAX_LINE = 4096;
+
+    exporter(format fmt = format::CSV);
+
+    /***
+     * Only export these message types, i.e. "AFECXDUP". All types are exported until this is called.
+     */
+    void select(const std::string& messageTypes);
+    bool is_selected(char messageType) const { return selected[(uint8_t)messageType]; }
+    format get_format() const { return outputFormat; }
+
+    /***
+     * @returns the CSV column names of a message type, or an empty string if it is unknown
+     */
+    std::string get_header(char messageType) const;
+
+    /****
+     * @brief write one record as a line (with its newline)
+     * @param record the record, starting with the message type
+     * @param length the size of the record
+     * @param out where to write, with room for MAX_LINE characters
+     * @return the number of characters written, 0 if the type is unknown, too short, or not selected
+     */
+    size_t format_record(const uint8_t* record, uint16_t length, char* out) const;
+
+    /****
+     * @brief convert length-prefixed records (i.e. a mapped ITCH file) and write them to a file descriptor
+     * @param data the records
+     * @param length the size of data
+     * @param fd where the lines go
+     * @param threads how many threads format chunks
+     * @param chunkSize how much input each chunk covers
+     * @return the number of lines written
+     */
+    uint64_t export_buffer(const uint8_t* data, size_t length, int fd, size_t threads = 4,
+            size_t chunkSize = 16 * 1024 * 1024) const;
+    /***
+     * Convert an ITCH file. If exactly one message type is selected, a CSV file starts with a header.
+     * @returns the number of lines written
+     */
+    uint64_t export_file(const std::string& inFileName, const std::string& outFileName, size_t threads = 4,
+            size_t chunkSize = 16 * 1024 * 1024) const;
+
+    protected:
+    struct column {
+        std::string name; // snake case, i.e. order_reference_number
+        message_record field;
+    };
+    /***
+     * The output of one chunk
+     */
+    struct chunk_output {
+        std::vector<char> text;
+        size_t used = 0;
+        size_t end = 0; // where the last record formatted ended
+        uint64_t lines = 0;
+    };
+
+    /***
+     * Format the records from start until one ends at or after stop
+     */
+    void format_chunk(const uint8_t* data, size_t length, size_t start, size_t stop, chunk_output& out) const;
+    char* write_csv(const uint8_t* record, const std::vector<column>& columns, char* out) const;
+    char* write_json(const uint8_t* record, const std::vector<column>& columns, char* out) const;
+    static char* write_field(const uint8_t* record, const message_record& field, bool json, char* out);
+    static void write_all(int fd, const char* data, size_t length);
+
+    protected:
+    format outputFormat = format::CSV;
+    std::vector<column> layouts[256];
+    bool selected[256];
+};
+
+} // end namespace itch
@@ -0,0 +1,255 @@
+#pragma once
+#include "itch.h"
+#include "itch_latency.h"
+#include <deque>
+#include <ctime>
+
+namespace itch
+{
+
+/***
+ * One second of the feed, by the local clock
+ */
+struct feed_latency_window {
+    uint64_t second = 0; // local time, seconds since midnight
+    uint64_t messages = 0;
+    // how long after its TIMESTAMP a message arrived, in ns
+    uint64_t delay_p50 = 0;
+    uint64_t delay_p99 = 0;
+    uint64_t delay_p999 = 0;
+    uint64_t delay_max = 0;
+    uint64_t negative = 0; // messages that arrived before their TIMESTAMP, i.e. the clocks disagree
+    uint32_t max_exchange_burst = 0; // the most messages with a TIMESTAMP in one 100us interval
+    uint32_t max_receive_burst = 0; // the most messages that arrived in one 100us interval
+};
+
+/***
+ * Compares the TIMESTAMP of each message with the local clock when it arrives.
+ *
+ * Keeps a distribution of the delay and the busiest 100us interval for each second, both by the
+ * exchange's TIMESTAMP and by the local clock. A burst at the exchange shows in both burst counts
+ * with the delay steady. A stall on our side shows as the delay climbing while the exchange rate
+ * does not, followed by a receive burst as the backlog drains.
+ *
+ * The local clock is CLOCK_REALTIME, read once a second, carried forward between reads with the
+ * TSC. Both clocks need to be synchronized (i.e. PTP) for the delay to mean anything absolute.
+ */
+class feed_latency_monitor
+{
+    public:
+    static constexpr uint64_t NS_PER_SECOND = 1000000000ull;
+    static constexpr uint64_t NS_PER_DAY = 86400ull * NS_PER_SECOND;
+    static constexpr uint64_t BURST_INTERVAL = 100000; // 100us
+
+    /***
+     * @param utcOffsetSeconds where midnight is for the TIMESTAMP, i.e. -14400 for New York in the summer
+     * @param windows how many seconds to keep
+     */
+    feed_latency_monitor(int64_t utcOffsetSeconds = local_utc_offset(), size_t windows = 60)
+            : utcOffset(utcOffsetSeconds * (int64_t)NS_PER_SECOND), maxWindows(windows)
+    {
+        calibrate();
+    }
+    virtual ~feed_latency_monitor() {}
+
+    /***
+     * on_delay_threshold is called when the delay goes above this, and on_delay_recovered when it
+     * comes back under. 0 turns it off.
+     */
+    void set_delay_threshold(uint64_t ns) { delayThreshold = ns; }
+    /***
+     * on_exchange_burst or on_receive_burst is called when a 100us interval gets this many messages.
+     * 0 turns it off.
+     */
+    void set_burst_threshold(uint32_t messages) { burstThreshold = messages; }
+
+    /***
+     * Count a record that has just arrived
+     */
+    void on_record(const uint8_t* record)
+    {
+        uint64_t tsc = read_tsc();
+        if (tsc - calibratedTsc > calibrationTicks)
+            calibrate();
+        on_record(record, local_time(tsc));
+    }
+    /****
+     * @brief count a record
+     * @param record the record, starting with the message type
+     * @param received when it arrived, in local ns since midnight
+     */
+    void on_record(const uint8_t* record, uint64_t received)
+    {
+        uint64_t timestamp = get_int(record, system_event::TIMESTAMP);
+        uint64_t second = received / NS_PER_SECOND;
+        if (second != current.second)
+        {
+            if (current.messages > 0)
+                close_window();
+            current.second = second;
+        }
+        current.messages++;
+        int64_t delay = (int64_t)received - (int64_t)timestamp;
+        // a message stamped just before midnight and received just after
+        if (delay < -(int64_t)(NS_PER_DAY / 2))
+            delay += NS_PER_DAY;
+        if (delay < 0)
+        {
+            current.negative++;
+            delay = 0;
+        }
+        delays.record(delay);
+        if (delayThreshold > 0)
+        {
+            if (!aboveThreshold && (uint64_t)delay > delayThreshold)
+            {
+                aboveThreshold = true;
+                on_delay_threshold(delay, timestamp);
+            }
+            else if (aboveThreshold && (uint64_t)delay <= delayThreshold)
+            {
+                aboveThreshold = false;
+                on_delay_recovered(delay, timestamp);
+            }
+        }
+        if (count_burst(exchangeBurst, timestamp, current.max_exchange_burst))
+            on_exchange_burst(exchangeBurst.messages, exchangeBurst.interval * BURST_INTERVAL);
+        if (count_burst(receiveBurst, received, current.max_receive_burst))
+            on_receive_burst(receiveBurst.messages, receiveBurst.interval * BURST_INTERVAL);
+    }
+
+    /***
+     * Close the current second, i.e. when the feed has gone quiet
+     */
+    void flush()
+    {
+        if (current.messages > 0)
+            close_window();
+    }
+
+    /***
+     * @returns the closed seconds, oldest first
+     */
+    const std::deque<feed_latency_window>& get_windows() const { return windows; }
+    /***
+     * @returns the second in progress, with the delays so far
+     */
+    feed_latency_window get_current() const
+    {
+        feed_latency_window retVal = current;
+        fill_delays(retVal);
+        return retVal;
+    }
+
+    /***
+     * @returns the local time in ns since midnight
+     */
+    uint64_t now() const { return local_time(read_tsc()); }
+    /***
+     * Read CLOCK_REALTIME again, so the TSC does not drift from it
+     */
+    void calibrate()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        calibratedTsc = read_tsc();
+        calibratedTime = (uint64_t)ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+        ticksPerNs = latency_registry::cycles_per_ns();
+        calibrationTicks = (uint64_t)(ticksPerNs * NS_PER_SECOND);
+    }
+    /***
+     * @returns the seconds east of UTC of the local time zone, now
+     */
+    static int64_t local_utc_offset()
+    {
+        time_t now = time(nullptr);
+        tm local;
+        localtime_r(&now, &local);
+        return local.tm_gmtoff;
+    }
+
+    protected:
+    /***
+     * Called when a second closes
+     */
+    virtual void on_window(const feed_latency_window& window) {}
+    /***
+     * The delay went above the threshold
+     * @param delay the delay of the message that crossed it
+     * @param timestamp the TIMESTAMP of that message
+     */
+    virtual void on_delay_threshold(uint64_t delay, uint64_t timestamp) {}
+    virtual void on_delay_recovered(uint64_t delay, uint64_t timestamp) {}
+    /***
+     * A 100us interval reached the burst threshold
+     * @param messages the threshold
+     * @param start when the interval started, in ns since midnight
+     */
+    virtual void on_exchange_burst(uint32_t messages, uint64_t start) {}
+    virtual void on_receive_burst(uint32_t messages, uint64_t start) {}
+
+    protected:
+    struct burst {
+        uint64_t interval = 0; // time / BURST_INTERVAL
+        uint32_t messages = 0;
+    };
+
+    /***
+     * @returns true if this message brought the interval to the threshold
+     */
+    bool count_burst(burst& in, uint64_t time, uint32_t& windowMax)
+    {
+        uint64_t interval = time / BURST_INTERVAL;
+        // anything out of order counts toward the interval it arrived in
+        if (interval > in.interval)
+        {
+            in.interval = interval;
+            in.messages = 0;
+        }
+        in.messages++;
+        if (in.messages > windowMax)
+            windowMax = in.messages;
+        return burstThreshold > 0 && in.messages == burstThreshold;
+    }
+    void fill_delays(feed_latency_window& window) const
+    {
+        window.delay_p50 = delays.value_at_percentile(50.0);
+        window.delay_p99 = delays.value_at_percentile(99.0);
+        window.delay_p999 = delays.value_at_percentile(99.9);
+        window.delay_max = delays.get_max();
+    }
+    void close_window()
+    {
+        fill_delays(current);
+        windows.push_back(current);
+        if (windows.size() > maxWindows)
+            windows.pop_front();
+        on_window(windows.back());
+        current = feed_latency_window();
+        delays.reset();
+    }
+    uint64_t local_time(uint64_t tsc) const
+    {
+        int64_t elapsed = (int64_t)((int64_t)(tsc - calibratedTsc) / ticksPerNs);
+        int64_t local = (int64_t)calibratedTime + elapsed + utcOffset;
+        return (uint64_t)(local % (int64_t)NS_PER_DAY + NS_PER_DAY) % NS_PER_DAY;
+    }
+
+    protected:
+    int64_t utcOffset;
+    size_t maxWindows;
+    uint64_t delayThreshold = 0;
+    uint32_t burstThreshold = 0;
+    bool aboveThreshold = false;
+    uint64_t calibratedTsc = 0;
+    uint64_t calibratedTime = 0; // ns since the epoch
+    uint64_t calibrationTicks = 0; // how long until calibrating again
+    double ticksPerNs = 1.0;
+    feed_latency_window current;
+    hdr_histogram delays;
+    burst exchangeBurst;
+    burst receiveBurst;
+    std::deque<feed_latency_window> windows;
+};
+
+} // end namespace itch
@@ -0,0 +1,161 @@
+#pragma once
+#include "itch.h"
+#include "message_filter.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace itch
+{
+
+/***
+ * ITCH files (and MoldUDP64 message blocks) store each record behind a 2 byte big-endian length
+ */
+const static uint8_t RECORD_LENGTH_LEN = 2;
+
+/****
+ * @brief walk the length-prefixed records in a buffer
+ * @param data the buffer
+ * @param length the size of the buffer
+ * @param func called as func(record, record_length) for each complete record. The record starts
+ *    with the message type.
+ * @return the number of bytes consumed. Anything after that is a partial record.
+ */
+template<typename F>
+size_t for_each_record(const uint8_t* data, size_t length, F&& func)
+{
+    size_t pos = 0;
+    while(pos + RECORD_LENGTH_LEN <= length)
+    {
+        uint16_t recordLength = swap_endian_bytes<uint16_t>(*(uint16_t*)&data[pos]);
+        if (pos + RECORD_LENGTH_LEN + recordLength > length)
+            break;
+        func(&data[pos + RECORD_LENGTH_LEN], recordLength);
+        pos += RECORD_LENGTH_LEN + recordLength;
+    }
+    return pos;
+}
+
+/***
+ * Frames records out of a stream that arrives in pieces. A record split between two pieces is
+ * kept until the rest of it arrives.
+ */
+class record_stitcher
+{
+    public:
+    /****
+     * @brief hand in the next piece of the stream
+     * @param data the piece
+     * @param length the size of the piece
+     * @param func called as func(record, record_length) for each complete record
+     * @return the number of bytes of complete records handed to func
+     */
+    template<typename F>
+    size_t feed(const uint8_t* data, size_t length, F&& func)
+    {
+        size_t consumed = 0;
+        size_t pos = 0;
+        if (!carry.empty())
+        {
+            while(carry.size() < RECORD_LENGTH_LEN && pos < length)
+                carry.push_back(data[pos++]);
+            if (carry.size() < RECORD_LENGTH_LEN)
+                return 0;
+            size_t recordLength = ((size_t)carry[0] << 8) | carry[1];
+            size_t wanted = RECORD_LENGTH_LEN + recordLength - carry.size();
+            size_t taken = wanted < length - pos ? wanted : length - pos;
+            carry.insert(carry.end(), data + pos, data + pos + taken);
+            pos += taken;
+            if (carry.size() < RECORD_LENGTH_LEN + recordLength)
+                return 0;
+            func(carry.data() + RECORD_LENGTH_LEN, (uint16_t)recordLength);
+            consumed += carry.size();
+            carry.clear();
+        }
+        size_t used = for_each_record(data + pos, length - pos, func);
+        carry.assign(data + pos + used, data + length);
+        return consumed + used;
+    }
+    /***
+     * @returns true if no partial record is waiting
+     */
+    bool empty() const { return carry.empty(); }
+
+    private:
+    std::vector<uint8_t> carry;
+};
+
+/***
+ * A read-only, memory mapped ITCH file
+ */
+class mapped_file
+{
+    public:
+    mapped_file(const std::string& fileName)
+    {
+        fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::invalid_argument("Unable to open " + fileName);
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::invalid_argument("Unable to stat " + fileName);
+        }
+        length = st.st_size;
+        if (length > 0)
+        {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::invalid_argument("Unable to map " + fileName);
+            }
+            buffer = (const uint8_t*)mapped;
+            // we walk it front to back
+            madvise(mapped, length, MADV_SEQUENTIAL);
+        }
+    }
+    ~mapped_file()
+    {
+        if (buffer != nullptr)
+            munmap((void*)buffer, length);
+        if (fd >= 0)
+            ::close(fd);
+    }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const uint8_t* data() const { return buffer; }
+    size_t size() const { return length; }
+    /***
+     * Calls func(record, record_length) for each record in the file
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func) const { return for_each_record(buffer, length, func); }
+    /***
+     * Calls func(record, record_length) for each record the filter accepts
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func, MessageFilter& filter) const
+    {
+        return for_each_record(buffer, length, [&func, &filter](const uint8_t* record, uint16_t recordLength) {
+            if (filter.accept(record, recordLength))
+                func(record, recordLength);
+        });
+    }
+
+    private:
+    int fd = -1;
+    const uint8_t* buffer = nullptr;
+    size_t length = 0;
+};
+
+} // end namespace itch
@@ -0,0 +1,422 @@
+#pragma once
+#include "itch_file.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdio>
+#include <cctype>
+
+namespace itch
+{
+
+/***
+ * The start of an index sidecar file. It is followed by the arrays of the index, in the
+ * order they are declared in file_index.
+ */
+struct file_index_header {
+    char magic[8] = {'I', 'T', 'C', 'H', 'I', 'D', 'X', '1'};
+    uint32_t version = 0;
+    uint32_t block_size = 0;
+    uint64_t file_size = 0; // of the ITCH file
+    uint64_t record_count = 0;
+    uint64_t time_granularity = 0;
+    uint64_t time_count = 0;
+    uint64_t block_count = 0;
+    uint64_t directory_count = 0;
+    uint64_t locate_block_count = 0;
+};
+
+/***
+ * An index of an ITCH file, to seek by time or by instrument without scanning from the start.
+ *
+ * - time entries: the offset of the first record in each time_granularity bucket
+ * - block offsets: the offset of the first record that starts in each block of the file
+ * - locate blocks: for each STOCK_LOCATE, the blocks that have a record for it
+ * - directory entries: the offset of each stock_directory record
+ *
+ * Offsets are of the length in front of the record.
+ *
+ * It is built in one pass, split across threads. The file has no markers between records, so
+ * each thread finds its first record by looking for a run of records with the right length
+ * for their message type. If a thread does not land exactly where the next one started, the
+ * guess was wrong and the index is built again on one thread.
+ */
+class file_index
+{
+    public:
+    static const uint32_t VERSION = 1;
+    static const size_t MAX_LOCATES = 65536;
+    static const size_t SYNC_RECORDS = 16;
+
+    struct time_entry {
+        uint64_t timestamp = 0;
+        uint64_t offset = 0;
+    };
+    struct directory_entry {
+        uint64_t offset = 0;
+        uint16_t locate = 0;
+        uint16_t unused[3] = {0, 0, 0}; // so the file has no stray bytes
+    };
+
+    /****
+     * @brief index a file
+     * @param data the file
+     * @param length the size of the file
+     * @param threads how many threads to split the work across
+     * @param blockSize the granularity of the locate lists
+     * @param timeGranularity the granularity of the time entries, in nanoseconds
+     */
+    void build(const uint8_t* data, size_t length, size_t threads = std::thread::hardware_concurrency(),
+            uint32_t blockSize = 65536, uint64_t timeGranularity = 1000000000ull)
+    {
+        if (blockSize < 256)
+            throw std::invalid_argument("Block size must be at least 256");
+        if (timeGranularity == 0)
+            throw std::invalid_argument("Time granularity must be greater than 0");
+        header = file_index_header();
+        header.version = VERSION;
+        header.block_size = blockSize;
+        header.file_size = length;
+        header.time_granularity = timeGranularity;
+        if (threads == 0)
+            threads = 1;
+        // small pieces are not worth a thread
+        if (length / threads < (size_t)blockSize * 16)
+            threads = length / ((size_t)blockSize * 16) + 1;
+        std::vector<size_t> starts;
+        starts.push_back(0);
+        for(size_t i = 1; i < threads; ++i)
+        {
+            size_t start = find_record(data, length, length / threads * i);
+            if (start > starts.back() && start < length)
+                starts.push_back(start);
+        }
+        starts.push_back(length);
+        std::vector<partial> parts(starts.size() - 1);
+        std::vector<std::thread> workers;
+        for(size_t i = 0; i + 1 < starts.size(); ++i)
+            workers.emplace_back([this, &parts, &starts, data, i]() {
+                scan(data, starts[i], starts[i + 1], parts[i]);
+            });
+        for(auto& worker : workers)
+            worker.join();
+        // each piece has to end where the next one starts (the last may have a partial record)
+        bool synced = true;
+        for(size_t i = 0; i + 2 < starts.size(); ++i)
+            if (parts[i].end != starts[i + 1])
+                synced = false;
+        if (!synced)
+        {
+            parts.clear();
+            parts.resize(1);
+            scan(data, 0, length, parts[0]);
+        }
+        merge(parts);
+    }
+    void build(const mapped_file& file, size_t threads = std::thread::hardware_concurrency(),
+            uint32_t blockSize = 65536, uint64_t timeGranularity = 1000000000ull)
+    {
+        build(file.data(), file.size(), threads, blockSize, timeGranularity);
+    }
+
+    /***
+     * Write the index to a sidecar file
+     */
+    void save(const std::string& fileName) const
+    {
+        FILE* out = fopen(fileName.c_str(), "wb");
+        if (out == nullptr)
+            throw std::invalid_argument("Unable to open " + fileName);
+        bool ok = fwrite(&header, sizeof(file_index_header), 1, out) == 1;
+        ok = ok && write_array(out, timeEntries);
+        ok = ok && write_array(out, blockOffsets);
+        ok = ok && write_array(out, directoryEntries);
+        ok = ok && write_array(out, locateStarts);
+        ok = ok && write_array(out, locateBlocks);
+        ok = fclose(out) == 0 && ok;
+        if (!ok)
+            throw std::invalid_argument("Unable to write " + fileName);
+    }
+    /***
+     * Read an index from a sidecar file
+     */
+    void load(const std::string& fileName)
+    {
+        mapped_file file(fileName);
+        const uint8_t* pos = file.data();
+        const uint8_t* end = pos + file.size();
+        if (file.size() < sizeof(file_index_header))
+            throw std::invalid_argument("Index is too short");
+        file_index_header in;
+        memcpy(&in, pos, sizeof(file_index_header));
+        pos += sizeof(file_index_header);
+        if (memcmp(in.magic, file_index_header().magic, 8) != 0 || in.version != VERSION)
+            throw std::invalid_argument("Not an ITCH index: " + fileName);
+        if (!read_array(pos, end, timeEntries, in.time_count) || !read_array(pos, end, blockOffsets, in.block_count)
+                || !read_array(pos, end, directoryEntries, in.directory_count)
+                || !read_array(pos, end, locateStarts, MAX_LOCATES + 1)
+                || !read_array(pos, end, locateBlocks, in.locate_block_count) || pos != end)
+            throw std::invalid_argument("Index is the wrong size: " + fileName);
+        header = in;
+    }
+
+    const file_index_header& get_header() const { return header; }
+    /***
+     * @returns true if the index was built from a file of this size
+     */
+    bool matches(const mapped_file& file) const { return header.file_size == file.size(); }
+
+    /***
+     * @returns the offset to start reading from to see every record at or after the timestamp
+     */
+    uint64_t seek(uint64_t timestamp) const
+    {
+        // the last entry strictly before the time, so nothing with the same timestamp is skipped
+        auto itr = std::lower_bound(timeEntries.begin(), timeEntries.end(), timestamp,
+                [](const time_entry& lhs, uint64_t rhs) { return lhs.timestamp < rhs; });
+        if (itr == timeEntries.begin())
+            return 0;
+        return (itr - 1)->offset;
+    }
+    /****
+     * @brief calls func(record, record_length) for each record at or after a time
+     * @param file the ITCH file
+     * @param timestamp nanoseconds since midnight (see parse_time)
+     * @param func the callback. Return false to stop.
+     */
+    template<typename F>
+    void for_each_from(const mapped_file& file, uint64_t timestamp, F&& func) const
+    {
+        const uint8_t* data = file.data();
+        for(uint64_t pos = seek(timestamp); pos + RECORD_LENGTH_LEN <= file.size(); )
+        {
+            uint16_t recordLength = ((uint16_t)data[pos] << 8) | data[pos + 1];
+            if (pos + RECORD_LENGTH_LEN + recordLength > file.size())
+                break;
+            const uint8_t* record = data + pos + RECORD_LENGTH_LEN;
+            if (get_int(record, system_event::TIMESTAMP) >= timestamp && !func(record, recordLength))
+                break;
+            pos += RECORD_LENGTH_LEN + recordLength;
+        }
+    }
+
+    /***
+     * @returns the offset of the stock_directory for a locate, or UINT64_MAX if there was none
+     */
+    uint64_t directory_offset(uint16_t locate) const
+    {
+        for(const directory_entry& entry : directoryEntries)
+            if (entry.locate == locate)
+                return entry.offset;
+        return UINT64_MAX;
+    }
+    /***
+     * @returns the locate of a symbol, from the stock_directory records. 0 if not found
+     */
+    uint16_t find_locate(const mapped_file& file, const std::string& symbol) const
+    {
+        uint64_t packed = pack_symbol(symbol);
+        for(const directory_entry& entry : directoryEntries)
+            if (pack_symbol(file.data() + entry.offset + RECORD_LENGTH_LEN + stock_directory::STOCK.offset) == packed)
+                return entry.locate;
+        return 0;
+    }
+    /****
+     * @brief calls func(record, record_length) for each record of one instrument, in file order
+     * @param file the ITCH file
+     * @param locate the instrument
+     * @param func the callback
+     * @return the number of records passed to func
+     */
+    template<typename F>
+    size_t for_each_locate(const mapped_file& file, uint16_t locate, F&& func) const
+    {
+        size_t found = 0;
+        for(uint32_t idx = locateStarts[locate]; idx < locateStarts[(size_t)locate + 1]; ++idx)
+        {
+            uint32_t block = locateBlocks[idx];
+            uint64_t start = blockOffsets[block];
+            uint64_t end = block + 1 < blockOffsets.size() ? blockOffsets[block + 1] : file.size();
+            for_each_record(file.data() + start, end - start, [&](const uint8_t* record, uint16_t length) {
+                if (get_stock_locate(record) == locate)
+                {
+                    func(record, length);
+                    found++;
+                }
+            });
+        }
+        return found;
+    }
+
+    /***
+     * @param in HH:MM:SS, with optional fractional seconds (i.e. "10:30:00" or "09:30:00.000123")
+     * @returns nanoseconds since midnight
+     */
+    static uint64_t parse_time(const std::string& in)
+    {
+        unsigned int hours = 0, minutes = 0, seconds = 0;
+        int consumed = 0;
+        if (sscanf(in.c_str(), "%u:%u:%u%n", &hours, &minutes, &seconds, &consumed) != 3)
+            throw std::invalid_argument("Unable to parse time " + in);
+        uint64_t retVal = ((uint64_t)hours * 3600 + minutes * 60 + seconds) * 1000000000ull;
+        if (in[consumed] == '.')
+        {
+            uint64_t scale = 100000000ull;
+            for(size_t i = consumed + 1; i < in.size() && scale > 0 && isdigit(in[i]); ++i, scale /= 10)
+                retVal += (in[i] - '0') * scale;
+        }
+        return retVal;
+    }
+
+    /****
+     * @brief look for the start of a record, by finding a run of records that are the right length
+     * for their type
+     * @param data the file
+     * @param length the size of the file
+     * @param from where to start looking
+     * @return the offset of a record, or length if none was found
+     */
+    static size_t find_record(const uint8_t* data, size_t length, size_t from)
+    {
+        for(size_t pos = from; pos + RECORD_LENGTH_LEN < length; ++pos)
+        {
+            size_t curr = pos;
+            size_t matched = 0;
+            while(matched < SYNC_RECORDS && curr + RECORD_LENGTH_LEN < length)
+            {
+                uint16_t recordLength = ((uint16_t)data[curr] << 8) | data[curr + 1];
+                if (recordLength == 0 || get_record_length(data[curr + RECORD_LENGTH_LEN]) != recordLength)
+                    break;
+                curr += RECORD_LENGTH_LEN + recordLength;
+                matched++;
+            }
+            // a short run is fine if it ends exactly at the end of the file
+            if (matched == SYNC_RECORDS || (matched > 0 && curr == length))
+                return pos;
+        }
+        return length;
+    }
+
+    protected:
+    /***
+     * What one thread found
+     */
+    struct partial {
+        size_t end = 0;
+        uint64_t records = 0;
+        std::vector<time_entry> times;
+        std::vector<std::pair<uint64_t, uint64_t>> blocks; // block number, offset of its first record
+        std::vector<directory_entry> directory;
+        std::vector<std::vector<uint32_t>> locates;
+    };
+
+    void scan(const uint8_t* data, size_t start, size_t end, partial& out) const
+    {
+        out.locates.resize(MAX_LOCATES);
+        uint64_t lastBucket = UINT64_MAX;
+        uint64_t lastBlock = UINT64_MAX;
+        size_t pos = start;
+        while(pos + RECORD_LENGTH_LEN <= header.file_size && pos < end)
+        {
+            uint16_t recordLength = ((uint16_t)data[pos] << 8) | data[pos + 1];
+            if (pos + RECORD_LENGTH_LEN + recordLength > header.file_size)
+                break;
+            const uint8_t* record = data + pos + RECORD_LENGTH_LEN;
+            uint64_t bucket = get_int(record, system_event::TIMESTAMP) / header.time_granularity;
+            if (bucket != lastBucket)
+            {
+                out.times.push_back({get_int(record, system_event::TIMESTAMP), pos});
+                lastBucket = bucket;
+            }
+            uint64_t block = pos / header.block_size;
+            if (block != lastBlock)
+            {
+                out.blocks.push_back({block, pos});
+                lastBlock = block;
+            }
+            std::vector<uint32_t>& blocks = out.locates[get_stock_locate(record)];
+            if (blocks.empty() || blocks.back() != block)
+                blocks.push_back(block);
+            if (record[0] == 'R')
+                out.directory.push_back({pos, get_stock_locate(record)});
+            out.records++;
+            pos += RECORD_LENGTH_LEN + recordLength;
+        }
+        out.end = pos;
+    }
+
+    void merge(std::vector<partial>& parts)
+    {
+        timeEntries.clear();
+        directoryEntries.clear();
+        header.record_count = 0;
+        blockOffsets.assign((header.file_size + header.block_size - 1) / header.block_size, UINT64_MAX);
+        for(partial& part : parts)
+        {
+            header.record_count += part.records;
+            for(const time_entry& entry : part.times)
+            {
+                // a bucket can straddle two pieces, keep the first
+                if (timeEntries.empty() || entry.timestamp / header.time_granularity
+                        != timeEntries.back().timestamp / header.time_granularity)
+                    timeEntries.push_back(entry);
+            }
+            for(const auto& entry : part.blocks)
+                if (entry.second < blockOffsets[entry.first])
+                    blockOffsets[entry.first] = entry.second;
+            directoryEntries.insert(directoryEntries.end(), part.directory.begin(), part.directory.end());
+        }
+        // blocks nothing starts in (i.e. past a partial record at the end) begin where the next one does
+        uint64_t next = header.file_size;
+        for(size_t i = blockOffsets.size(); i > 0; --i)
+        {
+            if (blockOffsets[i - 1] == UINT64_MAX)
+                blockOffsets[i - 1] = next;
+            next = blockOffsets[i - 1];
+        }
+        // the locate lists, flattened
+        locateStarts.assign(MAX_LOCATES + 1, 0);
+        locateBlocks.clear();
+        for(size_t locate = 0; locate < MAX_LOCATES; ++locate)
+        {
+            locateStarts[locate] = locateBlocks.size();
+            for(partial& part : parts)
+                for(uint32_t block : part.locates[locate])
+                    if (locateBlocks.size() == locateStarts[locate] || locateBlocks.back() != block)
+                        locateBlocks.push_back(block);
+        }
+        locateStarts[MAX_LOCATES] = locateBlocks.size();
+        header.time_count = timeEntries.size();
+        header.block_count = blockOffsets.size();
+        header.directory_count = directoryEntries.size();
+        header.locate_block_count = locateBlocks.size();
+    }
+
+    template<typename T>
+    static bool write_array(FILE* out, const std::vector<T>& in)
+    {
+        return in.empty() || fwrite(in.data(), sizeof(T), in.size(), out) == in.size();
+    }
+    template<typename T>
+    static bool read_array(const uint8_t*& pos, const uint8_t* end, std::vector<T>& out, uint64_t count)
+    {
+        if ((uint64_t)(end - pos) / sizeof(T) < count)
+            return false;
+        out.resize(count);
+        memcpy(out.data(), pos, count * sizeof(T));
+        pos += count * sizeof(T);
+        return true;
+    }
+
+    protected:
+    file_index_header header;
+    std::vector<time_entry> timeEntries;
+    std::vector<uint64_t> blockOffsets;
+    std::vector<directory_entry> directoryEntries;
+    std::vector<uint32_t> locateStarts; // index into locateBlocks, one per locate plus one
+    std::vector<uint32_t> locateBlocks;
+};
+
+} // end namespace itch
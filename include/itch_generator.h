@@ -0,0 +1,145 @@
+#pragma once
+#include "itch_file.h"
+#include <string>
+#include <vector>
+
+namespace itch
+{
+
+/***
+ * Makes up a plausible trading day of ITCH 5.0, for tests and benchmarks.
+ *
+ * The day opens with the system events, a stock_directory and stock_trading_action for each
+ * symbol, then runs add, execute, cancel, replace and delete flows against the orders it has
+ * added, and closes with the end of day system events. Every execute, cancel, replace and
+ * delete refers to an order that is live at the time, so the output drives an order book.
+ *
+ * Records are encoded straight into the caller's buffer with their 2 byte length prefix, the
+ * same layout as an ITCH file. The same seed gives the same day.
+ */
+class generator
+{
+    public:
+    struct options
+    {
+        uint16_t symbols = 100;
+        uint64_t messages = 1000000; // order flow messages, not counting the open and close
+        uint64_t seed = 1;
+        uint64_t startTime = 34200000000000ull; // 09:30, in ns since midnight
+        uint64_t meanGapNs = 20000; // between messages outside a burst
+        // the message mix, as relative weights
+        uint32_t addWeight = 40;
+        uint32_t executeWeight = 8;
+        uint32_t cancelWeight = 10;
+        uint32_t replaceWeight = 12;
+        uint32_t deleteWeight = 30;
+        // the chance (out of 1000) that a message starts a burst
+        uint32_t burstChance = 2;
+        uint32_t burstLength = 200; // messages
+        uint64_t burstGapNs = 100; // between messages in a burst
+    };
+    /***
+     * No record is longer than this (with its length prefix)
+     */
+    static constexpr size_t MAX_RECORD = 64;
+
+    generator(const options& opts);
+
+    /****
+     * @brief write the next records, each behind its 2 byte length
+     * @param buffer where to write
+     * @param capacity the size of the buffer, at least MAX_RECORD
+     * @return the number of bytes written, 0 once the day is over
+     */
+    size_t generate(uint8_t* buffer, size_t capacity);
+    bool done() const { return phase == phase_type::DONE; }
+    /***
+     * @returns the number of records written so far
+     */
+    uint64_t get_records() const { return records; }
+    size_t get_live_orders() const { return live.size(); }
+
+    /***
+     * Calls func(record, record_length) for each record of the rest of the day
+     * @returns the number of records
+     */
+    template<typename F>
+    uint64_t for_each(F&& func, size_t bufferSize = 1024 * 1024)
+    {
+        std::vector<uint8_t> buffer(bufferSize < MAX_RECORD ? MAX_RECORD : bufferSize);
+        uint64_t start = records;
+        for(size_t length = generate(buffer.data(), buffer.size()); length > 0;
+                length = generate(buffer.data(), buffer.size()))
+            for_each_record(buffer.data(), length, func);
+        return records - start;
+    }
+    /***
+     * Sends the rest of the day as sequenced data, i.e. through a SoupBinServer
+     * @returns the number of records
+     */
+    template<typename SERVER>
+    uint64_t publish(SERVER& server)
+    {
+        return for_each([&server](const uint8_t* record, uint16_t length) {
+            server.send_sequenced(std::vector<unsigned char>(record, record + length));
+        });
+    }
+    /***
+     * Writes the rest of the day to an ITCH file
+     * @returns the number of records
+     */
+    uint64_t write_file(const std::string& fileName, size_t bufferSize = 4 * 1024 * 1024);
+
+    protected:
+    enum class phase_type
+    {
+        OPEN = 0,
+        DIRECTORY = 1,
+        TRADING_ACTION = 2,
+        MARKET_OPEN = 3,
+        FLOW = 4,
+        CLOSE = 5,
+        DONE = 6
+    };
+    struct live_order {
+        uint64_t reference;
+        uint32_t price;
+        uint32_t shares;
+        uint16_t locate;
+        char side;
+    };
+
+    /***
+     * Write the next record (without its length)
+     * @returns the length of the record
+     */
+    uint16_t next_record(uint8_t* out);
+    uint16_t next_flow(uint8_t* out);
+    uint16_t write_add(uint8_t* out);
+    uint16_t write_system_event(uint8_t* out, char eventCode);
+    uint16_t write_directory(uint8_t* out, uint16_t locate);
+    uint16_t write_trading_action(uint8_t* out, uint16_t locate);
+    void write_header(uint8_t* out, char messageType, uint16_t locate);
+    void remove_live(size_t idx);
+    void advance_time();
+    uint64_t next_random();
+    uint64_t random_below(uint64_t bound) { return next_random() % bound; }
+
+    protected:
+    options opts;
+    phase_type phase = phase_type::OPEN;
+    uint32_t phaseStep = 0; // progress within the phase
+    uint64_t random = 0;
+    uint64_t timestamp = 0;
+    uint32_t burstLeft = 0;
+    uint64_t flowMessages = 0;
+    uint64_t records = 0;
+    uint64_t nextReference = 1;
+    uint64_t nextMatch = 1;
+    uint32_t totalWeight = 0;
+    std::vector<uint64_t> symbols; // packed, by locate - 1
+    std::vector<uint32_t> mids; // Price(4), by locate - 1
+    std::vector<live_order> live;
+};
+
+} // end namespace itch
@@ -0,0 +1,191 @@
+#pragma once
+#include "itch.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace itch
+{
+
+/***
+ * The reference state of one instrument, built up from the administrative messages
+ */
+struct instrument {
+    uint64_t symbol = 0; // packed, see pack_symbol. 0 if no stock_directory has been seen
+    uint32_t round_lot_size = 0;
+    char market_category = ' ';
+    char financial_status_indicator = ' ';
+    char round_lots_only = ' ';
+    char issue_classification = ' ';
+    char issue_sub_type[2] = {' ', ' '};
+    char authenticity = ' ';
+    char short_sale_threshold_indicator = ' ';
+    char ipo_flag = ' ';
+    char luld_reference_price_tier = ' ';
+    char etp_flag = ' ';
+    char inverse_indicator = ' ';
+    uint32_t etp_leverage_factor = 0;
+    // stock_trading_action
+    char trading_state = ' '; // H halted, P paused, Q quotation only, T trading
+    char trading_reason[4] = {' ', ' ', ' ', ' '};
+    // reg_sho_restriction: 0 no price test, 1 in effect (intra-day drop), 2 remains in effect
+    char reg_sho_action = '0';
+    // operational_halt
+    char operational_halt_market = ' ';
+    char operational_halt_action = ' '; // H halted, T resumed
+    // ipo_quoting_period_update
+    char ipo_quotation_release_qualifier = ' ';
+    uint32_t ipo_quotation_release_time = 0;
+    uint32_t ipo_price = 0;
+    // luld_auction_collar
+    uint32_t auction_collar_reference_price = 0;
+    uint32_t upper_auction_collar_price = 0;
+    uint32_t lower_auction_collar_price = 0;
+    uint32_t auction_collar_extension = 0;
+
+    bool known() const { return symbol != 0; }
+    bool is_halted() const
+    {
+        return trading_state == 'H' || trading_state == 'P' || operational_halt_action == 'H';
+    }
+    bool is_trading() const { return trading_state == 'T' && operational_halt_action != 'H'; }
+    bool is_short_sale_restricted() const { return reg_sho_action == '1' || reg_sho_action == '2'; }
+};
+
+/***
+ * Instrument reference state, indexed by STOCK_LOCATE.
+ *
+ * Every locate has a slot in a flat array, so lookups by locate are a single index. Symbols are
+ * packed into 64 bit integers and resolved to locates with an open addressed hash table.
+ */
+class instrument_table
+{
+    public:
+    static const size_t MAX_LOCATES = 65536;
+
+    instrument_table() : instruments(MAX_LOCATES), symbols(SYMBOL_SLOTS) {}
+
+    const instrument& get(uint16_t locate) const { return instruments[locate]; }
+    const instrument& operator[](uint16_t locate) const { return instruments[locate]; }
+
+    /****
+     * @brief find the locate for a symbol
+     * @param symbol the packed symbol (see pack_symbol)
+     * @return the locate, or 0 if not found (0 is never given to an instrument)
+     */
+    uint16_t find(uint64_t symbol) const
+    {
+        for(size_t slot = hash(symbol); ; slot = (slot + 1) & (SYMBOL_SLOTS - 1))
+        {
+            const symbol_slot& curr = symbols[slot];
+            if (curr.symbol == 0)
+                return 0;
+            // the locate may have been handed to a different symbol since
+            if (curr.symbol == symbol && instruments[curr.locate].symbol == symbol)
+                return curr.locate;
+        }
+    }
+    uint16_t find(const std::string& symbol) const { return find(pack_symbol(symbol)); }
+
+    /****
+     * @brief update the table from a raw ITCH record
+     * @param record the record, starting with the message type
+     * @return true if the record was one of the administrative messages the table keeps
+     */
+    bool apply(const uint8_t* record)
+    {
+        instrument& curr = instruments[get_stock_locate(record)];
+        switch(record[0])
+        {
+            case('R'):
+                on_stock_directory(record, curr);
+                return true;
+            case('H'):
+                curr.trading_state = record[stock_trading_action::TRADING_STATE.offset];
+                memcpy(curr.trading_reason, &record[stock_trading_action::REASON.offset], 4);
+                return true;
+            case('Y'):
+                curr.reg_sho_action = record[reg_sho_restriction::REG_SHO_ACTION.offset];
+                return true;
+            case('h'):
+                curr.operational_halt_market = record[operational_halt::MARKET_CODE.offset];
+                curr.operational_halt_action = record[operational_halt::OPERATIONAL_HALT_ACTION.offset];
+                return true;
+            case('K'):
+                curr.ipo_quotation_release_time = get_int(record, ipo_quoting_period_update::IPO_QUOTATION_RELEASE_TIME);
+                curr.ipo_quotation_release_qualifier =
+                        record[ipo_quoting_period_update::IPO_QUOTATION_RELEASE_QUALIFIER.offset];
+                curr.ipo_price = get_int(record, ipo_quoting_period_update::IPO_PRICE);
+                return true;
+            case('J'):
+                curr.auction_collar_reference_price =
+                        get_int(record, luld_auction_collar::AUCTION_COLLAR_REFERENCE_PRICE);
+                curr.upper_auction_collar_price = get_int(record, luld_auction_collar::UPPER_AUCTION_COLLAR_PRICE);
+                curr.lower_auction_collar_price = get_int(record, luld_auction_collar::LOWER_AUCTION_COLLAR_PRICE);
+                curr.auction_collar_extension = get_int(record, luld_auction_collar::AUCTION_COLLAR_EXTENSION);
+                return true;
+            default:
+                break;
+        }
+        return false;
+    }
+    template<unsigned int SIZE>
+    bool apply(const message<SIZE>& msg) { return apply(msg.get_record()); }
+
+    /***
+     * Forget everything (i.e. at the start of a new day)
+     */
+    void clear()
+    {
+        std::fill(instruments.begin(), instruments.end(), instrument());
+        std::fill(symbols.begin(), symbols.end(), symbol_slot());
+    }
+
+    protected:
+    void on_stock_directory(const uint8_t* record, instrument& curr)
+    {
+        uint16_t locate = get_stock_locate(record);
+        curr.symbol = pack_symbol(&record[stock_directory::STOCK.offset]);
+        curr.market_category = record[stock_directory::MARKET_CATEGORY.offset];
+        curr.financial_status_indicator = record[stock_directory::FINANCIAL_STATUS_INDICATOR.offset];
+        curr.round_lot_size = get_int(record, stock_directory::ROUND_LOT_SIZE);
+        curr.round_lots_only = record[stock_directory::ROUND_LOTS_ONLY.offset];
+        curr.issue_classification = record[stock_directory::ISSUE_CLASSIFICATION.offset];
+        memcpy(curr.issue_sub_type, &record[stock_directory::ISSUE_SUB_TYPE.offset], 2);
+        curr.authenticity = record[stock_directory::AUTHENTICITY.offset];
+        curr.short_sale_threshold_indicator = record[stock_directory::SHORT_SALE_THRESHOLD_INDICATOR.offset];
+        curr.ipo_flag = record[stock_directory::IPO_FLAG.offset];
+        curr.luld_reference_price_tier = record[stock_directory::LULDREFERENCE_PRICE_TIER.offset];
+        curr.etp_flag = record[stock_directory::ETP_FLAG.offset];
+        curr.etp_leverage_factor = get_int(record, stock_directory::ETP_LEVERAGE_FACTOR);
+        curr.inverse_indicator = record[stock_directory::INVERSE_INDICATOR.offset];
+        index_symbol(curr.symbol, locate);
+    }
+    void index_symbol(uint64_t symbol, uint16_t locate)
+    {
+        size_t slot = hash(symbol);
+        while(symbols[slot].symbol != 0 && symbols[slot].symbol != symbol)
+            slot = (slot + 1) & (SYMBOL_SLOTS - 1);
+        symbols[slot].symbol = symbol;
+        symbols[slot].locate = locate;
+    }
+    static size_t hash(uint64_t symbol)
+    {
+        // fibonacci hashing, the top bits are the best mixed
+        return (symbol * 0x9E3779B97F4A7C15ull) >> (64 - SYMBOL_BITS);
+    }
+
+    protected:
+    friend class checkpoint;
+    struct symbol_slot {
+        uint64_t symbol = 0;
+        uint16_t locate = 0;
+    };
+    // twice the number of locates keeps the probes short
+    static const size_t SYMBOL_BITS = 17;
+    static const size_t SYMBOL_SLOTS = 1 << SYMBOL_BITS;
+    std::vector<instrument> instruments;
+    std::vector<symbol_slot> symbols;
+};
+
+} // end namespace itch
@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/***
+ * Latency probes on the hot path. They compile to nothing unless NASDAQ_ITCH_LATENCY is
+ * defined, which has to be the same for everything that includes this.
+ *
+ * uint64_t start = ITCH_PROBE_TSC();
+ * ... the work ...
+ * ITCH_PROBE(itch::latency_stage::BOOK_UPDATE, start);
+ */
+#ifdef NASDAQ_ITCH_LATENCY
+#define ITCH_PROBE_TSC() itch::read_tsc()
+#define ITCH_PROBE(stage, start) itch::latency_registry::record(stage, start)
+#else
+#define ITCH_PROBE_TSC() 0
+#define ITCH_PROBE(stage, start) (void)(start)
+#endif
+
+namespace itch
+{
+
+/***
+ * @returns the time stamp counter, or steady_clock nanoseconds where there is none
+ */
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/***
+ * Where the time goes
+ */
+enum class latency_stage
+{
+    SOCKET_READ = 0, // from the header arriving to the body arriving
+    FRAME_PARSE = 1, // from the body arriving to the frame being handed on
+    DISPATCH = 2, // on_sequenced_data, until it returns
+    BOOK_UPDATE = 3, // order_book::apply
+    COUNT = 4
+};
+
+inline const char* to_string(latency_stage stage)
+{
+    static const char* names[] = { "socket_read", "frame_parse", "dispatch", "book_update" };
+    return stage < latency_stage::COUNT ? names[(int)stage] : "unknown";
+}
+
+/***
+ * A histogram of cycle counts with a relative error under 2% (close to HdrHistogram with 2
+ * significant digits). Values under 128 get a bucket each, and every power of two above that
+ * is split into 64 buckets.
+ *
+ * One thread records, any thread can read while it does. Recording is a relaxed load and store,
+ * no locked instruction.
+ */
+class hdr_histogram
+{
+    public:
+    static constexpr int SUB_BITS = 7;
+    static constexpr uint64_t SUB_COUNT = 1 << SUB_BITS;
+    static constexpr uint64_t HALF_COUNT = SUB_COUNT / 2;
+    static constexpr size_t BUCKETS = SUB_COUNT + (64 - SUB_BITS) * HALF_COUNT;
+
+    hdr_histogram() : counts(BUCKETS) {}
+    hdr_histogram(const hdr_histogram& in) : counts(BUCKETS) { merge(in); }
+
+    void record(uint64_t value)
+    {
+        catch_up_with_reset();
+        increment(counts[bucket_of(value)], 1);
+        increment(total, 1);
+        if (value > maximum.load(std::memory_order_relaxed))
+            maximum.store(value, std::memory_order_relaxed);
+        // a reset() in the middle would be undone by the stores above
+        catch_up_with_reset();
+    }
+    /***
+     * Add the counts of another histogram to this one
+     */
+    void merge(const hdr_histogram& in)
+    {
+        for(size_t i = 0; i < BUCKETS; ++i)
+        {
+            uint64_t val = in.counts[i].load(std::memory_order_relaxed);
+            if (val > 0)
+                increment(counts[i], val);
+        }
+        increment(total, in.get_count());
+        if (in.get_max() > get_max())
+            maximum.store(in.get_max(), std::memory_order_relaxed);
+    }
+    /***
+     * Can be called from any thread. The owner clears the counts again when it next records,
+     * in case it wrote back old ones, so a value recorded at the same time may be lost.
+     */
+    void reset()
+    {
+        clear();
+        resets.fetch_add(1, std::memory_order_release);
+    }
+
+    uint64_t get_count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t get_max() const { return maximum.load(std::memory_order_relaxed); }
+    /***
+     * @param percentile i.e. 99.9
+     * @returns the highest value of the bucket the percentile falls in, or 0 if there are no values
+     */
+    uint64_t value_at_percentile(double percentile) const
+    {
+        uint64_t count = 0;
+        for(size_t i = 0; i < BUCKETS; ++i)
+            count += counts[i].load(std::memory_order_relaxed);
+        if (count == 0)
+            return 0;
+        uint64_t target = (uint64_t)(percentile / 100.0 * count + 0.5);
+        if (target == 0)
+            target = 1;
+        uint64_t sum = 0;
+        for(size_t i = 0; i < BUCKETS; ++i)
+        {
+            sum += counts[i].load(std::memory_order_relaxed);
+            if (sum >= target)
+                return std::min(highest_in_bucket(i), get_max());
+        }
+        return get_max();
+    }
+
+    static size_t bucket_of(uint64_t value)
+    {
+        if (value < SUB_COUNT)
+            return value;
+        int shift = 63 - __builtin_clzll(value) - (SUB_BITS - 1);
+        return SUB_COUNT + (shift - 1) * HALF_COUNT + ((value >> shift) - HALF_COUNT);
+    }
+    static uint64_t highest_in_bucket(size_t bucket)
+    {
+        if (bucket < SUB_COUNT)
+            return bucket;
+        int shift = (bucket - SUB_COUNT) / HALF_COUNT + 1;
+        uint64_t top = (bucket - SUB_COUNT) % HALF_COUNT + HALF_COUNT;
+        return ((top + 1) << shift) - 1;
+    }
+
+    protected:
+    // only the owning thread writes, so this does not need to be a read-modify-write
+    static void increment(std::atomic<uint64_t>& counter, uint64_t by)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+    void clear()
+    {
+        for(auto& curr : counts)
+            curr.store(0, std::memory_order_relaxed);
+        total.store(0, std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+    void catch_up_with_reset()
+    {
+        uint64_t latest = resets.load(std::memory_order_acquire);
+        if (latest != seenResets)
+        {
+            seenResets = latest;
+            clear();
+        }
+    }
+
+    protected:
+    std::vector<std::atomic<uint64_t>> counts;
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maximum{0};
+    std::atomic<uint64_t> resets{0}; // bumped by reset()
+    uint64_t seenResets = 0; // the owner's view of resets
+};
+
+/***
+ * The histograms of every thread that has recorded, one per stage. A thread's histograms are
+ * kept after it exits, so they are still in the totals.
+ */
+class latency_registry
+{
+    public:
+    struct thread_histograms
+    {
+        std::thread::id owner;
+        hdr_histogram stages[(int)latency_stage::COUNT];
+    };
+
+    static latency_registry& instance()
+    {
+        static latency_registry registry;
+        return registry;
+    }
+
+    /***
+     * Record the cycles from start until now against this thread's histogram of the stage
+     */
+    static void record(latency_stage stage, uint64_t start)
+    {
+        uint64_t now = read_tsc();
+        local().stages[(int)stage].record(now > start ? now - start : 0);
+    }
+    /***
+     * @returns this thread's histograms
+     */
+    static thread_histograms& local()
+    {
+        thread_local thread_histograms* mine = instance().add_thread();
+        return *mine;
+    }
+
+    /***
+     * @returns the histogram of a stage over all threads, in cycles
+     */
+    hdr_histogram snapshot(latency_stage stage) const
+    {
+        hdr_histogram retVal;
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for(const auto& curr : threads)
+            retVal.merge(curr->stages[(int)stage]);
+        return retVal;
+    }
+    void reset()
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        for(const auto& curr : threads)
+            for(auto& stage : curr->stages)
+                stage.reset();
+    }
+    /***
+     * A line per stage that has values, i.e.
+     * "book_update count=1000 p50=35ns p99=120ns p99.9=400ns max=2100ns"
+     */
+    std::string dump() const
+    {
+        double perNs = cycles_per_ns();
+        std::stringstream ss;
+        for(int i = 0; i < (int)latency_stage::COUNT; ++i)
+        {
+            hdr_histogram curr = snapshot((latency_stage)i);
+            if (curr.get_count() == 0)
+                continue;
+            ss << to_string((latency_stage)i)
+                    << " count=" << curr.get_count()
+                    << " p50=" << (uint64_t)(curr.value_at_percentile(50.0) / perNs) << "ns"
+                    << " p99=" << (uint64_t)(curr.value_at_percentile(99.0) / perNs) << "ns"
+                    << " p99.9=" << (uint64_t)(curr.value_at_percentile(99.9) / perNs) << "ns"
+                    << " max=" << (uint64_t)(curr.get_max() / perNs) << "ns\n";
+        }
+        return ss.str();
+    }
+    /***
+     * @returns how many read_tsc() ticks make a nanosecond, measured over 10ms the first time
+     */
+    static double cycles_per_ns()
+    {
+        static const double retVal = []() {
+#if defined(__x86_64__) || defined(__i386__)
+            auto startTime = std::chrono::steady_clock::now();
+            uint64_t startTsc = read_tsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            uint64_t ticks = read_tsc() - startTsc;
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - startTime).count();
+            return ns > 0 && ticks > 0 ? (double)ticks / ns : 1.0;
+#else
+            return 1.0;
+#endif
+        }();
+        return retVal;
+    }
+
+    protected:
+    thread_histograms* add_thread()
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex);
+        threads.push_back(std::make_unique<thread_histograms>());
+        threads.back()->owner = std::this_thread::get_id();
+        return threads.back().get();
+    }
+
+    protected:
+    mutable std::mutex threadsMutex;
+    std::vector<std::unique_ptr<thread_histograms>> threads;
+};
+
+} // end namespace itch
@@ -0,0 +1,101 @@
+#pragma once
+#include "itch.h"
+#include "itch_instrument_table.h"
+#include "message_filter.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+
+namespace itch
+{
+
+/***
+ * Drops records for instruments nobody subscribed to, by checking the STOCK_LOCATE
+ * (offset 1 of every record) against a bitset.
+ *
+ * Subscriptions by symbol are resolved to a locate when their stock_directory comes through
+ * the filter (or right away, if given an instrument_table that already knows them). Records
+ * with a locate of 0 (system events, MWCP) always pass.
+ */
+class locate_filter : public MessageFilter
+{
+    public:
+    locate_filter()
+    {
+        clear();
+    }
+
+    void subscribe(uint16_t locate) { bits[locate >> 6] |= (uint64_t)1 << (locate & 63); }
+    void unsubscribe(uint16_t locate)
+    {
+        if (locate != 0)
+            bits[locate >> 6] &= ~((uint64_t)1 << (locate & 63));
+    }
+    bool is_subscribed(uint16_t locate) const { return (bits[locate >> 6] >> (locate & 63)) & 1; }
+    /***
+     * Subscribe to a symbol, resolved once its stock_directory passes through
+     */
+    void subscribe(const std::string& symbol)
+    {
+        uint64_t packed = pack_symbol(symbol);
+        auto itr = std::lower_bound(subscribedSymbols.begin(), subscribedSymbols.end(), packed);
+        if (itr == subscribedSymbols.end() || *itr != packed)
+            subscribedSymbols.insert(itr, packed);
+    }
+    /***
+     * Subscribe to a symbol, using the table if it already knows the locate
+     */
+    void subscribe(const std::string& symbol, const instrument_table& table)
+    {
+        uint16_t locate = table.find(symbol);
+        if (locate != 0)
+            subscribe(locate);
+        // the locate can change from day to day, so keep watching the directory
+        subscribe(symbol);
+    }
+    void clear()
+    {
+        memset(bits, 0, sizeof(bits));
+        subscribedSymbols.clear();
+        subscribe((uint16_t)0);
+    }
+
+    virtual bool accept(const uint8_t* record, size_t length) override
+    {
+        // too short to have a STOCK_LOCATE
+        if (length < 3)
+        {
+            dropped++;
+            return false;
+        }
+        uint16_t locate = get_stock_locate(record);
+        if (is_subscribed(locate))
+            return true;
+        if (record[0] == 'R' && length >= STOCK_DIRECTORY_LEN && !subscribedSymbols.empty() && resolve(record))
+        {
+            subscribe(locate);
+            return true;
+        }
+        dropped++;
+        return false;
+    }
+
+    /***
+     * The number of records turned away
+     */
+    uint64_t get_dropped() const { return dropped; }
+
+    private:
+    bool resolve(const uint8_t* record) const
+    {
+        return std::binary_search(subscribedSymbols.begin(), subscribedSymbols.end(),
+                pack_symbol(&record[stock_directory::STOCK.offset]));
+    }
+
+    private:
+    uint64_t bits[instrument_table::MAX_LOCATES / 64];
+    std::vector<uint64_t> subscribedSymbols; // sorted
+    uint64_t dropped = 0;
+};
+
+} // end namespace itch
@@ -0,0 +1,324 @@
+#pragma once
+#include "itch.h"
+#include "itch_latency.h"
+#include <vector>
+#include <algorithm>
+
+namespace itch
+{
+
+/***
+ * A resting order. Plain data, so the book can be copied out and back in with memcpy
+ */
+struct order {
+    uint64_t reference = 0; // 0 marks an empty slot
+    uint64_t priority = 0; // arrival order, lower was first
+    uint32_t price = 0; // 4 decimal places
+    uint32_t shares = 0;
+    uint16_t locate = 0;
+    char side = ' '; // B or S
+};
+
+struct price_level {
+    uint32_t price = 0;
+    uint32_t orders = 0;
+    uint64_t shares = 0;
+};
+
+/***
+ * Full depth, order by order book for every STOCK_LOCATE.
+ *
+ * Orders live in an open addressing hash table keyed by ORDER_REFERENCE_NUMBER. Price levels
+ * are kept in a sorted vector per locate and side, with the best price at the back, as most of
+ * the activity is at or near the top of the book.
+ */
+class order_book
+{
+    public:
+    static const size_t MAX_LOCATES = 65536;
+
+    order_book(size_t initialCapacity = 1 << 20) : levels(MAX_LOCATES * 2)
+    {
+        size_t capacity = 16;
+        while(capacity < initialCapacity)
+            capacity <<= 1;
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+    virtual ~order_book() {}
+
+    /****
+     * @brief update the book from a raw ITCH record
+     * @param record the record, starting with the message type
+     * @return true if the record changed the book
+     */
+    bool apply(const uint8_t* record)
+    {
+        uint64_t start = ITCH_PROBE_TSC();
+        bool retVal = update(record);
+        ITCH_PROBE(latency_stage::BOOK_UPDATE, start);
+        return retVal;
+    }
+    template<unsigned int SIZE>
+    bool apply(const message<SIZE>& msg) { return apply(msg.get_record()); }
+
+    /***
+     * @returns the order, or nullptr
+     */
+    const order* find(uint64_t reference) const
+    {
+        size_t slot = find_slot(reference);
+        return slots[slot].reference == 0 ? nullptr : &slots[slot];
+    }
+    size_t size() const { return count; }
+
+    /***
+     * @returns the levels for one side, best price at the back
+     */
+    const std::vector<price_level>& get_levels(uint16_t locate, char side) const
+    {
+        return levels[level_index(locate, side)];
+    }
+    /***
+     * @returns the best level, or an empty one (price 0) if the side is empty
+     */
+    price_level best_bid(uint16_t locate) const { return best(locate, 'B'); }
+    price_level best_ask(uint16_t locate) const { return best(locate, 'S'); }
+    /***
+     * @returns the level at a price, or an empty one (price 0) if there is none
+     */
+    price_level get_level(uint16_t locate, char side, uint32_t price) const
+    {
+        const std::vector<price_level>& curr = levels[level_index(locate, side)];
+        size_t pos = find_level(curr, side, price);
+        return pos == curr.size() || curr[pos].price != price ? price_level() : curr[pos];
+    }
+
+    /***
+     * Calls func(const order&) for each resting order, in no particular order
+     */
+    template<typename F>
+    void for_each_order(F&& func) const
+    {
+        for(const order& curr : slots)
+            if (curr.reference != 0)
+                func(curr);
+    }
+
+    /***
+     * Forget everything (i.e. at the start of a new day)
+     */
+    void clear()
+    {
+        std::fill(slots.begin(), slots.end(), order());
+        for(auto& side : levels)
+            side.clear();
+        count = 0;
+        nextPriority = 1;
+    }
+
+    protected:
+    /***
+     * apply() without the probe
+     */
+    bool update(const uint8_t* record)
+    {
+        switch(record[0])
+        {
+            case('A'):
+            case('F'):
+                add(get_int(record, add_order::ORDER_REFERENCE_NUMBER), get_stock_locate(record),
+                        record[add_order::BUY_SELL_INDICATOR.offset], get_int(record, add_order::PRICE),
+                        get_int(record, add_order::SHARES));
+                return true;
+            case('E'):
+                return reduce(get_int(record, order_executed::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_executed::EXECUTED_SHARES));
+            case('C'):
+                return reduce(get_int(record, order_executed_with_price::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_executed_with_price::EXECUTED_SHARES));
+            case('X'):
+                return reduce(get_int(record, order_cancel::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_cancel::CANCELLED_SHARES));
+            case('D'):
+                return remove(get_int(record, order_delete::ORDER_REFERENCE_NUMBER));
+            case('U'):
+                return replace(get_int(record, order_replace::ORIGINAL_ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_replace::NEW_ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_replace::PRICE), get_int(record, order_replace::SHARES));
+            default:
+                break;
+        }
+        return false;
+    }
+    void add(uint64_t reference, uint16_t locate, char side, uint32_t price, uint32_t shares)
+    {
+        // a reference that is already live replaces that order, so its level does not keep the shares
+        remove(reference);
+        order curr;
+        curr.reference = reference;
+        curr.priority = nextPriority++;
+        curr.price = price;
+        curr.shares = shares;
+        curr.locate = locate;
+        curr.side = side;
+        insert(curr);
+        add_to_level(curr, true);
+    }
+    /***
+     * Executions and partial cancels
+     */
+    bool reduce(uint64_t reference, uint32_t shares)
+    {
+        size_t slot = find_slot(reference);
+        order& curr = slots[slot];
+        if (curr.reference == 0)
+            return false;
+        if (shares >= curr.shares)
+        {
+            remove_from_level(curr, curr.shares, true);
+            erase(slot);
+        }
+        else
+        {
+            remove_from_level(curr, shares, false);
+            curr.shares -= shares;
+        }
+        return true;
+    }
+    bool remove(uint64_t reference)
+    {
+        size_t slot = find_slot(reference);
+        if (slots[slot].reference == 0)
+            return false;
+        remove_from_level(slots[slot], slots[slot].shares, true);
+        erase(slot);
+        return true;
+    }
+    /***
+     * The new order keeps the side and instrument, but goes to the back of the queue
+     */
+    bool replace(uint64_t original, uint64_t reference, uint32_t price, uint32_t shares)
+    {
+        size_t slot = find_slot(original);
+        if (slots[slot].reference == 0)
+            return false;
+        order prev = slots[slot];
+        remove_from_level(prev, prev.shares, true);
+        erase(slot);
+        add(reference, prev.locate, prev.side, price, shares);
+        return true;
+    }
+
+    static size_t level_index(uint16_t locate, char side) { return ((size_t)locate << 1) | (side == 'S' ? 1 : 0); }
+
+    /***
+     * Bids go up towards the back, asks go down
+     */
+    static bool better(char side, uint32_t lhs, uint32_t rhs) { return side == 'S' ? lhs < rhs : lhs > rhs; }
+
+    price_level best(uint16_t locate, char side) const
+    {
+        const std::vector<price_level>& curr = levels[level_index(locate, side)];
+        return curr.empty() ? price_level() : curr.back();
+    }
+
+    /***
+     * @returns the position of the price, or where it would be inserted
+     */
+    size_t find_level(const std::vector<price_level>& side, char sideCode, uint32_t price) const
+    {
+        // walk in from the top of the book
+        size_t pos = side.size();
+        while(pos > 0 && better(sideCode, side[pos - 1].price, price))
+            --pos;
+        return pos == 0 || side[pos - 1].price != price ? pos : pos - 1;
+    }
+
+    void add_to_level(const order& curr, bool newOrder)
+    {
+        std::vector<price_level>& side = levels[level_index(curr.locate, curr.side)];
+        size_t pos = find_level(side, curr.side, curr.price);
+        if (pos == side.size() || side[pos].price != curr.price)
+        {
+            price_level lvl;
+            lvl.price = curr.price;
+            side.insert(side.begin() + pos, lvl);
+        }
+        side[pos].shares += curr.shares;
+        if (newOrder)
+            side[pos].orders++;
+    }
+
+    void remove_from_level(const order& curr, uint32_t shares, bool lastOfOrder)
+    {
+        std::vector<price_level>& side = levels[level_index(curr.locate, curr.side)];
+        size_t pos = find_level(side, curr.side, curr.price);
+        if (pos == side.size() || side[pos].price != curr.price)
+            return;
+        side[pos].shares -= shares;
+        if (lastOfOrder && --side[pos].orders == 0)
+            side.erase(side.begin() + pos);
+    }
+
+    size_t hash(uint64_t reference) const { return (reference * 0x9E3779B97F4A7C15ull) & mask; }
+
+    size_t find_slot(uint64_t reference) const
+    {
+        size_t slot = hash(reference);
+        while(slots[slot].reference != 0 && slots[slot].reference != reference)
+            slot = (slot + 1) & mask;
+        return slot;
+    }
+
+    void insert(const order& in)
+    {
+        if ((count + 1) * 2 > slots.size())
+            grow();
+        size_t slot = find_slot(in.reference);
+        if (slots[slot].reference == 0)
+            count++;
+        slots[slot] = in;
+    }
+
+    /***
+     * Shift the rest of the probe run back so there are no tombstones
+     */
+    void erase(size_t slot)
+    {
+        size_t hole = slot;
+        for(size_t next = (hole + 1) & mask; slots[next].reference != 0; next = (next + 1) & mask)
+        {
+            size_t home = hash(slots[next].reference);
+            // it can move if its home is not between the hole and where it sits now
+            if (((next - home) & mask) >= ((next - hole) & mask))
+            {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        slots[hole] = order();
+        count--;
+    }
+
+    void grow()
+    {
+        std::vector<order> old(slots.size() * 2);
+        old.swap(slots);
+        mask = slots.size() - 1;
+        count = 0;
+        for(const order& curr : old)
+            if (curr.reference != 0)
+                insert(curr);
+    }
+
+    protected:
+    friend class checkpoint;
+    std::vector<order> slots;
+    size_t mask = 0;
+    size_t count = 0;
+    uint64_t nextPriority = 1;
+    std::vector<std::vector<price_level>> levels; // indexed by level_index
+};
+
+} // end namespace itch
@@ -0,0 +1,287 @@
+#pragma once
+#include "itch_file.h"
+#include "moldudp64.h"
+#include "message_filter.h"
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <string>
+
+namespace itch
+{
+
+struct pcap_stats
+{
+    uint64_t packets = 0;
+    uint64_t tcp_segments = 0;
+    uint64_t udp_datagrams = 0;
+    uint64_t skipped = 0; // not IPv4 TCP or UDP, or not on a port that was asked for
+    uint64_t truncated = 0; // cut short by the snap length, or corrupt
+    uint64_t fragments = 0; // IP fragments are not put back together
+    uint64_t out_of_order = 0; // TCP segments that arrived ahead of a hole
+    uint64_t retransmitted = 0; // TCP bytes that were already seen
+    uint64_t tcp_gaps = 0; // holes in a TCP stream that were never filled
+    uint64_t resync_bytes = 0; // TCP bytes dropped looking for a SoupBinTCP frame after a hole
+    uint64_t mold_duplicates = 0; // MoldUDP64 messages already seen (i.e. on the other line)
+    uint64_t mold_missing = 0; // MoldUDP64 messages never seen, not counting the late ones
+    uint64_t mold_late = 0; // MoldUDP64 messages that came too far behind to tell if they were seen
+    uint64_t records = 0; // ITCH messages handed out
+};
+
+/***
+ * Reads the ITCH messages out of a packet capture (pcap or pcapng) of a SoupBinTCP or
+ * MoldUDP64 feed.
+ *
+ * The capture is memory mapped and walked front to back. Ethernet (with VLAN tags), Linux
+ * cooked and raw IP captures of IPv4 are understood. TCP streams are put back in order and
+ * framed as SoupBinTCP, and the payload of each sequenced data packet is handed out. A
+ * stream is framed from its SYN. If the capture started part way through, or after a hole
+ * that was never filled, bytes are dropped until a run of valid SoupBinTCP headers is found.
+ * UDP datagrams are unpacked as MoldUDP64, skipping messages already seen in the same
+ * session, so a capture of both A and B lines reads as one feed. A message lost on one line
+ * is filled in from the other whenever its copy shows up, so MoldUDP64 messages are in
+ * capture order, which is not always sequence order.
+ *
+ * Each message comes with the capture time of the packet that completed it.
+ */
+class pcap_file
+{
+    public:
+    enum class format
+    {
+        PCAP = 0,
+        PCAPNG = 1
+    };
+
+    pcap_file(const std::string& fileName);
+    pcap_file(const pcap_file&) = delete;
+    pcap_file& operator=(const pcap_file&) = delete;
+
+    format get_format() const { return fileFormat; }
+    /***
+     * Only use traffic to or from this port. If no ports are added, all TCP and UDP traffic is used.
+     */
+    void add_port(uint16_t port) { ports.push_back(port); }
+    const pcap_stats& get_stats() const { return stats; }
+
+    /***
+     * Calls func(timestamp, record, record_length) for each ITCH message in the capture. The
+     * timestamp is the capture time in nanoseconds since the epoch.
+     * @returns the number of messages
+     */
+    template<typename F>
+    uint64_t for_each(F&& func)
+    {
+        start();
+        packet pkt;
+        while(next_packet(pkt))
+        {
+            if (pkt.protocol == UDP)
+            {
+                for_each_mold(pkt, func);
+                continue;
+            }
+            tcp_stream* stream = reassemble(pkt);
+            if (stream == nullptr)
+                continue;
+            auto emit = [this, &pkt, &func](const uint8_t* frame, uint16_t frameLength) {
+                // the frame starts with the SoupBinTCP packet type
+                if (frameLength > 1 && frame[0] == 'S')
+                {
+                    stats.records++;
+                    func(pkt.timestamp, frame + 1, (uint16_t)(frameLength - 1));
+                }
+            };
+            for(const chunk& curr : chunks)
+            {
+                if (stream->synced)
+                {
+                    stream->stitcher.feed(curr.data, curr.length, emit);
+                    continue;
+                }
+                stream->unsynced.insert(stream->unsynced.end(), curr.data, curr.data + curr.length);
+                if (resync(*stream))
+                {
+                    stream->stitcher.feed(stream->unsynced.data(), stream->unsynced.size(), emit);
+                    stream->unsynced.clear();
+                }
+            }
+        }
+        finish();
+        return stats.records;
+    }
+    /***
+     * Calls func(timestamp, record, record_length) for each ITCH message the filter accepts
+     * @returns the number of messages in the capture
+     */
+    template<typename F>
+    uint64_t for_each(F&& func, MessageFilter& filter)
+    {
+        return for_each([&func, &filter](uint64_t timestamp, const uint8_t* record, uint16_t recordLength) {
+            if (filter.accept(record, recordLength))
+                func(timestamp, record, recordLength);
+        });
+    }
+
+    protected:
+    static const uint8_t TCP = 6;
+    static const uint8_t UDP = 17;
+    static const uint8_t TCP_SYN = 0x02;
+
+    /***
+     * The transport payload of a packet
+     */
+    struct packet {
+        uint64_t timestamp = 0;
+        uint8_t protocol = 0;
+        uint32_t source = 0;
+        uint32_t destination = 0;
+        uint16_t sourcePort = 0;
+        uint16_t destinationPort = 0;
+        uint32_t seq = 0; // TCP
+        uint8_t flags = 0; // TCP
+        const uint8_t* data = nullptr;
+        size_t length = 0;
+    };
+    struct chunk {
+        const uint8_t* data;
+        size_t length;
+    };
+    struct flow_key {
+        uint32_t source;
+        uint32_t destination;
+        uint16_t sourcePort;
+        uint16_t destinationPort;
+        bool operator==(const flow_key& in) const
+        {
+            return source == in.source && destination == in.destination && sourcePort == in.sourcePort
+                    && destinationPort == in.destinationPort;
+        }
+    };
+    struct flow_hash {
+        size_t operator()(const flow_key& in) const
+        {
+            uint64_t val = ((uint64_t)in.source << 32 | in.destination) * 0x9E3779B97F4A7C15ull;
+            return val ^ ((uint64_t)in.sourcePort << 16 | in.destinationPort);
+        }
+    };
+    struct tcp_stream {
+        uint32_t nextSeq = 0; // on the wire
+        uint64_t nextOffset = 0; // the same place, counted from the start of the stream
+        std::map<uint64_t, std::vector<uint8_t>> pending; // ahead of a hole, by offset
+        size_t pendingBytes = 0;
+        record_stitcher stitcher;
+        bool synced = true; // false until a frame boundary is found
+        std::vector<uint8_t> unsynced; // waiting for that
+    };
+    /***
+     * What has been handed out of a MoldUDP64 session. Like the FeedArbitrator window, each
+     * slot of the ring holds the last sequence number delivered that maps to it.
+     */
+    struct mold_session {
+        static const size_t WINDOW = 65536;
+        std::vector<uint64_t> window = std::vector<uint64_t>(WINDOW, 0);
+        uint64_t first = 0; // the lowest sequence number delivered
+        uint64_t end = 0; // one past the highest
+        uint64_t delivered = 0;
+        uint64_t late = 0;
+    };
+    /***
+     * Where a pcapng interface keeps its link type and timestamp units
+     */
+    struct interface {
+        uint16_t linkType = 0;
+        bool binary = false; // units of 2^-exponent seconds rather than 10^-exponent
+        uint8_t exponent = 6;
+    };
+
+    void start();
+    /***
+     * Step to the next TCP or UDP packet
+     * @returns false at the end of the capture
+     */
+    bool next_packet(packet& pkt);
+    bool next_pcap(packet& pkt);
+    bool next_pcapng(packet& pkt);
+    void read_interface(const uint8_t* body, size_t bodyLength);
+    uint64_t to_nanos(const interface& intf, uint64_t timestamp) const;
+    /***
+     * Peel the link, IP and transport headers off a frame
+     * @returns false if it is not a packet we want
+     */
+    bool decode(const uint8_t* frame, size_t length, uint16_t linkType, packet& pkt);
+    /***
+     * Put a TCP segment in its place in the stream. What can now be read in order is left in chunks.
+     * @returns the stream, or nullptr if there is nothing new to read
+     */
+    tcp_stream* reassemble(const packet& pkt);
+    /***
+     * Give up on the hole at the front of the stream and carry on after it
+     */
+    void skip_hole(tcp_stream& stream);
+    /***
+     * Look for a frame boundary in the bytes of a stream that lost its framing. The bytes
+     * before it are dropped.
+     * @returns true if found, and the unsynced bytes now start with it
+     */
+    bool resync(tcp_stream& stream);
+    mold_session& get_mold_session(const char* session);
+    void finish();
+
+    template<typename F>
+    void for_each_mold(const packet& pkt, F&& func)
+    {
+        moldudp64::packet_view view(pkt.data, pkt.length);
+        if (!view.valid())
+        {
+            stats.truncated++;
+            return;
+        }
+        if (view.is_end_of_session())
+            return;
+        mold_session& session = get_mold_session(view.session());
+        view.for_each_message([this, &session, &pkt, &func](uint64_t seq, const uint8_t* data, uint16_t length) {
+            uint64_t& slot = session.window[seq & (mold_session::WINDOW - 1)];
+            if (slot >= seq)
+            {
+                if (slot == seq)
+                    stats.mold_duplicates++;
+                else
+                {
+                    stats.mold_late++;
+                    session.late++;
+                }
+                return;
+            }
+            slot = seq;
+            session.delivered++;
+            if (session.first == 0 || seq < session.first)
+                session.first = seq;
+            if (seq >= session.end)
+                session.end = seq + 1;
+            stats.records++;
+            func(pkt.timestamp, data, length);
+        });
+    }
+
+    protected:
+    mapped_file file;
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    size_t pos = 0;
+    format fileFormat = format::PCAP;
+    bool swapped = false; // written on a machine of the other byte order
+    bool nanos = false; // pcap with nanosecond timestamps
+    uint16_t linkType = 0; // pcap
+    std::vector<interface> interfaces; // pcapng
+    std::vector<uint16_t> ports;
+    std::unordered_map<flow_key, tcp_stream, flow_hash> streams;
+    std::vector<chunk> chunks;
+    std::vector<std::vector<uint8_t>> released; // pending data handed out in chunks
+    std::unordered_map<std::string, mold_session> moldSessions;
+    std::string lastSession;
+    mold_session* lastMoldSession = nullptr;
+    pcap_stats stats;
+};
+
+} // end namespace itch
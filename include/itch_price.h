@@ -0,0 +1,217 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace itch
+{
+
+constexpr int64_t power_of_ten(int exponent)
+{
+    int64_t retVal = 1;
+    for(int i = 0; i < exponent; ++i)
+        retVal *= 10;
+    return retVal;
+}
+
+/***
+ * A price as an integer count of 10^-DECIMALS, the way the feed sends it.
+ *
+ * Comparison and arithmetic stay in integers. Prices of different scales can be compared
+ * directly, and converted with rescale(). to_chars formats without going through a double.
+ */
+template<int DECIMALS>
+class fixed_price
+{
+    static_assert(DECIMALS >= 0 && DECIMALS <= 18, "DECIMALS must fit in an int64_t");
+
+    public:
+    static constexpr int64_t SCALE = power_of_ten(DECIMALS);
+    static constexpr int DIGITS = DECIMALS;
+
+    constexpr fixed_price() = default;
+    constexpr explicit fixed_price(int64_t raw) : value(raw) {}
+    /***
+     * @returns the price of whole units plus a fraction given in 10^-DECIMALS
+     */
+    static constexpr fixed_price from_parts(int64_t units, int64_t fraction = 0)
+    {
+        return fixed_price(units * SCALE + (units < 0 ? -fraction : fraction));
+    }
+
+    constexpr int64_t raw() const { return value; }
+    constexpr int64_t units() const { return value / SCALE; }
+    constexpr int64_t fraction() const { return value % SCALE; }
+    /***
+     * Only for display or statistics, never for matching
+     */
+    constexpr double to_double() const { return (double)value / SCALE; }
+
+    /***
+     * @returns the price at another scale. Going to fewer decimals rounds half away from zero.
+     */
+    template<int TO>
+    constexpr fixed_price<TO> rescale() const
+    {
+        if constexpr (TO >= DECIMALS)
+            return fixed_price<TO>(value * power_of_ten(TO - DECIMALS));
+        else
+        {
+            constexpr int64_t divisor = power_of_ten(DECIMALS - TO);
+            int64_t half = value < 0 ? -divisor / 2 : divisor / 2;
+            return fixed_price<TO>((value + half) / divisor);
+        }
+    }
+
+    constexpr fixed_price operator+(fixed_price in) const { return fixed_price(value + in.value); }
+    constexpr fixed_price operator-(fixed_price in) const { return fixed_price(value - in.value); }
+    constexpr fixed_price operator-() const { return fixed_price(-value); }
+    constexpr fixed_price& operator+=(fixed_price in) { value += in.value; return *this; }
+    constexpr fixed_price& operator-=(fixed_price in) { value -= in.value; return *this; }
+    /***
+     * i.e. price times shares. Keeps the scale.
+     */
+    constexpr fixed_price operator*(int64_t in) const { return fixed_price(value * in); }
+    /***
+     * i.e. notional over shares. Rounds half away from zero.
+     */
+    constexpr fixed_price operator/(int64_t in) const
+    {
+        int64_t magnitude = in < 0 ? -in : in;
+        int64_t half = value < 0 ? -(magnitude / 2) : magnitude / 2;
+        return fixed_price((value + half) / in);
+    }
+
+    /***
+     * Write the price with all DECIMALS places, i.e. "12.3400" for a price4
+     * @param first where to start
+     * @param last one past the end of the buffer
+     * @returns one past the last character written, or nullptr if it did not fit
+     */
+    char* to_chars(char* first, char* last) const
+    {
+        // 19 digits, a sign and a point
+        char buf[24];
+        char* end = buf + sizeof(buf);
+        char* pos = end;
+        uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+        uint64_t whole = magnitude / SCALE;
+        uint64_t frac = magnitude % SCALE;
+        for(int i = 0; i < DECIMALS; ++i)
+        {
+            *--pos = '0' + frac % 10;
+            frac /= 10;
+        }
+        if (DECIMALS > 0)
+            *--pos = '.';
+        do
+        {
+            *--pos = '0' + whole % 10;
+            whole /= 10;
+        } while(whole > 0);
+        if (value < 0)
+            *--pos = '-';
+        size_t length = end - pos;
+        if ((size_t)(last - first) < length)
+            return nullptr;
+        memcpy(first, pos, length);
+        return first + length;
+    }
+    std::string to_string() const
+    {
+        char buf[24];
+        return std::string(buf, to_chars(buf, buf + sizeof(buf)));
+    }
+    /***
+     * Parse "12.34", "-0.5" or "7". More than DECIMALS places, no digits at all, or a value
+     * that does not fit is an error.
+     * @returns false if the text is not a price
+     */
+    static bool from_chars(const char* first, const char* last, fixed_price& out)
+    {
+        bool negative = first != last && *first == '-';
+        if (negative)
+            first++;
+        // the magnitude can be one more when negative
+        const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+        uint64_t whole = 0;
+        uint64_t frac = 0;
+        int places = -1; // -1 until the point
+        bool digits = false;
+        for(; first != last; ++first)
+        {
+            if (*first == '.' && places < 0)
+            {
+                places = 0;
+                continue;
+            }
+            if (*first < '0' || *first > '9')
+                return false;
+            uint64_t digit = *first - '0';
+            digits = true;
+            if (places < 0)
+            {
+                // checked before it is multiplied, so it cannot wrap
+                if (whole > (limit / SCALE - digit) / 10)
+                    return false;
+                whole = whole * 10 + digit;
+            }
+            else if (++places <= DECIMALS)
+                frac = frac * 10 + digit;
+            else
+                return false;
+        }
+        if (!digits)
+            return false;
+        for(int i = places < 0 ? 0 : places; i < DECIMALS; ++i)
+            frac *= 10;
+        if (frac > limit - whole * SCALE)
+            return false;
+        uint64_t magnitude = whole * SCALE + frac;
+        out = fixed_price(negative && magnitude > 0 ? -(int64_t)(magnitude - 1) - 1 : (int64_t)magnitude);
+        return true;
+    }
+
+    protected:
+    int64_t value = 0;
+};
+
+/***
+ * Prices of different scales compare by value
+ */
+template<int A, int B>
+constexpr int compare(fixed_price<A> lhs, fixed_price<B> rhs)
+{
+    // widen to the larger scale, in 128 bits so that nothing overflows
+    __int128 left = lhs.raw();
+    __int128 right = rhs.raw();
+    if constexpr (A < B)
+        left *= power_of_ten(B - A);
+    else if constexpr (B < A)
+        right *= power_of_ten(A - B);
+    return left < right ? -1 : left > right ? 1 : 0;
+}
+
+template<int A, int B>
+constexpr bool operator==(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) == 0; }
+template<int A, int B>
+constexpr bool operator!=(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) != 0; }
+template<int A, int B>
+constexpr bool operator<(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) < 0; }
+template<int A, int B>
+constexpr bool operator<=(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) <= 0; }
+template<int A, int B>
+constexpr bool operator>(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) > 0; }
+template<int A, int B>
+constexpr bool operator>=(fixed_price<A> lhs, fixed_price<B> rhs) { return compare(lhs, rhs) >= 0; }
+
+/***
+ * Price(4), i.e. most ITCH prices
+ */
+using price4 = fixed_price<4>;
+/***
+ * Price(8), i.e. the MWCB levels
+ */
+using price8 = fixed_price<8>;
+
+} // end namespace itch
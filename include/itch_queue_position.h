@@ -0,0 +1,255 @@
+#pragma once
+#include "itch_order_book.h"
+#include "ouch.h"
+#include <unordered_map>
+#include <vector>
+
+namespace itch
+{
+
+/***
+ * Where one of our orders stands in the queue at its price
+ */
+struct queue_position {
+    uint64_t reference = 0; // ORDER_REFERENCE_NUMBER, the same in OUCH and ITCH
+    uint64_t priority = 0; // from the order book
+    uint32_t price = 0; // 4 decimal places
+    uint32_t shares = 0; // ours, still resting
+    uint16_t locate = 0;
+    char side = ' ';
+    bool on_book = false; // false until the ITCH add_order is seen
+    uint64_t shares_ahead = 0; // displayed shares at our price that were there first
+    uint32_t orders_ahead = 0;
+};
+
+/***
+ * Joins our accepted OUCH orders with the ITCH book and keeps an estimate of our place in the
+ * queue at each of our prices.
+ *
+ * OUCH order_accepted gives the ORDER_REFERENCE_NUMBER that ITCH uses for a displayed order.
+ * When the ITCH add_order for it arrives, everything already resting at that price is ahead
+ * of us. After that, each execute, cancel, delete or replace of an order that is ahead of one of
+ * ours comes off its shares_ahead. That is a lookup of the order in the book and of our orders at
+ * its price, so each ITCH message costs the same no matter how deep the book is.
+ *
+ * Hidden and reserve size is not in ITCH, so this is an estimate: the real queue can be longer.
+ */
+class queue_position_tracker
+{
+    public:
+    queue_position_tracker(size_t initialCapacity = 1 << 20) : book(initialCapacity), ownPerLocate(order_book::MAX_LOCATES) {}
+    virtual ~queue_position_tracker() {}
+
+    /***
+     * Start tracking one of our orders, i.e. on OUCH order_accepted. If the ITCH add_order has
+     * already arrived, the orders ahead are counted from the book (slower, but rare).
+     */
+    void add_own(uint64_t reference)
+    {
+        if (own.count(reference) > 0)
+            return;
+        queue_position& pos = own[reference];
+        pos.reference = reference;
+        const order* curr = book.find(reference);
+        if (curr == nullptr)
+            return;
+        place(pos, *curr);
+        book.for_each_order([&pos](const order& other) {
+            if (other.locate == pos.locate && other.side == pos.side && other.price == pos.price
+                    && other.priority < pos.priority)
+            {
+                pos.shares_ahead += other.shares;
+                pos.orders_ahead++;
+            }
+        });
+        on_position(pos);
+    }
+    void add_own(const ouch::order_accepted& in) { add_own(in.get_int(ouch::order_accepted::ORDER_REFERENCE_NUMBER)); }
+    /***
+     * Stop tracking an order, i.e. one that was never displayed
+     */
+    void remove_own(uint64_t reference)
+    {
+        auto itr = own.find(reference);
+        if (itr == own.end())
+            return;
+        if (itr->second.on_book)
+            unplace(itr->second);
+        own.erase(itr);
+    }
+
+    /****
+     * @brief update the book and our positions from a raw ITCH record
+     * @param record the record, starting with the message type
+     * @return true if the record changed the book
+     */
+    bool apply(const uint8_t* record)
+    {
+        switch(record[0])
+        {
+            case('A'):
+            case('F'):
+            {
+                if (!book.apply(record))
+                    return false;
+                uint64_t reference = get_int(record, add_order::ORDER_REFERENCE_NUMBER);
+                auto itr = own.empty() ? own.end() : own.find(reference);
+                if (itr != own.end())
+                    arrived(itr->second);
+                return true;
+            }
+            case('E'):
+                taken(get_int(record, order_executed::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_executed::EXECUTED_SHARES));
+                break;
+            case('C'):
+                taken(get_int(record, order_executed_with_price::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_executed_with_price::EXECUTED_SHARES));
+                break;
+            case('X'):
+                taken(get_int(record, order_cancel::ORDER_REFERENCE_NUMBER),
+                        get_int(record, order_cancel::CANCELLED_SHARES));
+                break;
+            case('D'):
+                taken(get_int(record, order_delete::ORDER_REFERENCE_NUMBER), UINT32_MAX);
+                break;
+            case('U'):
+            {
+                uint64_t original = get_int(record, order_replace::ORIGINAL_ORDER_REFERENCE_NUMBER);
+                bool ours = !own.empty() && own.count(original) > 0;
+                taken(original, UINT32_MAX);
+                if (!ours)
+                    break;
+                // ours, so it starts again at the back under the new reference
+                uint64_t reference = get_int(record, order_replace::NEW_ORDER_REFERENCE_NUMBER);
+                bool retVal = book.apply(record);
+                queue_position& pos = own[reference];
+                pos.reference = reference;
+                if (retVal)
+                    arrived(pos);
+                return retVal;
+            }
+            default:
+                break;
+        }
+        return book.apply(record);
+    }
+    template<unsigned int SIZE>
+    bool apply(const message<SIZE>& msg) { return apply(msg.get_record()); }
+
+    /***
+     * @returns our order, or nullptr if it is not being tracked
+     */
+    const queue_position* get_position(uint64_t reference) const
+    {
+        auto itr = own.find(reference);
+        return itr == own.end() ? nullptr : &itr->second;
+    }
+    size_t get_own_count() const { return own.size(); }
+    const order_book& get_book() const { return book; }
+
+    protected:
+    /***
+     * Our place changed, or we are on the book for the first time
+     */
+    virtual void on_position(const queue_position& pos) {}
+    /***
+     * Our order is off the book: filled, cancelled or replaced
+     */
+    virtual void on_own_done(const queue_position& pos) {}
+
+    protected:
+    static uint64_t level_key(uint16_t locate, char side, uint32_t price)
+    {
+        return ((uint64_t)locate << 33) | ((uint64_t)(side == 'S') << 32) | price;
+    }
+    /***
+     * Our order is on the book, behind everything already at its price
+     */
+    void arrived(queue_position& pos)
+    {
+        const order* curr = book.find(pos.reference);
+        if (curr == nullptr)
+            return;
+        place(pos, *curr);
+        price_level level = book.get_level(pos.locate, pos.side, pos.price);
+        pos.shares_ahead = level.shares - pos.shares;
+        pos.orders_ahead = level.orders - 1;
+        on_position(pos);
+    }
+    void place(queue_position& pos, const order& curr)
+    {
+        pos.priority = curr.priority;
+        pos.price = curr.price;
+        pos.shares = curr.shares;
+        pos.locate = curr.locate;
+        pos.side = curr.side;
+        pos.on_book = true;
+        pos.shares_ahead = 0;
+        pos.orders_ahead = 0;
+        ownLevels[level_key(pos.locate, pos.side, pos.price)].push_back(pos.reference);
+        ownPerLocate[pos.locate]++;
+    }
+    void unplace(const queue_position& pos)
+    {
+        auto itr = ownLevels.find(level_key(pos.locate, pos.side, pos.price));
+        if (itr != ownLevels.end())
+        {
+            std::vector<uint64_t>& refs = itr->second;
+            refs.erase(std::remove(refs.begin(), refs.end(), pos.reference), refs.end());
+            if (refs.empty())
+                ownLevels.erase(itr);
+        }
+        ownPerLocate[pos.locate]--;
+    }
+    /***
+     * Shares came off an order: executed, cancelled, or all of them deleted
+     */
+    void taken(uint64_t reference, uint32_t shares)
+    {
+        const order* curr = book.find(reference);
+        // most messages are for instruments where we have nothing resting
+        if (curr == nullptr || ownPerLocate[curr->locate] == 0)
+            return;
+        uint32_t removed = shares < curr->shares ? shares : curr->shares;
+        bool gone = removed == curr->shares;
+        // everything of ours behind it moves up, even if it was one of ours
+        auto levelItr = ownLevels.find(level_key(curr->locate, curr->side, curr->price));
+        if (levelItr != ownLevels.end())
+        {
+            for(uint64_t ref : levelItr->second)
+            {
+                queue_position& pos = own[ref];
+                if (pos.priority <= curr->priority)
+                    continue;
+                pos.shares_ahead -= removed;
+                if (gone)
+                    pos.orders_ahead--;
+                on_position(pos);
+            }
+        }
+        auto ownItr = own.find(reference);
+        if (ownItr == own.end())
+            return;
+        queue_position& pos = ownItr->second;
+        pos.shares -= removed;
+        if (!gone)
+        {
+            on_position(pos);
+            return;
+        }
+        unplace(pos);
+        pos.on_book = false;
+        queue_position done = pos;
+        own.erase(ownItr);
+        on_own_done(done);
+    }
+
+    protected:
+    order_book book;
+    std::unordered_map<uint64_t, queue_position> own; // by reference
+    std::unordered_map<uint64_t, std::vector<uint64_t>> ownLevels; // references on the book, by level_key
+    std::vector<uint32_t> ownPerLocate;
+};
+
+} // end namespace itch
@@ -0,0 +1,165 @@
+#pragma once
+#include "itch_file.h"
+#include "message_filter.h"
+#include <vector>
+#include <string>
+
+namespace itch
+{
+
+/***
+ * Reads an ITCH file with io_uring, keeping several large reads in flight while the records
+ * in the buffers that have already arrived are handled.
+ *
+ * The file is opened with O_DIRECT so that it does not go through (and push everything else
+ * out of) the page cache. Buffers are aligned to suit. If the filesystem does not support
+ * O_DIRECT, the file is opened normally. If io_uring is not available (old kernel, or blocked
+ * by seccomp), the same buffers are filled with pread one at a time.
+ */
+class uring_file
+{
+    public:
+    static const size_t ALIGNMENT = 4096;
+
+    /***
+     * @param fileName the file
+     * @param bufferSize the size of each read (rounded up to a multiple of 4096)
+     * @param queueDepth how many reads to keep in flight
+     * @param direct false to go through the page cache
+     */
+    uring_file(const std::string& fileName, size_t bufferSize = 1024 * 1024, size_t queueDepth = 8,
+            bool direct = true);
+    ~uring_file();
+    uring_file(const uring_file&) = delete;
+    uring_file& operator=(const uring_file&) = delete;
+
+    uint64_t size() const { return fileSize; }
+    bool is_direct() const { return direct; }
+    /***
+     * @returns false if reads fell back to pread
+     */
+    bool is_async() const { return ringFd >= 0; }
+
+    /***
+     * Calls func(record, record_length) for each record in the file
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func)
+    {
+        start();
+        size_t consumed = 0;
+        record_stitcher stitcher;
+        size_t length = 0;
+        try
+        {
+            for(const uint8_t* data = next(length); data != nullptr; data = next(length))
+            {
+                consumed += stitcher.feed(data, length, func);
+                release();
+            }
+        }
+        catch(...)
+        {
+            drain();
+            throw;
+        }
+        return consumed;
+    }
+    /***
+     * Calls func(record, record_length) for each record the filter accepts
+     * @returns the number of bytes consumed
+     */
+    template<typename F>
+    size_t for_each(F&& func, MessageFilter& filter)
+    {
+        return for_each([&func, &filter](const uint8_t* record, uint16_t recordLength) {
+            if (filter.accept(record, recordLength))
+                func(record, recordLength);
+        });
+    }
+
+    protected:
+    struct buffer {
+        uint8_t* data = nullptr;
+        uint64_t offset = 0; // in the file
+        size_t expected = 0; // bytes wanted from the file
+        size_t filled = 0;
+        bool pending = false; // a read is in flight
+    };
+
+    void setup_ring(size_t queueDepth);
+    void start();
+    /***
+     * @returns the next buffer in file order once it is filled, or nullptr at the end
+     */
+    const uint8_t* next(size_t& length);
+    void release();
+    /***
+     * Start reading block number idx of the file
+     */
+    void issue(uint64_t idx);
+    void submit(buffer& buf, size_t bufIdx);
+    void read_sync(buffer& buf);
+    /***
+     * Where to pick up after a short read that started at before
+     * @returns false if a direct read did not get a whole block further
+     */
+    bool resume_short_read(buffer& buf, size_t before);
+    void reap(bool wait);
+    /***
+     * Wait for every read in flight, so the buffers can be let go
+     */
+    void drain();
+
+    protected:
+    int fd = -1;
+    bool direct = false;
+    uint64_t fileSize = 0;
+    size_t bufferSize = 0;
+    std::vector<buffer> buffers;
+    uint64_t nextIdx = 0; // the next block to hand out
+    size_t inFlight = 0;
+    // the ring
+    int ringFd = -1;
+    void* sqPtr = nullptr;
+    size_t sqSize = 0;
+    void* cqPtr = nullptr;
+    size_t cqSize = 0;
+    void* sqesPtr = nullptr;
+    size_t sqesSize = 0;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    void* cqes = nullptr;
+};
+
+enum class read_backend
+{
+    MMAP = 0,
+    IO_URING = 1
+};
+
+/****
+ * @brief read every record of a file with the chosen backend
+ * @param fileName the file
+ * @param backend mmap (best when the file is in, or fits in, the page cache) or io_uring
+ * @param func called as func(record, record_length)
+ * @return the number of bytes consumed
+ */
+template<typename F>
+size_t for_each_in_file(const std::string& fileName, read_backend backend, F&& func)
+{
+    if (backend == read_backend::IO_URING)
+    {
+        uring_file file(fileName);
+        return file.for_each(func);
+    }
+    mapped_file file(fileName);
+    return file.for_each(func);
+}
+
+} // end namespace itch
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/***
+ * Decides whether a message is worth handing on. Runs on the raw bytes, right after framing and
+ * before any message object is built.
+ */
+class MessageFilter
+{
+    public:
+    /****
+     * @param data the message (for ITCH, starting with the message type)
+     * @param length the length of the message
+     * @return true if the message should be passed on
+     */
+    virtual bool accept(const uint8_t* data, size_t length) = 0;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include "moldudp64.h"
+#include <vector>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <sys/socket.h>
+#include <boost/asio.hpp>
+
+/***
+ * Messages indexed by sequence number (starting at 1). The messages are not copied, the store
+ * points into a buffer of length-prefixed records (i.e. a memory mapped ITCH file), which are
+ * already in MoldUDP64 message block format.
+ */
+class MoldUDP64MessageStore
+{
+    public:
+    MoldUDP64MessageStore(const uint8_t* data, size_t length);
+
+    uint64_t size() const { return offsets.size() - 1; }
+    /***
+     * @returns the length-prefixed block for the sequence number
+     */
+    const uint8_t* block(uint64_t seqNo) const { return data + offsets[seqNo - 1]; }
+    /***
+     * @returns the number of bytes taken by the blocks from seqNo up to (but not including) endSeqNo
+     */
+    size_t span(uint64_t seqNo, uint64_t endSeqNo) const { return offsets[endSeqNo - 1] - offsets[seqNo - 1]; }
+
+    private:
+    const uint8_t* data;
+    std::vector<uint64_t> offsets; // one per message, plus one for the end
+};
+
+/***
+ * Publishes a MoldUDP64 feed from a message store, and answers retransmission requests.
+ *
+ * Packets are sent in batches with sendmmsg. For testing feed handlers, packets can be
+ * paced, and loss and reordering can be injected.
+ */
+class MoldUDP64Publisher
+{
+    public:
+    struct Options
+    {
+        size_t maxPacketLength = 1472; // fits in a 1500 byte MTU after IP and UDP headers
+        uint16_t maxMessagesPerPacket = 0xFFFE;
+        size_t batchSize = 32; // packets per sendmmsg call
+        uint64_t packetsPerSecond = 0; // 0 sends as fast as possible
+        double dropRate = 0.0; // chance a packet is never sent
+        double reorderRate = 0.0; // chance a packet is swapped with the one after it
+        uint32_t seed = 1;
+    };
+    struct Stats
+    {
+        uint64_t batches = 0;
+        uint64_t packets_sent = 0;
+        uint64_t messages_sent = 0;
+        uint64_t packets_dropped = 0; // by the injected loss, or because sendmmsg failed
+        uint64_t packets_reordered = 0;
+        // updated by the rewind thread
+        uint64_t requests = 0;
+        uint64_t retransmitted_packets = 0;
+    };
+
+    /***
+     * @param store where the messages come from
+     * @param session the session name (up to 10 characters)
+     * @param group the multicast group to publish to
+     * @param port the port to publish to
+     * @param interfaceAddress the local interface to publish on ("127.0.0.1" for loopback)
+     * @param rewindPort the port to listen on for retransmission requests, 0 for any
+     */
+    MoldUDP64Publisher(const MoldUDP64MessageStore& store, const std::string& session, const std::string& group,
+            uint16_t port, const std::string& interfaceAddress, uint16_t rewindPort, const Options& options);
+    MoldUDP64Publisher(const MoldUDP64MessageStore& store, const std::string& session, const std::string& group,
+            uint16_t port, const std::string& interfaceAddress = "0.0.0.0", uint16_t rewindPort = 0);
+    ~MoldUDP64Publisher();
+
+    /****
+     * @brief publish the next messages in the store (blocks until sent)
+     * @param count the max number of messages to publish
+     * @return the number of messages published
+     */
+    uint64_t publish(uint64_t count = UINT64_MAX);
+    void send_heartbeat();
+    void send_end_of_session();
+
+    uint64_t get_next_seq() const { return nextSeq; }
+    uint16_t get_rewind_port() const { return rewindSkt.local_endpoint().port(); }
+    /***
+     * @returns a copy of the counters, safe to call from any thread
+     */
+    Stats get_stats() const;
+
+    private:
+    size_t build_packet(uint8_t* buffer, uint64_t seqNo, uint64_t maxMessages, uint16_t& numMessages);
+    void send_batch(size_t numPackets);
+    void pace(uint64_t packetsSoFar);
+    void serve_retransmissions();
+
+    private:
+    // the same counters as Stats, kept with relaxed atomics as the rewind thread updates some
+    struct Counters
+    {
+        std::atomic<uint64_t> batches = 0;
+        std::atomic<uint64_t> packets_sent = 0;
+        std::atomic<uint64_t> messages_sent = 0;
+        std::atomic<uint64_t> packets_dropped = 0;
+        std::atomic<uint64_t> packets_reordered = 0;
+        std::atomic<uint64_t> requests = 0;
+        std::atomic<uint64_t> retransmitted_packets = 0;
+    };
+
+    private:
+    const MoldUDP64MessageStore& store;
+    Options options;
+    char session[moldudp64::SESSION_LEN];
+    boost::asio::io_context io_context;
+    boost::asio::ip::udp::socket skt;
+    boost::asio::ip::udp::socket rewindSkt;
+    std::atomic<uint64_t> nextSeq = 1;
+    Counters counters;
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> chance{0.0, 1.0};
+    std::chrono::steady_clock::time_point pacingStart;
+    uint64_t pacedPackets = 0;
+    // preallocated send buffers
+    std::vector<uint8_t> buffers;
+    std::vector<struct iovec> iovecs;
+    std::vector<struct mmsghdr> msgs;
+    std::vector<uint8_t> rewindBuffer;
+    std::thread rewindThread;
+    std::atomic<bool> shuttingDown = false;
+};
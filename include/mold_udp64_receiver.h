@@ -0,0 +1,133 @@
+#pragma once
+#include "moldudp64.h"
+#include "message_filter.h"
+#include <vector>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <boost/asio.hpp>
+
+/***
+ * Receives a MoldUDP64 multicast feed.
+ *
+ * Datagrams are pulled in batches with recvmmsg into buffers that are allocated once, up front.
+ * Messages are handed to on_message as pointers into those buffers (no copies), and are only
+ * valid for the duration of the call.
+ *
+ * The next expected sequence number is tracked. If a gap is detected and a rewind server was
+ * given, a retransmission request is sent and messages past the gap are held back (dropped and
+ * re-requested) so that on_message always sees sequence numbers in order. Only one request is
+ * out at a time: it is sent again if the answer does not come within the retransmit timeout,
+ * and the rest is asked for once everything requested has arrived. Without a rewind server,
+ * on_gap is called and the receiver jumps ahead.
+ */
+class MoldUDP64Receiver
+{
+    public:
+    struct Stats
+    {
+        uint64_t batches = 0; // recvmmsg calls that returned data
+        uint64_t packets = 0;
+        uint64_t messages = 0;
+        uint64_t heartbeats = 0;
+        uint64_t duplicates = 0; // packets that had nothing new
+        uint64_t gaps = 0; // number of times a gap was detected
+        uint64_t missing_messages = 0; // number of messages missing when gaps were detected
+        uint64_t requests_sent = 0;
+        uint64_t truncated = 0; // datagrams bigger than the receive buffer, or with bad block lengths
+        uint64_t malformed = 0; // too short to hold a header
+        uint64_t other_session = 0; // packets for a session other than the one we are following
+    };
+
+    /***
+     * @param group the multicast group to join (i.e. "239.1.1.1")
+     * @param port the port the feed is published on
+     * @param interfaceAddress the address of the local interface to join on ("127.0.0.1" for loopback)
+     * @param rewindServer "host:port" of the retransmission server, empty for none
+     * @param nextSequenceNo the first sequence number wanted, 0 to start wherever the feed is
+     * @param batchSize the max number of datagrams read per syscall
+     * @param bufferSize the max size of a datagram
+     */
+    MoldUDP64Receiver(const std::string& group, uint16_t port, const std::string& interfaceAddress = "0.0.0.0",
+            const std::string& rewindServer = "", uint64_t nextSequenceNo = 0,
+            size_t batchSize = 64, size_t bufferSize = 2048);
+    virtual ~MoldUDP64Receiver();
+
+    /***
+     * Read on a background thread until stop() is called
+     */
+    void start();
+    void stop();
+    /****
+     * @brief wait for datagrams and process one batch of them
+     * @param timeoutMs how long to wait for something to arrive
+     * @return the number of datagrams processed
+     */
+    size_t poll(int timeoutMs);
+
+    uint64_t get_next_seq() const { return nextSeq; }
+    std::string get_session_id() const { return std::string(session, moldudp64::SESSION_LEN); }
+    /***
+     * @returns a copy of the counters, safe to call while the reading thread runs
+     */
+    Stats get_stats() const;
+    /***
+     * How long to wait for a retransmission before asking again
+     */
+    void set_retransmit_timeout(uint64_t ms) { retransmitTimeoutMs = ms; }
+    /***
+     * Messages the filter turns away are not passed to on_message (they are still sequenced)
+     */
+    void set_filter(MessageFilter* in) { filter = in; }
+
+    protected:
+    // these are called from the reading thread
+    virtual void on_message(uint64_t seqNo, const uint8_t* data, uint16_t length) {}
+    virtual void on_gap(uint64_t firstMissing, uint64_t lastMissing) {}
+    virtual void on_end_of_session() {}
+
+    void process_packet(const uint8_t* data, size_t length);
+    void request_retransmission(uint64_t seqNo, uint64_t count);
+
+    protected:
+    // the same counters as Stats, kept with relaxed atomics so get_stats() can read them
+    struct Counters
+    {
+        std::atomic<uint64_t> batches = 0;
+        std::atomic<uint64_t> packets = 0;
+        std::atomic<uint64_t> messages = 0;
+        std::atomic<uint64_t> heartbeats = 0;
+        std::atomic<uint64_t> duplicates = 0;
+        std::atomic<uint64_t> gaps = 0;
+        std::atomic<uint64_t> missing_messages = 0;
+        std::atomic<uint64_t> requests_sent = 0;
+        std::atomic<uint64_t> truncated = 0;
+        std::atomic<uint64_t> malformed = 0;
+        std::atomic<uint64_t> other_session = 0;
+    };
+
+    protected:
+    boost::asio::io_context io_context;
+    boost::asio::ip::udp::socket skt;
+    boost::asio::ip::udp::endpoint rewindEndpoint;
+    bool hasRewindServer = false;
+    std::atomic<uint64_t> nextSeq = 0;
+    uint64_t highestSeen = 0; // one past the highest sequence number seen while recovering
+    bool recovering = false;
+    uint64_t requestedEnd = 0; // one past the last sequence number of the request that is out
+    uint64_t lastRequestMs = 0;
+    uint64_t retransmitTimeoutMs = 250;
+    char session[moldudp64::SESSION_LEN] = {0};
+    bool haveSession = false;
+    Counters counters;
+    // preallocated receive buffers
+    size_t batchSize;
+    size_t bufferSize;
+    std::vector<uint8_t> buffers;
+    std::vector<struct iovec> iovecs;
+    std::vector<struct mmsghdr> msgs;
+    std::thread readerThread;
+    std::atomic<bool> shuttingDown = false;
+    MessageFilter* filter = nullptr;
+};
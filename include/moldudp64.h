@@ -0,0 +1,190 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <string>
+
+namespace moldudp64 {
+
+template <typename T>
+T swap_endian_bytes(T in)
+{
+    static_assert(CHAR_BIT == 8, "CHAR_BIT != 8");
+    union
+    {
+        T u;
+        unsigned char u8[sizeof(T)];
+    } source, dest;
+    source.u = in;
+
+    for(size_t k = 0; k < sizeof(T); k++)
+        dest.u8[k] = source.u8[sizeof(T) - k - 1];
+    return dest.u;
+}
+
+template <typename T>
+T read_big_endian(const uint8_t* in)
+{
+    T val;
+    memcpy(&val, in, sizeof(T));
+    return swap_endian_bytes<T>(val);
+}
+
+template <typename T>
+void write_big_endian(uint8_t* out, T in)
+{
+    T val = swap_endian_bytes<T>(in);
+    memcpy(out, &val, sizeof(T));
+}
+
+struct message_record {
+    uint8_t offset = 0;
+    uint8_t length = 0;
+};
+
+const static uint8_t SESSION_LEN = 10;
+const static uint8_t HEADER_LEN = 20;
+const static uint8_t MESSAGE_LENGTH_LEN = 2;
+const static uint8_t REQUEST_LEN = 20;
+/***
+ * A message count of 0 is a heartbeat, 0xFFFF is the end of the session
+ */
+const static uint16_t HEARTBEAT_COUNT = 0;
+const static uint16_t END_OF_SESSION_COUNT = 0xFFFF;
+
+/***
+ * The header that starts every downstream packet
+ */
+struct header {
+    static constexpr message_record SESSION{0, 10};
+    static constexpr message_record SEQUENCE_NUMBER{10, 8};
+    static constexpr message_record MESSAGE_COUNT{18, 2};
+};
+
+/***
+ * A retransmission request sent to the rewind server. Same layout as the header, where the
+ * count is the number of messages requested.
+ */
+struct request_packet {
+    static constexpr message_record SESSION{0, 10};
+    static constexpr message_record SEQUENCE_NUMBER{10, 8};
+    static constexpr message_record REQUESTED_MESSAGE_COUNT{18, 2};
+
+    uint8_t record[REQUEST_LEN];
+
+    request_packet(const char* session, uint64_t seqNo, uint16_t count)
+    {
+        memset(record, ' ', SESSION_LEN);
+        memcpy(record, session, strnlen(session, SESSION_LEN));
+        write_big_endian<uint64_t>(&record[SEQUENCE_NUMBER.offset], seqNo);
+        write_big_endian<uint16_t>(&record[REQUESTED_MESSAGE_COUNT.offset], count);
+    }
+    request_packet(const uint8_t* in) { memcpy(record, in, REQUEST_LEN); }
+    std::string session() const { return std::string((const char*)&record[SESSION.offset], SESSION_LEN); }
+    uint64_t sequence_number() const { return read_big_endian<uint64_t>(&record[SEQUENCE_NUMBER.offset]); }
+    uint16_t requested_message_count() const
+    {
+        return read_big_endian<uint16_t>(&record[REQUESTED_MESSAGE_COUNT.offset]);
+    }
+};
+
+/***
+ * A read-only view over a downstream packet. Nothing is copied, so the view (and the
+ * message pointers it hands out) are only good as long as the underlying buffer is.
+ */
+struct packet_view {
+    packet_view(const uint8_t* data, size_t length) : data(data), length(length) {}
+
+    bool valid() const { return length >= HEADER_LEN; }
+    const char* session() const { return (const char*)&data[header::SESSION.offset]; }
+    uint64_t sequence_number() const { return read_big_endian<uint64_t>(&data[header::SEQUENCE_NUMBER.offset]); }
+    uint16_t message_count() const { return read_big_endian<uint16_t>(&data[header::MESSAGE_COUNT.offset]); }
+    bool is_heartbeat() const { return message_count() == HEARTBEAT_COUNT; }
+    bool is_end_of_session() const { return message_count() == END_OF_SESSION_COUNT; }
+
+    /****
+     * @brief walk the message blocks of the packet
+     * @param func called as func(sequence_number, data, length) for each message
+     * @param skip the number of messages at the front of the packet to pass over
+     * @return the number of messages walked (including skipped ones). Less than
+     *    message_count() if the packet is truncated.
+     */
+    template<typename F>
+    uint16_t for_each_message(F&& func, uint16_t skip = 0) const
+    {
+        if (!valid() || is_end_of_session())
+            return 0;
+        uint16_t count = message_count();
+        uint64_t seqNo = sequence_number();
+        size_t pos = HEADER_LEN;
+        uint16_t i = 0;
+        for(; i < count; ++i)
+        {
+            if (pos + MESSAGE_LENGTH_LEN > length)
+                break;
+            uint16_t msgLen = read_big_endian<uint16_t>(&data[pos]);
+            pos += MESSAGE_LENGTH_LEN;
+            if (pos + msgLen > length)
+                break;
+            if (i >= skip)
+                func(seqNo + i, &data[pos], msgLen);
+            pos += msgLen;
+        }
+        return i;
+    }
+
+    const uint8_t* data;
+    size_t length;
+};
+
+/***
+ * Packs message blocks into a downstream packet inside a caller-supplied buffer
+ */
+struct packet_builder {
+    packet_builder(uint8_t* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+    void reset(const char* session, uint64_t seqNo)
+    {
+        memset(buffer, ' ', SESSION_LEN);
+        memcpy(buffer, session, strnlen(session, SESSION_LEN));
+        write_big_endian<uint64_t>(&buffer[header::SEQUENCE_NUMBER.offset], seqNo);
+        set_message_count(0);
+        length = HEADER_LEN;
+        count = 0;
+    }
+    /***
+     * @returns false if the message does not fit
+     */
+    bool add(const uint8_t* msg, uint16_t msgLength)
+    {
+        if (length + MESSAGE_LENGTH_LEN + msgLength > capacity)
+            return false;
+        write_big_endian<uint16_t>(&buffer[length], msgLength);
+        memcpy(&buffer[length + MESSAGE_LENGTH_LEN], msg, msgLength);
+        length += MESSAGE_LENGTH_LEN + msgLength;
+        set_message_count(++count);
+        return true;
+    }
+    /***
+     * Add message blocks that are already length-prefixed (i.e. straight from an ITCH file)
+     * @returns false if they do not fit
+     */
+    bool add_blocks(const uint8_t* blocks, size_t blocksLength, uint16_t numMessages)
+    {
+        if (length + blocksLength > capacity)
+            return false;
+        memcpy(&buffer[length], blocks, blocksLength);
+        length += blocksLength;
+        count += numMessages;
+        set_message_count(count);
+        return true;
+    }
+    void set_message_count(uint16_t in) { write_big_endian<uint16_t>(&buffer[header::MESSAGE_COUNT.offset], in); }
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length = 0;
+    uint16_t count = 0;
+};
+
+} // end namespace moldudp64
@@ -5,10 +5,16 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include "itch_price.h"
 
 namespace ouch
 {
 
+/***
+ * OUCH prices are 8 bytes (PRICE8 is the width) with 4 implied decimals
+ */
+using price4 = itch::price4;
+
 template <typename T>
 T swap_endian_bytes(T in)
 {
@@ -131,7 +137,7 @@ struct message {
     }
     const uint8_t get_raw_byte(uint8_t pos) const { return record[pos]; }
     void set_raw_byte(uint8_t pos, uint8_t in) { record[pos] = in; }
-    int64_t get_int(const message_record& mr) {
+    int64_t get_int(const message_record& mr) const {
         // how many bytes to grab
         switch(mr.length)
         {
@@ -169,17 +175,16 @@ struct message {
         }
         memcpy(&record[mr.offset], &tmp, mr.length);
     }
+    price4 get_price4(const message_record& mr) const { return price4(get_int(mr)); }
+    void set_price(const message_record& mr, price4 in) { set_int(mr, in.raw()); }
     void set_string(const message_record& mr, const std::string& in)
     {
         strncpy(&record[mr.offset], in.c_str(), mr.length);
     }
     const std::string get_string(const message_record& mr)
     {
-        // get the section of the record we want
-        char buf[mr.length+1];
-        memset(buf, 0, mr.length+1);
-        strncpy(buf, &record[mr.offset], mr.length);
-        return buf;
+        const char* start = &record[mr.offset];
+        return std::string(start, strnlen(start, mr.length));
     }
     const char* get_record() const { return record; }
     const char* get_tag_values() const { return tag_values; }
@@ -0,0 +1,143 @@
+#pragma once
+#include "itch_file.h"
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+/***
+ * Records SoupBin frames to a file for audit and replay.
+ *
+ * The network thread copies each frame, with its receive time, into a lock-free ring and
+ * moves on. It never touches the disk, and if the ring is full the frame is counted as
+ * dropped rather than waited for. A writer thread drains the ring into large blocks and
+ * appends them to a preallocated file, optionally with O_DIRECT.
+ *
+ * The ring has a single producer, so one capture serves one connection (all the reads of
+ * a connection happen on its own thread).
+ *
+ * The file is a run of records: an 8 byte receive time (ns since the epoch, host order)
+ * followed by the frame as it came off the wire. The frame carries its own length.
+ */
+class SoupBinCapture
+{
+    public:
+    static constexpr size_t ALIGNMENT = 4096;
+    static constexpr size_t TIMESTAMP_LEN = 8;
+
+    /***
+     * @param fileName the file (truncated if it exists)
+     * @param ringSize bytes of frames that can wait for the writer (rounded up to a power of 2)
+     * @param blockSize the size of each write (rounded up to a multiple of 4096)
+     * @param preallocate bytes of disk to reserve at a time
+     * @param direct true to write with O_DIRECT
+     */
+    SoupBinCapture(const std::string& fileName, size_t ringSize = 16 * 1024 * 1024,
+            size_t blockSize = 1024 * 1024, uint64_t preallocate = 256 * 1024 * 1024, bool direct = false);
+    ~SoupBinCapture();
+    SoupBinCapture(const SoupBinCapture&) = delete;
+    SoupBinCapture& operator=(const SoupBinCapture&) = delete;
+
+    /***
+     * Copy a frame into the ring. Called from the network thread, never blocks.
+     * @param frame the frame, starting at its length field
+     * @param length the length of the frame
+     * @returns false if the ring was full and the frame was dropped, or the capture is closed
+     */
+    bool capture(const uint8_t* frame, size_t length) { return capture(frame, length, now()); }
+    bool capture(const uint8_t* frame, size_t length, uint64_t timestamp);
+    /***
+     * Wait until everything captured so far is on disk
+     */
+    void flush();
+    /***
+     * Write what is left and close the file. Nothing more can be captured.
+     */
+    void close();
+
+    bool is_direct() const { return direct; }
+    uint64_t get_captured() const { return captured; }
+    uint64_t get_dropped() const { return dropped; }
+    /***
+     * @returns the number of bytes handed to the file so far
+     */
+    uint64_t get_written() const { return written; }
+
+    /***
+     * @returns nanoseconds since the epoch
+     */
+    static uint64_t now();
+
+    /***
+     * Calls func(timestamp, frame, frame_length) for each frame in a capture file. Stops at
+     * the end of the file, or at the zeroes left behind if the writer did not get to close it.
+     * @returns the number of frames
+     */
+    template<typename F>
+    static uint64_t for_each(const std::string& fileName, F&& func)
+    {
+        itch::mapped_file file(fileName);
+        const uint8_t* data = file.data();
+        size_t pos = 0;
+        uint64_t count = 0;
+        while(file.size() - pos >= TIMESTAMP_LEN + 2)
+        {
+            uint64_t timestamp;
+            memcpy(&timestamp, data + pos, TIMESTAMP_LEN);
+            const uint8_t* frame = data + pos + TIMESTAMP_LEN;
+            size_t frameLength = ((size_t)frame[0] << 8 | frame[1]) + 2;
+            if (frameLength == 2 || file.size() - pos - TIMESTAMP_LEN < frameLength)
+                break;
+            func(timestamp, frame, frameLength);
+            pos += TIMESTAMP_LEN + frameLength;
+            count++;
+        }
+        return count;
+    }
+
+    protected:
+    // the writer thread
+    void run();
+    /***
+     * Move what is in the ring to the block, writing out blocks as they fill
+     * @returns the number of bytes moved
+     */
+    size_t drain();
+    /***
+     * Write the block, padded to the alignment if need be. A partial block stays where it
+     * is, and is written again (at the same offset) once there is more in it.
+     */
+    void write_block();
+    void reserve(uint64_t upTo);
+
+    protected:
+    int fd = -1;
+    bool direct = false;
+    uint8_t* ring = nullptr;
+    size_t ringMask = 0;
+    uint8_t* block = nullptr;
+    size_t blockSize = 0;
+    size_t blockUsed = 0;
+    uint64_t blockOffset = 0; // where the block goes in the file
+    bool blockDirty = false; // holds bytes that are not in the file yet
+    uint64_t preallocate = 0;
+    uint64_t reserved = 0; // disk reserved so far
+    // the producer and the writer each own one of these
+    alignas(64) std::atomic<uint64_t> head = 0; // written by the network thread
+    alignas(64) std::atomic<uint64_t> tail = 0; // written by the writer thread
+    alignas(64) std::atomic<uint64_t> captured = 0;
+    std::atomic<uint64_t> dropped = 0;
+    std::atomic<uint64_t> written = 0;
+    // flush requests, never touched by the network thread
+    std::atomic<uint64_t> flushTarget = 0;
+    uint64_t flushed = 0;
+    std::exception_ptr error;
+    std::mutex flushMutex;
+    std::condition_variable flushCv;
+    std::atomic<bool> stopping = false;
+    bool closed = false;
+    std::thread writerThread;
+};
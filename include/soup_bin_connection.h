@@ -1,19 +1,92 @@
 #pragma once
 #include "soup_bin_timer.h"
 #include "soupbintcp.h"
+#include "message_filter.h"
 #include <vector>
 #include <unordered_map>
 #include <atomic>
 #include <deque>
+#include <memory>
 #include <string>
 #include <boost/asio.hpp>
 
 class SoupBinConnection;
+class SoupBinCapture;
+class SoupBinJournal;
+
+/***
+ * What a connection has done so far
+ */
+struct SoupBinStats
+{
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t packetsIn[256] = {}; // by packet type
+    uint64_t packetsOut[256] = {};
+    uint64_t writeQueueDepth = 0; // packets waiting to be written
+    uint64_t writeQueueBytes = 0;
+    uint64_t writeQueueHighWater = 0; // the deepest the write queue has been
+    uint64_t writeQueueBytesHighWater = 0;
+    uint64_t writeLimitHits = 0; // times the write limit was reached
+    uint64_t writeDropped = 0; // packets not queued because of the write limit, or a client that stopped reconnecting
+    uint64_t msSinceReceive = 0; // a slow or dead peer shows here before the heartbeat timeout
+    uint64_t msSinceSend = 0;
+    uint64_t lastSequence = 0; // of the last sequenced data sent or received
+    uint64_t sequenceGap = 0; // messages the server skipped past at login
+    uint64_t replayFrom = 0; // the sequence number a client asked to start from
+    uint64_t replayed = 0; // sequenced data resent because of that
+    uint64_t reconnects = 0; // times a client logged back in after losing the connection
+    uint64_t connections = 0; // 1, or how many were added together
+
+    /***
+     * Add another connection's stats. Counters are summed, depths and lags take the worst.
+     */
+    void add(const SoupBinStats& in);
+    /***
+     * @brief write the stats as text, one "soupbin_<name>{connection=\"<label>\"} <value>" line each
+     * @param label what goes in the connection label, i.e. "total" or "3"
+     */
+    std::string to_text(const std::string& label) const;
+};
+
+/***
+ * How much a server connection may have waiting to be written, and what happens to a client that
+ * does not keep up. Under CONFLATE and PAUSE_AND_REPLAY, heartbeats and unsequenced data that do
+ * not fit are dropped (counted in writeDropped), not queued for later. A client that is that far
+ * behind has unread packets to show the connection is alive.
+ */
+struct SoupBinWriteLimit
+{
+    enum class Policy
+    {
+        DISCONNECT, // close the connection
+        CONFLATE, // stop sending sequenced data, the client only gets SoupBinServer::send_conflated from then on
+        PAUSE_AND_REPLAY // stop queueing sequenced data, and resend it from the server's store once the queue drains
+    };
+    uint64_t maxBytes = 0; // 0 for no limit
+    uint64_t maxPackets = 0; // 0 for no limit
+    Policy policy = Policy::DISCONNECT;
+    uint32_t resumePercent = 50; // PAUSE_AND_REPLAY resumes when the queue is down to this much of the limit
+};
+
+/***
+ * A whole packet (length, type and payload), encoded once. A server queues the same one on every
+ * connection, so sending to more clients does not mean more copies.
+ */
+typedef std::shared_ptr<const std::vector<unsigned char> > SoupBinFrame;
 
 class MessageRepeater
 {
     public:
     virtual void repeat_from(SoupBinConnection* conn, uint64_t startPos) = 0;
+    /***
+     * The sequence number the next sequenced data will get, for a login that asks for 0
+     */
+    virtual uint64_t next_sequence() const = 0;
+    /***
+     * The connection's socket closed. Its aborted handlers are still queued on the socket's thread.
+     */
+    virtual void on_closed(SoupBinConnection* conn) {}
 };
 
 /***
@@ -30,24 +103,84 @@ class SoupBinConnection : public TimerListener
     };
 
     /***
-     * A connection to a server from a client
+     * A connection to a server from a client. Nothing happens until connect().
      */
     SoupBinConnection(const std::string& url, const std::string& username, const std::string& password,
             const std::string& sessionId = "", uint64_t nextSequenceNo = 0);
+    /***
+     * A connection to a server from a client, that logs in with the session and next sequence
+     * number of the journal, and adds the sequenced data it receives to it. Replay the journal
+     * before connecting. Nothing happens until connect().
+     */
+    SoupBinConnection(const std::string& url, const std::string& username, const std::string& password,
+            SoupBinJournal* journal);
     /***
      * A connection from a client (this ctor used by a server
      */
     SoupBinConnection(boost::asio::ip::tcp::socket skt, MessageRepeater* parent);
     ~SoupBinConnection();
 
+    /***
+     * Clients only: resolve, connect and log in, on the connection's own thread. The hooks are
+     * called from that thread, so a derived class calls this once it is fully constructed
+     * (i.e. at the end of its constructor), never the base constructor.
+     */
+    void connect();
+
     /***
      * Stores message for repeats, plus sends it
     */
     virtual void send_sequenced(uint64_t seqNo, const std::vector<unsigned char>& bytes);
     virtual void send_sequenced(const std::vector<unsigned char>& bytes);
+    /***
+     * Sends a sequenced data frame that is already encoded (see make_frame). It is not stored, the
+     * server keeps the frames for repeats.
+     */
+    virtual void send_sequenced(uint64_t seqNo, const SoupBinFrame& frame);
+    /***
+     * A client keeps what it sends while it is not logged in (i.e. waiting to reconnect), and
+     * sends it once the login is accepted. If it is not going to reconnect, it is dropped and
+     * passed to on_send_dropped.
+     */
     void send_unsequenced(const std::vector<unsigned char>& bytes);
+    void send_unsequenced(const SoupBinFrame& frame) { send(frame); }
+    /***
+     * Server connections only. Takes effect for what is queued from then on.
+     */
+    void set_write_limit(const SoupBinWriteLimit& in) { writeLimit = in; }
+    bool is_paused() const { return paused; }
+    bool is_conflated() const { return conflated; }
+    /****
+     * @brief encode a packet once, for sending on any number of connections
+     * @param type the packet type, i.e. 'S' for sequenced data
+     * @param payload what follows the type
+     * @return the frame
+     */
+    static SoupBinFrame make_frame(char type, const std::vector<unsigned char>& payload);
     uint64_t get_next_seq(bool increment = true);
     std::string get_session_id() { return sessionId; }
+    /***
+     * Sequenced data the filter turns away never becomes a sequenced_data object, and goes to
+     * on_sequenced_data_filtered instead of on_sequenced_data
+     */
+    void set_filter(MessageFilter* in) { filter = in; }
+    /***
+     * Every frame that comes in is copied to the capture (before the filter sees it)
+     */
+    void set_capture(SoupBinCapture* in) { capture = in; }
+    /***
+     * @returns a copy of the counters. Safe to call from any thread while the connection runs.
+     */
+    SoupBinStats get_stats() const;
+    /***
+     * Clients only: when the connection drops or cannot be made, resolve and connect again after
+     * initialMs, then twice as long each time up to maxMs. The login asks for the same session at
+     * the next sequence number expected. Runs on the connection's thread, no thread is added.
+     * @param initialMs the first wait, 0 turns it off
+     * @param maxMs the longest wait
+     * @param maxAttempts give up after this many in a row, 0 to keep trying
+     */
+    void set_reconnect(uint64_t initialMs, uint64_t maxMs = 30000, uint32_t maxAttempts = 0);
 
     // TimerListener implementation
     virtual void OnTimer(uint64_t msSince) override;
@@ -61,15 +194,43 @@ class SoupBinConnection : public TimerListener
     virtual void on_login_accepted(const soupbintcp::login_accepted& in) { status = Status::CONNECTED; }
     virtual void on_login_rejected(const soupbintcp::login_rejected& in) {}
     virtual void on_sequenced_data(const soupbintcp::sequenced_data& in) {}
+    // sequenced data was dropped by the filter (it still takes up a sequence number)
+    virtual void on_sequenced_data_filtered() {}
     virtual void on_unsequenced_data(const soupbintcp::unsequenced_data&  in) {}
     virtual void on_login_request(const soupbintcp::login_request& in);
     virtual void on_logout_request(const soupbintcp::logout_request& in) {}
     virtual void on_server_heartbeat(const soupbintcp::server_heartbeat& in) {} 
     virtual void on_client_heartbeat(const soupbintcp::client_heartbeat& in) {}
     virtual void on_end_of_session(const soupbintcp::end_of_session& in) {}
+    // a client lost its connection (not called when the connection is destroyed)
+    virtual void on_disconnected() {}
+    // a client will try to connect again after delayMs
+    virtual void on_reconnecting(uint32_t attempt, uint64_t delayMs) {}
+    // the server logged us in after the sequence number we asked for, so count messages from first are lost
+    virtual void on_sequence_gap(uint64_t first, uint64_t count) {}
+    // a server connection reached its write limit, and the policy is about to be applied
+    virtual void on_slow_consumer(SoupBinWriteLimit::Policy policy) {}
+    // a client's unsequenced data will not be sent, as it is not connected and will not reconnect
+    virtual void on_send_dropped(const SoupBinFrame& frame) {}
     void send(const std::vector<unsigned char>& bytes);
+    void send(const SoupBinFrame& frame);
+    // on the socket's thread
+    void queue(const SoupBinFrame& frame);
+    void queue_sequenced(uint64_t seqNo, const SoupBinFrame& frame);
+    void send_pending();
+    void drop_pending();
+    bool will_reconnect() const;
+    void count_incoming();
+    void count_queued(const std::vector<unsigned char>& bytes);
+    void count_written(const std::vector<unsigned char>& bytes);
+    bool over_write_limit(size_t adding) const;
+    void conflate();
+    void resume();
 
     // boost asio
+    void start(const std::string& url);
+    void do_resolve();
+    void schedule_reconnect();
     void do_connect(const boost::asio::ip::tcp::resolver::results_type& endpoints);
     void do_read_header();
     void do_read_body();
@@ -86,11 +247,55 @@ class SoupBinConnection : public TimerListener
     std::unordered_map<uint64_t, std::vector<unsigned char> > messages;
     boost::asio::io_context io_context;
     boost::asio::ip::tcp::socket skt;
+    // clients only, so the thread keeps running while there is no socket
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> workGuard{io_context.get_executor()};
+    boost::asio::ip::tcp::resolver resolver{io_context};
+    boost::asio::steady_timer reconnectTimer{io_context};
+    std::string host;
+    std::string port;
     std::thread readerThread;
-    bool shuttingDown = false;
-    std::deque<std::vector<unsigned char> > write_msgs;
+    std::atomic<bool> shuttingDown = false;
+    std::deque<SoupBinFrame> write_msgs;
+    std::deque<SoupBinFrame> pending; // a client's unsequenced data, waiting for the login to be accepted
     std::deque<std::vector<unsigned char> > read_msgs;
     soupbintcp::incoming_message currentIncoming;
     MessageRepeater* parent;
+    MessageFilter* filter = nullptr;
+    SoupBinCapture* capture = nullptr;
+    SoupBinJournal* journal = nullptr;
+    uint64_t readStart = 0; // when the header arrived, for the latency probes
+    // metrics, kept with relaxed atomics so get_stats() can read them from another thread
+    std::atomic<uint64_t> bytesIn = 0;
+    std::atomic<uint64_t> bytesOut = 0;
+    std::atomic<uint64_t> packetsIn[256] = {};
+    std::atomic<uint64_t> packetsOut[256] = {};
+    std::atomic<uint64_t> writeQueueDepth = 0;
+    std::atomic<uint64_t> writeQueueBytes = 0;
+    std::atomic<uint64_t> writeQueueHighWater = 0;
+    std::atomic<uint64_t> writeQueueBytesHighWater = 0;
+    std::atomic<uint64_t> writeLimitHits = 0;
+    std::atomic<uint64_t> writeDropped = 0;
+    std::atomic<uint64_t> lastReceiveMs;
+    std::atomic<uint64_t> lastSendMs;
+    std::atomic<uint64_t> lastSequence = 0;
+    std::atomic<uint64_t> sequenceGap = 0;
+    std::atomic<uint64_t> replayFrom = 0;
+    std::atomic<uint64_t> replayed = 0;
+    bool replaying = false; // inside repeat_from
+    SoupBinWriteLimit writeLimit;
+    std::atomic<bool> paused = false; // PAUSE_AND_REPLAY, waiting for the queue to drain
+    uint64_t pausedFrom = 0; // the first sequence number not queued
+    std::atomic<bool> conflated = false;
+    // reconnecting, touched only on the connection's thread
+    uint64_t requestedSeq = 0; // what the login asks for
+    bool loggedIn = false; // a client at least once, a server connection once it can be sent sequenced data
+    bool sessionUp = false; // a client, from the login being accepted until the connection drops
+    uint64_t reconnectInitialMs = 0;
+    uint64_t reconnectMaxMs = 0;
+    uint32_t reconnectMaxAttempts = 0;
+    uint32_t reconnectAttempts = 0; // since the last login
+    bool reconnectPending = false;
+    bool connecting = false; // a resolve or connect is in flight
+    std::atomic<uint64_t> reconnects = 0;
 };
 
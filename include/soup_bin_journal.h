@@ -0,0 +1,119 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+/***
+ * Keeps the sequenced data a client has received, so that after a restart it can be replayed
+ * locally and the client logs back in where it left off instead of asking for the whole session.
+ *
+ * Two memory mapped files: the payloads, each one after a 2 byte length (host order), and
+ * fileName.idx, with the session, the first sequence number, and the offset of each payload by
+ * sequence number. A message is in the index only after its payload is written, so what is in
+ * the index is complete even if the process dies. sync() is needed for it to survive the machine.
+ *
+ * SoupBinJournal journal("/var/lib/itch/feed.journal");
+ * journal.replay([&book](uint64_t seq, const unsigned char* data, size_t length) { book.apply(data); });
+ * MyConnection conn(url, user, password, &journal); // logs in with the session and next sequence
+ * conn.connect();
+ *
+ * Used from one thread at a time (the connection's).
+ */
+class SoupBinJournal
+{
+    public:
+    static constexpr uint64_t MISSING = UINT64_MAX; // the offset of a message the server skipped
+    static constexpr size_t SESSION_LEN = 10;
+
+    /***
+     * Opens the journal, or creates it
+     * @param fileName the payload file, the index goes next to it
+     * @param initialBytes the size of the payload file to start with, it doubles as needed
+     */
+    SoupBinJournal(const std::string& fileName, uint64_t initialBytes = 64 * 1024 * 1024);
+    ~SoupBinJournal();
+    SoupBinJournal(const SoupBinJournal&) = delete;
+    SoupBinJournal& operator=(const SoupBinJournal&) = delete;
+
+    /***
+     * The server accepted a login. A different session starts the journal again.
+     * @param session the session from login accepted
+     * @param nextSequence the sequence number from login accepted
+     */
+    void start_session(const std::string& session, uint64_t nextSequence);
+    /****
+     * @brief add a message
+     * @param seq its sequence number. Anything skipped since the last one is kept as MISSING.
+     * @param data the payload of the sequenced data
+     * @param length the length of the payload
+     * @return false if the sequence number is already in the journal
+     */
+    bool append(uint64_t seq, const unsigned char* data, size_t length);
+    /***
+     * @brief a message in the journal
+     * @param seq the sequence number
+     * @param length set to the length of the payload
+     * @return the payload, or nullptr if it is not in the journal. Good until the next append.
+     */
+    const unsigned char* get(uint64_t seq, size_t& length) const;
+    /***
+     * Calls func(seq, data, length) for each message, oldest first
+     * @param from the first sequence number to replay, 0 for all of them
+     * @returns the number of messages
+     */
+    template<typename F>
+    uint64_t replay(F&& func, uint64_t from = 0) const
+    {
+        uint64_t count = 0;
+        uint64_t seq = from > header->firstSequence ? from : header->firstSequence;
+        for(; seq < get_next_sequence(); ++seq)
+        {
+            size_t length = 0;
+            const unsigned char* data = get(seq, length);
+            if (data == nullptr)
+                continue;
+            func(seq, data, length);
+            count++;
+        }
+        return count;
+    }
+    /***
+     * Write everything to disk
+     */
+    void sync();
+
+    std::string get_session() const;
+    /***
+     * @returns the sequence number to log in with, 0 if the journal is empty
+     */
+    uint64_t get_next_sequence() const { return header->count == 0 ? header->firstSequence : header->firstSequence + header->count; }
+    uint64_t get_first_sequence() const { return header->firstSequence; }
+    /***
+     * @returns the number of sequence numbers in the journal, including MISSING ones
+     */
+    uint64_t get_count() const { return header->count; }
+
+    protected:
+    struct index_header
+    {
+        char magic[8];
+        char session[SESSION_LEN];
+        uint64_t firstSequence;
+        uint64_t count; // entries in the index
+        uint64_t dataEnd; // bytes used in the payload file
+    };
+    static constexpr size_t INDEX_HEADER_LEN = 4096;
+
+    void map_data(uint64_t size);
+    void map_index(uint64_t entries);
+    void reset(const std::string& session, uint64_t firstSequence);
+    uint64_t* offsets() const { return (uint64_t*)((unsigned char*)header + INDEX_HEADER_LEN); }
+
+    protected:
+    std::string fileName;
+    int dataFd = -1;
+    int indexFd = -1;
+    unsigned char* data = nullptr;
+    uint64_t dataSize = 0;
+    index_header* header = nullptr;
+    uint64_t indexCapacity = 0; // entries
+};
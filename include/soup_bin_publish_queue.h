@@ -0,0 +1,114 @@
+#pragma once
+#include "soup_bin_connection.h"
+#include <atomic>
+#include <thread>
+
+/***
+ * Packets on their way from any number of application threads to a SoupBinServer's thread.
+ *
+ * An intrusive multi-producer single-consumer queue (Vyukov): a push is one exchange and one
+ * store, with no lock and no compare and swap loop, so publishers never wait for each other or
+ * for the server. Only the first push after the consumer starts draining needs to wake it.
+ */
+class SoupBinPublishQueue
+{
+    public:
+    enum class Kind
+    {
+        SEQUENCED,
+        UNSEQUENCED,
+        CONFLATED // unsequenced, for conflated connections only
+    };
+    struct Node
+    {
+        std::atomic<Node*> next = nullptr;
+        Kind kind = Kind::SEQUENCED;
+        SoupBinFrame frame;
+    };
+
+    SoupBinPublishQueue() : head(&stub), tail(&stub) {}
+    ~SoupBinPublishQueue()
+    {
+        while(Node* node = pop())
+            delete node;
+    }
+    SoupBinPublishQueue(const SoupBinPublishQueue&) = delete;
+    SoupBinPublishQueue& operator=(const SoupBinPublishQueue&) = delete;
+
+    /***
+     * Any thread
+     * @returns true if the consumer needs to be woken up to drain the queue
+     */
+    bool push(Kind kind, SoupBinFrame frame)
+    {
+        Node* node = new Node;
+        node->kind = kind;
+        node->frame = std::move(frame);
+        push(node);
+        return !scheduled.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /***
+     * The consumer, before it drains. Anything pushed from here on wakes it again. An exchange,
+     * so a push whose flag it clears synchronizes with it and is seen by the drain that follows.
+     */
+    void start_drain() { scheduled.exchange(false, std::memory_order_acq_rel); }
+    /***
+     * The consumer only. Waits out a push that is half done, so only returns nullptr when the
+     * queue is empty.
+     * @returns the oldest node (the caller deletes it), or nullptr
+     */
+    Node* next()
+    {
+        while(true)
+        {
+            Node* node = pop();
+            if (node != nullptr || empty())
+                return node;
+            std::this_thread::yield();
+        }
+    }
+
+    protected:
+    void push(Node* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        // between these two the queue looks empty to the consumer, see next()
+        prev->next.store(node, std::memory_order_release);
+    }
+    Node* pop()
+    {
+        Node* t = tail;
+        Node* n = t->next.load(std::memory_order_acquire);
+        if (t == &stub)
+        {
+            if (n == nullptr)
+                return nullptr;
+            tail = n;
+            t = n;
+            n = n->next.load(std::memory_order_acquire);
+        }
+        if (n != nullptr)
+        {
+            tail = n;
+            return t;
+        }
+        if (t != head.load(std::memory_order_acquire))
+            return nullptr;
+        // t is the last one, put the stub behind it so it can be taken
+        push(&stub);
+        n = t->next.load(std::memory_order_acquire);
+        if (n == nullptr)
+            return nullptr;
+        tail = n;
+        return t;
+    }
+    bool empty() const { return tail == &stub && head.load(std::memory_order_acquire) == &stub; }
+
+    protected:
+    alignas(64) std::atomic<Node*> head; // producers
+    alignas(64) Node* tail; // the consumer
+    Node stub;
+    alignas(64) std::atomic<bool> scheduled = false;
+};
@@ -1,7 +1,9 @@
 #pragma once
 #include "soup_bin_connection.h"
+#include "soup_bin_publish_queue.h"
 #include <vector>
 #include <memory>
+#include <atomic>
 #include <boost/asio.hpp>
 
 class SoupBinLoginVerifier
@@ -23,6 +25,8 @@ template<typename CONNECTION>
 class SoupBinServer : public MessageRepeater
 {
     public:
+    typedef std::shared_ptr<const std::vector<std::shared_ptr<CONNECTION> > > ConnectionList;
+
     SoupBinServer(int32_t listenPort)
     {
         boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), listenPort);
@@ -38,51 +42,241 @@ class SoupBinServer : public MessageRepeater
             runThread.join();
     }
     void set_login_verifier(SoupBinLoginVerifier* verifier) { loginVerifier = verifier; }
+    /***
+     * Bound the write queue of each connection, so one slow client cannot use up the memory
+     */
+    void set_write_limit(const SoupBinWriteLimit& in)
+    {
+        boost::asio::post(io_context, [this, in]() {
+            writeLimit = in;
+            for(auto& c : *get_connections())
+                c->set_write_limit(in);
+        });
+    }
 
+    /***
+     * The send methods can be called from any number of threads at once. The packet is encoded
+     * on the caller's thread and handed to the server's thread through a lock-free queue, which
+     * numbers sequenced data in the order it was queued and gives each connection the same copy.
+     */
     void send_unsequenced(const std::vector<unsigned char>& bytes)
     {
-        for(auto c : connections)
-            c->send_unsequenced(bytes);
+        publish(SoupBinPublishQueue::Kind::UNSEQUENCED, SoupBinConnection::make_frame('U', bytes));
+    }
+
+    /***
+     * Unsequenced data for the connections that have been conflated (see SoupBinWriteLimit),
+     * i.e. snapshots from an itch::depth_conflator
+     */
+    void send_conflated(const std::vector<unsigned char>& bytes)
+    {
+        publish(SoupBinPublishQueue::Kind::CONFLATED, SoupBinConnection::make_frame('U', bytes));
     }
 
     void send_sequenced(const std::vector<unsigned char>& bytes)
     {
-        uint64_t seq = nextSeq++;
-        messages[seq] = bytes;
-        for(auto c : connections)
-            c->send_sequenced(seq, bytes);
+        publish(SoupBinPublishQueue::Kind::SEQUENCED, SoupBinConnection::make_frame('S', bytes));
     }
 
+    /***
+     * The server's thread only (a login or a paused connection that caught up)
+     */
     void repeat_from(SoupBinConnection* conn, uint64_t startPos)
     {
         while(true)
         {
             auto itr = messages.find(startPos);
-            if (itr == messages.end())
+            // a paused connection picks up from where it stopped once it has caught up
+            if (itr == messages.end() || conn->is_paused())
                 return;
             conn->send_sequenced((*itr).first, (*itr).second);
             startPos++;
         }
     }
+    /***
+     * The server's thread (a login)
+     */
+    virtual uint64_t next_sequence() const override { return nextSeq; }
+    /***
+     * @returns the connections as they are now. The list is never changed, a connection
+     * coming or going replaces it, so it can be read from any thread without a lock.
+     */
+    ConnectionList get_connections() const { return std::atomic_load(&connections); }
+    /***
+     * @returns the stats of all connections added together, closed ones included
+     */
+    SoupBinStats get_stats() const
+    {
+        ConnectionStatsPtr current = std::atomic_load(&connectionStats);
+        SoupBinStats retVal = current->closedTotal;
+        for(const auto& e : current->live)
+            retVal.add(e.second->get_stats());
+        return retVal;
+    }
+    /***
+     * @returns the stats of each connection still open, in the order they connected
+     */
+    std::vector<SoupBinStats> get_connection_stats() const
+    {
+        std::vector<SoupBinStats> retVal;
+        for(const auto& e : std::atomic_load(&connectionStats)->live)
+            retVal.push_back(e.second->get_stats());
+        return retVal;
+    }
+    /***
+     * @returns the stats of the connections that have closed, added together
+     */
+    SoupBinStats get_closed_stats() const { return std::atomic_load(&connectionStats)->closedTotal; }
+    /***
+     * @returns the totals, the closed connections, then each open connection labelled by
+     * the order it connected in, as text (i.e. for a SoupBinStatsExporter)
+     */
+    std::string get_stats_text() const
+    {
+        ConnectionStatsPtr current = std::atomic_load(&connectionStats);
+        SoupBinStats total = current->closedTotal;
+        std::string each;
+        for(const auto& e : current->live)
+        {
+            SoupBinStats curr = e.second->get_stats();
+            total.add(curr);
+            each += curr.to_text(std::to_string(e.first));
+        }
+        return total.to_text("total") + current->closedTotal.to_text("closed") + each;
+    }
+
+    /***
+     * The server's thread. The connection stops getting data now, and is let go once the
+     * handlers its close aborted have run, leaving its final stats in the closed total.
+     */
+    virtual void on_closed(SoupBinConnection* conn) override
+    {
+        replace_connections(nullptr);
+        // the aborted handlers were queued by the close, so they run before this
+        boost::asio::post(io_context, [this, conn]() { release(conn); });
+    }
+
     private:
+    // for the stats. Open connections, numbered in the order they connected, and what the
+    // closed ones added up to.
+    struct ConnectionStats
+    {
+        std::vector<std::pair<uint64_t, std::shared_ptr<CONNECTION> > > live;
+        SoupBinStats closedTotal;
+    };
+    typedef std::shared_ptr<const ConnectionStats> ConnectionStatsPtr;
+
     // boost asio
     void do_accept()
     {
         acceptor->async_accept([this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
             if (!ec)
-                connections.emplace_back(std::make_shared<CONNECTION>(std::move(socket), this));
+            {
+                auto conn = std::make_shared<CONNECTION>(std::move(socket), this);
+                conn->set_write_limit(writeLimit);
+                replace_connections(conn);
+            }
             if (!shuttingDown)
                 do_accept();
         });
     }
 
     protected:
-    std::atomic<uint64_t> nextSeq = 1;
-    std::vector<std::shared_ptr<CONNECTION> > connections;
+    void publish(SoupBinPublishQueue::Kind kind, SoupBinFrame frame)
+    {
+        if (publishQueue.push(kind, std::move(frame)))
+            boost::asio::post(io_context, [this]() { drain(); });
+    }
+    /***
+     * The server's thread. Everything queued so far goes out in one pass over the connections.
+     */
+    void drain()
+    {
+        publishQueue.start_drain();
+        ConnectionList current = get_connections();
+        while(SoupBinPublishQueue::Node* node = publishQueue.next())
+        {
+            switch(node->kind)
+            {
+                case SoupBinPublishQueue::Kind::SEQUENCED:
+                {
+                    uint64_t seq = nextSeq++;
+                    messages[seq] = node->frame;
+                    for(auto& c : *current)
+                        c->send_sequenced(seq, node->frame);
+                    break;
+                }
+                case SoupBinPublishQueue::Kind::UNSEQUENCED:
+                    for(auto& c : *current)
+                        c->send_unsequenced(node->frame);
+                    break;
+                case SoupBinPublishQueue::Kind::CONFLATED:
+                    for(auto& c : *current)
+                        if (c->is_conflated())
+                            c->send_unsequenced(node->frame);
+                    break;
+            }
+            delete node;
+        }
+    }
+    /***
+     * The server's thread. Publishes a new list without the closed connections, and with the
+     * new one if there is one. Readers keep the list they have until they are done with it.
+     */
+    void replace_connections(std::shared_ptr<CONNECTION> added)
+    {
+        ConnectionList current = get_connections();
+        auto next = std::make_shared<std::vector<std::shared_ptr<CONNECTION> > >();
+        next->reserve(current->size() + 1);
+        for(auto& c : *current)
+            if (c->status != SoupBinConnection::Status::DISCONNECTED)
+                next->push_back(c);
+        if (added != nullptr)
+        {
+            next->push_back(added);
+            auto stats = std::make_shared<ConnectionStats>(*std::atomic_load(&connectionStats));
+            stats->live.emplace_back(connectionNumber++, added);
+            std::atomic_store(&connectionStats, ConnectionStatsPtr(std::move(stats)));
+        }
+        std::atomic_store(&connections, ConnectionList(std::move(next)));
+    }
+    /***
+     * The server's thread. Adds a closed connection's stats to the closed total. It is destroyed
+     * here, or by whichever reader still has it in a list.
+     */
+    void release(SoupBinConnection* conn)
+    {
+        ConnectionStatsPtr current = std::atomic_load(&connectionStats);
+        auto next = std::make_shared<ConnectionStats>();
+        next->live.reserve(current->live.size());
+        next->closedTotal = current->closedTotal;
+        for(const auto& e : current->live)
+        {
+            if (e.second.get() != conn)
+            {
+                next->live.push_back(e);
+                continue;
+            }
+            // what it has queued or when it last heard something no longer means anything
+            SoupBinStats closed = conn->get_stats();
+            closed.writeQueueDepth = closed.writeQueueBytes = 0;
+            closed.msSinceReceive = closed.msSinceSend = 0;
+            next->closedTotal.add(closed);
+        }
+        std::atomic_store(&connectionStats, ConnectionStatsPtr(std::move(next)));
+    }
+
+    protected:
+    uint64_t nextSeq = 1; // the server's thread
+    ConnectionList connections = std::make_shared<const std::vector<std::shared_ptr<CONNECTION> > >();
+    ConnectionStatsPtr connectionStats = std::make_shared<const ConnectionStats>();
+    uint64_t connectionNumber = 0; // the server's thread
+    SoupBinPublishQueue publishQueue;
     SoupBinLoginVerifier* loginVerifier = nullptr;
+    SoupBinWriteLimit writeLimit;
     boost::asio::io_context io_context;
     boost::asio::ip::tcp::acceptor* acceptor;
     std::thread runThread;
     bool shuttingDown = false;
-    std::unordered_map<uint64_t, std::vector<unsigned char> > messages;
+    std::unordered_map<uint64_t, SoupBinFrame> messages; // encoded, so repeats are not encoded again. The server's thread.
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <boost/asio.hpp>
+
+/***
+ * Serves text on a Unix domain socket: every client that connects gets the current text, and
+ * the socket is closed. i.e. "socat - UNIX-CONNECT:/run/itch/stats.sock"
+ *
+ * SoupBinStatsExporter exporter("/run/itch/stats.sock", [&server]() { return server.get_stats_text(); });
+ */
+class SoupBinStatsExporter
+{
+    public:
+    /***
+     * @param socketPath where to listen. Anything already there is removed.
+     * @param source makes the text, called on the exporter's thread
+     */
+    SoupBinStatsExporter(const std::string& socketPath, std::function<std::string()> source);
+    ~SoupBinStatsExporter();
+
+    /***
+     * @returns how many clients have been sent the text
+     */
+    uint64_t get_requests() const { return requests; }
+
+    protected:
+    void do_accept();
+
+    protected:
+    std::string socketPath;
+    std::function<std::string()> source;
+    boost::asio::io_context io_context;
+    boost::asio::local::stream_protocol::acceptor acceptor;
+    std::thread runThread;
+    std::atomic<uint64_t> requests = 0;
+};
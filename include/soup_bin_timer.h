@@ -1,6 +1,9 @@
 #pragma once
 #include <cstdint>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 class TimerListener
 {
@@ -15,7 +18,8 @@ class Timer
     ~Timer();
     void run(); // blocks
     void reset(); // reset timer
-    void wait_until(uint64_t specifiedTime); // blocks until a specified time
+    void wait_until(uint64_t specifiedTime); // blocks until a specified time, or stop()
+    void stop(); // no more callbacks once this returns, can be called more than once
     /****
      * @brief check to see if the timer has expired, does callback if necessary
      * @return true if callback called
@@ -28,6 +32,8 @@ class Timer
     uint64_t msBeforeFire; // how long each wait time should be
     TimerListener* listener; // the callback
     std::thread timerThread; // waits and fires the callback
-    bool shuttingDown = false; // shuts down the thread on dtor
+    std::atomic<bool> shuttingDown = false; // shuts down the thread on stop() or dtor
+    std::mutex waitMutex; // so stop() can wake the thread up
+    std::condition_variable wakeUp;
 };
 
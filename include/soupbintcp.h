@@ -134,11 +134,8 @@ struct message {
     }
     const std::string get_string(const message_record& mr) const
     {
-        // get the section of the record we want
-        char buf[mr.length+1];
-        memset(buf, 0, mr.length+1);
-        strncpy(buf, (const char*)&record[mr.offset], mr.length);
-        return buf;
+        const char* start = (const char*)&record[mr.offset];
+        return std::string(start, strnlen(start, mr.length));
     }
     void set_message(const std::vector<unsigned char> data)
     {
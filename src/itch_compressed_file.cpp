@@ -0,0 +1,356 @@
+#include "itch_compressed_file.h"
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef NASDAQ_ITCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef NASDAQ_ITCH_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+namespace itch
+{
+
+// compressed bytes read per syscall
+static const size_t INPUT_BUFFER_SIZE = 1024 * 1024;
+
+compressed_file::compressed_file(const std::string& fileName, format fmt, size_t chunkSize, size_t chunkCount)
+        : fileFormat(fmt), chunks(chunkCount < 2 ? 2 : chunkCount)
+{
+    if (chunkSize == 0)
+        throw std::invalid_argument("Chunk size must be greater than 0");
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::invalid_argument("Unable to open " + fileName);
+    if (fileFormat == format::AUTO)
+    {
+        uint8_t magic[4];
+        ssize_t got = ::pread(fd, magic, sizeof(magic), 0);
+        fileFormat = detect(magic, got < 0 ? 0 : got);
+    }
+#ifndef NASDAQ_ITCH_HAVE_ZSTD
+    if (fileFormat == format::ZSTD)
+    {
+        ::close(fd);
+        throw std::invalid_argument("Built without zstd support: " + fileName);
+    }
+#endif
+#ifndef NASDAQ_ITCH_HAVE_LZ4
+    if (fileFormat == format::LZ4)
+    {
+        ::close(fd);
+        throw std::invalid_argument("Built without lz4 support: " + fileName);
+    }
+#endif
+    for(chunk& curr : chunks)
+        curr.data.resize(chunkSize);
+}
+
+compressed_file::~compressed_file()
+{
+    stop();
+    if (fd >= 0)
+        ::close(fd);
+}
+
+compressed_file::format compressed_file::detect(const uint8_t* data, size_t length)
+{
+    if (length >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+        return format::GZIP;
+    if (length >= 4 && data[0] == 0x28 && data[1] == 0xb5 && data[2] == 0x2f && data[3] == 0xfd)
+        return format::ZSTD;
+    if (length >= 4 && data[0] == 0x04 && data[1] == 0x22 && data[2] == 0x4d && data[3] == 0x18)
+        return format::LZ4;
+    return format::NONE;
+}
+
+void compressed_file::start()
+{
+    if (started)
+        throw std::logic_error("A compressed_file can only be read once");
+    started = true;
+    decompressThread = std::thread([this]() { run(); });
+}
+
+void compressed_file::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (decompressThread.joinable())
+        decompressThread.join();
+}
+
+void compressed_file::rethrow()
+{
+    if (error)
+        std::rethrow_exception(error);
+}
+
+const compressed_file::chunk* compressed_file::next()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return chunks[readIdx].full || done; });
+    return chunks[readIdx].full ? &chunks[readIdx] : nullptr;
+}
+
+void compressed_file::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunks[readIdx].full = false;
+        chunks[readIdx].length = 0;
+        readIdx = (readIdx + 1) % chunks.size();
+    }
+    cv.notify_all();
+}
+
+void compressed_file::run()
+{
+    try
+    {
+        switch(fileFormat)
+        {
+            case format::GZIP:
+                decompress_gzip();
+                break;
+            case format::ZSTD:
+                decompress_zstd();
+                break;
+            case format::LZ4:
+                decompress_lz4();
+                break;
+            default:
+                decompress_none();
+                break;
+        }
+    }
+    catch(...)
+    {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+}
+
+compressed_file::chunk* compressed_file::next_empty()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !chunks[writeIdx].full || stopping; });
+    return stopping ? nullptr : &chunks[writeIdx];
+}
+
+void compressed_file::publish(chunk* curr)
+{
+    decompressed += curr->length;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        curr->full = true;
+        writeIdx = (writeIdx + 1) % chunks.size();
+    }
+    cv.notify_all();
+}
+
+size_t compressed_file::read_input(uint8_t* buffer, size_t length)
+{
+    while(true)
+    {
+        ssize_t got = ::read(fd, buffer, length);
+        if (got >= 0)
+            return got;
+        if (errno != EINTR)
+            throw std::runtime_error("Unable to read compressed file");
+    }
+}
+
+void compressed_file::decompress_none()
+{
+    while(true)
+    {
+        chunk* curr = next_empty();
+        if (curr == nullptr)
+            return;
+        while(curr->length < curr->data.size())
+        {
+            size_t got = read_input(curr->data.data() + curr->length, curr->data.size() - curr->length);
+            if (got == 0)
+                break;
+            curr->length += got;
+        }
+        if (curr->length == 0)
+            return;
+        bool last = curr->length < curr->data.size();
+        publish(curr);
+        if (last)
+            return;
+    }
+}
+
+void compressed_file::decompress_gzip()
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // 32 lets zlib find the gzip header itself
+    if (inflateInit2(&strm, 15 + 32) != Z_OK)
+        throw std::runtime_error("Unable to start gzip decompression");
+    std::vector<uint8_t> input(INPUT_BUFFER_SIZE);
+    chunk* curr = nullptr;
+    bool eof = false;
+    bool inMember = false; // part way through a gzip member
+    while(true)
+    {
+        if (strm.avail_in == 0 && !eof)
+        {
+            strm.avail_in = read_input(input.data(), input.size());
+            strm.next_in = input.data();
+            eof = strm.avail_in == 0;
+        }
+        if (strm.avail_in == 0 && eof)
+            break;
+        if (curr == nullptr)
+        {
+            curr = next_empty();
+            if (curr == nullptr)
+                break;
+        }
+        strm.next_out = curr->data.data() + curr->length;
+        strm.avail_out = curr->data.size() - curr->length;
+        inMember = true;
+        int ret = inflate(&strm, Z_NO_FLUSH);
+        curr->length = curr->data.size() - strm.avail_out;
+        if (ret == Z_STREAM_END)
+        {
+            // the archive may be several members stuck together
+            inflateReset(&strm);
+            inMember = false;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            inflateEnd(&strm);
+            throw std::runtime_error("Corrupt gzip data");
+        }
+        if (curr->length == curr->data.size())
+        {
+            publish(curr);
+            curr = nullptr;
+        }
+    }
+    inflateEnd(&strm);
+    if (curr != nullptr && curr->length > 0)
+        publish(curr);
+    if (eof && inMember)
+        throw std::runtime_error("Truncated gzip data");
+}
+
+void compressed_file::decompress_zstd()
+{
+#ifdef NASDAQ_ITCH_HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if (stream == nullptr)
+        throw std::runtime_error("Unable to start zstd decompression");
+    ZSTD_initDStream(stream);
+    std::vector<uint8_t> input(INPUT_BUFFER_SIZE);
+    ZSTD_inBuffer in{input.data(), 0, 0};
+    chunk* curr = nullptr;
+    bool eof = false;
+    size_t lastRet = 0; // 0 when a frame is complete
+    while(true)
+    {
+        if (in.pos == in.size && !eof)
+        {
+            in.size = read_input(input.data(), input.size());
+            in.pos = 0;
+            eof = in.size == 0;
+        }
+        if (in.pos == in.size && eof)
+            break;
+        if (curr == nullptr)
+        {
+            curr = next_empty();
+            if (curr == nullptr)
+                break;
+        }
+        ZSTD_outBuffer out{curr->data.data(), curr->data.size(), curr->length};
+        lastRet = ZSTD_decompressStream(stream, &out, &in);
+        if (ZSTD_isError(lastRet))
+        {
+            ZSTD_freeDStream(stream);
+            throw std::runtime_error(std::string("Corrupt zstd data: ") + ZSTD_getErrorName(lastRet));
+        }
+        curr->length = out.pos;
+        if (curr->length == curr->data.size())
+        {
+            publish(curr);
+            curr = nullptr;
+        }
+    }
+    ZSTD_freeDStream(stream);
+    if (curr != nullptr && curr->length > 0)
+        publish(curr);
+    if (eof && lastRet != 0)
+        throw std::runtime_error("Truncated zstd data");
+#endif
+}
+
+void compressed_file::decompress_lz4()
+{
+#ifdef NASDAQ_ITCH_HAVE_LZ4
+    LZ4F_dctx* ctx = nullptr;
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION)))
+        throw std::runtime_error("Unable to start lz4 decompression");
+    std::vector<uint8_t> input(INPUT_BUFFER_SIZE);
+    size_t inPos = 0;
+    size_t inSize = 0;
+    chunk* curr = nullptr;
+    bool eof = false;
+    size_t lastRet = 0; // 0 when a frame is complete
+    while(true)
+    {
+        if (inPos == inSize && !eof)
+        {
+            inSize = read_input(input.data(), input.size());
+            inPos = 0;
+            eof = inSize == 0;
+        }
+        if (inPos == inSize && eof)
+            break;
+        if (curr == nullptr)
+        {
+            curr = next_empty();
+            if (curr == nullptr)
+                break;
+        }
+        size_t outSize = curr->data.size() - curr->length;
+        size_t srcSize = inSize - inPos;
+        lastRet = LZ4F_decompress(ctx, curr->data.data() + curr->length, &outSize, input.data() + inPos, &srcSize,
+                nullptr);
+        if (LZ4F_isError(lastRet))
+        {
+            LZ4F_freeDecompressionContext(ctx);
+            throw std::runtime_error(std::string("Corrupt lz4 data: ") + LZ4F_getErrorName(lastRet));
+        }
+        inPos += srcSize;
+        curr->length += outSize;
+        if (curr->length == curr->data.size())
+        {
+            publish(curr);
+            curr = nullptr;
+        }
+    }
+    LZ4F_freeDecompressionContext(ctx);
+    if (curr != nullptr && curr->length > 0)
+        publish(curr);
+    if (eof && lastRet != 0)
+        throw std::runtime_error("Truncated lz4 data");
+#endif
+}
+
+} // end namespace itch
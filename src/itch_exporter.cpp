@@ -0,0 +1,566 @@
+#include "itch_exporter.h"
+#include "itch_file_index.h"
+#include <stdexcept>
+#include <charconv>
+#include <cctype>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace itch
+{
+
+// the name of the field in lower case, and where it is
+#define COLUMN(msg, field) column{#field, msg::field}
+
+exporter::exporter(format fmt) : outputFormat(fmt)
+{
+    for(bool& curr : selected)
+        curr = true;
+    layouts[(uint8_t)system_event().message_type] = {
+        COLUMN(system_event, MESSAGE_TYPE),
+        COLUMN(system_event, STOCK_LOCATE),
+        COLUMN(system_event, TRACKING_NUMBER),
+        COLUMN(system_event, TIMESTAMP),
+        COLUMN(system_event, EVENT_CODE)
+    };
+    layouts[(uint8_t)stock_directory().message_type] = {
+        COLUMN(stock_directory, MESSAGE_TYPE),
+        COLUMN(stock_directory, STOCK_LOCATE),
+        COLUMN(stock_directory, TRACKING_NUMBER),
+        COLUMN(stock_directory, TIMESTAMP),
+        COLUMN(stock_directory, STOCK),
+        COLUMN(stock_directory, MARKET_CATEGORY),
+        COLUMN(stock_directory, FINANCIAL_STATUS_INDICATOR),
+        COLUMN(stock_directory, ROUND_LOT_SIZE),
+        COLUMN(stock_directory, ROUND_LOTS_ONLY),
+        COLUMN(stock_directory, ISSUE_CLASSIFICATION),
+        COLUMN(stock_directory, ISSUE_SUB_TYPE),
+        COLUMN(stock_directory, AUTHENTICITY),
+        COLUMN(stock_directory, SHORT_SALE_THRESHOLD_INDICATOR),
+        COLUMN(stock_directory, IPO_FLAG),
+        COLUMN(stock_directory, LULDREFERENCE_PRICE_TIER),
+        COLUMN(stock_directory, ETP_FLAG),
+        COLUMN(stock_directory, ETP_LEVERAGE_FACTOR),
+        COLUMN(stock_directory, INVERSE_INDICATOR)
+    };
+    layouts[(uint8_t)stock_trading_action().message_type] = {
+        COLUMN(stock_trading_action, MESSAGE_TYPE),
+        COLUMN(stock_trading_action, STOCK_LOCATE),
+        COLUMN(stock_trading_action, TRACKING_NUMBER),
+        COLUMN(stock_trading_action, TIMESTAMP),
+        COLUMN(stock_trading_action, STOCK),
+        COLUMN(stock_trading_action, TRADING_STATE),
+        COLUMN(stock_trading_action, RESERVED),
+        COLUMN(stock_trading_action, REASON)
+    };
+    layouts[(uint8_t)reg_sho_restriction().message_type] = {
+        COLUMN(reg_sho_restriction, MESSAGE_TYPE),
+        COLUMN(reg_sho_restriction, STOCK_LOCATE),
+        COLUMN(reg_sho_restriction, TRACKING_NUMBER),
+        COLUMN(reg_sho_restriction, TIMESTAMP),
+        COLUMN(reg_sho_restriction, STOCK),
+        COLUMN(reg_sho_restriction, REG_SHO_ACTION)
+    };
+    layouts[(uint8_t)market_participant_position().message_type] = {
+        COLUMN(market_participant_position, MESSAGE_TYPE),
+        COLUMN(market_participant_position, STOCK_LOCATE),
+        COLUMN(market_participant_position, TRACKING_NUMBER),
+        COLUMN(market_participant_position, TIMESTAMP),
+        COLUMN(market_participant_position, MPID),
+        COLUMN(market_participant_position, STOCK),
+        COLUMN(market_participant_position, PRIMARY_MARKET_MAKER),
+        COLUMN(market_participant_position, MARKET_MAKER_MODE),
+        COLUMN(market_participant_position, MARKET_PARTICIPANT_STATE)
+    };
+    layouts[(uint8_t)mwcp_decline_level().message_type] = {
+        COLUMN(mwcp_decline_level, MESSAGE_TYPE),
+        COLUMN(mwcp_decline_level, STOCK_LOCATE),
+        COLUMN(mwcp_decline_level, TRACKING_NUMBER),
+        COLUMN(mwcp_decline_level, TIMESTAMP),
+        COLUMN(mwcp_decline_level, LEVEL_1),
+        COLUMN(mwcp_decline_level, LEVEL_2),
+        COLUMN(mwcp_decline_level, LEVEL_3)
+    };
+    layouts[(uint8_t)mwcp_status().message_type] = {
+        COLUMN(mwcp_status, MESSAGE_TYPE),
+        COLUMN(mwcp_status, STOCK_LOCATE),
+        COLUMN(mwcp_status, TRACKING_NUMBER),
+        COLUMN(mwcp_status, TIMESTAMP),
+        COLUMN(mwcp_status, BREACHED_LEVEL)
+    };
+    layouts[(uint8_t)ipo_quoting_period_update().message_type] = {
+        COLUMN(ipo_quoting_period_update, MESSAGE_TYPE),
+        COLUMN(ipo_quoting_period_update, STOCK_LOCATE),
+        COLUMN(ipo_quoting_period_update, TRACKING_NUMBER),
+        COLUMN(ipo_quoting_period_update, TIMESTAMP),
+        COLUMN(ipo_quoting_period_update, STOCK),
+        COLUMN(ipo_quoting_period_update, IPO_QUOTATION_RELEASE_TIME),
+        COLUMN(ipo_quoting_period_update, IPO_QUOTATION_RELEASE_QUALIFIER),
+        COLUMN(ipo_quoting_period_update, IPO_PRICE)
+    };
+    layouts[(uint8_t)luld_auction_collar().message_type] = {
+        COLUMN(luld_auction_collar, MESSAGE_TYPE),
+        COLUMN(luld_auction_collar, STOCK_LOCATE),
+        COLUMN(luld_auction_collar, TRACKING_NUMBER),
+        COLUMN(luld_auction_collar, TIMESTAMP),
+        COLUMN(luld_auction_collar, STOCK),
+        COLUMN(luld_auction_collar, AUCTION_COLLAR_REFERENCE_PRICE),
+        COLUMN(luld_auction_collar, UPPER_AUCTION_COLLAR_PRICE),
+        COLUMN(luld_auction_collar, LOWER_AUCTION_COLLAR_PRICE),
+        COLUMN(luld_auction_collar, AUCTION_COLLAR_EXTENSION)
+    };
+    layouts[(uint8_t)operational_halt().message_type] = {
+        COLUMN(operational_halt, MESSAGE_TYPE),
+        COLUMN(operational_halt, STOCK_LOCATE),
+        COLUMN(operational_halt, TRACKING_NUMBER),
+        COLUMN(operational_halt, TIMESTAMP),
+        COLUMN(operational_halt, STOCK),
+        COLUMN(operational_halt, MARKET_CODE),
+        COLUMN(operational_halt, OPERATIONAL_HALT_ACTION)
+    };
+    layouts[(uint8_t)add_order().message_type] = {
+        COLUMN(add_order, MESSAGE_TYPE),
+        COLUMN(add_order, STOCK_LOCATE),
+        COLUMN(add_order, TRACKING_NUMBER),
+        COLUMN(add_order, TIMESTAMP),
+        COLUMN(add_order, ORDER_REFERENCE_NUMBER),
+        COLUMN(add_order, BUY_SELL_INDICATOR),
+        COLUMN(add_order, SHARES),
+        COLUMN(add_order, STOCK),
+        COLUMN(add_order, PRICE)
+    };
+    layouts[(uint8_t)add_order_with_mpid().message_type] = {
+        COLUMN(add_order_with_mpid, MESSAGE_TYPE),
+        COLUMN(add_order_with_mpid, STOCK_LOCATE),
+        COLUMN(add_order_with_mpid, TRACKING_NUMBER),
+        COLUMN(add_order_with_mpid, TIMESTAMP),
+        COLUMN(add_order_with_mpid, ORDER_REFERENCE_NUMBER),
+        COLUMN(add_order_with_mpid, BUY_SELL_INDICATOR),
+        COLUMN(add_order_with_mpid, SHARES),
+        COLUMN(add_order_with_mpid, STOCK),
+        COLUMN(add_order_with_mpid, PRICE),
+        COLUMN(add_order_with_mpid, ATTRIBUTION)
+    };
+    layouts[(uint8_t)order_executed().message_type] = {
+        COLUMN(order_executed, MESSAGE_TYPE),
+        COLUMN(order_executed, STOCK_LOCATE),
+        COLUMN(order_executed, TRACKING_NUMBER),
+        COLUMN(order_executed, TIMESTAMP),
+        COLUMN(order_executed, ORDER_REFERENCE_NUMBER),
+        COLUMN(order_executed, EXECUTED_SHARES),
+        COLUMN(order_executed, MATCH_NUMBER)
+    };
+    layouts[(uint8_t)order_executed_with_price().message_type] = {
+        COLUMN(order_executed_with_price, MESSAGE_TYPE),
+        COLUMN(order_executed_with_price, STOCK_LOCATE),
+        COLUMN(order_executed_with_price, TRACKING_NUMBER),
+        COLUMN(order_executed_with_price, TIMESTAMP),
+        COLUMN(order_executed_with_price, ORDER_REFERENCE_NUMBER),
+        COLUMN(order_executed_with_price, EXECUTED_SHARES),
+        COLUMN(order_executed_with_price, MATCH_NUMBER),
+        COLUMN(order_executed_with_price, PRINTABLE),
+        COLUMN(order_executed_with_price, EXECUTION_PRICE)
+    };
+    layouts[(uint8_t)order_cancel().message_type] = {
+        COLUMN(order_cancel, MESSAGE_TYPE),
+        COLUMN(order_cancel, STOCK_LOCATE),
+        COLUMN(order_cancel, TRACKING_NUMBER),
+        COLUMN(order_cancel, TIMESTAMP),
+        COLUMN(order_cancel, ORDER_REFERENCE_NUMBER),
+        COLUMN(order_cancel, CANCELLED_SHARES)
+    };
+    layouts[(uint8_t)order_delete().message_type] = {
+        COLUMN(order_delete, MESSAGE_TYPE),
+        COLUMN(order_delete, STOCK_LOCATE),
+        COLUMN(order_delete, TRACKING_NUMBER),
+        COLUMN(order_delete, TIMESTAMP),
+        COLUMN(order_delete, ORDER_REFERENCE_NUMBER)
+    };
+    layouts[(uint8_t)order_replace().message_type] = {
+        COLUMN(order_replace, MESSAGE_TYPE),
+        COLUMN(order_replace, STOCK_LOCATE),
+        COLUMN(order_replace, TRACKING_NUMBER),
+        COLUMN(order_replace, TIMESTAMP),
+        COLUMN(order_replace, ORIGINAL_ORDER_REFERENCE_NUMBER),
+        COLUMN(order_replace, NEW_ORDER_REFERENCE_NUMBER),
+        COLUMN(order_replace, SHARES),
+        COLUMN(order_replace, PRICE)
+    };
+    layouts[(uint8_t)trade().message_type] = {
+        COLUMN(trade, MESSAGE_TYPE),
+        COLUMN(trade, STOCK_LOCATE),
+        COLUMN(trade, TRACKING_NUMBER),
+        COLUMN(trade, TIMESTAMP),
+        COLUMN(trade, ORDER_REFERENCE_NUMBER),
+        COLUMN(trade, BUY_SELL_INDICATOR),
+        COLUMN(trade, SHARES),
+        COLUMN(trade, STOCK),
+        COLUMN(trade, PRICE),
+        COLUMN(trade, MATCH_NUMBER)
+    };
+    layouts[(uint8_t)cross_trade().message_type] = {
+        COLUMN(cross_trade, MESSAGE_TYPE),
+        COLUMN(cross_trade, STOCK_LOCATE),
+        COLUMN(cross_trade, TRACKING_NUMBER),
+        COLUMN(cross_trade, TIMESTAMP),
+        COLUMN(cross_trade, SHARES),
+        COLUMN(cross_trade, STOCK),
+        COLUMN(cross_trade, CROSS_PRICE),
+        COLUMN(cross_trade, MATCH_NUMBER),
+        COLUMN(cross_trade, CROSS_TYPE)
+    };
+    layouts[(uint8_t)broken_trade().message_type] = {
+        COLUMN(broken_trade, MESSAGE_TYPE),
+        COLUMN(broken_trade, STOCK_LOCATE),
+        COLUMN(broken_trade, TRACKING_NUMBER),
+        COLUMN(broken_trade, TIMESTAMP),
+        COLUMN(broken_trade, MATCH_NUMBER)
+    };
+    layouts[(uint8_t)noii().message_type] = {
+        COLUMN(noii, MESSAGE_TYPE),
+        COLUMN(noii, STOCK_LOCATE),
+        COLUMN(noii, TRACKING_NUMBER),
+        COLUMN(noii, TIMESTAMP),
+        COLUMN(noii, PAIRED_SHARES),
+        COLUMN(noii, IMBALANCE_SHARES),
+        COLUMN(noii, IMBALANCE_DIRECTION),
+        COLUMN(noii, STOCK),
+        COLUMN(noii, FAR_PRICE),
+        COLUMN(noii, NEAR_PRICE),
+        COLUMN(noii, CURRENT_REFERENCE_PRICE),
+        COLUMN(noii, CROSS_TYPE),
+        COLUMN(noii, PRICE_VARIATION_INDICATOR)
+    };
+    layouts[(uint8_t)rpii().message_type] = {
+        COLUMN(rpii, MESSAGE_TYPE),
+        COLUMN(rpii, STOCK_LOCATE),
+        COLUMN(rpii, TRACKING_NUMBER),
+        COLUMN(rpii, TIMESTAMP),
+        COLUMN(rpii, STOCK),
+        COLUMN(rpii, INTEREST_FLAG)
+    };
+    layouts[(uint8_t)direct_listing_with_capital_raise_price_discovery().message_type] = {
+        COLUMN(direct_listing_with_capital_raise_price_discovery, MESSAGE_TYPE),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, STOCK_LOCATE),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, TRACKING_NUMBER),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, TIMESTAMP),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, STOCK),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, OPEN_ELIGIBILITY_STATUS),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, MINIMUM_ALLOWABLE_PRICE),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, MAXIMUM_ALLOWABLE_PRICE),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, NEAR_EXECUTION_PRICE),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, NEAR_EXECUTION_TIME),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, LOWER_PRICE_RANGE_COLLAR),
+        COLUMN(direct_listing_with_capital_raise_price_discovery, UPPER_PRICE_RANGE_COLLAR)
+    };
+    for(std::vector<column>& layout : layouts)
+        for(column& curr : layout)
+            for(char& c : curr.name)
+                c = tolower(c);
+}
+
+#undef COLUMN
+
+void exporter::select(const std::string& messageTypes)
+{
+    for(bool& curr : selected)
+        curr = false;
+    for(char type : messageTypes)
+        selected[(uint8_t)type] = true;
+}
+
+std::string exporter::get_header(char messageType) const
+{
+    std::string retVal;
+    for(const column& curr : layouts[(uint8_t)messageType])
+    {
+        if (!retVal.empty())
+            retVal += ',';
+        retVal += curr.name;
+    }
+    return retVal;
+}
+
+size_t exporter::format_record(const uint8_t* record, uint16_t length, char* out) const
+{
+    if (length == 0 || !selected[record[0]])
+        return 0;
+    const std::vector<column>& columns = layouts[record[0]];
+    // every layout ends with its last field
+    if (columns.empty() || length < columns.back().field.offset + columns.back().field.length)
+        return 0;
+    char* end = outputFormat == format::CSV ? write_csv(record, columns, out) : write_json(record, columns, out);
+    *end++ = '\n';
+    return end - out;
+}
+
+char* exporter::write_csv(const uint8_t* record, const std::vector<column>& columns, char* out) const
+{
+    for(size_t i = 0; i < columns.size(); ++i)
+    {
+        if (i > 0)
+            *out++ = ',';
+        out = write_field(record, columns[i].field, false, out);
+    }
+    return out;
+}
+
+char* exporter::write_json(const uint8_t* record, const std::vector<column>& columns, char* out) const
+{
+    *out++ = '{';
+    for(size_t i = 0; i < columns.size(); ++i)
+    {
+        if (i > 0)
+            *out++ = ',';
+        *out++ = '"';
+        memcpy(out, columns[i].name.data(), columns[i].name.size());
+        out += columns[i].name.size();
+        *out++ = '"';
+        *out++ = ':';
+        out = write_field(record, columns[i].field, true, out);
+    }
+    *out++ = '}';
+    return out;
+}
+
+char* exporter::write_field(const uint8_t* record, const message_record& field, bool json, char* out)
+{
+    // 24 is enough for any integer or price
+    switch(field.type)
+    {
+        case message_record::field_type::INTEGER:
+            return std::to_chars(out, out + 24, get_int(record, field)).ptr;
+        case message_record::field_type::PRICE4:
+            return price4((int64_t)get_int(record, field)).to_chars(out, out + 24);
+        case message_record::field_type::PRICE8:
+            return price8((int64_t)get_int(record, field)).to_chars(out, out + 24);
+        default:
+            break;
+    }
+    // text is padded on the right with spaces
+    const uint8_t* text = record + field.offset;
+    size_t length = field.length;
+    while(length > 0 && (text[length - 1] == ' ' || text[length - 1] == 0))
+        length--;
+    bool quote = json;
+    for(size_t i = 0; i < length && !quote; ++i)
+        quote = text[i] == ',' || text[i] == '"';
+    if (quote)
+        *out++ = '"';
+    for(size_t i = 0; i < length; ++i)
+    {
+        uint8_t c = text[i];
+        if (!json)
+        {
+            if (c == '"')
+                *out++ = '"';
+            *out++ = c;
+        }
+        else if (c == '"' || c == '\\')
+        {
+            *out++ = '\\';
+            *out++ = c;
+        }
+        else if (c < 0x20 || c >= 0x7f)
+        {
+            static const char* HEX = "0123456789abcdef";
+            memcpy(out, "\\u00", 4);
+            out[4] = HEX[c >> 4];
+            out[5] = HEX[c & 0x0f];
+            out += 6;
+        }
+        else
+        {
+            *out++ = c;
+        }
+    }
+    if (quote)
+        *out++ = '"';
+    return out;
+}
+
+void exporter::format_chunk(const uint8_t* data, size_t length, size_t start, size_t stop, chunk_output& out) const
+{
+    out.used = 0;
+    out.lines = 0;
+    size_t pos = start;
+    while(pos < stop && pos + RECORD_LENGTH_LEN <= length)
+    {
+        uint16_t recordLength = ((uint16_t)data[pos] << 8) | data[pos + 1];
+        if (pos + RECORD_LENGTH_LEN + recordLength > length)
+            break;
+        if (out.text.size() - out.used < MAX_LINE)
+            out.text.resize(out.text.size() < MAX_LINE ? MAX_LINE * 64 : out.text.size() * 2);
+        size_t written = format_record(data + pos + RECORD_LENGTH_LEN, recordLength, out.text.data() + out.used);
+        out.used += written;
+        out.lines += written > 0;
+        pos += RECORD_LENGTH_LEN + recordLength;
+    }
+    out.end = pos;
+}
+
+void exporter::write_all(int fd, const char* data, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw std::runtime_error("Unable to write export");
+        data += written;
+        length -= written;
+    }
+}
+
+uint64_t exporter::export_buffer(const uint8_t* data, size_t length, int fd, size_t threads, size_t chunkSize) const
+{
+    if (chunkSize == 0)
+        throw std::invalid_argument("Chunk size must be greater than 0");
+    if (threads == 0)
+        threads = 1;
+    size_t chunkCount = (length + chunkSize - 1) / chunkSize;
+    if (threads == 1 || chunkCount <= 1)
+    {
+        chunk_output out;
+        uint64_t lines = 0;
+        for(size_t pos = 0; pos < length; )
+        {
+            format_chunk(data, length, pos, pos + chunkSize, out);
+            write_all(fd, out.text.data(), out.used);
+            lines += out.lines;
+            if (out.end == pos)
+                break; // a partial record at the end
+            pos = out.end;
+        }
+        return lines;
+    }
+    // each chunk starts at the first record after its share of the input
+    std::vector<size_t> starts(chunkCount + 1);
+    starts[0] = 0;
+    for(size_t i = 1; i < chunkCount; ++i)
+        starts[i] = file_index::find_record(data, length, i * chunkSize);
+    starts[chunkCount] = length;
+    // a window of chunks in flight, each slot reused once it is written
+    size_t window = threads * 2;
+    std::vector<chunk_output> outputs(window);
+    std::vector<bool> ready(window, false);
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t nextChunk = 0; // the next to be formatted
+    size_t nextWrite = 0; // the next to be written
+    bool stopping = false;
+    auto worker = [&]() {
+        while(true)
+        {
+            size_t idx;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return stopping || nextChunk >= chunkCount || nextChunk < nextWrite + window; });
+                if (stopping || nextChunk >= chunkCount)
+                    return;
+                idx = nextChunk++;
+            }
+            chunk_output& out = outputs[idx % window];
+            format_chunk(data, length, starts[idx], starts[idx + 1], out);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[idx % window] = true;
+            }
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> workers;
+    for(size_t i = 0; i < threads; ++i)
+        workers.emplace_back(worker);
+    uint64_t lines = 0;
+    size_t pos = 0; // where the output has got to in the input
+    try
+    {
+        chunk_output fallback;
+        for(size_t idx = 0; idx < chunkCount; ++idx)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return ready[idx % window]; });
+            }
+            chunk_output& out = outputs[idx % window];
+            if (starts[idx] == pos)
+            {
+                write_all(fd, out.text.data(), out.used);
+                lines += out.lines;
+                pos = out.end;
+            }
+            else if (pos < starts[idx + 1])
+            {
+                // the chunk did not start on a record after all, redo it from where the last one ended
+                format_chunk(data, length, pos, starts[idx + 1], fallback);
+                write_all(fd, fallback.text.data(), fallback.used);
+                lines += fallback.lines;
+                pos = fallback.end;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready[idx % window] = false;
+                nextWrite++;
+            }
+            cv.notify_all();
+        }
+    }
+    catch(...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for(std::thread& curr : workers)
+            curr.join();
+        throw;
+    }
+    for(std::thread& curr : workers)
+        curr.join();
+    return lines;
+}
+
+uint64_t exporter::export_file(const std::string& inFileName, const std::string& outFileName, size_t threads,
+        size_t chunkSize) const
+{
+    mapped_file in(inFileName);
+    int fd = ::open(outFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::invalid_argument("Unable to open " + outFileName);
+    try
+    {
+        char only = 0;
+        size_t count = 0;
+        for(int i = 0; i < 256; ++i)
+        {
+            if (selected[i] && !layouts[i].empty())
+            {
+                only = (char)i;
+                count++;
+            }
+        }
+        if (outputFormat == format::CSV && count == 1)
+        {
+            std::string header = get_header(only) + "\n";
+            write_all(fd, header.data(), header.size());
+        }
+        uint64_t lines = export_buffer(in.data(), in.size(), fd, threads, chunkSize);
+        ::close(fd);
+        return lines;
+    }
+    catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+}
+
+} // end namespace itch
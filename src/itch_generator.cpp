@@ -0,0 +1,339 @@
+#include "itch_generator.h"
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace itch
+{
+
+namespace
+{
+
+// prices move in cents, i.e. 100 in Price(4)
+const uint32_t TICK = 100;
+
+inline void put16(uint8_t* out, uint16_t val)
+{
+    out[0] = val >> 8;
+    out[1] = val;
+}
+
+inline void put32(uint8_t* out, uint32_t val)
+{
+    out[0] = val >> 24;
+    out[1] = val >> 16;
+    out[2] = val >> 8;
+    out[3] = val;
+}
+
+inline void put48(uint8_t* out, uint64_t val)
+{
+    put16(out, val >> 32);
+    put32(out + 2, val);
+}
+
+inline void put64(uint8_t* out, uint64_t val)
+{
+    put32(out, val >> 32);
+    put32(out + 4, val);
+}
+
+inline void put_symbol(uint8_t* out, uint64_t symbol)
+{
+    memcpy(out, &symbol, 8);
+}
+
+/***
+ * AAAA, AAAB, ... so that every locate has its own symbol
+ */
+uint64_t make_symbol(uint16_t locate)
+{
+    uint8_t buf[8];
+    memset(buf, ' ', 8);
+    uint32_t idx = locate - 1;
+    for(int i = 3; i >= 0; --i)
+    {
+        buf[i] = 'A' + idx % 26;
+        idx /= 26;
+    }
+    return pack_symbol(buf);
+}
+
+} // namespace
+
+generator::generator(const options& in) : opts(in)
+{
+    if (opts.symbols == 0)
+        throw std::invalid_argument("generator needs at least one symbol");
+    totalWeight = opts.addWeight + opts.executeWeight + opts.cancelWeight + opts.replaceWeight + opts.deleteWeight;
+    if (totalWeight == 0)
+        throw std::invalid_argument("generator needs a message mix");
+    random = opts.seed;
+    timestamp = opts.startTime;
+    symbols.reserve(opts.symbols);
+    mids.reserve(opts.symbols);
+    for(uint16_t locate = 1; locate <= opts.symbols; ++locate)
+    {
+        symbols.push_back(make_symbol(locate));
+        // somewhere between $10 and $500
+        mids.push_back((10 + random_below(490)) * 10000);
+    }
+    live.reserve(1 << 16);
+}
+
+size_t generator::generate(uint8_t* buffer, size_t capacity)
+{
+    size_t pos = 0;
+    while(phase != phase_type::DONE && capacity - pos >= MAX_RECORD)
+    {
+        uint16_t length = next_record(buffer + pos + RECORD_LENGTH_LEN);
+        put16(buffer + pos, length);
+        pos += RECORD_LENGTH_LEN + length;
+        records++;
+    }
+    return pos;
+}
+
+uint64_t generator::write_file(const std::string& fileName, size_t bufferSize)
+{
+    int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::invalid_argument("Unable to open " + fileName);
+    std::vector<uint8_t> buffer(bufferSize < MAX_RECORD ? MAX_RECORD : bufferSize);
+    uint64_t start = records;
+    for(size_t length = generate(buffer.data(), buffer.size()); length > 0;
+            length = generate(buffer.data(), buffer.size()))
+    {
+        const uint8_t* data = buffer.data();
+        while(length > 0)
+        {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                ::close(fd);
+                throw std::runtime_error("Unable to write " + fileName);
+            }
+            data += written;
+            length -= written;
+        }
+    }
+    if (::close(fd) != 0)
+        throw std::runtime_error("Unable to write " + fileName);
+    return records - start;
+}
+
+uint16_t generator::next_record(uint8_t* out)
+{
+    uint16_t length = 0;
+    switch(phase)
+    {
+        case(phase_type::OPEN):
+            length = write_system_event(out, 'O');
+            phase = phase_type::DIRECTORY;
+            break;
+        case(phase_type::DIRECTORY):
+            length = write_directory(out, ++phaseStep);
+            if (phaseStep == opts.symbols)
+            {
+                phase = phase_type::TRADING_ACTION;
+                phaseStep = 0;
+            }
+            break;
+        case(phase_type::TRADING_ACTION):
+            length = write_trading_action(out, ++phaseStep);
+            if (phaseStep == opts.symbols)
+            {
+                phase = phase_type::MARKET_OPEN;
+                phaseStep = 0;
+            }
+            break;
+        case(phase_type::MARKET_OPEN):
+            length = write_system_event(out, phaseStep == 0 ? 'S' : 'Q');
+            if (++phaseStep == 2)
+            {
+                phase = opts.messages > 0 ? phase_type::FLOW : phase_type::CLOSE;
+                phaseStep = 0;
+            }
+            break;
+        case(phase_type::FLOW):
+            advance_time();
+            length = next_flow(out);
+            if (++flowMessages == opts.messages)
+                phase = phase_type::CLOSE;
+            break;
+        case(phase_type::CLOSE):
+        {
+            static const char events[] = { 'M', 'E', 'C' };
+            length = write_system_event(out, events[phaseStep]);
+            if (++phaseStep == sizeof(events))
+                phase = phase_type::DONE;
+            break;
+        }
+        case(phase_type::DONE):
+            break;
+    }
+    return length;
+}
+
+uint16_t generator::next_flow(uint8_t* out)
+{
+    uint32_t pick = random_below(totalWeight);
+    if (pick < opts.addWeight || live.empty())
+        return write_add(out);
+    pick -= opts.addWeight;
+    size_t idx = random_below(live.size());
+    live_order& order = live[idx];
+    if (pick < opts.executeWeight)
+    {
+        uint32_t shares = 1 + random_below(order.shares);
+        write_header(out, 'E', order.locate);
+        put64(out + order_executed::ORDER_REFERENCE_NUMBER.offset, order.reference);
+        put32(out + order_executed::EXECUTED_SHARES.offset, shares);
+        put64(out + order_executed::MATCH_NUMBER.offset, nextMatch++);
+        // the market trades toward the order
+        mids[order.locate - 1] = order.price;
+        order.shares -= shares;
+        if (order.shares == 0)
+            remove_live(idx);
+        return ORDER_EXECUTED_LEN;
+    }
+    pick -= opts.executeWeight;
+    if (pick < opts.cancelWeight && order.shares > 1)
+    {
+        uint32_t shares = 1 + random_below(order.shares - 1);
+        write_header(out, 'X', order.locate);
+        put64(out + order_cancel::ORDER_REFERENCE_NUMBER.offset, order.reference);
+        put32(out + order_cancel::CANCELLED_SHARES.offset, shares);
+        order.shares -= shares;
+        return ORDER_CANCEL_LEN;
+    }
+    pick -= opts.cancelWeight;
+    if (pick < opts.replaceWeight)
+    {
+        uint32_t mid = mids[order.locate - 1];
+        uint32_t offset = TICK * (1 + random_below(10));
+        write_header(out, 'U', order.locate);
+        put64(out + order_replace::ORIGINAL_ORDER_REFERENCE_NUMBER.offset, order.reference);
+        order.reference = nextReference++;
+        order.shares = 100 * (1 + random_below(10));
+        order.price = order.side == 'B' ? (mid > offset ? mid - offset : TICK) : mid + offset;
+        put64(out + order_replace::NEW_ORDER_REFERENCE_NUMBER.offset, order.reference);
+        put32(out + order_replace::SHARES.offset, order.shares);
+        put32(out + order_replace::PRICE.offset, order.price);
+        return ORDER_REPLACE_LEN;
+    }
+    // a delete, or a cancel of the last share
+    write_header(out, 'D', order.locate);
+    put64(out + order_delete::ORDER_REFERENCE_NUMBER.offset, order.reference);
+    remove_live(idx);
+    return ORDER_DELETE_LEN;
+}
+
+uint16_t generator::write_add(uint8_t* out)
+{
+    uint16_t locate = 1 + random_below(opts.symbols);
+    uint32_t& mid = mids[locate - 1];
+    // a random walk, a tick at a time
+    uint64_t step = random_below(8);
+    if (step == 0 && mid > TICK * 20)
+        mid -= TICK;
+    else if (step == 1)
+        mid += TICK;
+    live_order order;
+    order.reference = nextReference++;
+    order.locate = locate;
+    order.side = random_below(2) == 0 ? 'B' : 'S';
+    uint32_t offset = TICK * random_below(10);
+    order.price = order.side == 'B' ? (mid > offset + TICK ? mid - offset - TICK : TICK) : mid + offset + TICK;
+    // mostly round lots
+    order.shares = random_below(10) == 0 ? 1 + random_below(99) : 100 * (1 + random_below(10));
+    write_header(out, 'A', locate);
+    put64(out + add_order::ORDER_REFERENCE_NUMBER.offset, order.reference);
+    out[add_order::BUY_SELL_INDICATOR.offset] = order.side;
+    put32(out + add_order::SHARES.offset, order.shares);
+    put_symbol(out + add_order::STOCK.offset, symbols[locate - 1]);
+    put32(out + add_order::PRICE.offset, order.price);
+    live.push_back(order);
+    return ADD_ORDER_LEN;
+}
+
+uint16_t generator::write_system_event(uint8_t* out, char eventCode)
+{
+    timestamp += 1000;
+    write_header(out, 'S', 0);
+    out[system_event::EVENT_CODE.offset] = eventCode;
+    return SYSTEM_EVENT_LEN;
+}
+
+uint16_t generator::write_directory(uint8_t* out, uint16_t locate)
+{
+    write_header(out, 'R', locate);
+    put_symbol(out + stock_directory::STOCK.offset, symbols[locate - 1]);
+    out[stock_directory::MARKET_CATEGORY.offset] = 'Q';
+    out[stock_directory::FINANCIAL_STATUS_INDICATOR.offset] = 'N';
+    put32(out + stock_directory::ROUND_LOT_SIZE.offset, 100);
+    out[stock_directory::ROUND_LOTS_ONLY.offset] = 'N';
+    out[stock_directory::ISSUE_CLASSIFICATION.offset] = 'C';
+    out[stock_directory::ISSUE_SUB_TYPE.offset] = 'Z';
+    out[stock_directory::ISSUE_SUB_TYPE.offset + 1] = ' ';
+    out[stock_directory::AUTHENTICITY.offset] = 'P';
+    out[stock_directory::SHORT_SALE_THRESHOLD_INDICATOR.offset] = 'N';
+    out[stock_directory::IPO_FLAG.offset] = 'N';
+    out[stock_directory::LULDREFERENCE_PRICE_TIER.offset] = '1';
+    out[stock_directory::ETP_FLAG.offset] = 'N';
+    put32(out + stock_directory::ETP_LEVERAGE_FACTOR.offset, 0);
+    out[stock_directory::INVERSE_INDICATOR.offset] = 'N';
+    return STOCK_DIRECTORY_LEN;
+}
+
+uint16_t generator::write_trading_action(uint8_t* out, uint16_t locate)
+{
+    write_header(out, 'H', locate);
+    put_symbol(out + stock_trading_action::STOCK.offset, symbols[locate - 1]);
+    out[stock_trading_action::TRADING_STATE.offset] = 'T';
+    out[stock_trading_action::RESERVED.offset] = ' ';
+    memset(out + stock_trading_action::REASON.offset, ' ', stock_trading_action::REASON.length);
+    return STOCK_TRADING_ACTION_LEN;
+}
+
+void generator::write_header(uint8_t* out, char messageType, uint16_t locate)
+{
+    out[0] = messageType;
+    put16(out + 1, locate);
+    put16(out + 3, 0); // tracking number
+    put48(out + 5, timestamp);
+}
+
+void generator::remove_live(size_t idx)
+{
+    live[idx] = live.back();
+    live.pop_back();
+}
+
+void generator::advance_time()
+{
+    uint64_t gap = opts.meanGapNs;
+    if (burstLeft > 0)
+    {
+        burstLeft--;
+        gap = opts.burstGapNs;
+    }
+    else if (random_below(1000) < opts.burstChance)
+        burstLeft = opts.burstLength;
+    // uniform around the mean, and never standing still
+    timestamp += 1 + (gap > 0 ? random_below(gap * 2) : 0);
+}
+
+uint64_t generator::next_random()
+{
+    // splitmix64
+    uint64_t z = (random += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+} // end namespace itch
@@ -0,0 +1,529 @@
+#include "itch_pcap_file.h"
+#include <stdexcept>
+#include <cstring>
+
+namespace itch
+{
+
+static const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+static const uint32_t PCAP_NANO_MAGIC = 0xa1b23c4d;
+static const uint32_t PCAPNG_SECTION = 0x0a0d0d0a;
+static const uint32_t PCAPNG_BYTE_ORDER = 0x1a2b3c4d;
+static const uint32_t PCAPNG_INTERFACE = 1;
+static const uint32_t PCAPNG_SIMPLE_PACKET = 3;
+static const uint32_t PCAPNG_ENHANCED_PACKET = 6;
+static const uint16_t PCAPNG_TSRESOL = 9;
+static const size_t PCAP_HEADER_LEN = 24;
+static const size_t PCAP_RECORD_LEN = 16;
+
+static const uint16_t LINK_ETHERNET = 1;
+static const uint16_t LINK_RAW = 101;
+static const uint16_t LINK_LINUX_SLL = 113;
+static const uint16_t ETHERTYPE_IPV4 = 0x0800;
+static const uint16_t ETHERTYPE_VLAN = 0x8100;
+static const uint16_t ETHERTYPE_QINQ = 0x88a8;
+
+// out of order TCP data held while waiting for a hole to fill, before giving up on the hole
+static const size_t MAX_PENDING_BYTES = 16 * 1024 * 1024;
+
+// what it takes to pick up the framing of a stream again
+static const int RESYNC_FRAMES = 3;
+static const size_t MAX_FRAME_LEN = 1024;
+static const char SOUP_BIN_TYPES[] = "+ASHZLUROJ";
+
+static uint16_t read_be16(const uint8_t* in) { return (uint16_t)(in[0] << 8 | in[1]); }
+static uint32_t read_be32(const uint8_t* in)
+{
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | in[3];
+}
+
+pcap_file::pcap_file(const std::string& fileName) : file(fileName), data(file.data()), length(file.size())
+{
+    if (length < 4)
+        throw std::invalid_argument("Not a packet capture: " + fileName);
+    uint32_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    if (magic == PCAPNG_SECTION)
+    {
+        fileFormat = format::PCAPNG;
+        return;
+    }
+    if (magic == swap_endian_bytes<uint32_t>(PCAP_MAGIC) || magic == swap_endian_bytes<uint32_t>(PCAP_NANO_MAGIC))
+    {
+        swapped = true;
+        magic = swap_endian_bytes<uint32_t>(magic);
+    }
+    if ((magic != PCAP_MAGIC && magic != PCAP_NANO_MAGIC) || length < PCAP_HEADER_LEN)
+        throw std::invalid_argument("Not a packet capture: " + fileName);
+    nanos = magic == PCAP_NANO_MAGIC;
+    uint32_t network;
+    memcpy(&network, data + 20, sizeof(network));
+    // the top bits can carry FCS information
+    linkType = (swapped ? swap_endian_bytes<uint32_t>(network) : network) & 0xffff;
+}
+
+void pcap_file::start()
+{
+    pos = fileFormat == format::PCAP ? PCAP_HEADER_LEN : 0;
+    streams.clear();
+    moldSessions.clear();
+    lastSession.clear();
+    lastMoldSession = nullptr;
+    interfaces.clear();
+    stats = pcap_stats();
+}
+
+bool pcap_file::next_packet(packet& pkt)
+{
+    return fileFormat == format::PCAP ? next_pcap(pkt) : next_pcapng(pkt);
+}
+
+bool pcap_file::next_pcap(packet& pkt)
+{
+    while(pos + PCAP_RECORD_LEN <= length)
+    {
+        uint32_t header[4];
+        memcpy(header, data + pos, sizeof(header));
+        if (swapped)
+            for(uint32_t& val : header)
+                val = swap_endian_bytes<uint32_t>(val);
+        const uint8_t* frame = data + pos + PCAP_RECORD_LEN;
+        size_t captured = header[2];
+        if (pos + PCAP_RECORD_LEN + captured > length)
+        {
+            // the capture was cut off part way through a packet
+            stats.truncated++;
+            pos = length;
+            return false;
+        }
+        pos += PCAP_RECORD_LEN + captured;
+        stats.packets++;
+        pkt.timestamp = (uint64_t)header[0] * 1000000000 + (uint64_t)header[1] * (nanos ? 1 : 1000);
+        if (decode(frame, captured, linkType, pkt))
+            return true;
+    }
+    return false;
+}
+
+bool pcap_file::next_pcapng(packet& pkt)
+{
+    while(pos + 12 <= length)
+    {
+        uint32_t type;
+        memcpy(&type, data + pos, sizeof(type));
+        if (type == PCAPNG_SECTION)
+        {
+            // every section says which byte order it was written in
+            uint32_t byteOrder;
+            memcpy(&byteOrder, data + pos + 8, sizeof(byteOrder));
+            swapped = byteOrder != PCAPNG_BYTE_ORDER;
+            interfaces.clear();
+        }
+        uint32_t blockLength;
+        memcpy(&blockLength, data + pos + 4, sizeof(blockLength));
+        if (swapped)
+        {
+            type = swap_endian_bytes<uint32_t>(type);
+            blockLength = swap_endian_bytes<uint32_t>(blockLength);
+        }
+        if (blockLength < 12 || blockLength % 4 != 0 || pos + blockLength > length)
+        {
+            stats.truncated++;
+            pos = length;
+            return false;
+        }
+        const uint8_t* body = data + pos + 8;
+        size_t bodyLength = blockLength - 12;
+        pos += blockLength;
+        auto read32 = [this](const uint8_t* in) {
+            uint32_t val;
+            memcpy(&val, in, sizeof(val));
+            return swapped ? swap_endian_bytes<uint32_t>(val) : val;
+        };
+        if (type == PCAPNG_INTERFACE)
+        {
+            read_interface(body, bodyLength);
+        }
+        else if (type == PCAPNG_ENHANCED_PACKET && bodyLength >= 20)
+        {
+            stats.packets++;
+            uint32_t intfId = read32(body);
+            uint64_t timestamp = (uint64_t)read32(body + 4) << 32 | read32(body + 8);
+            size_t captured = read32(body + 12);
+            if (intfId >= interfaces.size() || captured > bodyLength - 20)
+            {
+                stats.truncated++;
+                continue;
+            }
+            pkt.timestamp = to_nanos(interfaces[intfId], timestamp);
+            if (decode(body + 20, captured, interfaces[intfId].linkType, pkt))
+                return true;
+        }
+        else if (type == PCAPNG_SIMPLE_PACKET && bodyLength >= 4)
+        {
+            // no timestamp, and always the first interface
+            stats.packets++;
+            size_t captured = read32(body);
+            if (captured > bodyLength - 4)
+                captured = bodyLength - 4;
+            if (interfaces.empty())
+            {
+                stats.truncated++;
+                continue;
+            }
+            pkt.timestamp = 0;
+            if (decode(body + 4, captured, interfaces[0].linkType, pkt))
+                return true;
+        }
+    }
+    return false;
+}
+
+void pcap_file::read_interface(const uint8_t* body, size_t bodyLength)
+{
+    interface intf;
+    if (bodyLength >= 8)
+    {
+        uint16_t val;
+        memcpy(&val, body, sizeof(val));
+        intf.linkType = swapped ? swap_endian_bytes<uint16_t>(val) : val;
+    }
+    // the options follow the fixed part, each padded to 4 bytes
+    size_t optPos = 8;
+    while(optPos + 4 <= bodyLength)
+    {
+        uint16_t code;
+        uint16_t optLength;
+        memcpy(&code, body + optPos, sizeof(code));
+        memcpy(&optLength, body + optPos + 2, sizeof(optLength));
+        if (swapped)
+        {
+            code = swap_endian_bytes<uint16_t>(code);
+            optLength = swap_endian_bytes<uint16_t>(optLength);
+        }
+        if (code == 0 || optPos + 4 + optLength > bodyLength)
+            break;
+        if (code == PCAPNG_TSRESOL && optLength >= 1)
+        {
+            uint8_t resolution = body[optPos + 4];
+            intf.binary = (resolution & 0x80) != 0;
+            intf.exponent = resolution & 0x7f;
+        }
+        optPos += 4 + (optLength + 3) / 4 * 4;
+    }
+    interfaces.push_back(intf);
+}
+
+uint64_t pcap_file::to_nanos(const interface& intf, uint64_t timestamp) const
+{
+    if (intf.binary)
+    {
+        if (intf.exponent >= 64)
+            return 0;
+        uint64_t mask = (intf.exponent == 0 ? 0 : ((uint64_t)1 << intf.exponent) - 1);
+        return (timestamp >> intf.exponent) * 1000000000
+                + (uint64_t)(((unsigned __int128)(timestamp & mask) * 1000000000) >> intf.exponent);
+    }
+    uint64_t scale = 1;
+    if (intf.exponent <= 9)
+    {
+        for(uint8_t i = intf.exponent; i < 9; ++i)
+            scale *= 10;
+        return timestamp * scale;
+    }
+    for(uint8_t i = 9; i < intf.exponent && i < 28; ++i)
+        scale *= 10;
+    return timestamp / scale;
+}
+
+bool pcap_file::decode(const uint8_t* frame, size_t frameLength, uint16_t link, packet& pkt)
+{
+    size_t offset = 0;
+    uint16_t etherType = 0;
+    switch(link)
+    {
+        case LINK_ETHERNET:
+            if (frameLength < 14)
+            {
+                stats.truncated++;
+                return false;
+            }
+            etherType = read_be16(frame + 12);
+            offset = 14;
+            while(etherType == ETHERTYPE_VLAN || etherType == ETHERTYPE_QINQ)
+            {
+                if (frameLength < offset + 4)
+                {
+                    stats.truncated++;
+                    return false;
+                }
+                etherType = read_be16(frame + offset + 2);
+                offset += 4;
+            }
+            break;
+        case LINK_LINUX_SLL:
+            if (frameLength < 16)
+            {
+                stats.truncated++;
+                return false;
+            }
+            etherType = read_be16(frame + 14);
+            offset = 16;
+            break;
+        case LINK_RAW:
+            etherType = ETHERTYPE_IPV4;
+            break;
+        default:
+            stats.skipped++;
+            return false;
+    }
+    if (etherType != ETHERTYPE_IPV4)
+    {
+        stats.skipped++;
+        return false;
+    }
+    const uint8_t* ip = frame + offset;
+    size_t available = frameLength - offset;
+    if (available < 20 || (ip[0] >> 4) != 4)
+    {
+        stats.truncated++;
+        return false;
+    }
+    size_t headerLength = (ip[0] & 0x0f) * 4;
+    size_t totalLength = read_be16(ip + 2);
+    // anything past the total length is Ethernet padding
+    if (headerLength < 20 || totalLength < headerLength || totalLength > available)
+    {
+        stats.truncated++;
+        return false;
+    }
+    if ((read_be16(ip + 6) & 0x3fff) != 0)
+    {
+        stats.fragments++;
+        return false;
+    }
+    pkt.protocol = ip[9];
+    pkt.source = read_be32(ip + 12);
+    pkt.destination = read_be32(ip + 16);
+    const uint8_t* transport = ip + headerLength;
+    size_t transportLength = totalLength - headerLength;
+    if (pkt.protocol == UDP)
+    {
+        size_t udpLength = transportLength < 8 ? 0 : read_be16(transport + 4);
+        if (transportLength < 8 || udpLength < 8 || udpLength > transportLength)
+        {
+            stats.truncated++;
+            return false;
+        }
+        pkt.data = transport + 8;
+        pkt.length = udpLength - 8;
+    }
+    else if (pkt.protocol == TCP)
+    {
+        size_t dataOffset = transportLength < 20 ? 0 : (transport[12] >> 4) * 4;
+        if (dataOffset < 20 || dataOffset > transportLength)
+        {
+            stats.truncated++;
+            return false;
+        }
+        pkt.seq = read_be32(transport + 4);
+        pkt.flags = transport[13];
+        pkt.data = transport + dataOffset;
+        pkt.length = transportLength - dataOffset;
+    }
+    else
+    {
+        stats.skipped++;
+        return false;
+    }
+    pkt.sourcePort = read_be16(transport);
+    pkt.destinationPort = read_be16(transport + 2);
+    if (!ports.empty())
+    {
+        bool wanted = false;
+        for(uint16_t port : ports)
+            wanted = wanted || port == pkt.sourcePort || port == pkt.destinationPort;
+        if (!wanted)
+        {
+            stats.skipped++;
+            return false;
+        }
+    }
+    if (pkt.protocol == UDP)
+        stats.udp_datagrams++;
+    else
+        stats.tcp_segments++;
+    return true;
+}
+
+pcap_file::tcp_stream* pcap_file::reassemble(const packet& pkt)
+{
+    chunks.clear();
+    released.clear();
+    bool syn = (pkt.flags & TCP_SYN) != 0;
+    flow_key key{pkt.source, pkt.destination, pkt.sourcePort, pkt.destinationPort};
+    auto itr = streams.find(key);
+    if (itr == streams.end())
+    {
+        // a bare ACK says nothing about where the stream is
+        if (pkt.length == 0 && !syn)
+            return nullptr;
+        itr = streams.emplace(key, tcp_stream()).first;
+        itr->second.nextSeq = pkt.seq + (syn ? 1 : 0);
+        // part way through, so the segment may not start with a frame
+        itr->second.synced = syn;
+    }
+    else if (syn)
+    {
+        // the connection was made again
+        itr->second = tcp_stream();
+        itr->second.nextSeq = pkt.seq + 1;
+    }
+    tcp_stream& stream = itr->second;
+    const uint8_t* segment = pkt.data;
+    size_t segmentLength = pkt.length;
+    if (segmentLength == 0)
+        return nullptr;
+    int32_t ahead = (int32_t)(pkt.seq + (syn ? 1 : 0) - stream.nextSeq);
+    if (ahead < 0)
+    {
+        size_t seen = (size_t)(-(int64_t)ahead);
+        if (seen >= segmentLength)
+        {
+            stats.retransmitted += segmentLength;
+            return nullptr;
+        }
+        stats.retransmitted += seen;
+        segment += seen;
+        segmentLength -= seen;
+        ahead = 0;
+    }
+    if (ahead > 0)
+    {
+        stats.out_of_order++;
+        std::vector<uint8_t>& held = stream.pending[stream.nextOffset + ahead];
+        if (held.size() < segmentLength)
+        {
+            stream.pendingBytes += segmentLength - held.size();
+            held.assign(segment, segment + segmentLength);
+        }
+        if (stream.pendingBytes <= MAX_PENDING_BYTES)
+            return nullptr;
+        skip_hole(stream);
+    }
+    else
+    {
+        chunks.push_back({segment, segmentLength});
+        stream.nextOffset += segmentLength;
+        stream.nextSeq += segmentLength;
+    }
+    // the segment may have filled a hole
+    while(!stream.pending.empty() && stream.pending.begin()->first <= stream.nextOffset)
+    {
+        auto first = stream.pending.begin();
+        uint64_t end = first->first + first->second.size();
+        stream.pendingBytes -= first->second.size();
+        if (end > stream.nextOffset)
+        {
+            size_t seen = stream.nextOffset - first->first;
+            stats.retransmitted += seen;
+            released.push_back(std::move(first->second));
+            chunks.push_back({released.back().data() + seen, released.back().size() - seen});
+            stream.nextSeq += end - stream.nextOffset;
+            stream.nextOffset = end;
+        }
+        else
+        {
+            stats.retransmitted += first->second.size();
+        }
+        stream.pending.erase(first);
+    }
+    return chunks.empty() ? nullptr : &stream;
+}
+
+void pcap_file::skip_hole(tcp_stream& stream)
+{
+    stats.tcp_gaps++;
+    uint64_t resume = stream.pending.begin()->first;
+    stream.nextSeq += resume - stream.nextOffset;
+    stream.nextOffset = resume;
+    // whatever was part way through framing is lost, and the next segment can start anywhere
+    stream.stitcher = record_stitcher();
+    stream.synced = false;
+    stream.unsynced.clear();
+}
+
+/***
+ * @returns 1 if there are RESYNC_FRAMES plausible SoupBinTCP headers in a row, 0 if it takes
+ * more bytes to tell, -1 if not
+ */
+static int check_frames(const uint8_t* in, size_t length)
+{
+    size_t pos = 0;
+    for(int i = 0; i < RESYNC_FRAMES; ++i)
+    {
+        if (pos + 3 > length)
+            return 0;
+        size_t frameLength = read_be16(in + pos);
+        if (frameLength == 0 || frameLength > MAX_FRAME_LEN || strchr(SOUP_BIN_TYPES, in[pos + 2]) == nullptr
+                || in[pos + 2] == 0)
+            return -1;
+        if (in[pos + 2] == 'S')
+        {
+            // the payload has to be as long as its ITCH message type says
+            if (pos + 4 > length)
+                return 0;
+            if (frameLength - 1 != itch::get_record_length(in[pos + 3]))
+                return -1;
+        }
+        pos += 2 + frameLength;
+    }
+    return 1;
+}
+
+bool pcap_file::resync(tcp_stream& stream)
+{
+    std::vector<uint8_t>& buf = stream.unsynced;
+    size_t start = 0;
+    int found = -1;
+    for(; start < buf.size(); ++start)
+    {
+        found = check_frames(buf.data() + start, buf.size() - start);
+        if (found >= 0)
+            break;
+    }
+    stats.resync_bytes += start;
+    buf.erase(buf.begin(), buf.begin() + start);
+    if (found <= 0)
+        return false;
+    stream.synced = true;
+    return true;
+}
+
+pcap_file::mold_session& pcap_file::get_mold_session(const char* session)
+{
+    // nearly every packet is from the same session as the last
+    if (lastMoldSession != nullptr && memcmp(lastSession.data(), session, moldudp64::SESSION_LEN) == 0)
+        return *lastMoldSession;
+    lastSession.assign(session, moldudp64::SESSION_LEN);
+    lastMoldSession = &moldSessions[lastSession];
+    return *lastMoldSession;
+}
+
+void pcap_file::finish()
+{
+    for(auto& [key, stream] : streams)
+    {
+        if (!stream.pending.empty())
+            stats.tcp_gaps++;
+    }
+    // only now is it known which holes neither line filled. Late messages may have filled
+    // some of them, so they are not counted again.
+    for(const auto& [name, session] : moldSessions)
+    {
+        uint64_t notDelivered = session.end - session.first - session.delivered;
+        stats.mold_missing += notDelivered > session.late ? notDelivered - session.late : 0;
+    }
+}
+
+} // end namespace itch
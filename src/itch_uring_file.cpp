@@ -0,0 +1,295 @@
+#include "itch_uring_file.h"
+#include <stdexcept>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace itch
+{
+
+// there is no libc wrapper, and liburing is not a dependency
+static int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+uring_file::uring_file(const std::string& fileName, size_t bufferSize, size_t queueDepth, bool direct)
+        : direct(direct), bufferSize((bufferSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT),
+        buffers(queueDepth == 0 ? 1 : queueDepth)
+{
+    if (this->bufferSize == 0)
+        throw std::invalid_argument("Buffer size must be greater than 0");
+    if (direct)
+    {
+        fd = ::open(fileName.c_str(), O_RDONLY | O_DIRECT);
+        // i.e. tmpfs
+        if (fd < 0 && errno == EINVAL)
+            this->direct = false;
+    }
+    if (fd < 0)
+        fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::invalid_argument("Unable to open " + fileName);
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::invalid_argument("Unable to stat " + fileName);
+    }
+    fileSize = st.st_size;
+    for(buffer& buf : buffers)
+    {
+        buf.data = (uint8_t*)aligned_alloc(ALIGNMENT, this->bufferSize);
+        if (buf.data == nullptr)
+        {
+            for(buffer& allocated : buffers)
+                free(allocated.data);
+            ::close(fd);
+            throw std::bad_alloc();
+        }
+    }
+    setup_ring(buffers.size());
+}
+
+uring_file::~uring_file()
+{
+    drain();
+    if (sqesPtr != nullptr)
+        munmap(sqesPtr, sqesSize);
+    if (cqPtr != nullptr && cqPtr != sqPtr)
+        munmap(cqPtr, cqSize);
+    if (sqPtr != nullptr)
+        munmap(sqPtr, sqSize);
+    if (ringFd >= 0)
+        ::close(ringFd);
+    for(buffer& buf : buffers)
+        free(buf.data);
+    if (fd >= 0)
+        ::close(fd);
+}
+
+void uring_file::setup_ring(size_t queueDepth)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringFd = io_uring_setup(queueDepth, &params);
+    if (ringFd < 0)
+        return; // pread it is
+    sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        sqSize = cqSize = sqSize > cqSize ? sqSize : cqSize;
+    sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqPtr == MAP_FAILED)
+        sqPtr = nullptr;
+    if (singleMmap)
+        cqPtr = sqPtr;
+    else if (sqPtr != nullptr)
+    {
+        cqPtr = mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqPtr == MAP_FAILED)
+            cqPtr = nullptr;
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (cqPtr != nullptr)
+    {
+        sqesPtr = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqesPtr == MAP_FAILED)
+            sqesPtr = nullptr;
+    }
+    if (sqesPtr == nullptr)
+    {
+        if (cqPtr != nullptr && cqPtr != sqPtr)
+            munmap(cqPtr, cqSize);
+        if (sqPtr != nullptr)
+            munmap(sqPtr, sqSize);
+        sqPtr = cqPtr = nullptr;
+        ::close(ringFd);
+        ringFd = -1;
+        return;
+    }
+    uint8_t* sq = (uint8_t*)sqPtr;
+    sqTail = (unsigned*)(sq + params.sq_off.tail);
+    sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sqArray = (unsigned*)(sq + params.sq_off.array);
+    uint8_t* cq = (uint8_t*)cqPtr;
+    cqHead = (unsigned*)(cq + params.cq_off.head);
+    cqTail = (unsigned*)(cq + params.cq_off.tail);
+    cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+}
+
+void uring_file::start()
+{
+    nextIdx = 0;
+    for(uint64_t idx = 0; idx < buffers.size(); ++idx)
+        issue(idx);
+}
+
+void uring_file::issue(uint64_t idx)
+{
+    uint64_t offset = idx * bufferSize;
+    if (offset >= fileSize)
+        return;
+    buffer& buf = buffers[idx % buffers.size()];
+    buf.offset = offset;
+    buf.expected = fileSize - offset < bufferSize ? fileSize - offset : bufferSize;
+    buf.filled = 0;
+    if (ringFd >= 0)
+        submit(buf, idx % buffers.size());
+    else
+        read_sync(buf);
+}
+
+void uring_file::submit(buffer& buf, size_t bufIdx)
+{
+    unsigned tail = *sqTail;
+    unsigned slot = tail & *sqMask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*)sqesPtr)[slot];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(buf.data + buf.filled);
+    // O_DIRECT wants whole blocks, the read stops at the end of the file anyway
+    sqe->len = bufferSize - buf.filled;
+    sqe->off = buf.offset + buf.filled;
+    sqe->user_data = bufIdx;
+    sqArray[slot] = slot;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    buf.pending = true;
+    inFlight++;
+    while(io_uring_enter(ringFd, 1, 0, 0) < 0)
+    {
+        if (errno != EINTR && errno != EAGAIN)
+            throw std::runtime_error("io_uring_enter failed");
+    }
+}
+
+void uring_file::read_sync(buffer& buf)
+{
+    while(buf.filled < buf.expected)
+    {
+        ssize_t got = ::pread(fd, buf.data + buf.filled, bufferSize - buf.filled, buf.offset + buf.filled);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            throw std::runtime_error("Unable to read file");
+        if (got == 0)
+            break; // the file got shorter
+        size_t before = buf.filled;
+        buf.filled += got;
+        if (buf.filled < buf.expected && !resume_short_read(buf, before))
+            throw std::runtime_error("Read stopped inside a block");
+    }
+}
+
+bool uring_file::resume_short_read(buffer& buf, size_t before)
+{
+    if (!direct)
+        return true;
+    // O_DIRECT only takes whole blocks, so read the partial one again
+    size_t aligned = buf.filled / ALIGNMENT * ALIGNMENT;
+    if (aligned <= before)
+        return false;
+    buf.filled = aligned;
+    return true;
+}
+
+void uring_file::reap(bool wait)
+{
+    if (wait)
+    {
+        while(io_uring_enter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+        {
+            if (errno != EINTR)
+                throw std::runtime_error("io_uring_enter failed");
+        }
+    }
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    std::exception_ptr error;
+    while(head != tail)
+    {
+        struct io_uring_cqe* cqe = &((struct io_uring_cqe*)cqes)[head & *cqMask];
+        size_t bufIdx = cqe->user_data;
+        int res = cqe->res;
+        buffer& buf = buffers[bufIdx];
+        // the slot is the kernel's again after this
+        head++;
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        buf.pending = false;
+        inFlight--;
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            submit(buf, bufIdx);
+            continue;
+        }
+        if (res < 0)
+        {
+            error = std::make_exception_ptr(std::runtime_error("io_uring read failed: " + std::to_string(-res)));
+            continue;
+        }
+        size_t before = buf.filled;
+        buf.filled += res;
+        // a short read before the end of the file, ask for the rest
+        if (res > 0 && buf.filled < buf.expected)
+        {
+            if (!resume_short_read(buf, before))
+            {
+                error = std::make_exception_ptr(std::runtime_error("io_uring read stopped inside a block"));
+                continue;
+            }
+            submit(buf, bufIdx);
+        }
+        else
+            buf.expected = buf.filled; // res == 0 means the file got shorter
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+const uint8_t* uring_file::next(size_t& length)
+{
+    if (nextIdx * bufferSize >= fileSize)
+        return nullptr;
+    buffer& buf = buffers[nextIdx % buffers.size()];
+    while(buf.pending)
+        reap(true);
+    length = buf.filled;
+    return buf.data;
+}
+
+void uring_file::release()
+{
+    // the buffer is free, put it back to work further along the file
+    issue(nextIdx + buffers.size());
+    nextIdx++;
+}
+
+void uring_file::drain()
+{
+    while(inFlight > 0)
+    {
+        try
+        {
+            reap(true);
+        }
+        catch(...)
+        {
+            // on the way out, only the buffers matter
+        }
+    }
+}
+
+} // end namespace itch
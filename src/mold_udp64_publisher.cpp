@@ -0,0 +1,229 @@
+#include "mold_udp64_publisher.h"
+#include <poll.h>
+#include <stdexcept>
+
+MoldUDP64MessageStore::MoldUDP64MessageStore(const uint8_t* data, size_t length) : data(data)
+{
+    size_t pos = 0;
+    while(pos + moldudp64::MESSAGE_LENGTH_LEN <= length)
+    {
+        uint16_t msgLength = moldudp64::read_big_endian<uint16_t>(&data[pos]);
+        if (pos + moldudp64::MESSAGE_LENGTH_LEN + msgLength > length)
+            break;
+        offsets.push_back(pos);
+        pos += moldudp64::MESSAGE_LENGTH_LEN + msgLength;
+    }
+    offsets.push_back(pos);
+}
+
+MoldUDP64Publisher::MoldUDP64Publisher(const MoldUDP64MessageStore& store, const std::string& sessionName,
+        const std::string& group, uint16_t port, const std::string& interfaceAddress, uint16_t rewindPort,
+        const Options& options)
+        : store(store), options(options), skt(io_context),
+        rewindSkt(io_context, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), rewindPort)),
+        rng(options.seed), buffers(options.batchSize * options.maxPacketLength), iovecs(options.batchSize),
+        msgs(options.batchSize), rewindBuffer(options.maxPacketLength)
+{
+    memset(session, ' ', moldudp64::SESSION_LEN);
+    memcpy(session, sessionName.c_str(), std::min<size_t>(sessionName.size(), moldudp64::SESSION_LEN));
+    skt.open(boost::asio::ip::udp::v4());
+    skt.set_option(boost::asio::ip::multicast::outbound_interface(boost::asio::ip::make_address_v4(interfaceAddress)));
+    skt.set_option(boost::asio::ip::multicast::enable_loopback(true));
+    try
+    {
+        skt.set_option(boost::asio::socket_base::send_buffer_size(8 * 1024 * 1024));
+    }
+    catch(...)
+    {
+    }
+    skt.connect(boost::asio::ip::udp::endpoint(boost::asio::ip::make_address_v4(group), port));
+    for(size_t i = 0; i < options.batchSize; ++i)
+    {
+        iovecs[i].iov_base = &buffers[i * options.maxPacketLength];
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    rewindThread = std::thread(&MoldUDP64Publisher::serve_retransmissions, this);
+}
+
+MoldUDP64Publisher::MoldUDP64Publisher(const MoldUDP64MessageStore& store, const std::string& sessionName,
+        const std::string& group, uint16_t port, const std::string& interfaceAddress, uint16_t rewindPort)
+        : MoldUDP64Publisher(store, sessionName, group, port, interfaceAddress, rewindPort, Options())
+{
+}
+
+MoldUDP64Publisher::~MoldUDP64Publisher()
+{
+    shuttingDown = true;
+    if (rewindThread.joinable())
+        rewindThread.join();
+}
+
+uint64_t MoldUDP64Publisher::publish(uint64_t count)
+{
+    uint64_t published = 0;
+    if (pacedPackets == 0)
+        pacingStart = std::chrono::steady_clock::now();
+    while(published < count && nextSeq <= store.size())
+    {
+        size_t numPackets = 0;
+        while(numPackets < options.batchSize && published < count && nextSeq <= store.size())
+        {
+            uint16_t numMessages = 0;
+            iovecs[numPackets].iov_base = &buffers[numPackets * options.maxPacketLength];
+            iovecs[numPackets].iov_len = build_packet((uint8_t*)iovecs[numPackets].iov_base, nextSeq,
+                    count - published, numMessages);
+            nextSeq += numMessages;
+            published += numMessages;
+            pacedPackets++;
+            if (options.dropRate > 0.0 && chance(rng) < options.dropRate)
+            {
+                // reuse the slot, this one never goes out
+                counters.packets_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            counters.messages_sent.fetch_add(numMessages, std::memory_order_relaxed);
+            numPackets++;
+        }
+        if (options.reorderRate > 0.0)
+        {
+            for(size_t i = 0; i + 1 < numPackets; ++i)
+            {
+                if (chance(rng) < options.reorderRate)
+                {
+                    std::swap(iovecs[i], iovecs[i + 1]);
+                    counters.packets_reordered.fetch_add(1, std::memory_order_relaxed);
+                    ++i;
+                }
+            }
+        }
+        send_batch(numPackets);
+        pace(pacedPackets);
+    }
+    return published;
+}
+
+size_t MoldUDP64Publisher::build_packet(uint8_t* buffer, uint64_t seqNo, uint64_t maxMessages, uint16_t& numMessages)
+{
+    moldudp64::packet_builder builder(buffer, options.maxPacketLength);
+    builder.reset(session, seqNo);
+    uint64_t limit = seqNo + std::min<uint64_t>(maxMessages, options.maxMessagesPerPacket);
+    if (limit > store.size() + 1)
+        limit = store.size() + 1;
+    // take as many whole blocks as fit
+    uint64_t end = seqNo;
+    while(end < limit && moldudp64::HEADER_LEN + store.span(seqNo, end + 1) <= options.maxPacketLength)
+        end++;
+    if (end == seqNo && seqNo < limit)
+        throw std::length_error("Message " + std::to_string(seqNo) + " does not fit in a packet");
+    builder.add_blocks(store.block(seqNo), store.span(seqNo, end), end - seqNo);
+    numMessages = end - seqNo;
+    return builder.length;
+}
+
+void MoldUDP64Publisher::send_batch(size_t numPackets)
+{
+    size_t sent = 0;
+    while(sent < numPackets)
+    {
+        int result = sendmmsg(skt.native_handle(), &msgs[sent], numPackets - sent, 0);
+        if (result < 0)
+        {
+            if (errno == EAGAIN || errno == ENOBUFS || errno == EINTR)
+                continue;
+            // the rest of the batch is lost
+            counters.packets_dropped.fetch_add(numPackets - sent, std::memory_order_relaxed);
+            break;
+        }
+        sent += result;
+    }
+    counters.packets_sent.fetch_add(sent, std::memory_order_relaxed);
+    if (sent > 0)
+        counters.batches.fetch_add(1, std::memory_order_relaxed);
+}
+
+MoldUDP64Publisher::Stats MoldUDP64Publisher::get_stats() const
+{
+    Stats retVal;
+    retVal.batches = counters.batches.load(std::memory_order_relaxed);
+    retVal.packets_sent = counters.packets_sent.load(std::memory_order_relaxed);
+    retVal.messages_sent = counters.messages_sent.load(std::memory_order_relaxed);
+    retVal.packets_dropped = counters.packets_dropped.load(std::memory_order_relaxed);
+    retVal.packets_reordered = counters.packets_reordered.load(std::memory_order_relaxed);
+    retVal.requests = counters.requests.load(std::memory_order_relaxed);
+    retVal.retransmitted_packets = counters.retransmitted_packets.load(std::memory_order_relaxed);
+    return retVal;
+}
+
+void MoldUDP64Publisher::pace(uint64_t packetsSoFar)
+{
+    if (options.packetsPerSecond == 0)
+        return;
+    auto target = pacingStart + std::chrono::nanoseconds(packetsSoFar * 1000000000ull / options.packetsPerSecond);
+    while(true)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= target)
+            return;
+        // sleeping is too coarse for the last stretch, so spin it out
+        if (target - now > std::chrono::microseconds(100))
+            std::this_thread::sleep_for(target - now - std::chrono::microseconds(50));
+    }
+}
+
+void MoldUDP64Publisher::send_heartbeat()
+{
+    uint8_t buffer[moldudp64::HEADER_LEN];
+    moldudp64::packet_builder builder(buffer, moldudp64::HEADER_LEN);
+    builder.reset(session, nextSeq);
+    skt.send(boost::asio::buffer(buffer, builder.length));
+}
+
+void MoldUDP64Publisher::send_end_of_session()
+{
+    uint8_t buffer[moldudp64::HEADER_LEN];
+    moldudp64::packet_builder builder(buffer, moldudp64::HEADER_LEN);
+    builder.reset(session, nextSeq);
+    builder.set_message_count(moldudp64::END_OF_SESSION_COUNT);
+    skt.send(boost::asio::buffer(buffer, builder.length));
+}
+
+void MoldUDP64Publisher::serve_retransmissions()
+{
+    uint8_t request[64];
+    while(!shuttingDown)
+    {
+        struct pollfd pfd;
+        pfd.fd = rewindSkt.native_handle();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (::poll(&pfd, 1, 100) <= 0)
+            continue;
+        boost::asio::ip::udp::endpoint requester;
+        boost::system::error_code ec;
+        size_t length = rewindSkt.receive_from(boost::asio::buffer(request), requester, 0, ec);
+        if (ec || length < moldudp64::REQUEST_LEN)
+            continue;
+        counters.requests.fetch_add(1, std::memory_order_relaxed);
+        moldudp64::request_packet req(request);
+        if (memcmp(req.record, session, moldudp64::SESSION_LEN) != 0)
+            continue;
+        uint64_t seqNo = req.sequence_number();
+        uint64_t published = nextSeq;
+        if (seqNo == 0 || seqNo >= published)
+            continue;
+        // as many packets as it takes, like a rewind server does
+        uint64_t count = std::min<uint64_t>(req.requested_message_count(), published - seqNo);
+        while(count > 0 && !shuttingDown)
+        {
+            uint16_t numMessages = 0;
+            size_t packetLength = build_packet(rewindBuffer.data(), seqNo, count, numMessages);
+            rewindSkt.send_to(boost::asio::buffer(rewindBuffer.data(), packetLength), requester, 0, ec);
+            if (!ec)
+                counters.retransmitted_packets.fetch_add(1, std::memory_order_relaxed);
+            seqNo += numMessages;
+            count -= numMessages;
+        }
+    }
+}
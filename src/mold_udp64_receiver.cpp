@@ -0,0 +1,216 @@
+#include "mold_udp64_receiver.h"
+#include "soup_bin_timer.h"
+#include <poll.h>
+
+MoldUDP64Receiver::MoldUDP64Receiver(const std::string& group, uint16_t port, const std::string& interfaceAddress,
+        const std::string& rewindServer, uint64_t nextSequenceNo, size_t batchSize, size_t bufferSize)
+        : skt(io_context), nextSeq(nextSequenceNo), batchSize(batchSize), bufferSize(bufferSize),
+        buffers(batchSize * bufferSize), iovecs(batchSize), msgs(batchSize)
+{
+    boost::asio::ip::udp::endpoint listenEndpoint(boost::asio::ip::address_v4::any(), port);
+    skt.open(listenEndpoint.protocol());
+    skt.set_option(boost::asio::ip::udp::socket::reuse_address(true));
+    skt.bind(listenEndpoint);
+    skt.set_option(boost::asio::ip::multicast::join_group(boost::asio::ip::make_address_v4(group),
+            boost::asio::ip::make_address_v4(interfaceAddress)));
+    try
+    {
+        // bursts arrive faster than we can drain them, give the kernel room
+        skt.set_option(boost::asio::socket_base::receive_buffer_size(8 * 1024 * 1024));
+    }
+    catch(...)
+    {
+    }
+    if (!rewindServer.empty())
+    {
+        std::string address = rewindServer;
+        std::string rewindPort = "0";
+        size_t pos = address.find(":");
+        if (pos != std::string::npos)
+        {
+            rewindPort = address.substr(pos + 1);
+            address = address.substr(0, pos);
+        }
+        boost::asio::ip::udp::resolver resolver(io_context);
+        rewindEndpoint = *resolver.resolve(boost::asio::ip::udp::v4(), address, rewindPort).begin();
+        hasRewindServer = true;
+    }
+    // point each message header at its slice of the buffer
+    for(size_t i = 0; i < batchSize; ++i)
+    {
+        iovecs[i].iov_base = &buffers[i * bufferSize];
+        iovecs[i].iov_len = bufferSize;
+        memset(&msgs[i], 0, sizeof(struct mmsghdr));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+MoldUDP64Receiver::~MoldUDP64Receiver()
+{
+    stop();
+}
+
+void MoldUDP64Receiver::start()
+{
+    shuttingDown = false;
+    readerThread = std::thread([this]() {
+        while(!shuttingDown)
+            poll(100);
+    });
+}
+
+void MoldUDP64Receiver::stop()
+{
+    shuttingDown = true;
+    if (readerThread.joinable())
+        readerThread.join();
+}
+
+MoldUDP64Receiver::Stats MoldUDP64Receiver::get_stats() const
+{
+    Stats retVal;
+    retVal.batches = counters.batches.load(std::memory_order_relaxed);
+    retVal.packets = counters.packets.load(std::memory_order_relaxed);
+    retVal.messages = counters.messages.load(std::memory_order_relaxed);
+    retVal.heartbeats = counters.heartbeats.load(std::memory_order_relaxed);
+    retVal.duplicates = counters.duplicates.load(std::memory_order_relaxed);
+    retVal.gaps = counters.gaps.load(std::memory_order_relaxed);
+    retVal.missing_messages = counters.missing_messages.load(std::memory_order_relaxed);
+    retVal.requests_sent = counters.requests_sent.load(std::memory_order_relaxed);
+    retVal.truncated = counters.truncated.load(std::memory_order_relaxed);
+    retVal.malformed = counters.malformed.load(std::memory_order_relaxed);
+    retVal.other_session = counters.other_session.load(std::memory_order_relaxed);
+    return retVal;
+}
+
+size_t MoldUDP64Receiver::poll(int timeoutMs)
+{
+    struct pollfd pfd;
+    pfd.fd = skt.native_handle();
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (::poll(&pfd, 1, timeoutMs) <= 0)
+    {
+        // the answer, or the rest of it, never came
+        if (recovering && Timer::get_time() - lastRequestMs >= retransmitTimeoutMs)
+            request_retransmission(nextSeq, highestSeen - nextSeq);
+        return 0;
+    }
+    int received = recvmmsg(skt.native_handle(), msgs.data(), batchSize, MSG_DONTWAIT, nullptr);
+    if (received <= 0)
+        return 0;
+    counters.batches.fetch_add(1, std::memory_order_relaxed);
+    for(int i = 0; i < received; ++i)
+    {
+        if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0)
+        {
+            counters.truncated.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        process_packet((const uint8_t*)iovecs[i].iov_base, msgs[i].msg_len);
+    }
+    return received;
+}
+
+void MoldUDP64Receiver::process_packet(const uint8_t* data, size_t length)
+{
+    moldudp64::packet_view pkt(data, length);
+    if (!pkt.valid())
+    {
+        counters.malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!haveSession)
+    {
+        memcpy(session, pkt.session(), moldudp64::SESSION_LEN);
+        haveSession = true;
+    }
+    else if (memcmp(session, pkt.session(), moldudp64::SESSION_LEN) != 0)
+    {
+        counters.other_session.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    counters.packets.fetch_add(1, std::memory_order_relaxed);
+    if (pkt.is_end_of_session())
+    {
+        on_end_of_session();
+        return;
+    }
+    uint64_t seqNo = pkt.sequence_number();
+    uint16_t count = pkt.message_count();
+    if (count == moldudp64::HEARTBEAT_COUNT)
+        counters.heartbeats.fetch_add(1, std::memory_order_relaxed);
+    uint64_t expected = nextSeq;
+    if (expected == 0)
+        expected = nextSeq = seqNo;
+    if (seqNo > expected)
+    {
+        if (!hasRewindServer)
+        {
+            // nobody to ask, so note it and move on
+            counters.gaps.fetch_add(1, std::memory_order_relaxed);
+            counters.missing_messages.fetch_add(seqNo - expected, std::memory_order_relaxed);
+            on_gap(expected, seqNo - 1);
+            expected = nextSeq = seqNo;
+        }
+        else
+        {
+            if (seqNo + count > highestSeen)
+                highestSeen = seqNo + count;
+            if (!recovering)
+            {
+                recovering = true;
+                counters.gaps.fetch_add(1, std::memory_order_relaxed);
+                counters.missing_messages.fetch_add(seqNo - expected, std::memory_order_relaxed);
+                on_gap(expected, seqNo - 1);
+                request_retransmission(expected, highestSeen - expected);
+            }
+            else if (Timer::get_time() - lastRequestMs >= retransmitTimeoutMs)
+            {
+                request_retransmission(expected, highestSeen - expected);
+            }
+            // everything in this packet will come again with the retransmission
+            return;
+        }
+    }
+    if (seqNo + count <= expected)
+    {
+        if (count != moldudp64::HEARTBEAT_COUNT)
+            counters.duplicates.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint16_t skip = expected - seqNo;
+    uint16_t walked = pkt.for_each_message([this](uint64_t msgSeqNo, const uint8_t* msg, uint16_t msgLength) {
+        if (filter == nullptr || filter->accept(msg, msgLength))
+            on_message(msgSeqNo, msg, msgLength);
+    }, skip);
+    if (walked > skip)
+    {
+        counters.messages.fetch_add(walked - skip, std::memory_order_relaxed);
+        nextSeq = seqNo + walked;
+    }
+    if (walked < count)
+        counters.truncated.fetch_add(1, std::memory_order_relaxed);
+    if (recovering)
+    {
+        if (nextSeq >= highestSeen)
+            recovering = false;
+        else if (nextSeq >= requestedEnd)
+            request_retransmission(nextSeq, highestSeen - nextSeq); // got all we asked for, ask for the rest
+        // otherwise more of the answer is on its way
+    }
+}
+
+void MoldUDP64Receiver::request_retransmission(uint64_t seqNo, uint64_t count)
+{
+    if (count > moldudp64::END_OF_SESSION_COUNT - 1)
+        count = moldudp64::END_OF_SESSION_COUNT - 1;
+    moldudp64::request_packet req(session, seqNo, count);
+    boost::system::error_code ec;
+    skt.send_to(boost::asio::buffer(req.record, moldudp64::REQUEST_LEN), rewindEndpoint, 0, ec);
+    if (!ec)
+        counters.requests_sent.fetch_add(1, std::memory_order_relaxed);
+    requestedEnd = seqNo + count;
+    lastRequestMs = Timer::get_time();
+}
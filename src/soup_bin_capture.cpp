@@ -0,0 +1,248 @@
+#include "soup_bin_capture.h"
+#include <stdexcept>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+// how long the writer sleeps when the ring is empty
+static const auto IDLE_SLEEP = std::chrono::milliseconds(1);
+// a partial block is written out once the ring has been quiet this long
+static const auto PARTIAL_BLOCK_DELAY = std::chrono::milliseconds(500);
+
+SoupBinCapture::SoupBinCapture(const std::string& fileName, size_t ringSize, size_t blockSize,
+        uint64_t preallocate, bool direct)
+        : direct(direct), blockSize((blockSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT), preallocate(preallocate)
+{
+    if (this->blockSize == 0)
+        throw std::invalid_argument("Block size must be greater than 0");
+    // a frame is at most 64k, there must be room for at least one
+    size_t ringCapacity = 128 * 1024;
+    while(ringCapacity < ringSize)
+        ringCapacity <<= 1;
+    ringMask = ringCapacity - 1;
+    if (direct)
+    {
+        fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        // i.e. tmpfs
+        if (fd < 0 && errno == EINVAL)
+            this->direct = false;
+    }
+    if (fd < 0)
+        fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::invalid_argument("Unable to open " + fileName);
+    ring = (uint8_t*)malloc(ringCapacity);
+    block = (uint8_t*)aligned_alloc(ALIGNMENT, this->blockSize);
+    if (ring == nullptr || block == nullptr)
+    {
+        free(ring);
+        free(block);
+        ::close(fd);
+        throw std::bad_alloc();
+    }
+    // touch everything now rather than on the network thread
+    memset(ring, 0, ringCapacity);
+    memset(block, 0, this->blockSize);
+    reserve(this->blockSize);
+    writerThread = std::thread([this]() { run(); });
+}
+
+SoupBinCapture::~SoupBinCapture()
+{
+    try
+    {
+        close();
+    }
+    catch(...)
+    {
+    }
+    free(ring);
+    free(block);
+}
+
+uint64_t SoupBinCapture::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool SoupBinCapture::capture(const uint8_t* frame, size_t length, uint64_t timestamp)
+{
+    if (stopping.load(std::memory_order_relaxed))
+        return false;
+    size_t needed = TIMESTAMP_LEN + length;
+    uint64_t h = head.load(std::memory_order_relaxed);
+    uint64_t t = tail.load(std::memory_order_acquire);
+    if (ringMask + 1 - (h - t) < needed)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint8_t stamp[TIMESTAMP_LEN];
+    memcpy(stamp, &timestamp, TIMESTAMP_LEN);
+    // the record may wrap around the end of the ring
+    const uint8_t* parts[2] = { stamp, frame };
+    size_t partLengths[2] = { TIMESTAMP_LEN, length };
+    uint64_t pos = h;
+    for(int i = 0; i < 2; ++i)
+    {
+        size_t offset = pos & ringMask;
+        size_t first = ringMask + 1 - offset;
+        if (first > partLengths[i])
+            first = partLengths[i];
+        memcpy(ring + offset, parts[i], first);
+        memcpy(ring, parts[i] + first, partLengths[i] - first);
+        pos += partLengths[i];
+    }
+    head.store(pos, std::memory_order_release);
+    captured.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void SoupBinCapture::flush()
+{
+    uint64_t target = head.load(std::memory_order_acquire);
+    uint64_t current = flushTarget.load();
+    while(current < target && !flushTarget.compare_exchange_weak(current, target))
+        ;
+    std::unique_lock<std::mutex> lock(flushMutex);
+    flushCv.wait(lock, [this, target]() { return flushed >= target || closed || error; });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void SoupBinCapture::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        if (closed)
+            return;
+    }
+    stopping = true;
+    if (writerThread.joinable())
+        writerThread.join();
+    {
+        std::lock_guard<std::mutex> lock(flushMutex);
+        closed = true;
+    }
+    flushCv.notify_all();
+    // O_DIRECT leaves the last block padded
+    int ret = ftruncate(fd, blockOffset + blockUsed);
+    ::close(fd);
+    fd = -1;
+    if (error)
+        std::rethrow_exception(error);
+    if (ret != 0)
+        throw std::runtime_error("Unable to truncate capture file");
+}
+
+void SoupBinCapture::run()
+{
+    auto lastMoved = std::chrono::steady_clock::now();
+    try
+    {
+        while(true)
+        {
+            // anything captured before the stop was seen still goes out
+            bool stop = stopping.load();
+            size_t moved = drain();
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            uint64_t target = flushTarget.load();
+            auto current = std::chrono::steady_clock::now();
+            if (moved > 0)
+                lastMoved = current;
+            bool flushing = target > flushed && target <= t;
+            bool quiet = moved == 0 && current - lastMoved >= PARTIAL_BLOCK_DELAY;
+            if (blockDirty && (flushing || quiet || (stop && moved == 0)))
+                write_block();
+            if (flushing)
+            {
+                if (fdatasync(fd) != 0)
+                    throw std::runtime_error("Unable to sync capture file");
+                {
+                    std::lock_guard<std::mutex> lock(flushMutex);
+                    flushed = t;
+                }
+                flushCv.notify_all();
+            }
+            if (stop && moved == 0)
+                break;
+            if (moved == 0)
+                std::this_thread::sleep_for(IDLE_SLEEP);
+        }
+    }
+    catch(...)
+    {
+        {
+            std::lock_guard<std::mutex> lock(flushMutex);
+            error = std::current_exception();
+        }
+        flushCv.notify_all();
+    }
+}
+
+size_t SoupBinCapture::drain()
+{
+    uint64_t h = head.load(std::memory_order_acquire);
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    size_t moved = 0;
+    while(t < h)
+    {
+        size_t offset = t & ringMask;
+        size_t length = h - t;
+        if (length > ringMask + 1 - offset)
+            length = ringMask + 1 - offset;
+        if (length > blockSize - blockUsed)
+            length = blockSize - blockUsed;
+        memcpy(block + blockUsed, ring + offset, length);
+        blockUsed += length;
+        blockDirty = true;
+        t += length;
+        moved += length;
+        // give the space back as soon as it is copied
+        tail.store(t, std::memory_order_release);
+        if (blockUsed == blockSize)
+            write_block();
+    }
+    return moved;
+}
+
+void SoupBinCapture::write_block()
+{
+    size_t length = blockUsed;
+    if (direct)
+    {
+        length = (blockUsed + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        memset(block + blockUsed, 0, length - blockUsed);
+    }
+    reserve(blockOffset + length);
+    size_t done = 0;
+    while(done < length)
+    {
+        ssize_t ret = ::pwrite(fd, block + done, length - done, blockOffset + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            throw std::runtime_error("Unable to write capture file");
+        done += ret;
+    }
+    written = blockOffset + blockUsed;
+    blockDirty = false;
+    if (blockUsed == blockSize)
+    {
+        blockOffset += blockSize;
+        blockUsed = 0;
+    }
+}
+
+void SoupBinCapture::reserve(uint64_t upTo)
+{
+    if (upTo <= reserved || preallocate == 0)
+        return;
+    uint64_t length = (upTo - reserved + preallocate - 1) / preallocate * preallocate;
+    // the file keeps its size, the blocks are just set aside. Not every filesystem can.
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, reserved, length);
+    reserved += length;
+}
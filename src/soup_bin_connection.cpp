@@ -1,43 +1,71 @@
 #include "soup_bin_server.h"
 #include "soupbintcp.h"
+#include "soup_bin_capture.h"
+#include "soup_bin_journal.h"
+#include "itch_latency.h"
 
 SoupBinConnection::SoupBinConnection(boost::asio::ip::tcp::socket inSkt, MessageRepeater* parent)
-        : heartbeatTimer(this, 1000, Timer::get_time()), localIsServer(true), skt(std::move(inSkt)), parent(parent)
+        : localIsServer(true), heartbeatTimer(this, 1000, Timer::get_time()), skt(std::move(inSkt)), parent(parent)
 {
     status = Status::CONNECTED;
+    lastReceiveMs = lastSendMs = Timer::get_time();
     do_read_header();
 }
 
 SoupBinConnection::SoupBinConnection(const std::string& url, const std::string& user, const std::string& pw,
         const std::string& sessionId, uint64_t nextSequenceNo) 
-        : heartbeatTimer(this, 1000, Timer::get_time()), localIsServer(false), skt(io_context), 
-        username(user), password(pw), sessionId(sessionId), nextSeq(nextSequenceNo)
+        : username(user), password(pw), sessionId(sessionId), localIsServer(false), nextSeq(nextSequenceNo),
+        heartbeatTimer(this, 1000, Timer::get_time()), skt(io_context)
 {
-    try
-    {
-        std::string address = url;
-        std::string port = "80";
-        size_t pos = address.find(":");
-        if (pos != std::string::npos)
-        {
-            port = address.substr(pos + 1);
-            address = address.substr(0, pos);
-        }
-        boost::asio::ip::tcp::resolver resolver(io_context);
-        do_connect(resolver.resolve(address, port));
-        readerThread = std::thread([this]() { io_context.run(); });
-    } 
-    catch(const std::exception& e)
+    start(url);
+}
+
+SoupBinConnection::SoupBinConnection(const std::string& url, const std::string& user, const std::string& pw,
+        SoupBinJournal* journal)
+        : username(user), password(pw), sessionId(journal->get_session()), localIsServer(false),
+        nextSeq(journal->get_next_sequence()), heartbeatTimer(this, 1000, Timer::get_time()), skt(io_context),
+        journal(journal)
+{
+    start(url);
+}
+
+void SoupBinConnection::start(const std::string& url)
+{
+    lastReceiveMs = lastSendMs = Timer::get_time();
+    host = url;
+    port = "80";
+    size_t pos = host.find(":");
+    if (pos != std::string::npos)
     {
-        // TODO
+        port = host.substr(pos + 1);
+        host = host.substr(0, pos);
     }
+    requestedSeq = nextSeq;
+}
+
+void SoupBinConnection::connect()
+{
+    if (localIsServer || readerThread.joinable())
+        return;
+    do_resolve();
+    readerThread = std::thread([this]() { io_context.run(); });
 }
 
 SoupBinConnection::~SoupBinConnection()
 {
+    shuttingDown = true;
     try
     {
-        close_socket();
+        if (localIsServer)
+            close_socket();
+        else
+            // everything else on the socket happens on its thread
+            boost::asio::post(io_context, [this]() {
+                reconnectTimer.cancel();
+                resolver.cancel();
+                close_socket();
+                workGuard.reset();
+            });
         if (readerThread.joinable())
             readerThread.join();
     } catch(...) {
@@ -54,12 +82,102 @@ std::string serverOrClient(bool server)
 
 void SoupBinConnection::close_socket()
 {
+    bool wasConnected = status == Status::CONNECTED;
+    sessionUp = false;
     try {
         status = Status::DISCONNECTED;
         if (skt.is_open())
             skt.close();
     } catch (...) {
     }
+    if (localIsServer)
+    {
+        // nothing left to send heartbeats to
+        heartbeatTimer.stop();
+        if (wasConnected && !shuttingDown && parent != nullptr)
+            parent->on_closed(this);
+        return;
+    }
+    if (shuttingDown)
+        return;
+    if (wasConnected)
+        on_disconnected();
+    schedule_reconnect();
+    if (!will_reconnect())
+        drop_pending();
+}
+
+void SoupBinConnection::set_reconnect(uint64_t initialMs, uint64_t maxMs, uint32_t maxAttempts)
+{
+    boost::asio::post(io_context, [this, initialMs, maxMs, maxAttempts]() {
+        reconnectInitialMs = initialMs;
+        reconnectMaxMs = maxMs > initialMs ? maxMs : initialMs;
+        reconnectMaxAttempts = maxAttempts;
+        // the first connect may have failed already
+        if (status == Status::DISCONNECTED)
+            schedule_reconnect();
+        if (!will_reconnect())
+            drop_pending();
+    });
+}
+
+bool SoupBinConnection::will_reconnect() const
+{
+    if (shuttingDown)
+        return false;
+    return reconnectPending || connecting || status == Status::CONNECTED;
+}
+
+void SoupBinConnection::schedule_reconnect()
+{
+    // one chain of attempts at a time
+    if (reconnectInitialMs == 0 || reconnectPending || connecting || shuttingDown)
+        return;
+    if (reconnectMaxAttempts > 0 && reconnectAttempts >= reconnectMaxAttempts)
+        return;
+    uint64_t delay = reconnectInitialMs;
+    for(uint32_t i = 0; i < reconnectAttempts && delay < reconnectMaxMs; ++i)
+        delay *= 2;
+    if (delay > reconnectMaxMs)
+        delay = reconnectMaxMs;
+    reconnectAttempts++;
+    reconnectPending = true;
+    on_reconnecting(reconnectAttempts, delay);
+    reconnectTimer.expires_after(std::chrono::milliseconds(delay));
+    reconnectTimer.async_wait([this](boost::system::error_code ec) {
+        reconnectPending = false;
+        if (ec || shuttingDown)
+            return;
+        // anything still waiting to go out was for the old connection
+        for(const SoupBinFrame& frame : write_msgs)
+        {
+            writeQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+            writeQueueBytes.fetch_sub(frame->size(), std::memory_order_relaxed);
+        }
+        write_msgs.clear();
+        if (loggedIn)
+            requestedSeq = lastSequence + 1;
+        do_resolve();
+    });
+}
+
+void SoupBinConnection::do_resolve()
+{
+    status = Status::CONNECTING;
+    connecting = true;
+    resolver.async_resolve(host, port, [this](boost::system::error_code ec,
+            boost::asio::ip::tcp::resolver::results_type endpoints) {
+        if (!ec)
+            do_connect(endpoints);
+        else
+        {
+            connecting = false;
+            status = Status::DISCONNECTED;
+            schedule_reconnect();
+            if (!will_reconnect())
+                drop_pending();
+        }
+    });
 }
 
 void SoupBinConnection::on_login_request(const soupbintcp::login_request& in)
@@ -76,20 +194,27 @@ void SoupBinConnection::on_login_request(const soupbintcp::login_request& in)
     if (requestedSeqNo != 0)
         resend = true;
     else
-        requestedSeqNo = 1;
+        // nothing is replayed, the client is numbered from what goes out next
+        requestedSeqNo = parent->next_sequence();
     soupbintcp::login_accepted msg;
     msg.set_int(soupbintcp::login_accepted::SEQUENCE_NUMBER, requestedSeqNo);
     msg.set_string(soupbintcp::login_accepted::SESSION, requestedSessionId);
     send(msg.get_record_as_vec());
+    // sequenced data goes out from here on, after the replay of what came before
+    loggedIn = true;
     if (resend)
     {
+        replayFrom = requestedSeqNo;
+        replaying = true;
         parent->repeat_from(this, requestedSeqNo);
+        replaying = false;
     }
 }
 
 void SoupBinConnection::do_connect(const boost::asio::ip::tcp::resolver::results_type& endpoints)
 {
     boost::asio::async_connect(skt, endpoints, [this](boost::system::error_code ec, boost::asio::ip::tcp::endpoint) {
+        connecting = false;
         if (!ec)
         {
             status = Status::CONNECTED;
@@ -97,11 +222,13 @@ void SoupBinConnection::do_connect(const boost::asio::ip::tcp::resolver::results
             soupbintcp::login_request req;
             req.set_string(soupbintcp::login_request::USERNAME, username);
             req.set_string(soupbintcp::login_request::PASSWORD, password);
-            req.set_int(soupbintcp::login_request::REQUESTED_SEQUENCE_NUMBER, nextSeq);
+            req.set_int(soupbintcp::login_request::REQUESTED_SEQUENCE_NUMBER, requestedSeq);
             req.set_string(soupbintcp::login_request::REQUESTED_SESSION, sessionId);
             send(req.get_record_as_vec());
             do_read_header();
         }
+        else
+            close_socket();
     });
 }
 void SoupBinConnection::do_read_header()
@@ -113,6 +240,7 @@ void SoupBinConnection::do_read_header()
                 {
                     if (currentIncoming.decode_header())
                     {
+                        readStart = ITCH_PROBE_TSC();
                         do_read_body();
                     }
                     else
@@ -133,8 +261,13 @@ void SoupBinConnection::do_read_body()
             {
                 if (!ec)
                 {
+                    ITCH_PROBE(itch::latency_stage::SOCKET_READ, readStart);
+                    uint64_t parseStart = ITCH_PROBE_TSC();
                     // if this is a system message, handle it. Otherwise place it in queue
                     if (currentIncoming.decode_header()) {
+                        count_incoming();
+                        if (capture != nullptr)
+                            capture->capture(currentIncoming.data(), currentIncoming.body_length() + 3);
                         switch(currentIncoming.data()[2])
                         {
                             // from server or client
@@ -143,14 +276,48 @@ void SoupBinConnection::do_read_body()
                                 break;
                             // from server
                             case('A'): // login accepted
-                                on_login_accepted(soupbintcp::login_accepted(currentIncoming.data()));
+                            {
+                                soupbintcp::login_accepted accepted(currentIncoming.data());
+                                uint64_t acceptedSeq = accepted.get_int(soupbintcp::login_accepted::SEQUENCE_NUMBER);
+                                uint64_t gap = requestedSeq > 0 && acceptedSeq > requestedSeq ? acceptedSeq - requestedSeq : 0;
+                                sequenceGap += gap;
+                                lastSequence = acceptedSeq > 0 ? acceptedSeq - 1 : 0;
+                                // a reconnect asks for this session
+                                sessionId = accepted.get_string(soupbintcp::login_accepted::SESSION);
+                                if (journal != nullptr)
+                                    journal->start_session(sessionId, acceptedSeq);
+                                if (loggedIn && reconnectAttempts > 0)
+                                    reconnects.fetch_add(1, std::memory_order_relaxed);
+                                loggedIn = true;
+                                sessionUp = true;
+                                reconnectAttempts = 0;
+                                send_pending();
+                                on_login_accepted(accepted);
+                                if (gap > 0)
+                                    on_sequence_gap(requestedSeq, gap);
                                 break;
+                            }
                             case('J'): // login rejected
                                 on_login_rejected(soupbintcp::login_rejected(currentIncoming.data()));
                                 break;
                             case('S'):
-                                on_sequenced_data(soupbintcp::sequenced_data(currentIncoming.data()));
+                            {
+                                uint64_t seq = lastSequence.fetch_add(1, std::memory_order_relaxed) + 1;
+                                // everything goes in the journal, the filter only decides what is dispatched
+                                if (journal != nullptr)
+                                    journal->append(seq, currentIncoming.body(), currentIncoming.body_length());
+                                if (filter == nullptr || filter->accept(currentIncoming.body(), currentIncoming.body_length()))
+                                {
+                                    soupbintcp::sequenced_data data(currentIncoming.data());
+                                    ITCH_PROBE(itch::latency_stage::FRAME_PARSE, parseStart);
+                                    uint64_t dispatchStart = ITCH_PROBE_TSC();
+                                    on_sequenced_data(data);
+                                    ITCH_PROBE(itch::latency_stage::DISPATCH, dispatchStart);
+                                }
+                                else
+                                    on_sequenced_data_filtered();
                                 break;
+                            }
                             case('H'): // heartbeat coming from server
                                 on_server_heartbeat(soupbintcp::server_heartbeat(currentIncoming.data()));
                                 break;
@@ -197,9 +364,48 @@ void SoupBinConnection::send_sequenced(uint64_t seqNo, const std::vector<unsigne
 {
     // add to map
     messages.emplace(seqNo, bytes);
-    soupbintcp::sequenced_data msg;
-    msg.set_message(bytes);
-    send(msg.get_record_as_vec());
+    send_sequenced(seqNo, make_frame('S', bytes));
+}
+
+void SoupBinConnection::send_sequenced(uint64_t seqNo, const SoupBinFrame& frame)
+{
+    boost::asio::dispatch(skt.get_executor(), [this, seqNo, frame]() { queue_sequenced(seqNo, frame); });
+}
+
+void SoupBinConnection::queue_sequenced(uint64_t seqNo, const SoupBinFrame& frame)
+{
+    // nothing before the login, the replay it asks for covers everything up to now
+    if (localIsServer && (status == Status::DISCONNECTED || !loggedIn))
+        return;
+    if (paused || conflated)
+    {
+        writeDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (localIsServer && over_write_limit(frame->size()))
+    {
+        writeLimitHits.fetch_add(1, std::memory_order_relaxed);
+        on_slow_consumer(writeLimit.policy);
+        switch(writeLimit.policy)
+        {
+            case(SoupBinWriteLimit::Policy::DISCONNECT):
+                close_socket();
+                return;
+            case(SoupBinWriteLimit::Policy::CONFLATE):
+                conflate();
+                break;
+            case(SoupBinWriteLimit::Policy::PAUSE_AND_REPLAY):
+                paused = true;
+                pausedFrom = seqNo;
+                break;
+        }
+        writeDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    lastSequence.store(seqNo, std::memory_order_relaxed);
+    if (replaying)
+        replayed.fetch_add(1, std::memory_order_relaxed);
+    queue(frame);
 }
 
 void SoupBinConnection::send_sequenced(const std::vector<unsigned char>& bytes)
@@ -209,19 +415,39 @@ void SoupBinConnection::send_sequenced(const std::vector<unsigned char>& bytes)
 
 void SoupBinConnection::send_unsequenced(const std::vector<unsigned char>& bytes)
 {
-    soupbintcp::unsequenced_data msg;
-    msg.set_message(bytes);
-    send(msg.get_record_as_vec());
+    send(make_frame('U', bytes));
+}
+
+SoupBinFrame SoupBinConnection::make_frame(char type, const std::vector<unsigned char>& payload)
+{
+    auto frame = std::make_shared<std::vector<unsigned char> >(payload.size() + 3);
+    uint16_t length = payload.size() + 1;
+    (*frame)[0] = length >> 8;
+    (*frame)[1] = length & 0xff;
+    (*frame)[2] = type;
+    std::copy(payload.begin(), payload.end(), frame->begin() + 3);
+    return frame;
 }
 
 void SoupBinConnection::do_write()
 {
-    boost::asio::async_write(skt, boost::asio::buffer(write_msgs.front().data(), write_msgs.front().size()),
-            [this](boost::system::error_code ec, std::size_t /* length */) {
+    // the frame may be shared with other connections, so hold on to it until the write is done
+    SoupBinFrame frame = write_msgs.front();
+    boost::asio::async_write(skt, boost::asio::buffer(frame->data(), frame->size()),
+            [this, frame](boost::system::error_code ec, std::size_t /* length */) {
                 if (!ec) {
+                    count_written(*frame);
                     write_msgs.pop_front();
                     if (!write_msgs.empty())
                         do_write();
+                    if (paused)
+                    {
+                        uint64_t bytes = writeQueueBytes.load(std::memory_order_relaxed);
+                        uint64_t depth = writeQueueDepth.load(std::memory_order_relaxed);
+                        if ((writeLimit.maxBytes == 0 || bytes <= writeLimit.maxBytes * writeLimit.resumePercent / 100)
+                                && (writeLimit.maxPackets == 0 || depth <= writeLimit.maxPackets * writeLimit.resumePercent / 100))
+                            resume();
+                    }
                 } else {
                     close_socket();
                 }
@@ -230,22 +456,82 @@ void SoupBinConnection::do_write()
 
 void SoupBinConnection::send(const std::vector<unsigned char>& bytes)
 {
-    if (localIsServer)
+    send(std::make_shared<const std::vector<unsigned char> >(bytes));
+}
+
+void SoupBinConnection::send(const SoupBinFrame& frame)
+{
+    // the write queue is only touched on the socket's thread
+    boost::asio::dispatch(skt.get_executor(), [this, frame]() { queue(frame); });
+}
+
+void SoupBinConnection::queue(const SoupBinFrame& frame)
+{
+    // a client's data waits for the login, so it is not lost to a reconnect
+    if (!localIsServer && (*frame)[2] == 'U' && !sessionUp)
     {
-        bool write_in_progress = !write_msgs.empty();
-        write_msgs.push_back(bytes);
-        if (!write_in_progress)
-            do_write();
+        if (!will_reconnect())
+        {
+            writeDropped.fetch_add(1, std::memory_order_relaxed);
+            on_send_dropped(frame);
+            return;
+        }
+        pending.push_back(frame);
+        count_queued(*frame);
+        return;
     }
-    else
+    // otherwise a client has nowhere to write while it resolves, connects or waits to reconnect,
+    // and a failed write would close the socket out from under the connect
+    if (!localIsServer && status != Status::CONNECTED)
+        return;
+    if (localIsServer)
     {
-        boost::asio::post(io_context, [this, bytes]() {
-            bool write_in_progress = !write_msgs.empty();
-            write_msgs.push_back(bytes);
-            if (!write_in_progress) {
-                do_write();
+        if (status == Status::DISCONNECTED)
+            return;
+        // sequenced data has been through the limit already
+        if ((*frame)[2] != 'S' && over_write_limit(frame->size()))
+        {
+            if (writeLimit.policy == SoupBinWriteLimit::Policy::DISCONNECT)
+            {
+                writeLimitHits.fetch_add(1, std::memory_order_relaxed);
+                on_slow_consumer(writeLimit.policy);
+                close_socket();
             }
-        });
+            else
+                // heartbeats and unsequenced data that do not fit are dropped, see SoupBinWriteLimit
+                writeDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    bool write_in_progress = !write_msgs.empty();
+    write_msgs.push_back(frame);
+    count_queued(*frame);
+    if (!write_in_progress)
+        do_write();
+}
+
+void SoupBinConnection::send_pending()
+{
+    if (pending.empty())
+        return;
+    bool write_in_progress = !write_msgs.empty();
+    // counted when they were kept
+    write_msgs.insert(write_msgs.end(), pending.begin(), pending.end());
+    pending.clear();
+    if (!write_in_progress)
+        do_write();
+}
+
+void SoupBinConnection::drop_pending()
+{
+    while(!pending.empty())
+    {
+        SoupBinFrame frame = pending.front();
+        pending.pop_front();
+        writeQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+        writeQueueBytes.fetch_sub(frame->size(), std::memory_order_relaxed);
+        writeDropped.fetch_add(1, std::memory_order_relaxed);
+        on_send_dropped(frame);
     }
 }
 
@@ -270,3 +556,155 @@ void SoupBinConnection::OnTimer(uint64_t msSince)
         send(hb.get_record_as_vec());
     }
 }
+
+void SoupBinConnection::count_incoming()
+{
+    bytesIn.fetch_add(currentIncoming.body_length() + 3, std::memory_order_relaxed);
+    packetsIn[(uint8_t)currentIncoming.data()[2]].fetch_add(1, std::memory_order_relaxed);
+    lastReceiveMs.store(Timer::get_time(), std::memory_order_relaxed);
+}
+
+void SoupBinConnection::count_queued(const std::vector<unsigned char>& bytes)
+{
+    uint64_t depth = writeQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t queued = writeQueueBytes.fetch_add(bytes.size(), std::memory_order_relaxed) + bytes.size();
+    uint64_t highWater = writeQueueHighWater.load(std::memory_order_relaxed);
+    while(depth > highWater && !writeQueueHighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+        ;
+    highWater = writeQueueBytesHighWater.load(std::memory_order_relaxed);
+    while(queued > highWater && !writeQueueBytesHighWater.compare_exchange_weak(highWater, queued, std::memory_order_relaxed))
+        ;
+}
+
+bool SoupBinConnection::over_write_limit(size_t adding) const
+{
+    uint64_t depth = writeQueueDepth.load(std::memory_order_relaxed);
+    // there is always room for one, so a packet bigger than the limit still goes out
+    if (depth == 0)
+        return false;
+    return (writeLimit.maxBytes > 0 && writeQueueBytes.load(std::memory_order_relaxed) + adding > writeLimit.maxBytes)
+            || (writeLimit.maxPackets > 0 && depth + 1 > writeLimit.maxPackets);
+}
+
+void SoupBinConnection::conflate()
+{
+    conflated = true;
+    // sequenced data that has not started writing is dropped, the front is being written
+    for(auto itr = write_msgs.size() > 1 ? write_msgs.begin() + 1 : write_msgs.end(); itr != write_msgs.end(); )
+    {
+        if ((**itr)[2] != 'S')
+        {
+            ++itr;
+            continue;
+        }
+        writeQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+        writeQueueBytes.fetch_sub((*itr)->size(), std::memory_order_relaxed);
+        writeDropped.fetch_add(1, std::memory_order_relaxed);
+        itr = write_msgs.erase(itr);
+    }
+}
+
+void SoupBinConnection::resume()
+{
+    paused = false;
+    replaying = true;
+    parent->repeat_from(this, pausedFrom);
+    replaying = false;
+}
+
+void SoupBinConnection::count_written(const std::vector<unsigned char>& bytes)
+{
+    writeQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+    writeQueueBytes.fetch_sub(bytes.size(), std::memory_order_relaxed);
+    bytesOut.fetch_add(bytes.size(), std::memory_order_relaxed);
+    if (bytes.size() > 2)
+        packetsOut[bytes[2]].fetch_add(1, std::memory_order_relaxed);
+    lastSendMs.store(Timer::get_time(), std::memory_order_relaxed);
+}
+
+SoupBinStats SoupBinConnection::get_stats() const
+{
+    SoupBinStats retVal;
+    retVal.bytesIn = bytesIn.load(std::memory_order_relaxed);
+    retVal.bytesOut = bytesOut.load(std::memory_order_relaxed);
+    for(int i = 0; i < 256; ++i)
+    {
+        retVal.packetsIn[i] = packetsIn[i].load(std::memory_order_relaxed);
+        retVal.packetsOut[i] = packetsOut[i].load(std::memory_order_relaxed);
+    }
+    retVal.writeQueueDepth = writeQueueDepth.load(std::memory_order_relaxed);
+    retVal.writeQueueBytes = writeQueueBytes.load(std::memory_order_relaxed);
+    retVal.writeQueueHighWater = writeQueueHighWater.load(std::memory_order_relaxed);
+    retVal.writeQueueBytesHighWater = writeQueueBytesHighWater.load(std::memory_order_relaxed);
+    retVal.writeLimitHits = writeLimitHits.load(std::memory_order_relaxed);
+    retVal.writeDropped = writeDropped.load(std::memory_order_relaxed);
+    uint64_t now = Timer::get_time();
+    uint64_t lastReceive = lastReceiveMs.load(std::memory_order_relaxed);
+    uint64_t lastSend = lastSendMs.load(std::memory_order_relaxed);
+    retVal.msSinceReceive = now > lastReceive ? now - lastReceive : 0;
+    retVal.msSinceSend = now > lastSend ? now - lastSend : 0;
+    retVal.lastSequence = lastSequence.load(std::memory_order_relaxed);
+    retVal.sequenceGap = sequenceGap.load(std::memory_order_relaxed);
+    retVal.replayFrom = replayFrom.load(std::memory_order_relaxed);
+    retVal.replayed = replayed.load(std::memory_order_relaxed);
+    retVal.reconnects = reconnects.load(std::memory_order_relaxed);
+    retVal.connections = 1;
+    return retVal;
+}
+
+void SoupBinStats::add(const SoupBinStats& in)
+{
+    bytesIn += in.bytesIn;
+    bytesOut += in.bytesOut;
+    for(int i = 0; i < 256; ++i)
+    {
+        packetsIn[i] += in.packetsIn[i];
+        packetsOut[i] += in.packetsOut[i];
+    }
+    writeQueueDepth = std::max(writeQueueDepth, in.writeQueueDepth);
+    writeQueueBytes = std::max(writeQueueBytes, in.writeQueueBytes);
+    writeQueueHighWater = std::max(writeQueueHighWater, in.writeQueueHighWater);
+    writeQueueBytesHighWater = std::max(writeQueueBytesHighWater, in.writeQueueBytesHighWater);
+    writeLimitHits += in.writeLimitHits;
+    writeDropped += in.writeDropped;
+    msSinceReceive = std::max(msSinceReceive, in.msSinceReceive);
+    msSinceSend = std::max(msSinceSend, in.msSinceSend);
+    lastSequence = std::max(lastSequence, in.lastSequence);
+    sequenceGap += in.sequenceGap;
+    replayFrom = std::max(replayFrom, in.replayFrom);
+    replayed += in.replayed;
+    reconnects += in.reconnects;
+    connections += in.connections;
+}
+
+std::string SoupBinStats::to_text(const std::string& label) const
+{
+    std::stringstream ss;
+    auto line = [&ss, &label](const char* name, uint64_t value) {
+        ss << "soupbin_" << name << "{connection=\"" << label << "\"} " << value << "\n";
+    };
+    line("connections", connections);
+    line("bytes_in", bytesIn);
+    line("bytes_out", bytesOut);
+    for(int i = 0; i < 256; ++i)
+    {
+        if (packetsIn[i] > 0)
+            ss << "soupbin_packets_in{connection=\"" << label << "\",type=\"" << (char)i << "\"} " << packetsIn[i] << "\n";
+        if (packetsOut[i] > 0)
+            ss << "soupbin_packets_out{connection=\"" << label << "\",type=\"" << (char)i << "\"} " << packetsOut[i] << "\n";
+    }
+    line("write_queue_depth", writeQueueDepth);
+    line("write_queue_bytes", writeQueueBytes);
+    line("write_queue_high_water", writeQueueHighWater);
+    line("write_queue_bytes_high_water", writeQueueBytesHighWater);
+    line("write_limit_hits", writeLimitHits);
+    line("write_dropped", writeDropped);
+    line("ms_since_receive", msSinceReceive);
+    line("ms_since_send", msSinceSend);
+    line("last_sequence", lastSequence);
+    line("sequence_gap", sequenceGap);
+    line("replay_from", replayFrom);
+    line("replayed", replayed);
+    line("reconnects", reconnects);
+    return ss.str();
+}
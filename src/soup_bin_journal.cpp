@@ -0,0 +1,193 @@
+#include "soup_bin_journal.h"
+#include <atomic>
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char JOURNAL_MAGIC[8] = { 'S', 'O', 'U', 'P', 'J', 'R', 'N', '1' };
+
+static uint64_t file_size(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        throw std::runtime_error("Unable to stat journal");
+    return st.st_size;
+}
+
+SoupBinJournal::SoupBinJournal(const std::string& fileName, uint64_t initialBytes) : fileName(fileName)
+{
+    dataFd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (dataFd < 0)
+        throw std::invalid_argument("Unable to open " + fileName);
+    indexFd = ::open((fileName + ".idx").c_str(), O_RDWR | O_CREAT, 0644);
+    if (indexFd < 0)
+    {
+        ::close(dataFd);
+        throw std::invalid_argument("Unable to open " + fileName + ".idx");
+    }
+    try
+    {
+        uint64_t indexSize = file_size(indexFd);
+        bool existing = indexSize >= INDEX_HEADER_LEN;
+        map_index(existing ? (indexSize - INDEX_HEADER_LEN) / sizeof(uint64_t)
+                : std::max<uint64_t>(initialBytes / 32, 4096));
+        if (!existing)
+        {
+            memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+            reset("", 0);
+        }
+        else if (memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+            throw std::invalid_argument(fileName + ".idx is not a journal index");
+        map_data(std::max(file_size(dataFd), std::max<uint64_t>(initialBytes, 4096)));
+        if (header->dataEnd > dataSize)
+            throw std::invalid_argument(fileName + " is shorter than its index");
+        if (header->count > indexCapacity)
+            throw std::invalid_argument(fileName + ".idx is shorter than its count");
+        // every entry, and the length in front of it, has to be inside what was written
+        const uint64_t* index = offsets();
+        for(uint64_t i = 0; i < header->count; ++i)
+        {
+            if (index[i] == MISSING)
+                continue;
+            if (index[i] > header->dataEnd || header->dataEnd - index[i] < sizeof(uint16_t))
+                throw std::invalid_argument(fileName + ".idx points past the end of " + fileName);
+            uint16_t length16;
+            memcpy(&length16, data + index[i], sizeof(uint16_t));
+            if (header->dataEnd - index[i] - sizeof(uint16_t) < length16)
+                throw std::invalid_argument(fileName + ".idx points past the end of " + fileName);
+        }
+    }
+    catch(...)
+    {
+        if (header != nullptr)
+            munmap(header, INDEX_HEADER_LEN + indexCapacity * sizeof(uint64_t));
+        if (data != nullptr)
+            munmap(data, dataSize);
+        ::close(dataFd);
+        ::close(indexFd);
+        throw;
+    }
+}
+
+SoupBinJournal::~SoupBinJournal()
+{
+    // the page cache has it all, the kernel writes it out even if we never sync
+    munmap(data, dataSize);
+    munmap(header, INDEX_HEADER_LEN + indexCapacity * sizeof(uint64_t));
+    ::close(dataFd);
+    ::close(indexFd);
+}
+
+void SoupBinJournal::map_data(uint64_t size)
+{
+    if (data != nullptr)
+        munmap(data, dataSize);
+    data = nullptr;
+    if (file_size(dataFd) < size && ftruncate(dataFd, size) != 0)
+        throw std::runtime_error("Unable to grow " + fileName);
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, dataFd, 0);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Unable to map " + fileName);
+    data = (unsigned char*)mapped;
+    dataSize = size;
+}
+
+void SoupBinJournal::map_index(uint64_t entries)
+{
+    if (header != nullptr)
+        munmap(header, INDEX_HEADER_LEN + indexCapacity * sizeof(uint64_t));
+    header = nullptr;
+    uint64_t size = INDEX_HEADER_LEN + entries * sizeof(uint64_t);
+    if (file_size(indexFd) < size && ftruncate(indexFd, size) != 0)
+        throw std::runtime_error("Unable to grow " + fileName + ".idx");
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Unable to map " + fileName + ".idx");
+    header = (index_header*)mapped;
+    indexCapacity = entries;
+}
+
+void SoupBinJournal::reset(const std::string& session, uint64_t firstSequence)
+{
+    memset(header->session, 0, SESSION_LEN);
+    memcpy(header->session, session.data(), std::min(session.size(), SESSION_LEN));
+    header->firstSequence = firstSequence;
+    header->count = 0;
+    header->dataEnd = 0;
+}
+
+std::string SoupBinJournal::get_session() const
+{
+    return std::string(header->session, strnlen(header->session, SESSION_LEN));
+}
+
+void SoupBinJournal::start_session(const std::string& session, uint64_t nextSequence)
+{
+    if (session != get_session())
+        reset(session, nextSequence);
+    else if (header->count == 0)
+        header->firstSequence = nextSequence;
+    // otherwise a gap is filled in by the next append
+}
+
+bool SoupBinJournal::append(uint64_t seq, const unsigned char* in, size_t length)
+{
+    if (header->count == 0 && header->firstSequence == 0)
+        header->firstSequence = seq;
+    uint64_t next = get_next_sequence();
+    if (seq < next)
+        return false;
+    uint64_t entries = header->count + (seq - next) + 1;
+    if (entries > indexCapacity)
+    {
+        uint64_t capacity = indexCapacity * 2;
+        while(capacity < entries)
+            capacity *= 2;
+        map_index(capacity);
+    }
+    uint64_t needed = sizeof(uint16_t) + length;
+    if (header->dataEnd + needed > dataSize)
+    {
+        uint64_t size = dataSize * 2;
+        while(size < header->dataEnd + needed)
+            size *= 2;
+        map_data(size);
+    }
+    uint64_t* index = offsets();
+    for(; next < seq; ++next)
+        index[header->count++] = MISSING;
+    uint16_t length16 = length;
+    memcpy(data + header->dataEnd, &length16, sizeof(uint16_t));
+    memcpy(data + header->dataEnd + sizeof(uint16_t), in, length);
+    index[header->count] = header->dataEnd;
+    // the payload, then the end, then the count, so a crash never leaves an entry without its payload.
+    // The fences keep the compiler from moving the stores into the mapping past the ones after them.
+    std::atomic_signal_fence(std::memory_order_release);
+    header->dataEnd += needed;
+    std::atomic_signal_fence(std::memory_order_release);
+    header->count++;
+    return true;
+}
+
+const unsigned char* SoupBinJournal::get(uint64_t seq, size_t& length) const
+{
+    if (seq < header->firstSequence || seq >= get_next_sequence())
+        return nullptr;
+    uint64_t offset = offsets()[seq - header->firstSequence];
+    if (offset == MISSING)
+        return nullptr;
+    uint16_t length16;
+    memcpy(&length16, data + offset, sizeof(uint16_t));
+    length = length16;
+    return data + offset + sizeof(uint16_t);
+}
+
+void SoupBinJournal::sync()
+{
+    if (msync(data, header->dataEnd > 0 ? header->dataEnd : 1, MS_SYNC) != 0
+            || msync(header, INDEX_HEADER_LEN + header->count * sizeof(uint64_t), MS_SYNC) != 0)
+        throw std::runtime_error("Unable to sync " + fileName);
+}
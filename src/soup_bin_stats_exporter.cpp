@@ -0,0 +1,52 @@
+#include "soup_bin_stats_exporter.h"
+#include <memory>
+#include <stdexcept>
+#include <unistd.h>
+
+SoupBinStatsExporter::SoupBinStatsExporter(const std::string& socketPath, std::function<std::string()> source)
+        : socketPath(socketPath), source(source), acceptor(io_context)
+{
+    ::unlink(socketPath.c_str());
+    try
+    {
+        boost::asio::local::stream_protocol::endpoint endpoint(socketPath);
+        acceptor.open(endpoint.protocol());
+        acceptor.bind(endpoint);
+        acceptor.listen();
+    }
+    catch(const boost::system::system_error& e)
+    {
+        throw std::invalid_argument("Unable to listen on " + socketPath + ": " + e.what());
+    }
+    do_accept();
+    runThread = std::thread([this]() { io_context.run(); });
+}
+
+SoupBinStatsExporter::~SoupBinStatsExporter()
+{
+    io_context.stop();
+    if (runThread.joinable())
+        runThread.join();
+    ::unlink(socketPath.c_str());
+}
+
+void SoupBinStatsExporter::do_accept()
+{
+    acceptor.async_accept([this](boost::system::error_code ec, boost::asio::local::stream_protocol::socket skt) {
+        if (!ec)
+        {
+            auto client = std::make_shared<boost::asio::local::stream_protocol::socket>(std::move(skt));
+            auto text = std::make_shared<std::string>(source());
+            boost::asio::async_write(*client, boost::asio::buffer(*text),
+                    [this, client, text](boost::system::error_code ec, std::size_t) {
+                        if (!ec)
+                            requests++;
+                        boost::system::error_code ignored;
+                        client->shutdown(boost::asio::local::stream_protocol::socket::shutdown_both, ignored);
+                        client->close(ignored);
+                    });
+        }
+        if (acceptor.is_open())
+            do_accept();
+    });
+}
@@ -10,8 +10,18 @@ Timer::Timer(TimerListener* listener, uint64_t msBeforeFire, uint64_t currentTim
 
 Timer::~Timer()
 {
-    shuttingDown = true;
-    if (timerThread.joinable())
+    stop();
+}
+
+void Timer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        shuttingDown = true;
+    }
+    wakeUp.notify_all();
+    // the callback may be the one stopping it
+    if (timerThread.joinable() && timerThread.get_id() != std::this_thread::get_id())
         timerThread.join();
 }
 
@@ -44,7 +54,7 @@ bool Timer::check()
 }
 
 /***
- * blocks until a specific time
+ * blocks until a specific time, or until stop() is called
  * @param specificTime when to return
  */
 void Timer::wait_until(uint64_t specificTime)
@@ -54,7 +64,8 @@ void Timer::wait_until(uint64_t specificTime)
     if (now <= specificTime)
     {
         int64_t waitMs = specificTime - now;
-        std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        std::unique_lock<std::mutex> lock(waitMutex);
+        wakeUp.wait_for(lock, std::chrono::milliseconds(waitMs), [this]() { return shuttingDown.load(); });
     }
 }
 
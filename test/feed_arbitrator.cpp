@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "feed_arbitrator.h"
+#include "mold_udp64_publisher.h"
+#include "itch_file.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+class CountingArbitrator : public FeedArbitrator
+{
+    public:
+    CountingArbitrator(size_t windowSize, uint64_t maxSeqNo, size_t maxLength = 64)
+            : FeedArbitrator(windowSize, maxLength), counts(maxSeqNo + 1) {}
+    virtual void on_message(uint64_t seqNo, const uint8_t* data, size_t length) override
+    {
+        if (inside.fetch_add(1) != 0)
+            overlaps++;
+        counts[seqNo]++;
+        order.push_back(seqNo);
+        // the payload is the sequence number, when there is room for it
+        if (length == sizeof(seqNo) && memcmp(data, &seqNo, sizeof(seqNo)) != 0)
+            corrupt++;
+        inside.fetch_sub(1);
+    }
+    std::vector<std::atomic<uint32_t>> counts;
+    std::vector<uint64_t> order; // only touched by on_message
+    std::atomic<uint32_t> inside = 0;
+    std::atomic<uint32_t> overlaps = 0; // on_message called while another call was running
+    uint32_t corrupt = 0; // payloads that are not the ones sent
+};
+
+} // namespace
+
+TEST(FeedArbitrator, FirstCopyWins)
+{
+    CountingArbitrator arb(8, 100);
+    const uint8_t msg[] = { 'S' };
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 1, msg, 1));
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::B, 1, msg, 1));
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 2, msg, 1));
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::A, 2, msg, 1));
+    // A skips 3 and 4, so 5 waits for B to fill them in
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 5, msg, 1));
+    EXPECT_EQ(arb.get_stats().held, 1);
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 3, msg, 1));
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 4, msg, 1));
+    EXPECT_EQ(arb.get_stats().held, 0);
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::B, 5, msg, 1));
+    // neither line has 6 to 16, and 17 needs the slot 9 has, so 6 to 9 are given up
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 17, msg, 1));
+    EXPECT_EQ(arb.get_stats().lost, 4);
+    EXPECT_EQ(arb.get_stats().held, 1);
+    // too far behind, the slot for 9 already holds 17
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::B, 9, msg, 1));
+    // B comes back past the rest of the hole
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 18, msg, 1));
+
+    for(uint64_t i = 1; i <= 5; ++i)
+        EXPECT_EQ(arb.counts[i], 1);
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4, 5, 17, 18}));
+    auto stats = arb.get_stats();
+    EXPECT_EQ(stats.emitted, 7);
+    EXPECT_EQ(stats.lost, 11);
+    EXPECT_EQ(stats.held, 0);
+    EXPECT_EQ(stats.lines[0].received, 4);
+    EXPECT_EQ(stats.lines[0].wins, 3);
+    EXPECT_EQ(stats.lines[0].duplicates, 1);
+    EXPECT_EQ(stats.lines[0].gaps, 2);
+    EXPECT_EQ(stats.lines[0].missing, 2 + 11);
+    EXPECT_EQ(stats.lines[1].received, 7);
+    EXPECT_EQ(stats.lines[1].wins, 4);
+    EXPECT_EQ(stats.lines[1].duplicates, 2);
+    EXPECT_EQ(stats.lines[1].late, 1);
+    EXPECT_EQ(stats.lines[1].gaps, 2);
+    EXPECT_EQ(stats.lines[1].missing, 3 + 8);
+    EXPECT_DOUBLE_EQ(stats.lines[1].win_rate(), 4.0 / 7);
+}
+
+TEST(FeedArbitrator, GiveUpHoles)
+{
+    CountingArbitrator arb(8, 100);
+    const uint8_t msg[] = { 'S' };
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 1, msg, 1));
+    // B may still have 2
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 3, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1}));
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 2, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3}));
+    // A skips 4 and 5, B only 5
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 6, msg, 1));
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 4, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4}));
+    EXPECT_EQ(arb.get_stats().lost, 0);
+    // both lines are past 5 now
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::B, 6, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4, 6}));
+    EXPECT_EQ(arb.get_stats().lost, 1);
+    // B stops, and A gets a window ahead of the hole at 7, which is given up for its slot
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 10, msg, 1));
+    EXPECT_EQ(arb.get_stats().held, 1);
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 15, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4, 6}));
+    EXPECT_EQ(arb.get_stats().lost, 1 + 1);
+    EXPECT_EQ(arb.get_stats().held, 2);
+    // given up already
+    EXPECT_FALSE(arb.on_line_message(FeedArbitrator::Line::B, 7, msg, 1));
+    EXPECT_EQ(arb.get_stats().lines[1].late, 1);
+    // 19 needs the slot 11 has, so 8, 9 and 11 go, and 10 with them
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::A, 19, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4, 6, 10}));
+    EXPECT_EQ(arb.get_stats().lost, 1 + 1 + 3);
+    // B comes back past the hole before 19
+    EXPECT_TRUE(arb.on_line_message(FeedArbitrator::Line::B, 20, msg, 1));
+    EXPECT_EQ(arb.order, std::vector<uint64_t>({1, 2, 3, 4, 6, 10, 15, 19, 20}));
+    EXPECT_EQ(arb.get_stats().lost, 1 + 3 + 4 + 3);
+    EXPECT_EQ(arb.get_stats().held, 0);
+    EXPECT_EQ(arb.get_stats().emitted, arb.order.size());
+}
+
+TEST(FeedArbitrator, Concurrent)
+{
+    const uint64_t numMessages = 1000000;
+    // the threads run freely, so give them enough room to drift apart
+    CountingArbitrator arb(1 << 20, numMessages, 8);
+    const uint8_t msg[] = { 'S' };
+    auto line = [&arb, &msg, numMessages](FeedArbitrator::Line l, uint64_t skipEvery) {
+        for(uint64_t i = 1; i <= numMessages; ++i)
+            if (i % skipEvery != 0)
+                arb.on_line_message(l, i, msg, 1);
+    };
+    std::thread a(line, FeedArbitrator::Line::A, 7);
+    std::thread b(line, FeedArbitrator::Line::B, 11);
+    a.join();
+    b.join();
+    uint64_t notOnce = 0;
+    for(uint64_t i = 1; i <= numMessages; ++i)
+    {
+        uint32_t expected = (i % 77 == 0) ? 0 : 1;
+        if (arb.counts[i] != expected)
+            notOnce++;
+    }
+    EXPECT_EQ(notOnce, 0);
+    // one stream, in order, one call at a time
+    EXPECT_EQ(arb.overlaps, 0);
+    EXPECT_TRUE(std::is_sorted(arb.order.begin(), arb.order.end()));
+    auto stats = arb.get_stats();
+    EXPECT_EQ(stats.emitted, numMessages - numMessages / 77);
+    EXPECT_EQ(arb.order.size(), stats.emitted);
+    EXPECT_EQ(stats.lost, numMessages / 77);
+    EXPECT_EQ(stats.held, 0);
+    EXPECT_EQ(stats.lines[0].wins + stats.lines[1].wins, stats.emitted);
+    EXPECT_EQ(stats.lines[0].missing, numMessages / 7);
+    EXPECT_EQ(stats.lines[1].missing, numMessages / 11);
+}
+
+TEST(FeedArbitrator, SmallWindow)
+{
+    const uint64_t numMessages = 200000;
+    // the lines drift further apart than the window, so slots are reused and holes given up for them
+    CountingArbitrator arb(64, numMessages, sizeof(uint64_t));
+    auto line = [&arb, numMessages](FeedArbitrator::Line l, uint64_t skipEvery) {
+        for(uint64_t i = 1; i <= numMessages; ++i)
+            if (i % skipEvery != 0)
+                arb.on_line_message(l, i, (const uint8_t*)&i, sizeof(i));
+    };
+    std::thread a(line, FeedArbitrator::Line::A, 5);
+    std::thread b(line, FeedArbitrator::Line::B, 3);
+    a.join();
+    b.join();
+    uint64_t twice = 0;
+    for(uint64_t i = 1; i <= numMessages; ++i)
+        if (arb.counts[i] > 1)
+            twice++;
+    EXPECT_EQ(twice, 0);
+    EXPECT_EQ(arb.overlaps, 0);
+    EXPECT_EQ(arb.corrupt, 0);
+    EXPECT_TRUE(std::is_sorted(arb.order.begin(), arb.order.end()));
+    auto stats = arb.get_stats();
+    EXPECT_EQ(stats.emitted + stats.lost, numMessages);
+    EXPECT_GE(stats.lost, numMessages / 15);
+    EXPECT_EQ(stats.held, 0);
+    EXPECT_EQ(stats.lines[0].wins + stats.lines[1].wins, stats.emitted);
+}
+
+TEST(FeedArbitrator, TwoMoldGroups)
+{
+    const uint64_t numMessages = 1000;
+    std::vector<uint8_t> file;
+    for(uint64_t i = 1; i <= numMessages; ++i)
+    {
+        itch::system_event msg(0, i, i, 'O');
+        size_t pos = file.size();
+        file.resize(pos + itch::RECORD_LENGTH_LEN + msg.get_size());
+        moldudp64::write_big_endian<uint16_t>(&file[pos], msg.get_size());
+        memcpy(&file[pos + itch::RECORD_LENGTH_LEN], msg.get_record(), msg.get_size());
+    }
+    MoldUDP64MessageStore store(file.data(), file.size());
+    MoldUDP64Publisher::Options lossy;
+    lossy.maxMessagesPerPacket = 5;
+    lossy.dropRate = 0.3;
+    lossy.packetsPerSecond = 20000;
+    MoldUDP64Publisher::Options clean = lossy;
+    clean.dropRate = 0.0;
+    MoldUDP64Publisher publisherA(store, "SESSION003", "239.192.10.3", 31212, "127.0.0.1", 0, lossy);
+    MoldUDP64Publisher publisherB(store, "SESSION003", "239.192.10.4", 31213, "127.0.0.1", 0, clean);
+
+    CountingArbitrator arb(4096, numMessages);
+    ArbitratedMoldUDP64Receiver lineA(arb, FeedArbitrator::Line::A, "239.192.10.3", 31212, "127.0.0.1");
+    ArbitratedMoldUDP64Receiver lineB(arb, FeedArbitrator::Line::B, "239.192.10.4", 31213, "127.0.0.1");
+    lineA.start();
+    lineB.start();
+    std::thread pubA([&publisherA]() { publisherA.publish(); });
+    publisherB.publish();
+    pubA.join();
+    for(int i = 0; i < 100 && arb.get_stats().emitted < numMessages; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    lineA.stop();
+    lineB.stop();
+
+    for(uint64_t i = 1; i <= numMessages; ++i)
+        EXPECT_EQ(arb.counts[i], 1);
+    EXPECT_EQ(arb.overlaps, 0);
+    EXPECT_TRUE(std::is_sorted(arb.order.begin(), arb.order.end()));
+    auto stats = arb.get_stats();
+    EXPECT_EQ(stats.emitted, numMessages);
+    EXPECT_GT(stats.lines[0].gaps, 0);
+    EXPECT_EQ(stats.lines[1].gaps, 0);
+    EXPECT_EQ(stats.lines[1].received, numMessages);
+}
@@ -1,4 +1,5 @@
 #include "itch.h"
+#include "itch_file.h"
 #include <gtest/gtest.h>
 #include <sstream>
 #include <fstream>
@@ -27,13 +28,14 @@ TEST(itch, construct)
     msg.set_int(msg.TIMESTAMP, 6);
     msg.set_string(msg.EVENT_CODE, "O");
     const uint8_t* record = msg.get_record();
-    const uint8_t arr[] = { 'S', 0x00, 0x01, 0x00, 0x02, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 'O'};
+    const uint8_t arr[] = { 'S', 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 'O'};
     EXPECT_EQ(arr[0], record[0]);
     EXPECT_EQ(arr[1], record[1]);
     EXPECT_EQ(arr[2], record[2]);
     for(int i = 0; i < 12; ++i)
         EXPECT_EQ(arr[i], record[i]);
     EXPECT_EQ(msg.get_int(msg.STOCK_LOCATE), 1);
+    EXPECT_EQ(msg.get_int(msg.TIMESTAMP), 6);
     EXPECT_EQ(msg.get_string(msg.EVENT_CODE), "O");
     EXPECT_EQ(msg.get_raw_byte(1), 0x00);
     EXPECT_EQ(msg.get_raw_byte(2), 0x01);
@@ -161,4 +163,44 @@ TEST(itch, DISABLED_parseFile)
         std::cout << "Record " << i.first << ": " << i.second << "\n";
     }
     free(buf);
-}
\ No newline at end of file
+}
+TEST(itch, mappedFile)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_mapped_file_test.itch").string();
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        for(int i = 1; i <= 3; ++i)
+        {
+            itch::system_event msg(0, i * 100, i, 'O');
+            uint16_t sz = itch::swap_endian_bytes<uint16_t>(msg.get_size());
+            out.write((const char*)&sz, 2);
+            out.write((const char*)msg.get_record(), msg.get_size());
+        }
+        // a partial record at the end
+        out.write("\0", 1);
+    }
+    itch::mapped_file file(fileName);
+    EXPECT_EQ(file.size(), 3 * (2 + itch::SYSTEM_EVENT_LEN) + 1);
+    std::vector<int64_t> trackingNumbers;
+    size_t consumed = file.for_each([&trackingNumbers](const uint8_t* record, uint16_t length) {
+        EXPECT_EQ(length, itch::SYSTEM_EVENT_LEN);
+        EXPECT_EQ(record[0], 'S');
+        trackingNumbers.push_back(itch::system_event(record).get_int(itch::system_event::TRACKING_NUMBER));
+    });
+    EXPECT_EQ(consumed, 3 * (2 + itch::SYSTEM_EVENT_LEN));
+    std::vector<int64_t> expected{100, 200, 300};
+    EXPECT_EQ(trackingNumbers, expected);
+    std::filesystem::remove(fileName);
+}
+TEST(itch, timestamp)
+{
+    // 6 byte field
+    itch::trade msg;
+    uint64_t ts = 34200000000000ull + 123456789; // 09:30:00.123456789
+    msg.set_int(msg.TIMESTAMP, ts);
+    msg.set_int(msg.TRACKING_NUMBER, 7);
+    EXPECT_EQ(msg.get_int(msg.TIMESTAMP), ts);
+    EXPECT_EQ(itch::get_int(msg.get_record(), msg.TIMESTAMP), ts);
+    EXPECT_EQ(msg.get_int(msg.TRACKING_NUMBER), 7);
+    EXPECT_EQ(msg.get_int(msg.ORDER_REFERENCE_NUMBER), 0);
+}
@@ -0,0 +1,129 @@
+#include "itch_bar_aggregator.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+const uint64_t SECOND = 1000000000ull;
+
+itch::trade make_trade(uint16_t locate, uint64_t timestamp, uint32_t price, uint32_t shares, uint64_t matchNumber)
+{
+    itch::trade msg;
+    msg.set_int(msg.STOCK_LOCATE, locate);
+    msg.set_int(msg.TIMESTAMP, timestamp);
+    msg.set_int(msg.PRICE, price);
+    msg.set_int(msg.SHARES, shares);
+    msg.set_int(msg.MATCH_NUMBER, matchNumber);
+    return msg;
+}
+
+class MyAggregator : public itch::bar_aggregator
+{
+    public:
+    MyAggregator() : itch::bar_aggregator(60 * SECOND) {}
+    std::vector<uint32_t> closed;
+    std::vector<uint32_t> corrected;
+    protected:
+    virtual void on_bar(uint32_t idx) override { closed.push_back(idx); }
+    virtual void on_bar_corrected(uint32_t idx) override { corrected.push_back(idx); }
+};
+
+} // namespace
+
+TEST(itch_bar_aggregator, bars)
+{
+    MyAggregator agg;
+    uint64_t start = 34200 * SECOND; // 9:30
+    EXPECT_TRUE(agg.apply(make_trade(1, start + 1, 100000, 100, 1)));
+    EXPECT_TRUE(agg.apply(make_trade(1, start + 2, 101000, 200, 2)));
+    EXPECT_TRUE(agg.apply(make_trade(2, start + 3, 500000, 10, 3)));
+    EXPECT_TRUE(agg.apply(make_trade(1, start + 4, 99000, 100, 4)));
+    // not printable
+    itch::order_executed_with_price exec;
+    exec.set_int(exec.STOCK_LOCATE, 1);
+    exec.set_int(exec.TIMESTAMP, start + 5);
+    exec.set_int(exec.EXECUTED_SHARES, 1000);
+    exec.set_int(exec.EXECUTION_PRICE, 1);
+    exec.set_string(exec.PRINTABLE, "N");
+    EXPECT_FALSE(agg.apply(exec));
+    EXPECT_EQ(agg.size(), 2);
+    EXPECT_TRUE(agg.closed.empty());
+    uint32_t idx = agg.get_current_bar(1);
+    itch::bar b = agg.get_bar(idx);
+    EXPECT_EQ(b.locate, 1);
+    EXPECT_EQ(b.start, start);
+    EXPECT_EQ(b.open, 100000);
+    EXPECT_EQ(b.high, 101000);
+    EXPECT_EQ(b.low, 99000);
+    EXPECT_EQ(b.close, 99000);
+    EXPECT_EQ(b.volume, 400);
+    EXPECT_EQ(b.trades, 3);
+    EXPECT_DOUBLE_EQ(b.vwap(), (10.0 * 100 + 10.1 * 200 + 9.9 * 100) / 400);
+    EXPECT_EQ(b.vwap_price(), itch::price4(100250));
+    // any message in the next minute closes both bars
+    itch::system_event evt;
+    evt.set_int(evt.TIMESTAMP, start + 60 * SECOND);
+    EXPECT_FALSE(agg.apply(evt));
+    EXPECT_EQ(agg.closed.size(), 2);
+    EXPECT_EQ(agg.get_current_bar(1), itch::bar_aggregator::NO_BAR);
+    // printable executions and crosses count
+    exec.set_int(exec.TIMESTAMP, start + 61 * SECOND);
+    exec.set_string(exec.PRINTABLE, "Y");
+    exec.set_int(exec.MATCH_NUMBER, 5);
+    EXPECT_TRUE(agg.apply(exec));
+    itch::cross_trade cross;
+    cross.set_int(cross.STOCK_LOCATE, 1);
+    cross.set_int(cross.TIMESTAMP, start + 62 * SECOND);
+    cross.set_int(cross.SHARES, 5000000000ull);
+    cross.set_int(cross.CROSS_PRICE, 2);
+    cross.set_int(cross.MATCH_NUMBER, 6);
+    EXPECT_TRUE(agg.apply(cross));
+    b = agg.get_bar(agg.get_current_bar(1));
+    EXPECT_EQ(b.start, start + 60 * SECOND);
+    EXPECT_EQ(b.volume, 5000001000ull);
+    EXPECT_EQ(b.trades, 2);
+    EXPECT_EQ(agg.get_trade_count(1), 5);
+    EXPECT_EQ(agg.get_volume(1), 5000001400ull);
+    EXPECT_EQ(agg.get_tape().size(), 6);
+    agg.flush();
+    EXPECT_EQ(agg.closed.size(), 3);
+}
+
+TEST(itch_bar_aggregator, brokenTrade)
+{
+    MyAggregator agg;
+    uint64_t start = 34200 * SECOND;
+    agg.apply(make_trade(1, start + 1, 100000, 100, 1));
+    agg.apply(make_trade(1, start + 2, 120000, 100, 2)); // the bad print
+    agg.apply(make_trade(1, start + 3, 101000, 100, 3));
+    agg.apply(make_trade(1, start + 61 * SECOND, 102000, 100, 4));
+    ASSERT_EQ(agg.closed.size(), 1);
+    itch::bar b = agg.get_bar(0);
+    EXPECT_EQ(b.high, 120000);
+    EXPECT_EQ(b.volume, 300);
+    // break it after its bar has closed
+    itch::broken_trade brk;
+    brk.set_int(brk.STOCK_LOCATE, 1);
+    brk.set_int(brk.TIMESTAMP, start + 62 * SECOND);
+    brk.set_int(brk.MATCH_NUMBER, 2);
+    EXPECT_TRUE(agg.apply(brk));
+    std::vector<uint32_t> expected{0};
+    EXPECT_EQ(agg.corrected, expected);
+    b = agg.get_bar(0);
+    EXPECT_EQ(b.open, 100000);
+    EXPECT_EQ(b.high, 101000);
+    EXPECT_EQ(b.low, 100000);
+    EXPECT_EQ(b.close, 101000);
+    EXPECT_EQ(b.volume, 200);
+    EXPECT_EQ(b.trades, 2);
+    EXPECT_TRUE(agg.get_tape()[1].broken);
+    EXPECT_EQ(agg.get_volume(1), 300);
+    EXPECT_EQ(agg.get_trade_count(1), 3);
+    EXPECT_DOUBLE_EQ(agg.get_vwap(1), (10.0 + 10.1 + 10.2) / 3);
+    EXPECT_EQ(agg.get_vwap_price(1), itch::price4::from_parts(10, 1000));
+    // unknown, or already broken
+    EXPECT_FALSE(agg.apply(brk));
+    agg.clear();
+    EXPECT_EQ(agg.size(), 0);
+    EXPECT_EQ(agg.get_volume(1), 0);
+}
@@ -0,0 +1,176 @@
+#include "itch_checkpoint.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+
+/***
+ * A day of random adds, executions and deletes across a few instruments
+ */
+std::vector<uint8_t> build_day(size_t count)
+{
+    std::vector<uint8_t> day;
+    for(uint16_t locate = 1; locate <= 4; ++locate)
+    {
+        itch::stock_directory dir;
+        dir.set_int(dir.STOCK_LOCATE, locate);
+        dir.set_string(dir.STOCK, "SYM" + std::to_string(locate));
+        itch_test::append(day, dir);
+    }
+    std::mt19937_64 rng(7);
+    uint64_t nextRef = 1;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if (rng() % 4 != 0)
+        {
+            uint16_t locate = 1 + rng() % 4;
+            char side = rng() % 2 ? 'B' : 'S';
+            uint32_t price = 100000 + (rng() % 20) * 100;
+            itch_test::append(day, itch_test::make_add(nextRef++, locate, side, price, 100));
+        }
+        else
+        {
+            itch::order_executed exec;
+            exec.set_int(exec.ORDER_REFERENCE_NUMBER, 1 + rng() % nextRef);
+            exec.set_int(exec.EXECUTED_SHARES, 50);
+            itch_test::append(day, exec);
+        }
+    }
+    return day;
+}
+
+void expect_same(const itch::order_book& lhs, const itch::order_book& rhs)
+{
+    EXPECT_EQ(lhs.size(), rhs.size());
+    lhs.for_each_order([&rhs](const itch::order& curr) {
+        const itch::order* other = rhs.find(curr.reference);
+        ASSERT_NE(other, nullptr);
+        EXPECT_EQ(curr.priority, other->priority);
+        EXPECT_EQ(curr.price, other->price);
+        EXPECT_EQ(curr.shares, other->shares);
+        EXPECT_EQ(curr.locate, other->locate);
+        EXPECT_EQ(curr.side, other->side);
+    });
+    for(uint16_t locate = 1; locate <= 4; ++locate)
+    {
+        for(char side : {'B', 'S'})
+        {
+            const std::vector<itch::price_level>& l = lhs.get_levels(locate, side);
+            const std::vector<itch::price_level>& r = rhs.get_levels(locate, side);
+            ASSERT_EQ(l.size(), r.size());
+            for(size_t i = 0; i < l.size(); ++i)
+            {
+                EXPECT_EQ(l[i].price, r[i].price);
+                EXPECT_EQ(l[i].shares, r[i].shares);
+                EXPECT_EQ(l[i].orders, r[i].orders);
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(itch_checkpoint, resume)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_checkpoint_test.ckpt").string();
+    std::vector<uint8_t> day = build_day(20000);
+    std::vector<const uint8_t*> records = itch_test::split_day(day);
+    size_t midDay = records.size() / 2;
+    itch::order_book book;
+    itch::instrument_table table;
+    {
+        itch::checkpoint_writer writer(fileName);
+        for(size_t i = 0; i < midDay; ++i)
+        {
+            book.apply(records[i]);
+            table.apply(records[i]);
+        }
+        writer.write(book, table, midDay, midDay + 1, "SESSION001");
+        writer.wait();
+        EXPECT_EQ(writer.get_written(), 1);
+        EXPECT_EQ(writer.get_failures(), 0);
+        // not due yet
+        EXPECT_FALSE(writer.maybe_write(book, table, midDay, midDay + 1));
+    }
+    // a restarted handler picks up from the checkpoint
+    itch::order_book restored(16);
+    itch::instrument_table restoredTable;
+    itch::checkpoint_header header = itch::checkpoint::read(fileName, restored, restoredTable);
+    EXPECT_EQ(header.itch_offset, midDay);
+    EXPECT_EQ(header.sequence_number, midDay + 1);
+    EXPECT_EQ(header.get_session(), "SESSION001");
+    EXPECT_EQ(header.order_count, book.size());
+    expect_same(book, restored);
+    EXPECT_EQ(restoredTable.find("SYM3"), 3);
+    for(size_t i = header.itch_offset; i < records.size(); ++i)
+    {
+        book.apply(records[i]);
+        restored.apply(records[i]);
+    }
+    expect_same(book, restored);
+    std::filesystem::remove(fileName);
+}
+
+TEST(itch_checkpoint, corrupt)
+{
+    itch::order_book book;
+    itch::instrument_table table;
+    std::vector<uint8_t> buffer;
+    itch::checkpoint::serialize(book, table, 0, 1, "", buffer);
+    // nothing left over in the padding, so the same state always gives the same file
+    for(size_t i = offsetof(itch::checkpoint_header, session); i < offsetof(itch::checkpoint_header, order_count); ++i)
+        EXPECT_EQ(buffer[i], 0);
+    EXPECT_NO_THROW(itch::checkpoint::restore(buffer.data(), buffer.size(), book, table));
+    EXPECT_THROW(itch::checkpoint::restore(buffer.data(), buffer.size() - 1, book, table), std::invalid_argument);
+    buffer[0] = 'X';
+    EXPECT_THROW(itch::checkpoint::restore(buffer.data(), buffer.size(), book, table), std::invalid_argument);
+    EXPECT_THROW(itch::checkpoint::restore(buffer.data(), 10, book, table), std::invalid_argument);
+    buffer[0] = 'I';
+    // a count that wraps when multiplied out
+    std::vector<uint8_t> hostile = buffer;
+    uint64_t count = (UINT64_MAX / sizeof(itch::order)) + 2;
+    memcpy(&hostile[offsetof(itch::checkpoint_header, order_count)], &count, sizeof(count));
+    EXPECT_THROW(itch::checkpoint::restore(hostile.data(), hostile.size(), book, table), std::invalid_argument);
+    hostile = buffer;
+    count = (UINT64_MAX / sizeof(itch::checkpoint_level)) + 2;
+    memcpy(&hostile[offsetof(itch::checkpoint_header, level_count)], &count, sizeof(count));
+    EXPECT_THROW(itch::checkpoint::restore(hostile.data(), hostile.size(), book, table), std::invalid_argument);
+}
+
+TEST(itch_checkpoint, reused_buffer)
+{
+    itch::order_book book;
+    itch::instrument_table table;
+    book.apply(itch_test::make_add(1, 1, 'B', 100000, 100));
+    // a buffer left over from an earlier checkpoint
+    std::vector<uint8_t> buffer;
+    itch::checkpoint::serialize(book, table, 0, 1, "", buffer);
+    std::fill(buffer.begin(), buffer.end(), 0xff);
+    itch::checkpoint::serialize(book, table, 0, 1, "", buffer);
+    size_t orderStart = sizeof(itch::checkpoint_header);
+    for(size_t i = offsetof(itch::order, side) + 1; i < sizeof(itch::order); ++i)
+        EXPECT_EQ(buffer[orderStart + i], 0);
+    size_t levelStart = orderStart + sizeof(itch::order);
+    for(size_t i = offsetof(itch::checkpoint_level, side) + 1; i < offsetof(itch::checkpoint_level, price); ++i)
+        EXPECT_EQ(buffer[levelStart + i], 0);
+    size_t instrumentStart = levelStart + sizeof(itch::checkpoint_level);
+    for(size_t i = offsetof(itch::instrument, ipo_quotation_release_qualifier) + 1;
+            i < offsetof(itch::instrument, ipo_quotation_release_time); ++i)
+        EXPECT_EQ(buffer[instrumentStart + i], 0);
+    itch::order_book restored;
+    EXPECT_NO_THROW(itch::checkpoint::restore(buffer.data(), buffer.size(), restored, table));
+    ASSERT_NE(restored.find(1), nullptr);
+    EXPECT_EQ(restored.find(1)->shares, 100);
+    // a side that is neither
+    std::vector<uint8_t> badSide = buffer;
+    badSide[levelStart + offsetof(itch::checkpoint_level, side)] = 'X';
+    EXPECT_THROW(itch::checkpoint::restore(badSide.data(), badSide.size(), restored, table), std::invalid_argument);
+    // and the book is left as it was
+    ASSERT_NE(restored.find(1), nullptr);
+    EXPECT_EQ(restored.find(1)->shares, 100);
+    ASSERT_EQ(restored.get_levels(1, 'B').size(), 1);
+    EXPECT_EQ(restored.get_levels(1, 'B').back().shares, 100);
+}
@@ -0,0 +1,179 @@
+#include "itch_compressed_file.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <zlib.h>
+#ifdef NASDAQ_ITCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef NASDAQ_ITCH_HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+namespace
+{
+
+std::vector<uint8_t> build_day(size_t count)
+{
+    std::vector<uint8_t> day;
+    for(size_t i = 0; i < count; ++i)
+    {
+        itch::add_order msg;
+        msg.set_int(msg.STOCK_LOCATE, i % 100);
+        msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+        itch_test::append(day, msg);
+    }
+    return day;
+}
+
+/***
+ * Write the data as gzip, split into members (the way archives that were appended to look)
+ */
+void write_gzip(const std::string& fileName, const std::vector<uint8_t>& data, size_t members)
+{
+    std::ofstream(fileName, std::ios::binary | std::ios::trunc);
+    size_t per = data.size() / members + 1;
+    for(size_t pos = 0; pos < data.size(); pos += per)
+    {
+        gzFile out = gzopen(fileName.c_str(), "ab");
+        size_t len = std::min(per, data.size() - pos);
+        gzwrite(out, data.data() + pos, len);
+        gzclose(out);
+    }
+}
+
+#ifdef NASDAQ_ITCH_HAVE_ZSTD
+/***
+ * Write the data as zstd, one frame per member
+ */
+void write_zstd(const std::string& fileName, const std::vector<uint8_t>& data, size_t members)
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    size_t per = data.size() / members + 1;
+    for(size_t pos = 0; pos < data.size(); pos += per)
+    {
+        size_t len = std::min(per, data.size() - pos);
+        std::vector<uint8_t> frame(ZSTD_compressBound(len));
+        size_t frameLen = ZSTD_compress(frame.data(), frame.size(), data.data() + pos, len, 3);
+        ASSERT_FALSE(ZSTD_isError(frameLen));
+        out.write((const char*)frame.data(), frameLen);
+    }
+}
+#endif
+
+#ifdef NASDAQ_ITCH_HAVE_LZ4
+/***
+ * Write the data as lz4, one frame per member
+ */
+void write_lz4(const std::string& fileName, const std::vector<uint8_t>& data, size_t members)
+{
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    size_t per = data.size() / members + 1;
+    for(size_t pos = 0; pos < data.size(); pos += per)
+    {
+        size_t len = std::min(per, data.size() - pos);
+        std::vector<uint8_t> frame(LZ4F_compressFrameBound(len, nullptr));
+        size_t frameLen = LZ4F_compressFrame(frame.data(), frame.size(), data.data() + pos, len, nullptr);
+        ASSERT_FALSE(LZ4F_isError(frameLen));
+        out.write((const char*)frame.data(), frameLen);
+    }
+}
+#endif
+
+/***
+ * Read the file back with a few chunk sizes, checking every record of the day is there in order,
+ * and that it can only be read once. Small chunks, so plenty of records straddle two of them.
+ */
+void expect_round_trip(const std::string& fileName, itch::compressed_file::format fmt, const std::vector<uint8_t>& day,
+        uint64_t count)
+{
+    for(size_t chunkSize : {7, 1000, 4 * 1024 * 1024})
+    {
+        itch::compressed_file file(fileName, itch::compressed_file::format::AUTO, chunkSize, 3);
+        EXPECT_EQ(file.get_format(), fmt);
+        uint64_t expectedRef = 0;
+        size_t bad = 0;
+        size_t consumed = file.for_each([&](const uint8_t* record, uint16_t length) {
+            if (length != itch::ADD_ORDER_LEN
+                    || itch::get_int(record, itch::add_order::ORDER_REFERENCE_NUMBER) != expectedRef)
+                bad++;
+            expectedRef++;
+        });
+        EXPECT_EQ(bad, 0);
+        EXPECT_EQ(expectedRef, count);
+        EXPECT_EQ(consumed, day.size());
+        EXPECT_EQ(file.get_decompressed_size(), day.size());
+        EXPECT_THROW(file.for_each([](const uint8_t*, uint16_t) {}), std::logic_error);
+    }
+}
+
+} // namespace
+
+TEST(itch_compressed_file, gzip)
+{
+    std::vector<uint8_t> day = build_day(20000);
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_compressed_file_test.itch.gz").string();
+    write_gzip(fileName, day, 3);
+    expect_round_trip(fileName, itch::compressed_file::format::GZIP, day, 20000);
+    // a truncated archive is an error, after everything that could be read
+    std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 10);
+    itch::compressed_file truncated(fileName);
+    size_t records = 0;
+    EXPECT_THROW(truncated.for_each([&records](const uint8_t*, uint16_t) { records++; }), std::runtime_error);
+    EXPECT_GT(records, 0);
+    std::filesystem::remove(fileName);
+}
+
+TEST(itch_compressed_file, uncompressedAndEarlyExit)
+{
+    std::vector<uint8_t> day = build_day(1000);
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_compressed_file_test.itch").string();
+    {
+        std::ofstream out(fileName, std::ios::binary);
+        out.write((const char*)day.data(), day.size());
+    }
+    itch::compressed_file file(fileName, itch::compressed_file::format::AUTO, 100);
+    EXPECT_EQ(file.get_format(), itch::compressed_file::format::NONE);
+    size_t records = 0;
+    EXPECT_EQ(file.for_each([&records](const uint8_t*, uint16_t) { records++; }), day.size());
+    EXPECT_EQ(records, 1000);
+    // the reader throwing stops the decompression thread
+    itch::compressed_file again(fileName, itch::compressed_file::format::NONE, 100);
+    records = 0;
+    EXPECT_THROW(again.for_each([&records](const uint8_t*, uint16_t) {
+        if (++records == 10)
+            throw std::runtime_error("stop");
+    }), std::runtime_error);
+    EXPECT_EQ(records, 10);
+    std::filesystem::remove(fileName);
+    EXPECT_THROW(itch::compressed_file("/does/not/exist.gz"), std::invalid_argument);
+}
+
+#ifdef NASDAQ_ITCH_HAVE_ZSTD
+TEST(itch_compressed_file, zstd)
+{
+    std::vector<uint8_t> day = build_day(20000);
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_compressed_file_test.itch.zst").string();
+    write_zstd(fileName, day, 3);
+    expect_round_trip(fileName, itch::compressed_file::format::ZSTD, day, 20000);
+    std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 10);
+    itch::compressed_file truncated(fileName);
+    EXPECT_THROW(truncated.for_each([](const uint8_t*, uint16_t) {}), std::runtime_error);
+    std::filesystem::remove(fileName);
+}
+#endif
+
+#ifdef NASDAQ_ITCH_HAVE_LZ4
+TEST(itch_compressed_file, lz4)
+{
+    std::vector<uint8_t> day = build_day(20000);
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_compressed_file_test.itch.lz4").string();
+    write_lz4(fileName, day, 3);
+    expect_round_trip(fileName, itch::compressed_file::format::LZ4, day, 20000);
+    std::filesystem::resize_file(fileName, std::filesystem::file_size(fileName) - 10);
+    itch::compressed_file truncated(fileName);
+    EXPECT_THROW(truncated.for_each([](const uint8_t*, uint16_t) {}), std::runtime_error);
+    std::filesystem::remove(fileName);
+}
+#endif
@@ -0,0 +1,122 @@
+#include "itch_depth_conflator.h"
+#include "itch_generator.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <map>
+
+namespace
+{
+
+struct test_server
+{
+    std::vector<std::vector<unsigned char>> sent;
+    void send_sequenced(const std::vector<unsigned char>& bytes) { sent.push_back(bytes); }
+};
+
+} // namespace
+
+TEST(itch_depth_conflator, coalesce)
+{
+    itch::order_book book;
+    itch::depth_conflator conflator(book, 2, 1000);
+    // many updates to one instrument, one to another
+    for(uint32_t i = 0; i < 10; ++i)
+    {
+        EXPECT_TRUE(conflator.apply(itch_test::make_add(i + 1, 1, 'B', 100000 - (i % 3) * 100, 100, i + 1)));
+        EXPECT_TRUE(conflator.apply(itch_test::make_add(i + 101, 1, 'S', 100100 + (i % 3) * 100, 200, i + 1)));
+    }
+    EXPECT_TRUE(conflator.apply(itch_test::make_add(1000, 2, 'S', 50000, 10, 50)));
+    EXPECT_EQ(conflator.get_dirty_count(), 2);
+    EXPECT_TRUE(conflator.is_dirty(1));
+    EXPECT_FALSE(conflator.is_dirty(3));
+
+    std::vector<itch::depth_snapshot> snapshots;
+    auto keep = [&snapshots](const itch::depth_snapshot& in) { snapshots.push_back(in); };
+    EXPECT_EQ(conflator.poll(1000, keep), 2);
+    ASSERT_EQ(snapshots.size(), 2);
+    EXPECT_EQ(snapshots[0].locate, 1);
+    // each instrument has the time of its own last change
+    EXPECT_EQ(snapshots[0].timestamp, 10);
+    EXPECT_EQ(snapshots[1].timestamp, 50);
+    // best first, and only 2 of the 3 levels
+    ASSERT_EQ(snapshots[0].bids.size(), 2);
+    EXPECT_EQ(snapshots[0].bids[0].price, 100000);
+    EXPECT_EQ(snapshots[0].bids[0].orders, 4);
+    EXPECT_EQ(snapshots[0].bids[0].shares, 400);
+    EXPECT_EQ(snapshots[0].bids[1].price, 99900);
+    ASSERT_EQ(snapshots[0].asks.size(), 2);
+    EXPECT_EQ(snapshots[0].asks[0].price, 100100);
+    EXPECT_EQ(snapshots[0].asks[1].price, 100200);
+    EXPECT_EQ(snapshots[1].locate, 2);
+    EXPECT_TRUE(snapshots[1].bids.empty());
+    ASSERT_EQ(snapshots[1].asks.size(), 1);
+    EXPECT_EQ(conflator.get_dirty_count(), 0);
+
+    // nothing changed, and then not yet time
+    EXPECT_EQ(conflator.publish(keep), 0);
+    EXPECT_TRUE(conflator.apply(itch_test::make_add(1001, 2, 'B', 49000, 10)));
+    EXPECT_EQ(conflator.poll(1500, keep), 0);
+    EXPECT_EQ(conflator.get_dirty_count(), 1);
+    EXPECT_EQ(conflator.poll(2000, keep), 1);
+    EXPECT_EQ(snapshots.size(), 3);
+
+    // a message for an order that is not there does not mark anything
+    itch::order_delete del;
+    del.set_int(del.ORDER_REFERENCE_NUMBER, 5000);
+    EXPECT_FALSE(conflator.apply(del));
+    EXPECT_EQ(conflator.get_dirty_count(), 0);
+}
+
+TEST(itch_depth_conflator, publish)
+{
+    itch::generator::options opts;
+    opts.symbols = 20;
+    opts.messages = 20000;
+    itch::generator gen(opts);
+    itch::order_book book;
+    itch::depth_conflator conflator(book, 5);
+    test_server server;
+    size_t records = 0;
+    size_t changes = 0;
+    size_t published = 0;
+    gen.for_each([&](const uint8_t* record, uint16_t length) {
+        if (conflator.apply(record))
+            changes++;
+        if (++records % 1000 == 0)
+            published += conflator.publish_to(server);
+    });
+    published += conflator.publish_to(server);
+    // at most one snapshot per instrument each time
+    EXPECT_EQ(server.sent.size(), published);
+    EXPECT_LE(published, (records / 1000 + 1) * opts.symbols);
+    EXPECT_GT(published, 0);
+    EXPECT_LT(published, changes / 10);
+
+    // the last one for each instrument matches the book
+    std::map<uint16_t, itch::depth_snapshot> last;
+    for(const std::vector<unsigned char>& bytes : server.sent)
+    {
+        itch::depth_snapshot snapshot;
+        ASSERT_TRUE(itch::depth_conflator::decode(bytes.data(), bytes.size(), snapshot));
+        last[snapshot.locate] = snapshot;
+    }
+    for(const auto& entry : last)
+    {
+        const std::vector<itch::price_level>& bids = book.get_levels(entry.first, 'B');
+        ASSERT_EQ(entry.second.bids.size(), std::min<size_t>(bids.size(), 5));
+        for(size_t i = 0; i < entry.second.bids.size(); ++i)
+        {
+            const itch::price_level& lvl = bids[bids.size() - 1 - i];
+            EXPECT_EQ(entry.second.bids[i].price, lvl.price);
+            EXPECT_EQ(entry.second.bids[i].shares, lvl.shares);
+            EXPECT_EQ(entry.second.bids[i].orders, lvl.orders);
+        }
+        const std::vector<itch::price_level>& asks = book.get_levels(entry.first, 'S');
+        ASSERT_EQ(entry.second.asks.size(), std::min<size_t>(asks.size(), 5));
+        if (!asks.empty())
+        {
+            EXPECT_EQ(entry.second.asks[0].price, asks.back().price);
+        }
+    }
+    EXPECT_FALSE(itch::depth_conflator::decode(server.sent[0].data(), server.sent[0].size() - 1, last[0]));
+}
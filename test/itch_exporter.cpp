@@ -0,0 +1,114 @@
+#include "itch_exporter.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+
+namespace
+{
+
+std::vector<uint8_t> build_day(size_t count)
+{
+    std::vector<uint8_t> day;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if (i % 3 == 0)
+        {
+            itch::add_order msg;
+            msg.set_int(msg.STOCK_LOCATE, 1 + i % 10);
+            msg.set_int(msg.TIMESTAMP, i);
+            msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+            msg.set_string(msg.BUY_SELL_INDICATOR, i % 2 ? "B" : "S");
+            msg.set_int(msg.SHARES, 100);
+            msg.set_string(msg.STOCK, "MSFT    ");
+            msg.set_price(msg.PRICE, itch::price4(i));
+            itch_test::append(day, msg);
+        }
+        else
+        {
+            itch::order_delete msg;
+            msg.set_int(msg.STOCK_LOCATE, 1 + i % 10);
+            msg.set_int(msg.TIMESTAMP, i);
+            msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+            itch_test::append(day, msg);
+        }
+    }
+    return day;
+}
+
+} // namespace
+
+TEST(itch_exporter, formatRecords)
+{
+    itch::add_order order;
+    order.set_int(order.STOCK_LOCATE, 1);
+    order.set_int(order.TRACKING_NUMBER, 2);
+    order.set_int(order.TIMESTAMP, 34200000000123ull);
+    order.set_int(order.ORDER_REFERENCE_NUMBER, 42);
+    order.set_string(order.BUY_SELL_INDICATOR, "B");
+    order.set_int(order.SHARES, 100);
+    order.set_string(order.STOCK, "AAPL    ");
+    order.set_price(order.PRICE, itch::price4::from_parts(101, 2500));
+
+    char buf[itch::exporter::MAX_LINE];
+    itch::exporter csv;
+    size_t length = csv.format_record(order.get_record(), order.get_size(), buf);
+    EXPECT_EQ(std::string(buf, length), "A,1,2,34200000000123,42,B,100,AAPL,101.2500\n");
+    EXPECT_EQ(csv.get_header('A'),
+            "message_type,stock_locate,tracking_number,timestamp,order_reference_number,buy_sell_indicator,shares,stock,price");
+    EXPECT_EQ(csv.get_header('z'), "");
+
+    itch::exporter json(itch::exporter::format::JSON);
+    length = json.format_record(order.get_record(), order.get_size(), buf);
+    EXPECT_EQ(std::string(buf, length), "{\"message_type\":\"A\",\"stock_locate\":1,\"tracking_number\":2,"
+            "\"timestamp\":34200000000123,\"order_reference_number\":42,\"buy_sell_indicator\":\"B\",\"shares\":100,"
+            "\"stock\":\"AAPL\",\"price\":101.2500}\n");
+
+    // MWCB levels are Price(8)
+    itch::mwcp_decline_level mwcb;
+    mwcb.set_price(mwcb.LEVEL_1, itch::price8::from_parts(3500, 12345678));
+    length = csv.format_record(mwcb.get_record(), mwcb.get_size(), buf);
+    EXPECT_EQ(std::string(buf, length), "V,0,0,0,3500.12345678,0.00000000,0.00000000\n");
+
+    // text that needs quoting
+    itch::stock_directory dir;
+    dir.set_string(dir.STOCK, "A,B\"C");
+    length = csv.format_record(dir.get_record(), dir.get_size(), buf);
+    EXPECT_EQ(std::string(buf, length).substr(0, 20), "R,0,0,0,\"A,B\"\"C\",,,0");
+    length = json.format_record(dir.get_record(), dir.get_size(), buf);
+    EXPECT_NE(std::string(buf, length).find("\"stock\":\"A,B\\\"C\""), std::string::npos);
+
+    // not selected, unknown, or too short
+    csv.select("D");
+    EXPECT_EQ(csv.format_record(order.get_record(), order.get_size(), buf), 0);
+    uint8_t unknown[] = {'z', 0, 0};
+    EXPECT_EQ(json.format_record(unknown, sizeof(unknown), buf), 0);
+    EXPECT_EQ(json.format_record(order.get_record(), 20, buf), 0);
+}
+
+TEST(itch_exporter, parallelMatchesSerial)
+{
+    std::string fileName = itch_test::write_day("itch_exporter_test.itch", build_day(60000));
+    std::string serialName = fileName + ".serial.csv";
+    std::string parallelName = fileName + ".parallel.csv";
+    itch::exporter csv;
+    EXPECT_EQ(csv.export_file(fileName, serialName, 1), 60000);
+    // small chunks, so plenty of them, and records across every boundary
+    EXPECT_EQ(csv.export_file(fileName, parallelName, 4, 4099), 60000);
+    std::string serial = itch_test::read_all(serialName);
+    EXPECT_EQ(serial, itch_test::read_all(parallelName));
+    EXPECT_EQ(serial.substr(0, serial.find('\n')), "A,1,0,0,0,S,100,MSFT,0.0000");
+
+    // one type gets a header
+    csv.select("A");
+    EXPECT_EQ(csv.export_file(fileName, parallelName, 3, 1000), 20000);
+    std::string adds = itch_test::read_all(parallelName);
+    EXPECT_EQ(adds.substr(0, adds.find('\n')), csv.get_header('A'));
+    EXPECT_EQ(std::count(adds.begin(), adds.end(), '\n'), 20001);
+
+    itch::exporter json(itch::exporter::format::JSON);
+    EXPECT_EQ(json.export_file(fileName, parallelName, 4, 8192), 60000);
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(serialName);
+    std::filesystem::remove(parallelName);
+    EXPECT_THROW(csv.export_file("/does/not/exist.itch", parallelName), std::invalid_argument);
+}
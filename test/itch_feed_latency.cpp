@@ -0,0 +1,110 @@
+#include "itch_feed_latency.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+class test_monitor : public itch::feed_latency_monitor
+{
+    public:
+    test_monitor() : feed_latency_monitor(0, 5) {}
+    std::vector<itch::feed_latency_window> closed;
+    std::vector<uint64_t> slow; // TIMESTAMPs where the delay went over
+    std::vector<uint64_t> recovered;
+    std::vector<uint64_t> exchangeBursts;
+    std::vector<uint64_t> receiveBursts;
+
+    protected:
+    virtual void on_window(const itch::feed_latency_window& window) override { closed.push_back(window); }
+    virtual void on_delay_threshold(uint64_t delay, uint64_t timestamp) override { slow.push_back(timestamp); }
+    virtual void on_delay_recovered(uint64_t delay, uint64_t timestamp) override { recovered.push_back(timestamp); }
+    virtual void on_exchange_burst(uint32_t messages, uint64_t start) override { exchangeBursts.push_back(start); }
+    virtual void on_receive_burst(uint32_t messages, uint64_t start) override { receiveBursts.push_back(start); }
+};
+
+const uint64_t OPEN = 34200ull * 1000000000ull;
+
+} // namespace
+
+TEST(itch_feed_latency, windows)
+{
+    test_monitor monitor;
+    monitor.set_delay_threshold(1000000);
+    monitor.set_burst_threshold(150);
+    itch::order_delete msg;
+    auto feed = [&](uint64_t timestamp, uint64_t received) {
+        msg.set_int(msg.TIMESTAMP, timestamp);
+        monitor.on_record(msg.get_record(), received);
+    };
+    // a steady second, 1 message every 10us arriving 50us later
+    for(uint64_t i = 0; i < 100000; ++i)
+        feed(OPEN + i * 10000, OPEN + i * 10000 + 50000);
+    // the next second starts with an exchange burst, 200 messages in 20us, still 50us late
+    for(uint64_t i = 0; i < 200; ++i)
+        feed(OPEN + 1000000000 + i * 100, OPEN + 1000050000 + i * 100);
+    // then we stall for 3ms, and catch up all at once
+    uint64_t stallStart = OPEN + 1001000000;
+    for(uint64_t i = 0; i < 300; ++i)
+        feed(stallStart + i * 10000, stallStart + 3000000 + 50000 + i * 10);
+    // back to normal
+    for(uint64_t i = 0; i < 1000; ++i)
+        feed(OPEN + 1010000000 + i * 10000, OPEN + 1010050000 + i * 10000);
+    monitor.flush();
+
+    ASSERT_EQ(monitor.closed.size(), 2);
+    const itch::feed_latency_window& steady = monitor.closed[0];
+    EXPECT_EQ(steady.second, 34200);
+    EXPECT_EQ(steady.messages, 99995); // the last 5 arrive in the next second
+    EXPECT_NEAR(steady.delay_p50, 50000, 1000);
+    EXPECT_NEAR(steady.delay_p999, 50000, 1000);
+    EXPECT_EQ(steady.max_exchange_burst, 10);
+    EXPECT_EQ(steady.max_receive_burst, 10);
+    EXPECT_EQ(steady.negative, 0);
+
+    const itch::feed_latency_window& busy = monitor.closed[1];
+    EXPECT_EQ(busy.second, 34201);
+    EXPECT_EQ(busy.max_exchange_burst, 200);
+    EXPECT_GE(busy.delay_max, 3000000);
+    EXPECT_GE(busy.max_receive_burst, 300);
+    // the exchange burst
+    ASSERT_EQ(monitor.exchangeBursts.size(), 1);
+    EXPECT_EQ(monitor.exchangeBursts[0], OPEN + 1000000000);
+    // the burst arrives as a receive burst as well, and so does the backlog from our stall
+    EXPECT_EQ(monitor.receiveBursts.size(), 2);
+    // the stall, once, until the delay came back down
+    ASSERT_EQ(monitor.slow.size(), 1);
+    EXPECT_EQ(monitor.slow[0], stallStart);
+    ASSERT_EQ(monitor.recovered.size(), 1);
+    EXPECT_GT(monitor.recovered[0], stallStart);
+    EXPECT_EQ(monitor.get_windows().size(), 2);
+
+    // only the last few seconds are kept
+    for(uint64_t i = 2; i < 10; ++i)
+        feed(OPEN + i * 1000000000, OPEN + i * 1000000000 + 1000);
+    monitor.flush();
+    EXPECT_EQ(monitor.get_windows().size(), 5);
+    EXPECT_EQ(monitor.get_windows().back().second, 34209);
+    EXPECT_EQ(monitor.get_current().messages, 0);
+
+    // stamped after it arrived
+    feed(OPEN + 20000000000ull, OPEN + 19000000000ull);
+    EXPECT_EQ(monitor.get_current().negative, 1);
+}
+
+TEST(itch_feed_latency, clock)
+{
+    itch::feed_latency_monitor monitor(0);
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t expected = ((uint64_t)ts.tv_sec % 86400) * 1000000000ull + ts.tv_nsec;
+    uint64_t now = monitor.now();
+    EXPECT_LT(now, itch::feed_latency_monitor::NS_PER_DAY);
+    // allow for crossing midnight while the test runs
+    uint64_t diff = now > expected ? now - expected : expected - now;
+    EXPECT_TRUE(diff < 10000000 || diff > itch::feed_latency_monitor::NS_PER_DAY - 10000000) << diff;
+    // a message stamped now shows a small delay
+    itch::order_delete msg;
+    msg.set_int(msg.TIMESTAMP, monitor.now());
+    monitor.on_record(msg.get_record());
+    EXPECT_LT(monitor.get_current().delay_max, 10000000);
+}
@@ -0,0 +1,146 @@
+#include "itch_file_index.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+
+/***
+ * A directory for 50 instruments, then adds, deletes and trades from 9:30 to 16:00
+ */
+std::vector<uint8_t> build_day(size_t count)
+{
+    std::vector<uint8_t> day;
+    for(uint16_t locate = 1; locate <= 50; ++locate)
+    {
+        itch::stock_directory dir;
+        dir.set_int(dir.STOCK_LOCATE, locate);
+        dir.set_int(dir.TIMESTAMP, 3600000000000ull);
+        dir.set_string(dir.STOCK, "SYM" + std::to_string(locate));
+        itch_test::append(day, dir);
+    }
+    std::mt19937_64 rng(11);
+    uint64_t start = itch::file_index::parse_time("09:30:00");
+    uint64_t end = itch::file_index::parse_time("16:00:00");
+    for(size_t i = 0; i < count; ++i)
+    {
+        uint64_t timestamp = start + (end - start) / count * i;
+        uint16_t locate = 1 + rng() % 50;
+        switch(rng() % 3)
+        {
+            case 0:
+            {
+                itch::add_order msg;
+                msg.set_int(msg.STOCK_LOCATE, locate);
+                msg.set_int(msg.TIMESTAMP, timestamp);
+                msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+                itch_test::append(day, msg);
+                break;
+            }
+            case 1:
+            {
+                itch::order_delete msg;
+                msg.set_int(msg.STOCK_LOCATE, locate);
+                msg.set_int(msg.TIMESTAMP, timestamp);
+                msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+                itch_test::append(day, msg);
+                break;
+            }
+            default:
+            {
+                itch::trade msg;
+                msg.set_int(msg.STOCK_LOCATE, locate);
+                msg.set_int(msg.TIMESTAMP, timestamp);
+                msg.set_int(msg.MATCH_NUMBER, i);
+                itch_test::append(day, msg);
+                break;
+            }
+        }
+    }
+    return day;
+}
+
+} // namespace
+
+TEST(itch_file_index, parseTime)
+{
+    EXPECT_EQ(itch::file_index::parse_time("10:30:00"), 37800000000000ull);
+    EXPECT_EQ(itch::file_index::parse_time("09:30:00.5"), 34200500000000ull);
+    EXPECT_EQ(itch::file_index::parse_time("09:30:00.000000123"), 34200000000123ull);
+    EXPECT_THROW(itch::file_index::parse_time("10h30"), std::invalid_argument);
+}
+
+TEST(itch_file_index, buildAndSeek)
+{
+    std::string fileName = itch_test::write_day("itch_file_index_test.itch", build_day(200000));
+    itch::mapped_file file(fileName);
+    // find a record from the middle of one
+    size_t found = itch::file_index::find_record(file.data(), file.size(), file.size() / 2);
+    size_t expected = 0;
+    file.for_each([&](const uint8_t* record, uint16_t length) {
+        size_t pos = record - itch::RECORD_LENGTH_LEN - file.data();
+        if (expected == 0 && pos >= file.size() / 2)
+            expected = pos;
+    });
+    EXPECT_EQ(found, expected);
+
+    itch::file_index parallel;
+    parallel.build(file, 4, 4096, 1000000000ull);
+    itch::file_index single;
+    single.build(file, 1, 4096, 1000000000ull);
+    EXPECT_EQ(parallel.get_header().record_count, 200050);
+    std::string parallelName = fileName + ".idx";
+    std::string singleName = fileName + ".single.idx";
+    parallel.save(parallelName);
+    single.save(singleName);
+    EXPECT_EQ(itch_test::read_all(parallelName), itch_test::read_all(singleName));
+
+    itch::file_index index;
+    index.load(parallelName);
+    EXPECT_TRUE(index.matches(file));
+    EXPECT_EQ(index.get_header().record_count, 200050);
+    // seek to 10:30, and check against a scan
+    uint64_t target = itch::file_index::parse_time("10:30:00");
+    size_t scanned = 0;
+    file.for_each([&](const uint8_t* record, uint16_t length) {
+        if (itch::get_int(record, itch::add_order::TIMESTAMP) >= target)
+            scanned++;
+    });
+    size_t seen = 0;
+    uint64_t first = 0;
+    index.for_each_from(file, target, [&](const uint8_t* record, uint16_t length) {
+        if (seen++ == 0)
+            first = itch::get_int(record, itch::add_order::TIMESTAMP);
+        return true;
+    });
+    EXPECT_EQ(seen, scanned);
+    EXPECT_GE(first, target);
+    EXPECT_LT(first, target + 1000000000ull);
+    EXPECT_LT(index.seek(target), file.size() / 4);
+    // stop early
+    seen = 0;
+    index.for_each_from(file, target, [&seen](const uint8_t*, uint16_t) { return ++seen < 10; });
+    EXPECT_EQ(seen, 10);
+
+    // all of one symbol
+    uint16_t locate = index.find_locate(file, "SYM7");
+    EXPECT_EQ(locate, 7);
+    EXPECT_EQ(index.find_locate(file, "NOPE"), 0);
+    EXPECT_EQ(index.directory_offset(7), 6 * (itch::RECORD_LENGTH_LEN + itch::STOCK_DIRECTORY_LEN));
+    std::vector<size_t> expectedOffsets;
+    file.for_each([&](const uint8_t* record, uint16_t length) {
+        if (itch::get_stock_locate(record) == locate)
+            expectedOffsets.push_back(record - file.data());
+    });
+    std::vector<size_t> offsets;
+    EXPECT_EQ(index.for_each_locate(file, locate, [&](const uint8_t* record, uint16_t length) {
+        offsets.push_back(record - file.data());
+    }), expectedOffsets.size());
+    EXPECT_EQ(offsets, expectedOffsets);
+
+    std::filesystem::remove(parallelName);
+    std::filesystem::remove(singleName);
+    std::filesystem::remove(fileName);
+}
@@ -0,0 +1,121 @@
+#include "itch_generator.h"
+#include "itch_order_book.h"
+#include "itch_file.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+
+TEST(itch_generator, day)
+{
+    itch::generator::options opts;
+    opts.symbols = 50;
+    opts.messages = 20000;
+    opts.seed = 42;
+    itch::generator gen(opts);
+    itch::order_book book;
+    std::vector<uint8_t> records;
+    uint64_t lastTimestamp = 0;
+    size_t count = 0;
+    char lastType = 0;
+    char lastEvent = 0;
+    gen.for_each([&](const uint8_t* record, uint16_t length) {
+        if (count == 0)
+        {
+            EXPECT_EQ(record[0], 'S');
+            EXPECT_EQ(record[itch::system_event::EVENT_CODE.offset], 'O');
+        }
+        else if (count <= 50)
+        {
+            ASSERT_EQ(record[0], 'R');
+            EXPECT_EQ(length, itch::STOCK_DIRECTORY_LEN);
+            itch::stock_directory dir(record);
+            EXPECT_EQ(dir.get_int(dir.STOCK_LOCATE), count);
+            EXPECT_EQ(dir.get_string(dir.MARKET_CATEGORY), "Q");
+            EXPECT_EQ(dir.get_int(dir.ROUND_LOT_SIZE), 100);
+        }
+        uint64_t timestamp = itch::get_int(record, itch::system_event::TIMESTAMP);
+        EXPECT_GE(timestamp, lastTimestamp);
+        lastTimestamp = timestamp;
+        switch(record[0])
+        {
+            case('A'):
+                EXPECT_EQ(length, itch::ADD_ORDER_LEN);
+                EXPECT_GT(itch::get_int(record, itch::add_order::PRICE), 0);
+                EXPECT_TRUE(book.apply(record));
+                break;
+            case('E'):
+            case('X'):
+            case('D'):
+            case('U'):
+                // every order it touches is on the book
+                EXPECT_TRUE(book.apply(record)) << record[0] << " at " << count;
+                break;
+            case('S'):
+                lastEvent = record[itch::system_event::EVENT_CODE.offset];
+                break;
+        }
+        lastType = record[0];
+        records.insert(records.end(), record, record + length);
+        count++;
+    });
+    EXPECT_TRUE(gen.done());
+    // open, directory, trading actions, S and Q, the flow, M, E and C
+    EXPECT_EQ(count, 1 + 50 + 50 + 2 + 20000 + 3);
+    EXPECT_EQ(gen.get_records(), count);
+    EXPECT_EQ(lastType, 'S');
+    EXPECT_EQ(lastEvent, 'C');
+    EXPECT_EQ(book.size(), gen.get_live_orders());
+    EXPECT_GT(book.size(), 0);
+
+    // the same seed makes the same day
+    itch::generator again(opts);
+    std::vector<uint8_t> againRecords;
+    again.for_each([&](const uint8_t* record, uint16_t length) {
+        againRecords.insert(againRecords.end(), record, record + length);
+    }, 4096);
+    EXPECT_EQ(records, againRecords);
+
+    // and the same file
+    std::string fileName = (std::filesystem::temp_directory_path() / "itch_generator_day.itch").string();
+    itch::generator toFile(opts);
+    EXPECT_EQ(toFile.write_file(fileName, 1000), count);
+    itch::mapped_file file(fileName);
+    std::vector<uint8_t> fileRecords;
+    file.for_each([&](const uint8_t* record, uint16_t length) {
+        fileRecords.insert(fileRecords.end(), record, record + length);
+    });
+    EXPECT_EQ(records, fileRecords);
+    std::filesystem::remove(fileName);
+
+    opts.symbols = 0;
+    EXPECT_THROW(itch::generator{opts}, std::invalid_argument);
+}
+
+namespace
+{
+
+struct fake_server
+{
+    void send_sequenced(const std::vector<unsigned char>& in) { messages.push_back(in); }
+    std::vector<std::vector<unsigned char>> messages;
+};
+
+} // namespace
+
+TEST(itch_generator, publish)
+{
+    itch::generator::options opts;
+    opts.symbols = 3;
+    opts.messages = 100;
+    opts.burstChance = 1000;
+    itch::generator gen(opts);
+    fake_server server;
+    EXPECT_EQ(gen.publish(server), 1 + 3 + 3 + 2 + 100 + 3);
+    ASSERT_EQ(server.messages.size(), 112);
+    EXPECT_EQ(server.messages[1][0], 'R');
+    EXPECT_EQ(server.messages[4][0], 'H');
+    itch::stock_trading_action action(server.messages[4].data());
+    EXPECT_EQ(action.get_string(action.STOCK), "AAAA    ");
+    EXPECT_EQ(action.get_string(action.TRADING_STATE), "T");
+    // nothing left
+    EXPECT_EQ(gen.publish(server), 0);
+}
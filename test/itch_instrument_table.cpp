@@ -0,0 +1,113 @@
+#include "itch_instrument_table.h"
+#include <gtest/gtest.h>
+
+namespace
+{
+
+itch::stock_directory make_directory(uint16_t locate, const std::string& symbol)
+{
+    itch::stock_directory msg;
+    msg.set_int(msg.STOCK_LOCATE, locate);
+    msg.set_string(msg.STOCK, symbol);
+    msg.set_string(msg.MARKET_CATEGORY, "Q");
+    msg.set_string(msg.FINANCIAL_STATUS_INDICATOR, "N");
+    msg.set_int(msg.ROUND_LOT_SIZE, 100);
+    msg.set_string(msg.ISSUE_SUB_TYPE, "Z");
+    return msg;
+}
+
+} // namespace
+
+TEST(itch_instrument_table, symbols)
+{
+    EXPECT_EQ(itch::unpack_symbol(itch::pack_symbol("AAPL")), "AAPL");
+    EXPECT_EQ(itch::pack_symbol("AAPL"), itch::pack_symbol((const uint8_t*)"AAPL    "));
+    EXPECT_EQ(itch::unpack_symbol(itch::pack_symbol("ABCDEFGHIJ")), "ABCDEFGH");
+    // a record from set_string pads with nulls, it should still match
+    itch::stock_directory msg = make_directory(1, "MSFT");
+    EXPECT_EQ(itch::pack_symbol(&msg.get_record()[msg.STOCK.offset]), itch::pack_symbol("MSFT"));
+}
+
+TEST(itch_instrument_table, directory)
+{
+    itch::instrument_table table;
+    EXPECT_FALSE(table[7].known());
+    EXPECT_EQ(table.find("AAPL"), 0);
+    EXPECT_TRUE(table.apply(make_directory(7, "AAPL")));
+    EXPECT_TRUE(table.apply(make_directory(12, "MSFT")));
+    EXPECT_TRUE(table[7].known());
+    EXPECT_EQ(table.find("AAPL"), 7);
+    EXPECT_EQ(table.find("MSFT"), 12);
+    EXPECT_EQ(table.find("GOOG"), 0);
+    EXPECT_EQ(table[7].round_lot_size, 100);
+    EXPECT_EQ(table[7].market_category, 'Q');
+    EXPECT_EQ(table[7].financial_status_indicator, 'N');
+    EXPECT_EQ(itch::unpack_symbol(table[12].symbol), "MSFT");
+    // the locate is handed to a new symbol
+    table.apply(make_directory(12, "GOOG"));
+    EXPECT_EQ(table.find("GOOG"), 12);
+    EXPECT_EQ(table.find("MSFT"), 0);
+    // messages the table does not care about
+    itch::add_order add;
+    EXPECT_FALSE(table.apply(add));
+    table.clear();
+    EXPECT_EQ(table.find("AAPL"), 0);
+}
+
+TEST(itch_instrument_table, state)
+{
+    itch::instrument_table table;
+    table.apply(make_directory(7, "AAPL"));
+    EXPECT_FALSE(table[7].is_halted());
+    EXPECT_FALSE(table[7].is_short_sale_restricted());
+
+    itch::stock_trading_action action;
+    action.set_int(action.STOCK_LOCATE, 7);
+    action.set_string(action.STOCK, "AAPL");
+    action.set_string(action.TRADING_STATE, "H");
+    action.set_string(action.REASON, "T1");
+    EXPECT_TRUE(table.apply(action));
+    EXPECT_TRUE(table[7].is_halted());
+    EXPECT_EQ(std::string(table[7].trading_reason, 2), "T1");
+    action.set_string(action.TRADING_STATE, "T");
+    table.apply(action);
+    EXPECT_TRUE(table[7].is_trading());
+
+    itch::reg_sho_restriction regSho;
+    regSho.set_int(regSho.STOCK_LOCATE, 7);
+    regSho.set_string(regSho.REG_SHO_ACTION, "1");
+    EXPECT_TRUE(table.apply(regSho));
+    EXPECT_TRUE(table[7].is_short_sale_restricted());
+
+    itch::operational_halt halt;
+    halt.set_int(halt.STOCK_LOCATE, 7);
+    halt.set_string(halt.MARKET_CODE, "Q");
+    halt.set_string(halt.OPERATIONAL_HALT_ACTION, "H");
+    EXPECT_TRUE(table.apply(halt));
+    EXPECT_TRUE(table[7].is_halted());
+    EXPECT_FALSE(table[7].is_trading());
+
+    itch::luld_auction_collar collar;
+    collar.set_int(collar.STOCK_LOCATE, 7);
+    collar.set_int(collar.AUCTION_COLLAR_REFERENCE_PRICE, 1500000);
+    collar.set_int(collar.UPPER_AUCTION_COLLAR_PRICE, 1650000);
+    collar.set_int(collar.LOWER_AUCTION_COLLAR_PRICE, 1350000);
+    collar.set_int(collar.AUCTION_COLLAR_EXTENSION, 2);
+    EXPECT_TRUE(table.apply(collar));
+    EXPECT_EQ(table[7].auction_collar_reference_price, 1500000);
+    EXPECT_EQ(table[7].upper_auction_collar_price, 1650000);
+    EXPECT_EQ(table[7].lower_auction_collar_price, 1350000);
+    EXPECT_EQ(table[7].auction_collar_extension, 2);
+
+    itch::ipo_quoting_period_update ipo;
+    ipo.set_int(ipo.STOCK_LOCATE, 7);
+    ipo.set_int(ipo.IPO_QUOTATION_RELEASE_TIME, 34200);
+    ipo.set_string(ipo.IPO_QUOTATION_RELEASE_QUALIFIER, "A");
+    ipo.set_int(ipo.IPO_PRICE, 250000);
+    EXPECT_TRUE(table.apply(ipo));
+    EXPECT_EQ(table[7].ipo_quotation_release_time, 34200);
+    EXPECT_EQ(table[7].ipo_quotation_release_qualifier, 'A');
+    EXPECT_EQ(table[7].ipo_price, 250000);
+    // nothing leaked to other locates
+    EXPECT_FALSE(table[8].is_halted());
+}
@@ -0,0 +1,126 @@
+#include "itch_latency.h"
+#include "itch_order_book.h"
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <random>
+
+TEST(itch_latency, histogram)
+{
+    itch::hdr_histogram histogram;
+    EXPECT_EQ(histogram.value_at_percentile(50.0), 0);
+    for(uint64_t i = 1; i <= 100000; ++i)
+        histogram.record(i);
+    EXPECT_EQ(histogram.get_count(), 100000);
+    EXPECT_EQ(histogram.get_max(), 100000);
+    EXPECT_NEAR(histogram.value_at_percentile(50.0), 50000, 1000);
+    EXPECT_NEAR(histogram.value_at_percentile(99.0), 99000, 2000);
+    EXPECT_NEAR(histogram.value_at_percentile(99.9), 99900, 2000);
+    EXPECT_EQ(histogram.value_at_percentile(100.0), 100000);
+
+    // small values are exact, large ones within 2%
+    std::mt19937_64 rng(7);
+    for(int i = 0; i < 100000; ++i)
+    {
+        uint64_t value = rng() >> (rng() % 64);
+        uint64_t highest = itch::hdr_histogram::highest_in_bucket(itch::hdr_histogram::bucket_of(value));
+        ASSERT_GE(highest, value);
+        if (value < itch::hdr_histogram::SUB_COUNT)
+            EXPECT_EQ(highest, value);
+        else
+            ASSERT_LE(highest - value, value / 50) << value;
+        ASSERT_LT(itch::hdr_histogram::bucket_of(value), itch::hdr_histogram::BUCKETS);
+    }
+
+    itch::hdr_histogram other;
+    other.record(1000000);
+    other.merge(histogram);
+    EXPECT_EQ(other.get_count(), 100001);
+    EXPECT_EQ(other.get_max(), 1000000);
+    other.reset();
+    EXPECT_EQ(other.get_count(), 0);
+}
+
+TEST(itch_latency, resetFromAnotherThread)
+{
+    itch::hdr_histogram histogram;
+    std::atomic<uint64_t> recorded = 0;
+    std::atomic<bool> stop = false;
+    std::thread owner([&]() {
+        while(!stop.load(std::memory_order_acquire))
+        {
+            histogram.record(100);
+            recorded.fetch_add(1, std::memory_order_relaxed);
+        }
+        // after the reset, so this one catches up with it
+        histogram.record(100);
+        recorded.fetch_add(1, std::memory_order_relaxed);
+    });
+    while(recorded.load(std::memory_order_relaxed) < 100000)
+        std::this_thread::yield();
+    uint64_t beforeReset = recorded.load(std::memory_order_relaxed);
+    histogram.reset();
+    stop.store(true, std::memory_order_release);
+    owner.join();
+    // none of the counts from before the reset were written back
+    EXPECT_GT(histogram.get_count(), 0);
+    EXPECT_LE(histogram.get_count(), recorded.load() - beforeReset);
+}
+
+TEST(itch_latency, registry)
+{
+    itch::latency_registry& registry = itch::latency_registry::instance();
+    uint64_t before = registry.snapshot(itch::latency_stage::BOOK_UPDATE).get_count();
+    // every thread has its own histograms, and they still count after it is gone
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 4; ++i)
+        threads.emplace_back([]() {
+            for(int j = 0; j < 1000; ++j)
+                itch::latency_registry::record(itch::latency_stage::BOOK_UPDATE, itch::read_tsc());
+        });
+    for(auto& curr : threads)
+        curr.join();
+    EXPECT_EQ(registry.snapshot(itch::latency_stage::BOOK_UPDATE).get_count(), before + 4000);
+    EXPECT_GT(itch::latency_registry::cycles_per_ns(), 0.0);
+    EXPECT_NE(registry.dump().find("book_update count="), std::string::npos);
+}
+
+#ifdef NASDAQ_ITCH_LATENCY
+TEST(itch_latency, probes)
+{
+    itch::latency_registry& registry = itch::latency_registry::instance();
+    registry.reset();
+    itch::order_book book;
+    itch::add_order msg;
+    msg.set_int(msg.STOCK_LOCATE, 1);
+    msg.set_int(msg.ORDER_REFERENCE_NUMBER, 1);
+    msg.set_char(msg.BUY_SELL_INDICATOR, 'B');
+    msg.set_int(msg.SHARES, 100);
+    msg.set_int(msg.PRICE, 10000);
+    book.apply(msg);
+    EXPECT_EQ(registry.snapshot(itch::latency_stage::BOOK_UPDATE).get_count(), 1);
+
+    class ProbedConnection : public SoupBinConnection
+    {
+        public:
+        ProbedConnection(boost::asio::ip::tcp::socket socket, MessageRepeater* parent)
+                : SoupBinConnection(std::move(socket), parent) {}
+        ProbedConnection(const std::string& url) : SoupBinConnection(url, "test1", "password") { connect(); }
+        std::atomic<int> received = 0;
+        protected:
+        virtual void on_sequenced_data(const soupbintcp::sequenced_data& in) override { received++; }
+    };
+    SoupBinServer<ProbedConnection> server(9014);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ProbedConnection client("127.0.0.1:9014");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(int i = 0; i < 10; ++i)
+        server.send_sequenced({'H', 'e', 'l', 'l', 'o'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(client.received, 10);
+    EXPECT_GE(registry.snapshot(itch::latency_stage::SOCKET_READ).get_count(), 10);
+    EXPECT_EQ(registry.snapshot(itch::latency_stage::FRAME_PARSE).get_count(), 10);
+    EXPECT_EQ(registry.snapshot(itch::latency_stage::DISPATCH).get_count(), 10);
+    std::string dump = registry.dump();
+    EXPECT_NE(dump.find("dispatch count=10 "), std::string::npos) << dump;
+}
+#endif
@@ -0,0 +1,118 @@
+#include "itch_locate_filter.h"
+#include "itch_file.h"
+#include "mold_udp64_receiver.h"
+#include "mold_udp64_publisher.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <vector>
+#include <filesystem>
+
+namespace
+{
+
+/***
+ * A start of day, 3 instruments in the directory, then an add_order for each of them
+ */
+std::vector<uint8_t> build_day()
+{
+    std::vector<uint8_t> file;
+    itch::system_event start;
+    start.set_string(start.EVENT_CODE, "O");
+    itch_test::append(file, start);
+    const char* symbols[] = { "AAPL", "MSFT", "GOOG" };
+    for(uint16_t i = 0; i < 3; ++i)
+    {
+        itch::stock_directory dir;
+        dir.set_int(dir.STOCK_LOCATE, i + 1);
+        dir.set_string(dir.STOCK, symbols[i]);
+        itch_test::append(file, dir);
+    }
+    for(uint16_t i = 0; i < 3; ++i)
+    {
+        itch::add_order add;
+        add.set_int(add.STOCK_LOCATE, i + 1);
+        add.set_int(add.ORDER_REFERENCE_NUMBER, 100 + i);
+        itch_test::append(file, add);
+    }
+    return file;
+}
+
+} // namespace
+
+TEST(itch_locate_filter, locates)
+{
+    itch::locate_filter filter;
+    itch::add_order add;
+    add.set_int(add.STOCK_LOCATE, 42);
+    EXPECT_FALSE(filter.accept(add.get_record(), add.get_size()));
+    filter.subscribe((uint16_t)42);
+    EXPECT_TRUE(filter.accept(add.get_record(), add.get_size()));
+    EXPECT_TRUE(filter.is_subscribed(42));
+    EXPECT_FALSE(filter.is_subscribed(43));
+    filter.unsubscribe(42);
+    EXPECT_FALSE(filter.accept(add.get_record(), add.get_size()));
+    // locate 0 always gets through
+    itch::system_event evt;
+    EXPECT_TRUE(filter.accept(evt.get_record(), evt.get_size()));
+    EXPECT_EQ(filter.get_dropped(), 2);
+    // too short for a locate
+    EXPECT_FALSE(filter.accept(evt.get_record(), 2));
+    EXPECT_EQ(filter.get_dropped(), 3);
+}
+
+TEST(itch_locate_filter, symbolsFromFile)
+{
+    std::vector<uint8_t> day = build_day();
+    std::string fileName = itch_test::write_day("itch_locate_filter_test.itch", day);
+    itch::mapped_file file(fileName);
+    itch::locate_filter filter;
+    filter.subscribe("MSFT");
+    std::vector<char> types;
+    std::vector<uint16_t> locates;
+    file.for_each([&](const uint8_t* record, uint16_t length) {
+        types.push_back(record[0]);
+        locates.push_back(itch::get_stock_locate(record));
+    }, filter);
+    std::vector<char> expectedTypes{'S', 'R', 'A'};
+    std::vector<uint16_t> expectedLocates{0, 2, 2};
+    EXPECT_EQ(types, expectedTypes);
+    EXPECT_EQ(locates, expectedLocates);
+    EXPECT_TRUE(filter.is_subscribed(2));
+    EXPECT_EQ(filter.get_dropped(), 4);
+    std::filesystem::remove(fileName);
+
+    // already known to an instrument table
+    itch::instrument_table table;
+    itch::for_each_record(day.data(), day.size(), [&table](const uint8_t* record, uint16_t) { table.apply(record); });
+    itch::locate_filter filter2;
+    filter2.subscribe("GOOG", table);
+    EXPECT_TRUE(filter2.is_subscribed(3));
+}
+
+TEST(itch_locate_filter, mold)
+{
+    class MyReceiver : public MoldUDP64Receiver
+    {
+        public:
+        MyReceiver() : MoldUDP64Receiver("239.192.10.5", 31214, "127.0.0.1") {}
+        virtual void on_message(uint64_t seqNo, const uint8_t* data, uint16_t length) override
+        {
+            seqNos.push_back(seqNo);
+        }
+        std::vector<uint64_t> seqNos;
+    };
+    std::vector<uint8_t> day = build_day();
+    MoldUDP64MessageStore store(day.data(), day.size());
+    MoldUDP64Publisher publisher(store, "SESSION004", "239.192.10.5", 31214, "127.0.0.1");
+    MyReceiver receiver;
+    itch::locate_filter filter;
+    filter.subscribe("AAPL");
+    filter.subscribe("GOOG");
+    receiver.set_filter(&filter);
+    publisher.publish();
+    for(int i = 0; i < 10 && receiver.get_next_seq() < 8; ++i)
+        receiver.poll(100);
+    std::vector<uint64_t> expected{1, 2, 4, 5, 7};
+    EXPECT_EQ(receiver.seqNos, expected);
+    EXPECT_EQ(receiver.get_next_seq(), 8);
+}
@@ -0,0 +1,126 @@
+#include "itch_order_book.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <map>
+
+TEST(itch_order_book, levels)
+{
+    itch::order_book book;
+    EXPECT_TRUE(book.apply(itch_test::make_add(1, 5, 'B', 100000, 100)));
+    EXPECT_TRUE(book.apply(itch_test::make_add(2, 5, 'B', 101000, 200)));
+    EXPECT_TRUE(book.apply(itch_test::make_add(3, 5, 'B', 100000, 300)));
+    EXPECT_TRUE(book.apply(itch_test::make_add(4, 5, 'S', 102000, 400)));
+    EXPECT_TRUE(book.apply(itch_test::make_add(5, 5, 'S', 103000, 500)));
+    EXPECT_EQ(book.size(), 5);
+    EXPECT_EQ(book.best_bid(5).price, 101000);
+    EXPECT_EQ(book.best_ask(5).price, 102000);
+    const std::vector<itch::price_level>& bids = book.get_levels(5, 'B');
+    ASSERT_EQ(bids.size(), 2);
+    EXPECT_EQ(bids[0].price, 100000);
+    EXPECT_EQ(bids[0].shares, 400);
+    EXPECT_EQ(bids[0].orders, 2);
+    const std::vector<itch::price_level>& asks = book.get_levels(5, 'S');
+    ASSERT_EQ(asks.size(), 2);
+    EXPECT_EQ(asks[0].price, 103000);
+    EXPECT_EQ(asks[1].price, 102000);
+    EXPECT_EQ(book.find(3)->priority, 3);
+    // partial execution, then the rest
+    itch::order_executed exec;
+    exec.set_int(exec.ORDER_REFERENCE_NUMBER, 2);
+    exec.set_int(exec.EXECUTED_SHARES, 50);
+    EXPECT_TRUE(book.apply(exec));
+    EXPECT_EQ(book.best_bid(5).shares, 150);
+    EXPECT_EQ(book.find(2)->shares, 150);
+    exec.set_int(exec.EXECUTED_SHARES, 150);
+    EXPECT_TRUE(book.apply(exec));
+    EXPECT_EQ(book.find(2), nullptr);
+    EXPECT_EQ(book.best_bid(5).price, 100000);
+    // cancel and delete
+    itch::order_cancel cancel;
+    cancel.set_int(cancel.ORDER_REFERENCE_NUMBER, 1);
+    cancel.set_int(cancel.CANCELLED_SHARES, 40);
+    EXPECT_TRUE(book.apply(cancel));
+    EXPECT_EQ(book.best_bid(5).shares, 360);
+    itch::order_delete del;
+    del.set_int(del.ORDER_REFERENCE_NUMBER, 4);
+    EXPECT_TRUE(book.apply(del));
+    EXPECT_EQ(book.best_ask(5).price, 103000);
+    EXPECT_FALSE(book.apply(del));
+    // replace loses priority and moves price
+    itch::order_replace replace;
+    replace.set_int(replace.ORIGINAL_ORDER_REFERENCE_NUMBER, 1);
+    replace.set_int(replace.NEW_ORDER_REFERENCE_NUMBER, 6);
+    replace.set_int(replace.PRICE, 99000);
+    replace.set_int(replace.SHARES, 10);
+    EXPECT_TRUE(book.apply(replace));
+    EXPECT_EQ(book.find(1), nullptr);
+    EXPECT_EQ(book.find(6)->side, 'B');
+    EXPECT_EQ(book.find(6)->locate, 5);
+    EXPECT_GT(book.find(6)->priority, book.find(5)->priority);
+    EXPECT_EQ(bids.size(), 2);
+    EXPECT_EQ(bids[0].price, 99000);
+    EXPECT_EQ(bids[1].shares, 300);
+    EXPECT_EQ(book.best_bid(6).price, 0);
+    // an add with a live reference takes the old order off its level
+    EXPECT_TRUE(book.apply(itch_test::make_add(6, 5, 'B', 100000, 20)));
+    EXPECT_EQ(book.find(6)->shares, 20);
+    EXPECT_EQ(bids.size(), 1);
+    EXPECT_EQ(bids[0].price, 100000);
+    EXPECT_EQ(bids[0].shares, 320);
+    EXPECT_EQ(bids[0].orders, 2);
+    book.clear();
+    EXPECT_EQ(book.size(), 0);
+    EXPECT_TRUE(book.get_levels(5, 'B').empty());
+}
+
+TEST(itch_order_book, random)
+{
+    // compare against a simple model, with enough orders to grow the table
+    itch::order_book book(16);
+    std::map<uint64_t, std::pair<uint32_t, uint32_t>> model; // reference to price, shares
+    std::mt19937_64 rng(42);
+    uint64_t nextRef = 1;
+    for(int i = 0; i < 200000; ++i)
+    {
+        if (model.empty() || rng() % 3 != 0)
+        {
+            uint32_t price = 100000 + (rng() % 50) * 100;
+            uint32_t shares = 1 + rng() % 1000;
+            book.apply(itch_test::make_add(nextRef, 1, 'B', price, shares));
+            model[nextRef++] = {price, shares};
+        }
+        else
+        {
+            auto itr = model.lower_bound(rng() % nextRef);
+            if (itr == model.end())
+                itr = model.begin();
+            itch::order_cancel cancel;
+            cancel.set_int(cancel.ORDER_REFERENCE_NUMBER, itr->first);
+            uint32_t shares = 1 + rng() % itr->second.second;
+            cancel.set_int(cancel.CANCELLED_SHARES, shares);
+            EXPECT_TRUE(book.apply(cancel));
+            itr->second.second -= shares;
+            if (itr->second.second == 0)
+                model.erase(itr);
+        }
+    }
+    EXPECT_EQ(book.size(), model.size());
+    std::map<uint32_t, uint64_t> levels;
+    for(auto& curr : model)
+    {
+        const itch::order* ord = book.find(curr.first);
+        ASSERT_NE(ord, nullptr);
+        EXPECT_EQ(ord->shares, curr.second.second);
+        levels[curr.second.first] += curr.second.second;
+    }
+    const std::vector<itch::price_level>& bids = book.get_levels(1, 'B');
+    ASSERT_EQ(bids.size(), levels.size());
+    size_t i = 0;
+    for(auto& curr : levels)
+    {
+        EXPECT_EQ(bids[i].price, curr.first);
+        EXPECT_EQ(bids[i].shares, curr.second);
+        ++i;
+    }
+}
@@ -0,0 +1,332 @@
+#include "itch_pcap_file.h"
+#include "itch_locate_filter.h"
+#include "soupbintcp.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+
+void put_be16(std::vector<uint8_t>& out, uint16_t val)
+{
+    out.push_back(val >> 8);
+    out.push_back(val & 0xff);
+}
+
+void put_be32(std::vector<uint8_t>& out, uint32_t val)
+{
+    put_be16(out, val >> 16);
+    put_be16(out, val & 0xffff);
+}
+
+template<typename T>
+void put(std::vector<uint8_t>& out, T val)
+{
+    const uint8_t* bytes = (const uint8_t*)&val;
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+/***
+ * An Ethernet frame carrying an IPv4 TCP or UDP packet
+ */
+std::vector<uint8_t> make_frame(uint8_t protocol, uint16_t sourcePort, uint16_t destinationPort,
+        const std::vector<uint8_t>& payload, uint32_t seq = 0, uint8_t flags = 0, bool vlan = false)
+{
+    std::vector<uint8_t> frame(12, 0); // MAC addresses
+    if (vlan)
+    {
+        put_be16(frame, 0x8100);
+        put_be16(frame, 42);
+    }
+    put_be16(frame, 0x0800);
+    size_t transportLength = (protocol == 17 ? 8 : 20) + payload.size();
+    frame.push_back(0x45);
+    frame.push_back(0);
+    put_be16(frame, 20 + transportLength);
+    put_be32(frame, 0); // id, flags, fragment offset
+    frame.push_back(64);
+    frame.push_back(protocol);
+    put_be16(frame, 0); // checksum
+    put_be32(frame, 0x0a000001);
+    put_be32(frame, protocol == 17 ? 0xefc00a01 : 0x0a000002);
+    put_be16(frame, sourcePort);
+    put_be16(frame, destinationPort);
+    if (protocol == 17)
+    {
+        put_be16(frame, transportLength);
+        put_be16(frame, 0);
+    }
+    else
+    {
+        put_be32(frame, seq);
+        put_be32(frame, 0); // ack
+        frame.push_back(5 << 4);
+        frame.push_back(flags);
+        put_be16(frame, 65535);
+        put_be32(frame, 0); // checksum, urgent pointer
+    }
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+std::vector<uint8_t> make_record(uint64_t ref)
+{
+    itch::order_delete msg;
+    msg.set_int(msg.STOCK_LOCATE, 1 + ref % 4);
+    msg.set_int(msg.ORDER_REFERENCE_NUMBER, ref);
+    return std::vector<uint8_t>(msg.get_record(), msg.get_record() + msg.get_size());
+}
+
+std::vector<uint8_t> make_mold(uint64_t seqNo, uint16_t count)
+{
+    std::vector<uint8_t> packet(1400);
+    moldudp64::packet_builder builder(packet.data(), packet.size());
+    builder.reset("SESSION005", seqNo);
+    for(uint16_t i = 0; i < count; ++i)
+    {
+        std::vector<uint8_t> record = make_record(seqNo + i);
+        builder.add(record.data(), record.size());
+    }
+    packet.resize(builder.length);
+    return packet;
+}
+
+/***
+ * A pcap file with nanosecond timestamps
+ */
+struct pcap_writer
+{
+    pcap_writer()
+    {
+        put<uint32_t>(bytes, 0xa1b23c4d);
+        put<uint16_t>(bytes, 2);
+        put<uint16_t>(bytes, 4);
+        put<uint32_t>(bytes, 0);
+        put<uint32_t>(bytes, 0);
+        put<uint32_t>(bytes, 65535);
+        put<uint32_t>(bytes, 1);
+    }
+    void add(uint64_t timestamp, const std::vector<uint8_t>& frame)
+    {
+        put<uint32_t>(bytes, timestamp / 1000000000);
+        put<uint32_t>(bytes, timestamp % 1000000000);
+        put<uint32_t>(bytes, frame.size());
+        put<uint32_t>(bytes, frame.size());
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+    }
+    std::string save(const std::string& name)
+    {
+        std::string fileName = (std::filesystem::temp_directory_path() / name).string();
+        std::ofstream out(fileName, std::ios::binary);
+        out.write((const char*)bytes.data(), bytes.size());
+        return fileName;
+    }
+    std::vector<uint8_t> bytes;
+};
+
+/***
+ * A pcapng file with one Ethernet interface in microseconds (the default)
+ */
+struct pcapng_writer : public pcap_writer
+{
+    pcapng_writer()
+    {
+        bytes.clear();
+        put<uint32_t>(bytes, 0x0a0d0d0a);
+        put<uint32_t>(bytes, 28);
+        put<uint32_t>(bytes, 0x1a2b3c4d);
+        put<uint16_t>(bytes, 1);
+        put<uint16_t>(bytes, 0);
+        put<int64_t>(bytes, -1);
+        put<uint32_t>(bytes, 28);
+        put<uint32_t>(bytes, 1);
+        put<uint32_t>(bytes, 20);
+        put<uint16_t>(bytes, 1);
+        put<uint16_t>(bytes, 0);
+        put<uint32_t>(bytes, 65535);
+        put<uint32_t>(bytes, 20);
+    }
+    void add(uint64_t timestamp, const std::vector<uint8_t>& frame)
+    {
+        uint32_t padded = (frame.size() + 3) / 4 * 4;
+        uint64_t micros = timestamp / 1000;
+        put<uint32_t>(bytes, 6);
+        put<uint32_t>(bytes, 32 + padded);
+        put<uint32_t>(bytes, 0);
+        put<uint32_t>(bytes, micros >> 32);
+        put<uint32_t>(bytes, micros & 0xffffffff);
+        put<uint32_t>(bytes, frame.size());
+        put<uint32_t>(bytes, frame.size());
+        bytes.insert(bytes.end(), frame.begin(), frame.end());
+        bytes.resize(bytes.size() + padded - frame.size(), 0);
+        put<uint32_t>(bytes, 32 + padded);
+    }
+};
+
+const uint64_t START = 1700000000000000000ull;
+
+} // namespace
+
+TEST(itch_pcap_file, moldLines)
+{
+    // line A loses packet 3, line B (VLAN tagged) has everything a little later
+    pcap_writer writer;
+    pcapng_writer ngWriter;
+    for(uint64_t i = 0; i < 10; ++i)
+    {
+        std::vector<uint8_t> mold = make_mold(1 + i * 5, 5);
+        if (i != 3)
+        {
+            writer.add(START + i * 1000, make_frame(17, 40000, 26477, mold));
+            ngWriter.add(START + i * 1000, make_frame(17, 40000, 26477, mold));
+        }
+        writer.add(START + i * 1000 + 10, make_frame(17, 40000, 26478, mold, 0, 0, true));
+        ngWriter.add(START + i * 1000 + 10, make_frame(17, 40000, 26478, mold, 0, 0, true));
+    }
+    // a heartbeat, and someone else's traffic
+    writer.add(START + 20000, make_frame(17, 40000, 26477, make_mold(51, 0)));
+    writer.add(START + 20000, make_frame(17, 5353, 5353, {1, 2, 3}));
+
+    std::string fileName = writer.save("itch_pcap_file_mold.pcap");
+    itch::pcap_file file(fileName);
+    file.add_port(26477);
+    file.add_port(26478);
+    EXPECT_EQ(file.get_format(), itch::pcap_file::format::PCAP);
+    std::vector<uint64_t> refs;
+    std::vector<uint64_t> timestamps;
+    EXPECT_EQ(file.for_each([&](uint64_t timestamp, const uint8_t* record, uint16_t length) {
+        EXPECT_EQ(length, itch::ORDER_DELETE_LEN);
+        refs.push_back(itch::get_int(record, itch::order_delete::ORDER_REFERENCE_NUMBER));
+        timestamps.push_back(timestamp);
+    }), 50);
+    ASSERT_EQ(refs.size(), 50);
+    for(uint64_t i = 0; i < 50; ++i)
+        EXPECT_EQ(refs[i], i + 1);
+    EXPECT_EQ(timestamps[0], START);
+    // packet 3 only came on line B
+    EXPECT_EQ(timestamps[15], START + 3010);
+    EXPECT_EQ(file.get_stats().mold_duplicates, 45);
+    EXPECT_EQ(file.get_stats().mold_missing, 0);
+    EXPECT_EQ(file.get_stats().skipped, 1);
+
+    // the same packets in pcapng, microseconds, and with a filter
+    std::string ngFileName = ngWriter.save("itch_pcap_file_mold.pcapng");
+    itch::pcap_file ngFile(ngFileName);
+    EXPECT_EQ(ngFile.get_format(), itch::pcap_file::format::PCAPNG);
+    itch::locate_filter filter;
+    filter.subscribe((uint16_t)2);
+    size_t records = 0;
+    ngFile.for_each([&](uint64_t timestamp, const uint8_t* record, uint16_t) {
+        EXPECT_EQ(itch::get_stock_locate(record), 2);
+        EXPECT_EQ(timestamp % 1000, 0);
+        records++;
+    }, filter);
+    EXPECT_EQ(records, 13);
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(ngFileName);
+    EXPECT_THROW(itch::pcap_file("/does/not/exist.pcap"), std::invalid_argument);
+}
+
+TEST(itch_pcap_file, moldLateFill)
+{
+    // line A loses packets 2 and 6, line B's copies come after A's next packet, and nobody has 8
+    pcap_writer writer;
+    for(uint64_t i = 0; i < 10; ++i)
+    {
+        std::vector<uint8_t> mold = make_mold(1 + i * 5, 5);
+        if (i != 2 && i != 6 && i != 8)
+            writer.add(START + i * 1000, make_frame(17, 40000, 26477, mold));
+        if (i != 8)
+            writer.add(START + i * 1000 + 1500, make_frame(17, 40000, 26478, mold));
+    }
+    std::string fileName = writer.save("itch_pcap_file_mold_late.pcap");
+    itch::pcap_file file(fileName);
+    std::vector<uint32_t> counts(51, 0);
+    EXPECT_EQ(file.for_each([&](uint64_t, const uint8_t* record, uint16_t) {
+        counts[itch::get_int(record, itch::order_delete::ORDER_REFERENCE_NUMBER)]++;
+    }), 45);
+    for(uint64_t i = 1; i <= 50; ++i)
+        EXPECT_EQ(counts[i], i >= 41 && i <= 45 ? 0 : 1) << i;
+    EXPECT_EQ(file.get_stats().mold_duplicates, 35);
+    EXPECT_EQ(file.get_stats().mold_missing, 5);
+    EXPECT_EQ(file.get_stats().mold_late, 0);
+    std::filesystem::remove(fileName);
+}
+
+TEST(itch_pcap_file, soupBinStream)
+{
+    // a login, then sequenced data, as one byte stream
+    std::vector<uint8_t> stream;
+    soupbintcp::login_accepted accepted;
+    std::vector<unsigned char> login = accepted.get_record_as_vec();
+    stream.insert(stream.end(), login.begin(), login.end());
+    for(uint64_t i = 0; i < 200; ++i)
+    {
+        std::vector<uint8_t> record = make_record(i);
+        soupbintcp::sequenced_data data;
+        data.set_message(record);
+        std::vector<unsigned char> frame = data.get_record_as_vec();
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+    // cut it up so frames straddle segments
+    const uint32_t isn = 0xfffff000; // the sequence numbers wrap
+    std::vector<std::pair<uint32_t, std::vector<uint8_t>>> segments;
+    for(size_t pos = 0; pos < stream.size(); pos += 37)
+    {
+        size_t len = std::min<size_t>(37, stream.size() - pos);
+        segments.emplace_back(isn + 1 + pos, std::vector<uint8_t>(stream.begin() + pos, stream.begin() + pos + len));
+    }
+    pcap_writer writer;
+    uint64_t ts = START;
+    writer.add(ts++, make_frame(6, 26400, 50000, {}, isn, 0x02));
+    // the client's side only has ACKs
+    writer.add(ts++, make_frame(6, 50000, 26400, {}, 1234, 0x10));
+    for(size_t i = 0; i < segments.size(); ++i)
+    {
+        // 10 and 11 are swapped, 20 is sent twice
+        size_t idx = i == 10 ? 11 : i == 11 ? 10 : i;
+        writer.add(ts++, make_frame(6, 26400, 50000, segments[idx].second, segments[idx].first, 0x18));
+        if (i == 20)
+            writer.add(ts++, make_frame(6, 26400, 50000, segments[idx].second, segments[idx].first, 0x18));
+    }
+    std::string fileName = writer.save("itch_pcap_file_soup.pcap");
+    itch::pcap_file file(fileName);
+    uint64_t expectedRef = 0;
+    uint64_t lastTimestamp = 0;
+    file.for_each([&](uint64_t timestamp, const uint8_t* record, uint16_t length) {
+        EXPECT_EQ(record[0], 'D');
+        EXPECT_EQ(itch::get_int(record, itch::order_delete::ORDER_REFERENCE_NUMBER), expectedRef++);
+        EXPECT_GE(timestamp, lastTimestamp);
+        lastTimestamp = timestamp;
+    });
+    EXPECT_EQ(expectedRef, 200);
+    EXPECT_EQ(file.get_stats().out_of_order, 1);
+    EXPECT_EQ(file.get_stats().retransmitted, 37);
+    EXPECT_EQ(file.get_stats().tcp_gaps, 0);
+    // can be read again
+    EXPECT_EQ(file.for_each([](uint64_t, const uint8_t*, uint16_t) {}), 200);
+    std::filesystem::remove(fileName);
+
+    // the capture starts part way through a frame, so bytes are dropped until the framing is found
+    pcap_writer lateWriter;
+    for(size_t i = 3; i < segments.size(); ++i)
+        lateWriter.add(ts++, make_frame(6, 26400, 50000, segments[i].second, segments[i].first, 0x18));
+    std::string lateFileName = lateWriter.save("itch_pcap_file_soup_late.pcap");
+    itch::pcap_file lateFile(lateFileName);
+    expectedRef = 0;
+    lateFile.for_each([&](uint64_t, const uint8_t* record, uint16_t length) {
+        EXPECT_EQ(record[0], 'D');
+        EXPECT_EQ(length, itch::ORDER_DELETE_LEN);
+        uint64_t ref = itch::get_int(record, itch::order_delete::ORDER_REFERENCE_NUMBER);
+        if (expectedRef != 0)
+        {
+            EXPECT_EQ(ref, expectedRef);
+        }
+        expectedRef = ref + 1;
+    });
+    EXPECT_EQ(expectedRef, 200);
+    EXPECT_GT(lateFile.get_stats().resync_bytes, 0);
+    EXPECT_LT(lateFile.get_stats().resync_bytes, itch::ORDER_DELETE_LEN + 3);
+    std::filesystem::remove(lateFileName);
+}
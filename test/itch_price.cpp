@@ -0,0 +1,98 @@
+#include "itch.h"
+#include "ouch.h"
+#include <gtest/gtest.h>
+
+TEST(itch_price, arithmetic)
+{
+    itch::price4 a = itch::price4::from_parts(12, 3400);
+    EXPECT_EQ(a.raw(), 123400);
+    EXPECT_EQ(a.units(), 12);
+    EXPECT_EQ(a.fraction(), 3400);
+    EXPECT_EQ(a + itch::price4(100), itch::price4(123500));
+    EXPECT_EQ(a - itch::price4(123500), itch::price4(-100));
+    EXPECT_EQ(a * 3, itch::price4(370200));
+    // rounds half away from zero
+    EXPECT_EQ(itch::price4(5) / 2, itch::price4(3));
+    EXPECT_EQ(itch::price4(-5) / 2, itch::price4(-3));
+    EXPECT_EQ(itch::price4(5) / -2, itch::price4(-3));
+    EXPECT_EQ(itch::price4(4) / 3, itch::price4(1));
+    EXPECT_DOUBLE_EQ(a.to_double(), 12.34);
+
+    // across scales
+    itch::price8 b(1234000000);
+    EXPECT_TRUE(a == b);
+    EXPECT_TRUE(a < itch::price8(1234000001));
+    EXPECT_TRUE(itch::price8(1233999999) < a);
+    EXPECT_TRUE(a >= b);
+    EXPECT_EQ(a.rescale<8>(), b);
+    EXPECT_EQ(itch::price8(1234005000).rescale<4>(), itch::price4(123401));
+    EXPECT_EQ(itch::price8(1234004999).rescale<4>(), itch::price4(123400));
+    EXPECT_EQ(itch::price8(-1234005000).rescale<4>(), itch::price4(-123401));
+    // would overflow 64 bits if widened there
+    EXPECT_TRUE(itch::price4(INT64_MAX) > itch::price8(INT64_MAX));
+}
+
+TEST(itch_price, chars)
+{
+    char buf[32];
+    char* end = itch::price4(123400).to_chars(buf, buf + sizeof(buf));
+    EXPECT_EQ(std::string(buf, end), "12.3400");
+    EXPECT_EQ(itch::price4(5).to_string(), "0.0005");
+    EXPECT_EQ(itch::price4(-5).to_string(), "-0.0005");
+    EXPECT_EQ(itch::price4(0).to_string(), "0.0000");
+    EXPECT_EQ(itch::price8(INT64_MIN).to_string(), "-92233720368.54775808");
+    EXPECT_EQ(itch::fixed_price<0>(42).to_string(), "42");
+    // no room
+    EXPECT_EQ(itch::price4(123400).to_chars(buf, buf + 6), nullptr);
+
+    itch::price4 parsed;
+    itch::price8 parsed8;
+    std::string in = "12.34";
+    EXPECT_TRUE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    EXPECT_EQ(parsed, itch::price4(123400));
+    in = "-7";
+    EXPECT_TRUE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    EXPECT_EQ(parsed, itch::price4(-70000));
+    in = "1.23456";
+    EXPECT_FALSE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    in = "1.2x";
+    EXPECT_FALSE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    in = "-";
+    EXPECT_FALSE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    // a point is not a number
+    for(std::string bad : {"", ".", "-.", "--1"})
+        EXPECT_FALSE(itch::price4::from_chars(bad.data(), bad.data() + bad.size(), parsed)) << bad;
+    in = ".5";
+    EXPECT_TRUE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    EXPECT_EQ(parsed, itch::price4(5000));
+    // as big as it gets, and one more
+    in = "922337203685477.5807";
+    EXPECT_TRUE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    EXPECT_EQ(parsed.raw(), INT64_MAX);
+    in = "922337203685477.5808";
+    EXPECT_FALSE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+    in = "-92233720368.54775808";
+    EXPECT_TRUE(itch::price8::from_chars(in.data(), in.data() + in.size(), parsed8));
+    EXPECT_EQ(parsed8.raw(), INT64_MIN);
+    in = "99999999999999999999";
+    EXPECT_FALSE(itch::price4::from_chars(in.data(), in.data() + in.size(), parsed));
+}
+
+TEST(itch_price, fields)
+{
+    itch::add_order order;
+    order.set_price(order.PRICE, itch::price4::from_parts(101, 2500));
+    EXPECT_EQ(order.get_int(order.PRICE), 1012500);
+    EXPECT_EQ(order.get_price4(order.PRICE), itch::price4(1012500));
+    EXPECT_EQ(itch::get_price4(order.get_record(), itch::add_order::PRICE).to_string(), "101.2500");
+
+    itch::mwcp_decline_level mwcb;
+    mwcb.set_price(mwcb.LEVEL_1, itch::price8::from_parts(3500, 12345678));
+    EXPECT_EQ(mwcb.get_price8(mwcb.LEVEL_1).to_string(), "3500.12345678");
+    EXPECT_EQ(itch::get_price8(mwcb.get_record(), itch::mwcp_decline_level::LEVEL_1).rescale<4>(), itch::price4(35001235));
+
+    ouch::enter_order enter;
+    enter.set_price(enter.PRICE, ouch::price4::from_parts(25));
+    EXPECT_EQ(enter.get_int(enter.PRICE), 250000);
+    EXPECT_EQ(enter.get_price4(enter.PRICE).to_string(), "25.0000");
+}
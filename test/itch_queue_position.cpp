@@ -0,0 +1,172 @@
+#include "itch_queue_position.h"
+#include "itch_generator.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <tuple>
+
+namespace
+{
+
+itch::order_cancel make_cancel(uint64_t reference, uint32_t shares)
+{
+    itch::order_cancel msg;
+    msg.set_int(msg.ORDER_REFERENCE_NUMBER, reference);
+    msg.set_int(msg.CANCELLED_SHARES, shares);
+    return msg;
+}
+
+itch::order_delete make_delete(uint64_t reference)
+{
+    itch::order_delete msg;
+    msg.set_int(msg.ORDER_REFERENCE_NUMBER, reference);
+    return msg;
+}
+
+itch::order_replace make_replace(uint64_t original, uint64_t reference, uint32_t price, uint32_t shares)
+{
+    itch::order_replace msg;
+    msg.set_int(msg.ORIGINAL_ORDER_REFERENCE_NUMBER, original);
+    msg.set_int(msg.NEW_ORDER_REFERENCE_NUMBER, reference);
+    msg.set_int(msg.PRICE, price);
+    msg.set_int(msg.SHARES, shares);
+    return msg;
+}
+
+class test_tracker : public itch::queue_position_tracker
+{
+    public:
+    std::vector<itch::queue_position> done;
+    size_t updates = 0;
+
+    protected:
+    virtual void on_position(const itch::queue_position& pos) override { updates++; }
+    virtual void on_own_done(const itch::queue_position& pos) override { done.push_back(pos); }
+};
+
+} // namespace
+
+TEST(itch_queue_position, level)
+{
+    test_tracker tracker;
+    tracker.apply(itch_test::make_add(1, 5, 'B', 100000, 200));
+    tracker.apply(itch_test::make_add(2, 5, 'B', 100000, 300));
+    // our order is accepted, then shows up on the feed
+    ouch::order_accepted accepted;
+    accepted.set_int(accepted.ORDER_REFERENCE_NUMBER, 10);
+    tracker.add_own(accepted);
+    ASSERT_NE(tracker.get_position(10), nullptr);
+    EXPECT_FALSE(tracker.get_position(10)->on_book);
+    tracker.apply(itch_test::make_add(10, 5, 'B', 100000, 100));
+    const itch::queue_position* pos = tracker.get_position(10);
+    ASSERT_NE(pos, nullptr);
+    EXPECT_TRUE(pos->on_book);
+    EXPECT_EQ(pos->shares_ahead, 500);
+    EXPECT_EQ(pos->orders_ahead, 2);
+    EXPECT_EQ(pos->shares, 100);
+    // behind us, another price, another instrument
+    tracker.apply(itch_test::make_add(3, 5, 'B', 100000, 400));
+    tracker.apply(itch_test::make_add(4, 5, 'B', 99000, 300));
+    tracker.apply(itch_test::make_add(5, 6, 'B', 100000, 300));
+    EXPECT_EQ(pos->shares_ahead, 500);
+    // those ahead execute and cancel
+    itch::order_executed exec;
+    exec.set_int(exec.ORDER_REFERENCE_NUMBER, 1);
+    exec.set_int(exec.EXECUTED_SHARES, 50);
+    tracker.apply(exec);
+    EXPECT_EQ(pos->shares_ahead, 450);
+    tracker.apply(make_cancel(2, 100));
+    EXPECT_EQ(pos->shares_ahead, 350);
+    tracker.apply(make_delete(1));
+    EXPECT_EQ(pos->shares_ahead, 200);
+    EXPECT_EQ(pos->orders_ahead, 1);
+    // those behind or elsewhere do not matter
+    tracker.apply(make_cancel(3, 100));
+    tracker.apply(make_delete(4));
+    tracker.apply(make_delete(5));
+    EXPECT_EQ(pos->shares_ahead, 200);
+    // a replace goes to the back
+    tracker.apply(make_replace(2, 20, 100000, 500));
+    EXPECT_EQ(pos->shares_ahead, 0);
+    EXPECT_EQ(pos->orders_ahead, 0);
+    // we get a partial fill, then replace to another price, behind what is there
+    tracker.apply(itch_test::make_add(6, 5, 'B', 99000, 300));
+    exec.set_int(exec.ORDER_REFERENCE_NUMBER, 10);
+    exec.set_int(exec.EXECUTED_SHARES, 40);
+    tracker.apply(exec);
+    EXPECT_EQ(pos->shares, 60);
+    tracker.apply(make_replace(10, 11, 99000, 100));
+    EXPECT_EQ(tracker.get_position(10), nullptr);
+    ASSERT_EQ(tracker.done.size(), 1);
+    EXPECT_EQ(tracker.done[0].reference, 10);
+    pos = tracker.get_position(11);
+    ASSERT_NE(pos, nullptr);
+    EXPECT_EQ(pos->price, 99000);
+    EXPECT_EQ(pos->shares_ahead, 300);
+    tracker.apply(make_delete(11));
+    EXPECT_EQ(tracker.get_position(11), nullptr);
+    EXPECT_EQ(tracker.done.size(), 2);
+    EXPECT_EQ(tracker.get_own_count(), 0);
+
+    // the feed beat OUCH
+    tracker.apply(itch_test::make_add(30, 7, 'S', 101000, 100));
+    tracker.apply(itch_test::make_add(31, 7, 'S', 101000, 200));
+    tracker.apply(itch_test::make_add(32, 7, 'S', 101000, 300));
+    tracker.add_own(31);
+    ASSERT_NE(tracker.get_position(31), nullptr);
+    EXPECT_EQ(tracker.get_position(31)->shares_ahead, 100);
+    EXPECT_EQ(tracker.get_position(31)->orders_ahead, 1);
+    tracker.remove_own(31);
+    EXPECT_EQ(tracker.get_position(31), nullptr);
+    tracker.apply(make_delete(30));
+}
+
+TEST(itch_queue_position, matchesBook)
+{
+    // every 20th add is ours, checked against a walk of the whole book
+    itch::generator::options opts;
+    opts.symbols = 5;
+    opts.messages = 50000;
+    itch::generator gen(opts);
+    test_tracker tracker;
+    size_t adds = 0;
+    size_t count = 0;
+    gen.for_each([&](const uint8_t* record, uint16_t length) {
+        if (record[0] == 'A' && adds++ % 20 == 0)
+            tracker.add_own(itch::get_int(record, itch::add_order::ORDER_REFERENCE_NUMBER));
+        tracker.apply(record);
+        if (++count % 500 != 0)
+            return;
+        // the book in queue order, level by level
+        std::vector<itch::order> orders;
+        tracker.get_book().for_each_order([&orders](const itch::order& curr) { orders.push_back(curr); });
+        std::sort(orders.begin(), orders.end(), [](const itch::order& lhs, const itch::order& rhs) {
+            return std::tie(lhs.locate, lhs.side, lhs.price, lhs.priority)
+                    < std::tie(rhs.locate, rhs.side, rhs.price, rhs.priority);
+        });
+        uint64_t shares = 0;
+        uint32_t ahead = 0;
+        for(size_t i = 0; i < orders.size(); ++i)
+        {
+            const itch::order& curr = orders[i];
+            if (i == 0 || curr.locate != orders[i - 1].locate || curr.side != orders[i - 1].side
+                    || curr.price != orders[i - 1].price)
+            {
+                shares = 0;
+                ahead = 0;
+            }
+            const itch::queue_position* pos = tracker.get_position(curr.reference);
+            if (pos != nullptr)
+            {
+                ASSERT_EQ(pos->shares_ahead, shares) << curr.reference;
+                ASSERT_EQ(pos->orders_ahead, ahead);
+                ASSERT_EQ(pos->shares, curr.shares);
+            }
+            shares += curr.shares;
+            ahead++;
+        }
+    });
+    EXPECT_GT(tracker.get_own_count(), 0);
+    EXPECT_GT(tracker.done.size(), 0);
+    EXPECT_GT(tracker.updates, 0);
+}
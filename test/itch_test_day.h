@@ -0,0 +1,82 @@
+#pragma once
+#include "itch.h"
+#include "itch_file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/***
+ * Building ITCH days for the tests. A day is a buffer of records, each behind its 2 byte
+ * (big endian) length, the same layout as an ITCH file.
+ */
+namespace itch_test
+{
+
+/***
+ * Add a record to the end of a day
+ */
+inline void append(std::vector<uint8_t>& day, const uint8_t* record, uint16_t length)
+{
+    size_t pos = day.size();
+    day.resize(pos + itch::RECORD_LENGTH_LEN + length);
+    uint16_t sz = itch::swap_endian_bytes<uint16_t>(length);
+    memcpy(&day[pos], &sz, itch::RECORD_LENGTH_LEN);
+    memcpy(&day[pos + itch::RECORD_LENGTH_LEN], record, length);
+}
+
+template<unsigned int SIZE>
+void append(std::vector<uint8_t>& day, const itch::message<SIZE>& msg)
+{
+    append(day, msg.get_record(), SIZE);
+}
+
+/***
+ * @returns where each record of a day starts, after its length
+ */
+inline std::vector<const uint8_t*> split_day(const std::vector<uint8_t>& day)
+{
+    std::vector<const uint8_t*> retVal;
+    itch::for_each_record(day.data(), day.size(), [&retVal](const uint8_t* record, uint16_t) {
+        retVal.push_back(record);
+    });
+    return retVal;
+}
+
+/***
+ * Write a day to the temp directory
+ * @returns the full name of the file
+ */
+inline std::string write_day(const std::string& name, const std::vector<uint8_t>& day)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(fileName, std::ios::binary | std::ios::trunc);
+    out.write((const char*)day.data(), day.size());
+    return fileName;
+}
+
+/***
+ * @returns the whole of a file
+ */
+inline std::string read_all(const std::string& fileName)
+{
+    std::ifstream in(fileName, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+inline itch::add_order make_add(uint64_t reference, uint16_t locate, char side, uint32_t price, uint32_t shares,
+        uint64_t timestamp = 0)
+{
+    itch::add_order msg;
+    msg.set_int(msg.STOCK_LOCATE, locate);
+    msg.set_int(msg.TIMESTAMP, timestamp);
+    msg.set_int(msg.ORDER_REFERENCE_NUMBER, reference);
+    msg.set_char(msg.BUY_SELL_INDICATOR, side);
+    msg.set_int(msg.PRICE, price);
+    msg.set_int(msg.SHARES, shares);
+    return msg;
+}
+
+} // namespace itch_test
@@ -0,0 +1,91 @@
+#include "itch_uring_file.h"
+#include "itch_locate_filter.h"
+#include "itch_test_day.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+
+namespace
+{
+
+std::vector<uint8_t> build_day(size_t count)
+{
+    std::vector<uint8_t> day;
+    for(size_t i = 0; i < count; ++i)
+    {
+        // mixed lengths, so records land across buffer boundaries in different ways
+        if (i % 3 == 0)
+        {
+            itch::order_delete msg;
+            msg.set_int(msg.STOCK_LOCATE, 1 + i % 10);
+            msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+            itch_test::append(day, msg);
+        }
+        else
+        {
+            itch::trade msg;
+            msg.set_int(msg.STOCK_LOCATE, 1 + i % 10);
+            msg.set_int(msg.ORDER_REFERENCE_NUMBER, i);
+            itch_test::append(day, msg);
+        }
+    }
+    return day;
+}
+
+} // namespace
+
+TEST(itch_uring_file, readsInOrder)
+{
+    std::string fileName = itch_test::write_day("itch_uring_file_test.itch", build_day(50000));
+    itch::uring_file file(fileName, 4096, 4);
+    EXPECT_EQ(file.size(), std::filesystem::file_size(fileName));
+    uint64_t expectedRef = 0;
+    size_t bad = 0;
+    size_t consumed = file.for_each([&](const uint8_t* record, uint16_t length) {
+        if (itch::get_int(record, itch::trade::ORDER_REFERENCE_NUMBER) != expectedRef++)
+            bad++;
+    });
+    EXPECT_EQ(bad, 0);
+    EXPECT_EQ(expectedRef, 50000);
+    EXPECT_EQ(consumed, file.size());
+    // and again
+    expectedRef = 0;
+    EXPECT_EQ(file.for_each([&](const uint8_t*, uint16_t) { expectedRef++; }), file.size());
+    EXPECT_EQ(expectedRef, 50000);
+
+    // the backends agree
+    std::vector<uint64_t> mmapRefs;
+    std::vector<uint64_t> uringRefs;
+    itch::for_each_in_file(fileName, itch::read_backend::MMAP, [&](const uint8_t* record, uint16_t) {
+        mmapRefs.push_back(itch::get_int(record, itch::trade::ORDER_REFERENCE_NUMBER));
+    });
+    itch::for_each_in_file(fileName, itch::read_backend::IO_URING, [&](const uint8_t* record, uint16_t) {
+        uringRefs.push_back(itch::get_int(record, itch::trade::ORDER_REFERENCE_NUMBER));
+    });
+    EXPECT_EQ(mmapRefs, uringRefs);
+
+    // with a filter, and going through the page cache
+    itch::uring_file cached(fileName, 8192, 2, false);
+    EXPECT_FALSE(cached.is_direct());
+    itch::locate_filter filter;
+    filter.subscribe((uint16_t)3);
+    size_t records = 0;
+    cached.for_each([&](const uint8_t* record, uint16_t) {
+        EXPECT_EQ(itch::get_stock_locate(record), 3);
+        records++;
+    }, filter);
+    EXPECT_EQ(records, 5000);
+    std::filesystem::remove(fileName);
+}
+
+TEST(itch_uring_file, earlyExit)
+{
+    std::string fileName = itch_test::write_day("itch_uring_file_exit.itch", build_day(10000));
+    itch::uring_file file(fileName, 4096, 8);
+    size_t records = 0;
+    EXPECT_THROW(file.for_each([&records](const uint8_t*, uint16_t) {
+        if (++records == 100)
+            throw std::runtime_error("stop");
+    }), std::runtime_error);
+    std::filesystem::remove(fileName);
+    EXPECT_THROW(itch::uring_file("/does/not/exist.itch"), std::invalid_argument);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "mold_udp64_receiver.h"
+#include "mold_udp64_publisher.h"
+#include "itch_file.h"
+#include <vector>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+std::vector<uint8_t> build_packet(const std::string& session, uint64_t seqNo, const std::vector<std::string>& msgs)
+{
+    std::vector<uint8_t> pkt(moldudp64::HEADER_LEN, ' ');
+    memcpy(pkt.data(), session.c_str(), std::min<size_t>(session.size(), moldudp64::SESSION_LEN));
+    moldudp64::write_big_endian<uint64_t>(&pkt[moldudp64::header::SEQUENCE_NUMBER.offset], seqNo);
+    moldudp64::write_big_endian<uint16_t>(&pkt[moldudp64::header::MESSAGE_COUNT.offset], msgs.size());
+    for(const auto& m : msgs)
+    {
+        size_t pos = pkt.size();
+        pkt.resize(pos + moldudp64::MESSAGE_LENGTH_LEN + m.size());
+        moldudp64::write_big_endian<uint16_t>(&pkt[pos], m.size());
+        memcpy(&pkt[pos + moldudp64::MESSAGE_LENGTH_LEN], m.c_str(), m.size());
+    }
+    return pkt;
+}
+
+class MyReceiver : public MoldUDP64Receiver
+{
+    public:
+    MyReceiver(const std::string& group, uint16_t port, const std::string& rewind)
+            : MoldUDP64Receiver(group, port, "127.0.0.1", rewind) {}
+    virtual void on_message(uint64_t seqNo, const uint8_t* data, uint16_t length) override
+    {
+        seqNos.push_back(seqNo);
+        messages.emplace_back((const char*)data, length);
+    }
+    virtual void on_gap(uint64_t first, uint64_t last) override { gaps.emplace_back(first, last); }
+    std::vector<uint64_t> seqNos;
+    std::vector<std::string> messages;
+    std::vector<std::pair<uint64_t, uint64_t>> gaps;
+};
+
+} // namespace
+
+TEST(MoldUDP64, PacketView)
+{
+    std::vector<uint8_t> pkt = build_packet("SESSION001", 10, {"ABC", "DE", "F"});
+    moldudp64::packet_view view(pkt.data(), pkt.size());
+    EXPECT_TRUE(view.valid());
+    EXPECT_EQ(view.sequence_number(), 10);
+    EXPECT_EQ(view.message_count(), 3);
+    EXPECT_EQ(std::string(view.session(), moldudp64::SESSION_LEN), "SESSION001");
+    std::vector<std::string> found;
+    uint16_t walked = view.for_each_message([&](uint64_t seqNo, const uint8_t* data, uint16_t length) {
+        found.push_back(std::to_string(seqNo) + std::string((const char*)data, length));
+    }, 1);
+    EXPECT_EQ(walked, 3);
+    ASSERT_EQ(found.size(), 2);
+    EXPECT_EQ(found[0], "11DE");
+    EXPECT_EQ(found[1], "12F");
+    // chop the last message in half
+    moldudp64::packet_view truncated(pkt.data(), pkt.size() - 2);
+    EXPECT_EQ(truncated.for_each_message([](uint64_t, const uint8_t*, uint16_t) {}), 2);
+}
+
+TEST(MoldUDP64, LoopbackGapAndRewind)
+{
+    const std::string group = "239.192.10.1";
+    const uint16_t port = 31210;
+    // the rewind server
+    boost::asio::io_context ctx;
+    boost::asio::ip::udp::socket rewind(ctx, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address_v4("127.0.0.1"), 0));
+    std::string rewindAddress = "127.0.0.1:" + std::to_string(rewind.local_endpoint().port());
+    MyReceiver receiver(group, port, rewindAddress);
+    // the publisher
+    boost::asio::ip::udp::socket sender(ctx, boost::asio::ip::udp::v4());
+    sender.set_option(boost::asio::ip::multicast::outbound_interface(boost::asio::ip::make_address_v4("127.0.0.1")));
+    sender.set_option(boost::asio::ip::multicast::enable_loopback(true));
+    boost::asio::ip::udp::endpoint groupEndpoint(boost::asio::ip::make_address_v4(group), port);
+
+    auto pkt1 = build_packet("SESSION001", 1, {"one", "two"});
+    auto pkt2 = build_packet("SESSION001", 3, {"three"});
+    auto pkt3 = build_packet("SESSION001", 4, {"four", "five"});
+    sender.send_to(boost::asio::buffer(pkt1), groupEndpoint);
+    // pkt2 is "lost"
+    sender.send_to(boost::asio::buffer(pkt3), groupEndpoint);
+    size_t processed = 0;
+    for(int i = 0; i < 10 && processed < 2; ++i)
+        processed += receiver.poll(100);
+    EXPECT_EQ(processed, 2);
+    ASSERT_EQ(receiver.gaps.size(), 1);
+    EXPECT_EQ(receiver.gaps[0].first, 3);
+    EXPECT_EQ(receiver.gaps[0].second, 3);
+    EXPECT_EQ(receiver.get_next_seq(), 3);
+    EXPECT_EQ(receiver.get_stats().requests_sent, 1);
+
+    // the rewind server should have been asked for 3 messages starting at 3
+    uint8_t buf[64];
+    boost::asio::ip::udp::endpoint requester;
+    size_t len = rewind.receive_from(boost::asio::buffer(buf), requester);
+    ASSERT_EQ(len, moldudp64::REQUEST_LEN);
+    moldudp64::request_packet req(buf);
+    EXPECT_EQ(req.session(), "SESSION001");
+    EXPECT_EQ(req.sequence_number(), 3);
+    EXPECT_EQ(req.requested_message_count(), 3);
+    // answered in two packets, the first one is not a reason to ask again
+    auto resend1 = build_packet("SESSION001", 3, {"three"});
+    rewind.send_to(boost::asio::buffer(resend1), requester);
+    for(int i = 0; i < 10 && receiver.get_next_seq() < 4; ++i)
+        receiver.poll(10);
+    EXPECT_EQ(receiver.get_next_seq(), 4);
+    auto resend2 = build_packet("SESSION001", 4, {"four", "five"});
+    rewind.send_to(boost::asio::buffer(resend2), requester);
+    for(int i = 0; i < 10 && receiver.get_next_seq() < 6; ++i)
+        receiver.poll(10);
+
+    EXPECT_EQ(receiver.get_next_seq(), 6);
+    EXPECT_EQ(receiver.get_stats().requests_sent, 1);
+    std::vector<std::string> expected{"one", "two", "three", "four", "five"};
+    EXPECT_EQ(receiver.messages, expected);
+    std::vector<uint64_t> expectedSeqNos{1, 2, 3, 4, 5};
+    EXPECT_EQ(receiver.seqNos, expectedSeqNos);
+
+    // a late copy of pkt3 changes nothing
+    sender.send_to(boost::asio::buffer(pkt3), groupEndpoint);
+    receiver.poll(500);
+    EXPECT_EQ(receiver.messages.size(), 5);
+    EXPECT_EQ(receiver.get_stats().duplicates, 1);
+}
+
+TEST(MoldUDP64, PublisherWithLossAndReordering)
+{
+    const std::string group = "239.192.10.2";
+    const uint16_t port = 31211;
+    const uint64_t numMessages = 2000;
+    // build an "ITCH file" in memory
+    std::vector<uint8_t> file;
+    for(uint64_t i = 1; i <= numMessages; ++i)
+    {
+        itch::system_event msg(0, i, i, 'O');
+        size_t pos = file.size();
+        file.resize(pos + itch::RECORD_LENGTH_LEN + msg.get_size());
+        moldudp64::write_big_endian<uint16_t>(&file[pos], msg.get_size());
+        memcpy(&file[pos + itch::RECORD_LENGTH_LEN], msg.get_record(), msg.get_size());
+    }
+    MoldUDP64MessageStore store(file.data(), file.size());
+    EXPECT_EQ(store.size(), numMessages);
+
+    MoldUDP64Publisher::Options options;
+    options.maxMessagesPerPacket = 10;
+    options.batchSize = 8;
+    options.dropRate = 0.1;
+    options.reorderRate = 0.1;
+    options.packetsPerSecond = 20000;
+    MoldUDP64Publisher publisher(store, "SESSION002", group, port, "127.0.0.1", 0, options);
+    MyReceiver receiver(group, port, "127.0.0.1:" + std::to_string(publisher.get_rewind_port()));
+    receiver.set_retransmit_timeout(20);
+    receiver.start();
+
+    EXPECT_EQ(publisher.publish(), numMessages);
+    EXPECT_EQ(publisher.get_next_seq(), numMessages + 1);
+    EXPECT_GT(publisher.get_stats().packets_dropped, 0);
+    EXPECT_GT(publisher.get_stats().packets_reordered, 0);
+    // heartbeats let the receiver find losses at the tail
+    for(int i = 0; i < 200 && receiver.get_next_seq() <= numMessages; ++i)
+    {
+        publisher.send_heartbeat();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    receiver.stop();
+    ASSERT_EQ(receiver.get_next_seq(), numMessages + 1);
+    ASSERT_EQ(receiver.seqNos.size(), numMessages);
+    for(uint64_t i = 0; i < numMessages; ++i)
+    {
+        EXPECT_EQ(receiver.seqNos[i], i + 1);
+        itch::system_event msg((const uint8_t*)receiver.messages[i].c_str());
+        EXPECT_EQ(msg.get_int(itch::system_event::TRACKING_NUMBER), i + 1);
+    }
+    EXPECT_GT(receiver.get_stats().gaps, 0);
+    EXPECT_GT(publisher.get_stats().retransmitted_packets, 0);
+}
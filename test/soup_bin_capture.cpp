@@ -0,0 +1,104 @@
+#include "soup_bin_capture.h"
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+
+namespace
+{
+
+std::vector<unsigned char> make_payload(size_t i)
+{
+    std::string msg = "Frame" + std::to_string(i) + std::string(i % 50, 'x');
+    return std::vector<unsigned char>(msg.begin(), msg.end());
+}
+
+std::vector<unsigned char> make_frame(size_t i)
+{
+    soupbintcp::sequenced_data data;
+    data.set_message(make_payload(i));
+    return data.get_record_as_vec();
+}
+
+} // namespace
+
+TEST(SoupBinCapture, roundTrip)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() / "capture_round_trip.cap").string();
+    const size_t count = 20000;
+    uint64_t expectedSize = 0;
+    {
+        // small blocks so that plenty of full blocks go out, and a ring the writer has to keep up with
+        SoupBinCapture capture(fileName, 128 * 1024, 4096, 64 * 1024, true);
+        for(size_t i = 0; i < count; ++i)
+        {
+            std::vector<unsigned char> frame = make_frame(i);
+            while(!capture.capture(frame.data(), frame.size(), i + 1))
+                std::this_thread::yield();
+            expectedSize += SoupBinCapture::TIMESTAMP_LEN + frame.size();
+        }
+        capture.flush();
+        EXPECT_EQ(capture.get_written(), expectedSize);
+        EXPECT_EQ(capture.get_captured(), count);
+        // capturing is all that happens after a flush, nothing waits on the disk
+        std::vector<unsigned char> frame = make_frame(count);
+        EXPECT_TRUE(capture.capture(frame.data(), frame.size(), count + 1));
+        expectedSize += SoupBinCapture::TIMESTAMP_LEN + frame.size();
+    }
+    EXPECT_EQ(std::filesystem::file_size(fileName), expectedSize);
+    size_t next = 0;
+    uint64_t frames = SoupBinCapture::for_each(fileName, [&next](uint64_t timestamp, const uint8_t* frame, size_t length) {
+        std::vector<unsigned char> expected = make_frame(next);
+        EXPECT_EQ(timestamp, next + 1);
+        ASSERT_EQ(length, expected.size());
+        EXPECT_EQ(memcmp(frame, expected.data(), length), 0);
+        next++;
+    });
+    EXPECT_EQ(frames, count + 1);
+    std::filesystem::remove(fileName);
+}
+
+TEST(SoupBinCapture, connection)
+{
+    class CapturingConnection : public SoupBinConnection
+    {
+        public:
+        CapturingConnection(boost::asio::ip::tcp::socket socket, MessageRepeater* parent)
+                : SoupBinConnection(std::move(socket), parent) {}
+        CapturingConnection(const std::string& url, SoupBinCapture* capture)
+                : SoupBinConnection(url, "test1", "password")
+        {
+            set_capture(capture);
+            connect();
+        }
+    };
+    std::string fileName = (std::filesystem::temp_directory_path() / "capture_connection.cap").string();
+    SoupBinCapture capture(fileName);
+    SoupBinServer<CapturingConnection> server(9013);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    uint64_t start = SoupBinCapture::now();
+    CapturingConnection client("127.0.0.1:9013", &capture);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(size_t i = 0; i < 3; ++i)
+        server.send_sequenced(make_payload(i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    capture.close();
+
+    std::vector<char> types;
+    size_t sequenced = 0;
+    SoupBinCapture::for_each(fileName, [&](uint64_t timestamp, const uint8_t* frame, size_t length) {
+        EXPECT_GE(timestamp, start);
+        types.push_back(frame[2]);
+        if (frame[2] == 'S')
+        {
+            std::vector<unsigned char> expected = make_frame(sequenced);
+            EXPECT_EQ(std::vector<unsigned char>(frame, frame + length), expected);
+            sequenced++;
+        }
+    });
+    ASSERT_FALSE(types.empty());
+    EXPECT_EQ(types[0], 'A');
+    EXPECT_EQ(sequenced, 3);
+    EXPECT_EQ(capture.get_dropped(), 0);
+    std::filesystem::remove(fileName);
+}
@@ -0,0 +1,221 @@
+#include "soup_bin_journal.h"
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+
+std::string temp_journal(const std::string& name)
+{
+    std::string fileName = (std::filesystem::temp_directory_path() / name).string();
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(fileName + ".idx");
+    return fileName;
+}
+
+std::string payload(const unsigned char* data, size_t length) { return std::string((const char*)data, length); }
+
+// write over 8 bytes of a file, to damage an index
+void patch(const std::string& fileName, uint64_t offset, uint64_t value)
+{
+    std::fstream file(fileName, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(offset);
+    file.write((const char*)&value, sizeof(value));
+}
+
+} // namespace
+
+TEST(SoupBinJournal, reopen)
+{
+    std::string fileName = temp_journal("soup_bin_journal_reopen");
+    {
+        // small, so it has to grow
+        SoupBinJournal journal(fileName, 4096);
+        EXPECT_EQ(journal.get_next_sequence(), 0);
+        journal.start_session("    ABC", 1);
+        EXPECT_EQ(journal.get_next_sequence(), 1);
+        for(uint64_t seq = 1; seq <= 1000; ++seq)
+        {
+            std::string msg = "Message" + std::to_string(seq);
+            EXPECT_TRUE(journal.append(seq, (const unsigned char*)msg.data(), msg.size()));
+        }
+        // already there
+        EXPECT_FALSE(journal.append(1000, (const unsigned char*)"X", 1));
+        // the server skipped 1001 and 1002
+        EXPECT_TRUE(journal.append(1003, (const unsigned char*)"After", 5));
+    }
+    SoupBinJournal journal(fileName);
+    EXPECT_EQ(journal.get_session(), "    ABC");
+    EXPECT_EQ(journal.get_first_sequence(), 1);
+    EXPECT_EQ(journal.get_next_sequence(), 1004);
+    EXPECT_EQ(journal.get_count(), 1003);
+    size_t length = 0;
+    const unsigned char* data = journal.get(500, length);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(payload(data, length), "Message500");
+    EXPECT_EQ(journal.get(1001, length), nullptr);
+    EXPECT_EQ(journal.get(1004, length), nullptr);
+    EXPECT_EQ(journal.get(0, length), nullptr);
+
+    std::vector<uint64_t> seqs;
+    std::string last;
+    EXPECT_EQ(journal.replay([&](uint64_t seq, const unsigned char* data, size_t length) {
+        seqs.push_back(seq);
+        last = payload(data, length);
+    }, 998), 4);
+    EXPECT_EQ(seqs, std::vector<uint64_t>({998, 999, 1000, 1003}));
+    EXPECT_EQ(last, "After");
+    journal.sync();
+
+    // the same session carries on, a new one starts again
+    journal.start_session("    ABC", 1004);
+    EXPECT_EQ(journal.get_count(), 1003);
+    journal.start_session("    DEF", 1);
+    EXPECT_EQ(journal.get_count(), 0);
+    EXPECT_EQ(journal.get_next_sequence(), 1);
+    EXPECT_EQ(journal.replay([](uint64_t, const unsigned char*, size_t) {}), 0);
+
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(fileName + ".idx");
+}
+
+TEST(SoupBinJournal, damagedIndex)
+{
+    std::string fileName;
+    auto make = [&fileName]() {
+        fileName = temp_journal("soup_bin_journal_damaged");
+        SoupBinJournal journal(fileName, 4096);
+        journal.start_session("    ABC", 1);
+        for(uint64_t seq = 1; seq <= 3; ++seq)
+            journal.append(seq, (const unsigned char*)"Message", 7);
+    };
+    // the count is after the magic, the session and the first sequence
+    const uint64_t countAt = 32;
+    const uint64_t dataEndAt = 40;
+    const uint64_t offsetsAt = 4096;
+    make();
+    EXPECT_NO_THROW(SoupBinJournal journal(fileName));
+    // more entries than the index holds
+    patch(fileName + ".idx", countAt, UINT64_MAX / 16);
+    EXPECT_THROW(SoupBinJournal journal(fileName), std::invalid_argument);
+    // an entry past what was written
+    make();
+    patch(fileName + ".idx", offsetsAt + 8, 1000);
+    EXPECT_THROW(SoupBinJournal journal(fileName), std::invalid_argument);
+    // the length in front of the last entry fits, its payload does not
+    make();
+    patch(fileName + ".idx", dataEndAt, 9 * 2 + 4);
+    EXPECT_THROW(SoupBinJournal journal(fileName), std::invalid_argument);
+    // a skipped entry has nothing to check
+    make();
+    patch(fileName + ".idx", offsetsAt + 8, SoupBinJournal::MISSING);
+    EXPECT_NO_THROW(SoupBinJournal journal(fileName));
+
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(fileName + ".idx");
+}
+
+TEST(SoupBinJournal, resume)
+{
+    std::string fileName = temp_journal("soup_bin_journal_resume");
+    SoupBinServer<SoupBinConnection> server(9017);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    {
+        SoupBinJournal journal(fileName);
+        SoupBinConnection client("127.0.0.1:9017", "test1", "password", &journal);
+        client.connect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        for(int i = 1; i <= 5; ++i)
+        {
+            std::string msg = "Hello" + std::to_string(i);
+            server.send_sequenced(std::vector<unsigned char>(msg.begin(), msg.end()));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    // sent while the client was gone
+    for(int i = 6; i <= 7; ++i)
+    {
+        std::string msg = "Hello" + std::to_string(i);
+        server.send_sequenced(std::vector<unsigned char>(msg.begin(), msg.end()));
+    }
+
+    SoupBinJournal journal(fileName);
+    EXPECT_EQ(journal.get_next_sequence(), 6);
+    std::vector<std::string> replayed;
+    journal.replay([&replayed](uint64_t seq, const unsigned char* data, size_t length) {
+        replayed.push_back(payload(data, length));
+    });
+    ASSERT_EQ(replayed.size(), 5);
+    EXPECT_EQ(replayed[4], "Hello5");
+    {
+        // logs in at 6, and only 6 and 7 come again
+        SoupBinConnection client("127.0.0.1:9017", "test1", "password", &journal);
+        client.connect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        EXPECT_EQ(client.get_stats().packetsIn['S'], 2);
+        EXPECT_EQ(client.get_stats().sequenceGap, 0);
+        EXPECT_EQ(server.get_connection_stats().back().replayFrom, 6);
+    }
+    EXPECT_EQ(journal.get_next_sequence(), 8);
+    size_t length = 0;
+    const unsigned char* data = journal.get(7, length);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(payload(data, length), "Hello7");
+
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(fileName + ".idx");
+}
+
+TEST(SoupBinJournal, joinLate)
+{
+    std::string fileName = temp_journal("soup_bin_journal_join_late");
+    SoupBinServer<SoupBinConnection> server(9028);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // already under way when the journal starts
+    for(int i = 1; i <= 100; ++i)
+        server.send_sequenced({'O', 'l', 'd'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    {
+        SoupBinJournal journal(fileName);
+        SoupBinConnection client("127.0.0.1:9028", "test1", "password", &journal);
+        client.connect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        for(int i = 101; i <= 103; ++i)
+        {
+            std::string msg = "Hello" + std::to_string(i);
+            server.send_sequenced(std::vector<unsigned char>(msg.begin(), msg.end()));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        EXPECT_EQ(client.get_stats().packetsIn['S'], 3);
+    }
+    server.send_sequenced({'H', 'e', 'l', 'l', 'o', '1', '0', '4'});
+
+    // kept under the server's numbers
+    SoupBinJournal journal(fileName);
+    EXPECT_EQ(journal.get_first_sequence(), 101);
+    EXPECT_EQ(journal.get_next_sequence(), 104);
+    size_t length = 0;
+    const unsigned char* data = journal.get(101, length);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(payload(data, length), "Hello101");
+    EXPECT_EQ(journal.get(1, length), nullptr);
+    {
+        // logs in at 104, and only 104 comes again
+        SoupBinConnection client("127.0.0.1:9028", "test1", "password", &journal);
+        client.connect();
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        EXPECT_EQ(client.get_stats().packetsIn['S'], 1);
+        EXPECT_EQ(client.get_stats().lastSequence, 104);
+        EXPECT_EQ(server.get_connection_stats().back().replayFrom, 104);
+    }
+    EXPECT_EQ(journal.get_next_sequence(), 105);
+    data = journal.get(104, length);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(payload(data, length), "Hello104");
+
+    std::filesystem::remove(fileName);
+    std::filesystem::remove(fileName + ".idx");
+}
@@ -0,0 +1,153 @@
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace
+{
+
+const int PUBLISHERS = 4;
+const uint32_t PER_PUBLISHER = 5000;
+
+std::vector<unsigned char> make_payload(int publisher, uint32_t count)
+{
+    return { (unsigned char)publisher, (unsigned char)(count >> 24), (unsigned char)(count >> 16),
+            (unsigned char)(count >> 8), (unsigned char)count };
+}
+
+class CountedConnection : public SoupBinConnection
+{
+    public:
+    CountedConnection(boost::asio::ip::tcp::socket socket, MessageRepeater* parent)
+            : SoupBinConnection(std::move(socket), parent) { live++; }
+    ~CountedConnection() { live--; }
+    static std::atomic<int> live;
+};
+std::atomic<int> CountedConnection::live = 0;
+
+class PublishClient : public SoupBinConnection
+{
+    public:
+    PublishClient(const std::string& url, uint64_t nextSeq = 0) : SoupBinConnection(url, "test1", "password", "", nextSeq)
+    {
+        connect();
+    }
+    std::mutex mutex;
+    std::vector<std::vector<unsigned char>> received;
+
+    protected:
+    virtual void on_sequenced_data(const soupbintcp::sequenced_data& in) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(in.get_message());
+    }
+};
+
+/***
+ * Each publisher's messages, in the order they arrived
+ */
+void check_order(const std::vector<std::vector<unsigned char>>& in)
+{
+    std::vector<uint32_t> next(PUBLISHERS, 0);
+    for(const auto& msg : in)
+    {
+        ASSERT_EQ(msg.size(), 5);
+        ASSERT_LT(msg[0], PUBLISHERS);
+        uint32_t count = ((uint32_t)msg[1] << 24) | ((uint32_t)msg[2] << 16) | ((uint32_t)msg[3] << 8) | msg[4];
+        ASSERT_EQ(count, next[msg[0]]);
+        next[msg[0]]++;
+    }
+    for(int i = 0; i < PUBLISHERS; ++i)
+        EXPECT_EQ(next[i], PER_PUBLISHER);
+}
+
+} // namespace
+
+TEST(SoupBinPublishQueue, producers)
+{
+    SoupBinPublishQueue queue;
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> wakeups = 0;
+    for(int i = 0; i < PUBLISHERS; ++i)
+        threads.emplace_back([&queue, &wakeups, i]() {
+            for(uint32_t j = 0; j < PER_PUBLISHER; ++j)
+                if (queue.push(SoupBinPublishQueue::Kind::SEQUENCED, SoupBinConnection::make_frame('S', make_payload(i, j))))
+                    wakeups++;
+        });
+    std::vector<std::vector<unsigned char>> popped;
+    while(popped.size() < PUBLISHERS * PER_PUBLISHER)
+    {
+        queue.start_drain();
+        while(SoupBinPublishQueue::Node* node = queue.next())
+        {
+            popped.emplace_back(node->frame->begin() + 3, node->frame->end());
+            delete node;
+        }
+    }
+    for(auto& t : threads)
+        t.join();
+    EXPECT_EQ(queue.next(), nullptr);
+    EXPECT_GE(wakeups, 1);
+    check_order(popped);
+}
+
+TEST(SoupBinPublishQueue, server)
+{
+    SoupBinServer<SoupBinConnection> server(9023);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    PublishClient early("127.0.0.1:9023");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < PUBLISHERS; ++i)
+        threads.emplace_back([&server, i]() {
+            for(uint32_t j = 0; j < PER_PUBLISHER; ++j)
+                server.send_sequenced(make_payload(i, j));
+        });
+    // joins while they publish, and catches up from the start
+    PublishClient late("127.0.0.1:9023", 1);
+    for(auto& t : threads)
+        t.join();
+
+    for(int i = 0; i < 100; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::lock_guard<std::mutex> lock1(early.mutex);
+        std::lock_guard<std::mutex> lock2(late.mutex);
+        if (early.received.size() >= PUBLISHERS * PER_PUBLISHER && late.received.size() >= PUBLISHERS * PER_PUBLISHER)
+            break;
+    }
+    std::lock_guard<std::mutex> lock1(early.mutex);
+    std::lock_guard<std::mutex> lock2(late.mutex);
+    ASSERT_EQ(early.received.size(), PUBLISHERS * PER_PUBLISHER);
+    check_order(early.received);
+    // the same numbering for everyone
+    EXPECT_TRUE(early.received == late.received);
+    EXPECT_EQ(server.get_connections()->size(), 2);
+    EXPECT_EQ(server.get_stats().packetsOut['S'], 2 * PUBLISHERS * PER_PUBLISHER);
+}
+
+TEST(SoupBinPublishQueue, closedConnectionsReleased)
+{
+    const int CLIENTS = 5;
+    SoupBinServer<CountedConnection> server(9026);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(int i = 0; i < CLIENTS; ++i)
+    {
+        PublishClient client("127.0.0.1:9026");
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        server.send_sequenced(make_payload(0, i));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_EQ(CountedConnection::live, 1);
+    }
+    for(int i = 0; i < 20 && CountedConnection::live > 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(CountedConnection::live, 0);
+    EXPECT_EQ(server.get_connections()->size(), 0);
+    // the stats outlive the connections, added together
+    EXPECT_EQ(server.get_connection_stats().size(), 0);
+    SoupBinStats closed = server.get_closed_stats();
+    EXPECT_EQ(closed.connections, CLIENTS);
+    EXPECT_EQ(closed.packetsIn['L'], CLIENTS);
+    EXPECT_EQ(closed.packetsOut['S'], CLIENTS);
+    EXPECT_EQ(server.get_stats().connections, CLIENTS);
+}
@@ -0,0 +1,233 @@
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+namespace
+{
+
+/***
+ * The server side, which can drop the client or log it in past what it asked for
+ */
+class DroppingConnection : public SoupBinConnection
+{
+    public:
+    DroppingConnection(boost::asio::ip::tcp::socket socket, MessageRepeater* parent)
+            : SoupBinConnection(std::move(socket), parent) {}
+    void drop() { close_socket(); }
+    static inline std::atomic<uint64_t> acceptAt = 0;
+    static inline std::atomic<uint32_t> unsequenced = 0; // received by any connection
+
+    protected:
+    virtual void on_unsequenced_data(const soupbintcp::unsequenced_data& in) override { unsequenced++; }
+    virtual void on_login_request(const soupbintcp::login_request& in) override
+    {
+        if (acceptAt == 0)
+        {
+            SoupBinConnection::on_login_request(in);
+            return;
+        }
+        soupbintcp::login_accepted msg;
+        msg.set_int(soupbintcp::login_accepted::SEQUENCE_NUMBER, acceptAt);
+        msg.set_string(soupbintcp::login_accepted::SESSION, in.get_string(soupbintcp::login_request::REQUESTED_SESSION));
+        send(msg.get_record_as_vec());
+    }
+};
+
+class DroppingServer : public SoupBinServer<DroppingConnection>
+{
+    public:
+    DroppingServer(int32_t port) : SoupBinServer(port) {}
+    void drop_all()
+    {
+        boost::asio::post(io_context, [this]() {
+            for(auto& c : *get_connections())
+                c->drop();
+        });
+    }
+};
+
+class ReconnectingClient : public SoupBinConnection
+{
+    public:
+    ReconnectingClient(const std::string& url) : SoupBinConnection(url, "test1", "password") { connect(); }
+    std::atomic<uint32_t> disconnects = 0;
+    std::atomic<uint32_t> received = 0;
+    std::atomic<uint32_t> sendDropped = 0;
+    std::mutex mutex;
+    std::vector<uint64_t> delays;
+    std::vector<std::pair<uint64_t, uint64_t>> gaps;
+
+    protected:
+    virtual void on_sequenced_data(const soupbintcp::sequenced_data& in) override { received++; }
+    virtual void on_disconnected() override { disconnects++; }
+    virtual void on_send_dropped(const SoupBinFrame& frame) override { sendDropped++; }
+    virtual void on_reconnecting(uint32_t attempt, uint64_t delayMs) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        delays.push_back(delayMs);
+    }
+    virtual void on_sequence_gap(uint64_t first, uint64_t count) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        gaps.emplace_back(first, count);
+    }
+};
+
+void send(DroppingServer& server, int count)
+{
+    for(int i = 0; i < count; ++i)
+        server.send_sequenced({'H', 'e', 'l', 'l', 'o'});
+}
+
+} // namespace
+
+TEST(SoupBinReconnect, resume)
+{
+    DroppingConnection::acceptAt = 0;
+    DroppingServer server(9018);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ReconnectingClient client("127.0.0.1:9018");
+    client.set_reconnect(50, 200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    send(server, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client.received, 3);
+
+    // dropped, and back at 4 with nothing lost
+    server.drop_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(client.disconnects, 1);
+    EXPECT_EQ(client.status, SoupBinConnection::Status::CONNECTED);
+    EXPECT_EQ(server.get_connection_stats().back().replayFrom, 4);
+    send(server, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client.received, 5);
+    EXPECT_EQ(client.get_stats().lastSequence, 5);
+    EXPECT_EQ(client.get_stats().reconnects, 1);
+
+    // dropped again, and the server only takes us back from 10
+    DroppingConnection::acceptAt = 10;
+    server.drop_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(client.disconnects, 2);
+    EXPECT_EQ(client.get_stats().reconnects, 2);
+    EXPECT_EQ(client.get_stats().sequenceGap, 4);
+    EXPECT_EQ(client.get_stats().lastSequence, 9);
+    std::lock_guard<std::mutex> lock(client.mutex);
+    ASSERT_EQ(client.gaps.size(), 1);
+    EXPECT_EQ(client.gaps[0].first, 6);
+    EXPECT_EQ(client.gaps[0].second, 4);
+    DroppingConnection::acceptAt = 0;
+}
+
+TEST(SoupBinReconnect, joinLate)
+{
+    DroppingConnection::acceptAt = 0;
+    DroppingServer server(9027);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // already under way when the client first logs in
+    send(server, 100);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ReconnectingClient client("127.0.0.1:9027");
+    client.set_reconnect(50, 200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(client.received, 0);
+    EXPECT_EQ(client.get_stats().lastSequence, 100);
+    send(server, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client.received, 3);
+    EXPECT_EQ(client.get_stats().lastSequence, 103);
+
+    // back at 104, and the first 100 do not come again
+    server.drop_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(client.disconnects, 1);
+    EXPECT_EQ(server.get_connection_stats().back().replayFrom, 104);
+    EXPECT_EQ(server.get_connection_stats().back().replayed, 0);
+    send(server, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(client.received, 5);
+    EXPECT_EQ(client.get_stats().lastSequence, 105);
+    EXPECT_EQ(client.get_stats().sequenceGap, 0);
+}
+
+TEST(SoupBinReconnect, keepUnsequenced)
+{
+    DroppingConnection::acceptAt = 0;
+    DroppingConnection::unsequenced = 0;
+    DroppingServer server(9029);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ReconnectingClient client("127.0.0.1:9029");
+    client.set_reconnect(400, 400);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    client.send_unsequenced({'O', 'r', 'd', 'e', 'r'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(DroppingConnection::unsequenced, 1);
+
+    // sent while waiting to reconnect, kept until the login is accepted
+    server.drop_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.disconnects, 1);
+    for(int i = 0; i < 3; ++i)
+        client.send_unsequenced({'O', 'r', 'd', 'e', 'r'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.get_stats().writeQueueDepth, 3);
+    EXPECT_EQ(DroppingConnection::unsequenced, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_EQ(client.status, SoupBinConnection::Status::CONNECTED);
+    EXPECT_EQ(DroppingConnection::unsequenced, 4);
+    EXPECT_EQ(client.get_stats().writeQueueDepth, 0);
+    EXPECT_EQ(client.get_stats().writeDropped, 0);
+    EXPECT_EQ(client.sendDropped, 0);
+}
+
+TEST(SoupBinReconnect, dropUnsequenced)
+{
+    // nothing listening, and no reconnect
+    ReconnectingClient client("127.0.0.1:9030");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    client.send_unsequenced({'O', 'r', 'd', 'e', 'r'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.get_stats().writeDropped, 1);
+    EXPECT_EQ(client.get_stats().writeQueueDepth, 0);
+    EXPECT_EQ(client.sendDropped, 1);
+
+    // kept while it tries, and dropped when it gives up
+    ReconnectingClient giveUp("127.0.0.1:9030");
+    giveUp.set_reconnect(100, 100, 2);
+    giveUp.send_unsequenced({'O', 'r', 'd', 'e', 'r'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(giveUp.get_stats().writeQueueDepth, 1);
+    EXPECT_EQ(giveUp.sendDropped, 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_EQ(giveUp.get_stats().writeQueueDepth, 0);
+    EXPECT_EQ(giveUp.get_stats().writeDropped, 1);
+    EXPECT_EQ(giveUp.sendDropped, 1);
+}
+
+TEST(SoupBinReconnect, backoff)
+{
+    // nothing listening
+    ReconnectingClient client("127.0.0.1:9019");
+    client.set_reconnect(20, 80, 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    EXPECT_EQ(client.status, SoupBinConnection::Status::DISCONNECTED);
+    EXPECT_EQ(client.disconnects, 0);
+    std::lock_guard<std::mutex> lock(client.mutex);
+    EXPECT_EQ(client.delays, std::vector<uint64_t>({20, 40, 80, 80, 80}));
+}
+
+TEST(SoupBinReconnect, quietWhileDisconnected)
+{
+    // nothing listening, long enough for the heartbeat timer to fire
+    ReconnectingClient client("127.0.0.1:9025");
+    client.set_reconnect(100, 400);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    EXPECT_EQ(client.get_stats().writeQueueHighWater, 0);
+    EXPECT_EQ(client.get_stats().bytesOut, 0);
+    // one chain of attempts, each delay double the last up to the limit
+    std::lock_guard<std::mutex> lock(client.mutex);
+    ASSERT_GE(client.delays.size(), 4);
+    for(size_t i = 0; i < client.delays.size(); ++i)
+        EXPECT_EQ(client.delays[i], std::min<uint64_t>(100 << i, 400));
+}
@@ -0,0 +1,83 @@
+#include "soup_bin_server.h"
+#include "soup_bin_stats_exporter.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+
+namespace
+{
+
+std::string read_socket(const std::string& socketPath)
+{
+    boost::asio::io_context ctx;
+    boost::asio::local::stream_protocol::socket skt(ctx);
+    skt.connect(boost::asio::local::stream_protocol::endpoint(socketPath));
+    std::string retVal;
+    boost::system::error_code ec;
+    char buf[4096];
+    while(!ec)
+    {
+        size_t length = skt.read_some(boost::asio::buffer(buf), ec);
+        retVal.append(buf, length);
+    }
+    return retVal;
+}
+
+} // namespace
+
+TEST(SoupBinStats, counters)
+{
+    SoupBinServer<SoupBinConnection> server(9015);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    SoupBinConnection client("127.0.0.1:9015", "test1", "password");
+    client.connect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(int i = 0; i < 5; ++i)
+        server.send_sequenced({'H', 'e', 'l', 'l', 'o'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    SoupBinStats clientStats = client.get_stats();
+    EXPECT_EQ(clientStats.packetsIn['A'], 1);
+    EXPECT_EQ(clientStats.packetsIn['S'], 5);
+    EXPECT_EQ(clientStats.packetsOut['L'], 1);
+    EXPECT_EQ(clientStats.lastSequence, 5);
+    EXPECT_EQ(clientStats.sequenceGap, 0);
+    EXPECT_GE(clientStats.bytesIn, 5 * 8);
+    EXPECT_LT(clientStats.msSinceReceive, 1500);
+
+    // a second client picks up from 2, and is sent the rest again
+    SoupBinConnection late("127.0.0.1:9015", "test1", "password", "", 2);
+    late.connect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(late.get_stats().packetsIn['S'], 4);
+    EXPECT_EQ(late.get_stats().lastSequence, 5);
+
+    std::vector<SoupBinStats> each = server.get_connection_stats();
+    ASSERT_EQ(each.size(), 2);
+    EXPECT_EQ(each[0].packetsOut['S'], 5);
+    EXPECT_EQ(each[0].replayed, 0);
+    EXPECT_EQ(each[1].replayFrom, 2);
+    EXPECT_EQ(each[1].replayed, 4);
+    SoupBinStats total = server.get_stats();
+    EXPECT_EQ(total.connections, 2);
+    EXPECT_EQ(total.packetsOut['S'], 9);
+    EXPECT_EQ(total.packetsIn['L'], 2);
+    EXPECT_EQ(total.writeQueueDepth, 0);
+    EXPECT_GE(total.writeQueueHighWater, 1);
+    EXPECT_EQ(total.lastSequence, 5);
+
+    std::string socketPath = (std::filesystem::temp_directory_path() / "soup_bin_stats.sock").string();
+    {
+        SoupBinStatsExporter exporter(socketPath, [&server]() { return server.get_stats_text(); });
+        std::string text = read_socket(socketPath);
+        EXPECT_NE(text.find("soupbin_connections{connection=\"total\"} 2\n"), std::string::npos) << text;
+        EXPECT_NE(text.find("soupbin_packets_out{connection=\"total\",type=\"S\"} 9\n"), std::string::npos);
+        EXPECT_NE(text.find("soupbin_replayed{connection=\"1\"} 4\n"), std::string::npos);
+        EXPECT_NE(text.find("soupbin_connections{connection=\"closed\"} 0\n"), std::string::npos);
+        // and again
+        EXPECT_NE(read_socket(socketPath).find("soupbin_bytes_out"), std::string::npos);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_EQ(exporter.get_requests(), 2);
+    }
+    EXPECT_FALSE(std::filesystem::exists(socketPath));
+}
@@ -0,0 +1,227 @@
+#include "soup_bin_server.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+
+/***
+ * A client that logs in and then only reads when it is told to
+ */
+class SlowClient
+{
+    public:
+    SlowClient(int port, bool loginNow = true)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int small = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+        timeval timeout{ 5, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected = connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+        if (loginNow)
+            login();
+    }
+    /***
+     * @param requestedSeq the sequence number to replay from, 0 for none
+     */
+    void login(uint64_t requestedSeq = 0)
+    {
+        soupbintcp::login_request req;
+        req.set_string(soupbintcp::login_request::USERNAME, "test1");
+        req.set_string(soupbintcp::login_request::PASSWORD, "password");
+        req.set_int(soupbintcp::login_request::REQUESTED_SEQUENCE_NUMBER, requestedSeq);
+        std::vector<unsigned char> bytes = req.get_record_as_vec();
+        connected = connected && write(fd, bytes.data(), bytes.size()) == (ssize_t)bytes.size();
+    }
+    ~SlowClient() { close(fd); }
+    /***
+     * @brief read frames until stop returns true, the server closes, or nothing comes for 5 seconds
+     * @param stop called with the type and payload of each frame
+     */
+    template<typename F>
+    void read(F&& stop)
+    {
+        while(true)
+        {
+            unsigned char header[2];
+            if (!read_fully(header, 2))
+                return;
+            std::vector<unsigned char> frame(header[0] << 8 | header[1]);
+            if (!read_fully(frame.data(), frame.size()))
+                return;
+            if (stop(frame[0], std::string(frame.begin() + 1, frame.end())))
+                return;
+        }
+    }
+    bool connected = false;
+
+    protected:
+    bool read_fully(unsigned char* out, size_t length)
+    {
+        while(length > 0)
+        {
+            ssize_t got = recv(fd, out, length, 0);
+            if (got <= 0)
+                return false;
+            out += got;
+            length -= got;
+        }
+        return true;
+    }
+    int fd = -1;
+};
+
+const int MESSAGES = 20000;
+
+/***
+ * Numbered, and big enough to fill the socket buffers
+ */
+void publish(SoupBinServer<SoupBinConnection>& server, int from, int to)
+{
+    std::vector<unsigned char> bytes(1000, 'x');
+    for(int i = from; i < to; ++i)
+    {
+        std::string number = std::to_string(i);
+        std::copy(number.begin(), number.end(), bytes.begin());
+        bytes[number.size()] = ' ';
+        server.send_sequenced(bytes);
+    }
+}
+
+} // namespace
+
+TEST(SoupBinWriteLimit, disconnect)
+{
+    SoupBinServer<SoupBinConnection> server(9020);
+    SoupBinWriteLimit limit;
+    limit.maxBytes = 1024 * 1024;
+    server.set_write_limit(limit);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    SlowClient slow(9020);
+    ASSERT_TRUE(slow.connected);
+    SoupBinConnection fast("127.0.0.1:9020", "test1", "password");
+    fast.connect();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // in bursts the fast one can keep up with
+    for(int i = 1; i <= MESSAGES; i += 200)
+    {
+        publish(server, i, i + 200);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    // the slow one is gone, the fast one has everything
+    SoupBinStats closed = server.get_closed_stats();
+    EXPECT_EQ(closed.connections, 1);
+    EXPECT_EQ(closed.writeLimitHits, 1);
+    EXPECT_LE(closed.writeQueueBytesHighWater, limit.maxBytes);
+    std::vector<SoupBinStats> each = server.get_connection_stats();
+    ASSERT_EQ(each.size(), 1);
+    EXPECT_EQ(each[0].writeLimitHits, 0);
+    EXPECT_EQ(fast.get_stats().packetsIn['S'], MESSAGES);
+    EXPECT_NE(server.get_stats_text().find("soupbin_write_limit_hits{connection=\"total\"} 1\n"), std::string::npos);
+}
+
+TEST(SoupBinWriteLimit, pauseAndReplay)
+{
+    SoupBinServer<SoupBinConnection> server(9021);
+    SoupBinWriteLimit limit;
+    limit.maxPackets = 500;
+    limit.policy = SoupBinWriteLimit::Policy::PAUSE_AND_REPLAY;
+    server.set_write_limit(limit);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    SlowClient slow(9021);
+    ASSERT_TRUE(slow.connected);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    publish(server, 1, MESSAGES + 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    SoupBinStats stats = server.get_stats();
+    EXPECT_GE(stats.writeLimitHits, 1);
+    EXPECT_LE(stats.writeQueueHighWater, limit.maxPackets);
+
+    // catching up gets everything, in order
+    int expected = 1;
+    slow.read([&expected](char type, const std::string& payload) {
+        if (type != 'S')
+            return false;
+        EXPECT_EQ(std::stoi(payload), expected);
+        return ++expected > MESSAGES;
+    });
+    EXPECT_EQ(expected, MESSAGES + 1);
+    EXPECT_GT(server.get_stats().replayed, 0);
+}
+
+TEST(SoupBinWriteLimit, conflate)
+{
+    SoupBinServer<SoupBinConnection> server(9022);
+    SoupBinWriteLimit limit;
+    limit.maxBytes = 1024 * 1024;
+    limit.policy = SoupBinWriteLimit::Policy::CONFLATE;
+    server.set_write_limit(limit);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    SlowClient slow(9022);
+    ASSERT_TRUE(slow.connected);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    publish(server, 1, MESSAGES + 1);
+    server.send_conflated({'s', 'n', 'a', 'p'});
+
+    // some of the stream, then only the conflated data
+    int sequenced = 0;
+    std::string last;
+    slow.read([&](char type, const std::string& payload) {
+        if (type == 'S')
+            sequenced++;
+        if (type != 'U')
+            return false;
+        last = payload;
+        return true;
+    });
+    EXPECT_EQ(last, "snap");
+    EXPECT_GT(sequenced, 0);
+    EXPECT_LT(sequenced, MESSAGES);
+    SoupBinStats stats = server.get_stats();
+    EXPECT_EQ(stats.writeLimitHits, 1);
+    EXPECT_EQ(stats.writeDropped + sequenced, MESSAGES);
+}
+
+TEST(SoupBinWriteLimit, replayAfterLateLogin)
+{
+    SoupBinServer<SoupBinConnection> server(9024);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    publish(server, 0, 3);
+    SlowClient client(9024, false);
+    ASSERT_TRUE(client.connected);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    // published after the connection was accepted, but before it logged in
+    publish(server, 3, 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    client.login(1);
+    ASSERT_TRUE(client.connected);
+    std::string types;
+    std::vector<int> numbers;
+    client.read([&](char type, const std::string& payload) {
+        if (type == 'H')
+            return false;
+        types += type;
+        if (type == 'S')
+            numbers.push_back(std::stoi(payload));
+        return numbers.size() == 4;
+    });
+    EXPECT_EQ(types, "ASSSS");
+    std::vector<int> expected{0, 1, 2, 3};
+    EXPECT_EQ(numbers, expected);
+    std::vector<SoupBinStats> each = server.get_connection_stats();
+    ASSERT_EQ(each.size(), 1);
+    EXPECT_EQ(each[0].replayFrom, 1);
+    EXPECT_EQ(each[0].replayed, 4);
+    EXPECT_EQ(each[0].lastSequence, 4);
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include "soup_bin_server.h"
 #include "soup_bin_client.h"
+#include <map>
 #include <thread>
 
 class MyConnection : public SoupBinConnection
@@ -9,7 +10,10 @@ class MyConnection : public SoupBinConnection
     MyConnection(boost::asio::ip::tcp::socket socket, MessageRepeater* parent) : SoupBinConnection(std::move(socket), parent) {}
     MyConnection(const std::string& url, const std::string& username, const std::string& password, 
             const std::string& sessionId, uint64_t seqNum) 
-            : SoupBinConnection(url, username, password, sessionId, seqNum) {}
+            : SoupBinConnection(url, username, password, sessionId, seqNum)
+    {
+        connect();
+    }
     virtual void on_client_heartbeat(const soupbintcp::client_heartbeat& in) override
     {
         numClientHeartbeats++;
@@ -41,14 +45,14 @@ class MySoupBinServer : public SoupBinServer<MyConnection>
     uint32_t GetNumClientHeartbeats()
     {
         uint32_t total = 0;
-        for(auto c : connections)
+        for(auto c : *get_connections())
             total += c->numClientHeartbeats;
         return total;
     }
     uint32_t GetNumServerHeartbeats()
     {
         uint32_t total = 0;
-        for(auto c : connections)
+        for(auto c : *get_connections())
             total += c->numServerHeartbeats;
         return total;
     }
@@ -164,3 +168,53 @@ TEST(SoupBinServer, ServerReconnect)
     std::this_thread::sleep_for(std::chrono::milliseconds(500));
     EXPECT_EQ(client->GetCurrentSequenceNo(), 4);
 }
+
+TEST(SoupBinServer, FanOut)
+{
+    // the same bytes as building the packet
+    std::vector<unsigned char> payload = {'H', 'e', 'l', 'l', 'o'};
+    soupbintcp::sequenced_data data;
+    data.set_message(payload);
+    EXPECT_EQ(*SoupBinConnection::make_frame('S', payload), data.get_record_as_vec());
+
+    // what a client got, by sequence number
+    auto received = [](MySoupBinClient& client) {
+        std::map<uint64_t, std::string> retVal;
+        for(const auto& msg : client.GetMessages())
+            retVal[msg.first] = std::string(msg.second.begin(), msg.second.end());
+        return retVal;
+    };
+    // HelloN goes out as N + 1
+    auto expected = [](int from, int to) {
+        std::map<uint64_t, std::string> retVal;
+        for(int i = from; i < to; ++i)
+            retVal[i + 1] = "Hello" + std::to_string(i);
+        return retVal;
+    };
+
+    MySoupBinServer server(9016);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::vector<std::shared_ptr<MySoupBinClient>> clients;
+    for(int i = 0; i < 4; ++i)
+        clients.push_back(std::make_shared<MySoupBinClient>("127.0.0.1:9016", "test1", "password"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(int i = 0; i < 10; ++i)
+    {
+        std::string msg = "Hello" + std::to_string(i);
+        server.send_sequenced(std::vector<unsigned char>(msg.begin(), msg.end()));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    for(auto& client : clients)
+        EXPECT_EQ(received(*client), expected(0, 10));
+    // and a late one gets the stored frames again
+    auto late = std::make_shared<MySoupBinClient>("127.0.0.1:9016", "test1", "password", "", 6);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(received(*late), expected(5, 10));
+    // one that asks for nothing is numbered from what goes out next
+    auto joined = std::make_shared<MySoupBinClient>("127.0.0.1:9016", "test1", "password");
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(joined->GetCurrentSequenceNo(), 11);
+    server.send_sequenced({'H', 'e', 'l', 'l', 'o', '1', '0'});
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    EXPECT_EQ(received(*joined), expected(10, 11));
+}